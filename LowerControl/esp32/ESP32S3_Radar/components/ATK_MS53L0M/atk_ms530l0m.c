@@ -7,6 +7,8 @@
 #include "sdkconfig.h"
 
 #include "radar_uart.h"
+#include "radar_latency.h"
+#include "radar_trace.h"
 #include "atk_ms53l0m.h"
 
 static const char *TAG = "atk_ms53l0m";
@@ -49,15 +51,12 @@ static inline uint16_t atk_ms53l0m_crc_check_sum(uint8_t *buf, uint16_t len)
  * @param       recv_len: 需要解析的数据包长度
  * 
  * @retval      ATK_MS53L0M_EOK     : 没有错误
- * @retval      ATK_MS53L0M_ETIMEOUT: 接收数据超时
  * @retval      ATK_MS53L0M_EFRAME  : 帧错误
  * @retval      ATK_MS53L0M_ECRC    : CRC校验错误
  * @retval      ATK_MS53L0M_EOPT    : 操作错误
  */
-static uint8_t atk_ms53l0m_unpack_recv_data(uint16_t *const dat)
+static uint8_t atk_ms53l0m_parse_recv_data(uint16_t *const dat, uint8_t *recv_dat, size_t recv_len)
 {
-    uint8_t* recv_dat;
-    size_t recv_len;
     uint16_t frame_loop = 0;
     int frame_head_index;
     uint16_t frame_len;
@@ -65,15 +64,6 @@ static uint8_t atk_ms53l0m_unpack_recv_data(uint16_t *const dat)
     uint16_t dat_len;
     uint16_t frame_check_sum;
     uint16_t check_sum;
-
-    /* 等待数据信号量 */
-    if (! xSemaphoreTake(g_uart_rx_atk_ms53l0m_frame.xBinarySemaphore, WAITTIME))
-        return ATK_MS53L0M_ETIMEOUT;
-    else
-    {
-        recv_dat = g_uart_rx_atk_ms53l0m_frame.buf;
-        recv_len = g_uart_rx_atk_ms53l0m_frame.len;
-    }
     
     /* 获取接收数据的长度 */
     if ((recv_len < ATK_MS53L0M_FRAME_LEN_MIN) || (recv_len > ATK_MS53L0M_FRAME_LEN_MAX))
@@ -195,6 +185,38 @@ static uint8_t atk_ms53l0m_unpack_recv_data(uint16_t *const dat)
     }
 }
 
+/**
+ * @brief       等待并解析接收到的数据包
+ * @param       dat     : 读操作时，读取到的数据要存入的地址
+ * 
+ * @retval      ATK_MS53L0M_EOK     : 没有错误
+ * @retval      ATK_MS53L0M_ETIMEOUT: 接收数据超时
+ * @retval      ATK_MS53L0M_EFRAME  : 帧错误
+ * @retval      ATK_MS53L0M_ECRC    : CRC校验错误
+ * @retval      ATK_MS53L0M_EOPT    : 操作错误
+ */
+static uint8_t atk_ms53l0m_unpack_recv_data(uint16_t *const dat)
+{
+    /* 等待数据信号量 */
+    if (! xSemaphoreTake(g_uart_rx_atk_ms53l0m_frame.xBinarySemaphore, WAITTIME))
+        return ATK_MS53L0M_ETIMEOUT;
+    
+    return atk_ms53l0m_parse_recv_data(dat, g_uart_rx_atk_ms53l0m_frame.buf, g_uart_rx_atk_ms53l0m_frame.len);
+}
+
+#if CONFIG_RADAR_BENCH
+/* 供基准测试调用的内部函数，见components/Radar_Bench */
+uint16_t atk_ms53l0m_bench_check_sum(uint8_t *buf, uint16_t len)
+{
+    return atk_ms53l0m_crc_check_sum(buf, len);
+}
+
+uint8_t atk_ms53l0m_bench_parse_recv_data(uint16_t *const dat, uint8_t *recv_dat, size_t recv_len)
+{
+    return atk_ms53l0m_parse_recv_data(dat, recv_dat, recv_len);
+}
+#endif
+
 /**
  * @brief       将UART接收到的数据拷贝到全局接收帧缓冲中
  * @param       uart_num: ATK-MS53L0M连接的UART端口号
@@ -233,6 +255,8 @@ uint8_t atk_ms53l0m_read_data(uint16_t addr, uint8_t fun_code, uint8_t len, uint
 {
     uint16_t check_sum;
     uint8_t buf[9];
+    uint8_t ret;
+    int64_t start;
     
     buf[0] = ATK_MS53L0M_MASTER_FRAME_HEAD;              /* 标志头 */
     buf[1] = ATK_MS53L0M_SENSOR_TYPE;                    /* 传感器类型 */
@@ -247,10 +271,15 @@ uint8_t atk_ms53l0m_read_data(uint16_t addr, uint8_t fun_code, uint8_t len, uint
     buf[7] = (uint8_t)(check_sum >> 8);                  /* CRC校验码，高8位 */
     buf[8] = (uint8_t)(check_sum & 0xFF);                /* CRC校验码，低8位 */
 
+    start = Radar_latency_now();
+    Radar_trace(RADAR_TRACE_SENSOR_TX, fun_code, addr);
     uart_write_bytes(g_uart_num, buf, 9);                /* 发送数据 */
     
     xSemaphoreTake(g_uart_rx_atk_ms53l0m_frame.xBinarySemaphore, 0); /* 清空信号量准备接收数据 */
-    return atk_ms53l0m_unpack_recv_data(dat);            /* 解析应答数据 */
+    ret = atk_ms53l0m_unpack_recv_data(dat);             /* 解析应答数据 */
+    Radar_latency_record(RADAR_LATENCY_SENSOR, Radar_latency_now() - start); /* 传感器往返时间 */
+    Radar_trace(RADAR_TRACE_SENSOR_RX, ret, (ret == ATK_MS53L0M_EOK) ? dat[0] : 0);
+    return ret;
 }
 
 /**
@@ -2,6 +2,7 @@
 #define _ATK_MS53L0M_H_
 
 #include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
 
 /* ATK-MS53L0M模块功能码 */
 enum
@@ -106,6 +107,11 @@ uint8_t atk_ms53l0m_init(uart_port_t uart_num, uint16_t *id);/* ATK-MS53L0M初
 uint8_t atk_ms53l0m_read_data(uint16_t addr, uint8_t fun_code, uint8_t len, uint16_t *dat);/* 根据模块功能码读取数据 */
 uint8_t atk_ms53l0m_write_data(uint16_t addr, uint8_t fun_code, uint8_t dat);/* 根据模块功能码写入1字节数据 */
 uint8_t atk_ms53l0m_modbus_get_data(uint16_t addr, uint16_t *dat);/* ATK-MS53L0M Modbus工作模式获取测量值 */
+
+#if CONFIG_RADAR_BENCH
+uint16_t atk_ms53l0m_bench_check_sum(uint8_t *buf, uint16_t len);/* 基准测试：CRC校验和 */
+uint8_t atk_ms53l0m_bench_parse_recv_data(uint16_t *const dat, uint8_t *recv_dat, size_t recv_len);/* 基准测试：解析数据包 */
+#endif
 /* ATK-MS53L0M Normal工作模式获取测量值 */
 
 #endif
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef _RADAR_BENCH_H_
+#define _RADAR_BENCH_H_
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+/*
+ * Microbenchmarks of the hot kernels, for the ESP32S3 and for Linux (host/bench/bench_kernels):
+ * the Modbus and ATK-MS53L0M checksums and frame parsers, the Modbus answer encoders, the servo
+ * angle to duty conversion and the sweep stages (coordinates, codecs, sector tree, occupancy grid).
+ * A kernel runs rounds of a fixed amount of work timed with the CPU cycle counter; the result is
+ * the median round divided by the bytes or points it handled.
+ */
+
+typedef struct {
+    const char* name;               /* Kernel, e.g. "modbus_parse_write" */
+    const char* unit;               /* "byte" or "point" */
+    uint32_t units;                 /* Bytes or points handled by one round */
+    float cycles_per_unit;          /* Median round */
+    float min_cycles_per_unit;      /* Fastest round */
+} Radar_bench_result_t;
+
+typedef void(* pRadar_bench_Report_t)(const Radar_bench_result_t* result);
+
+uint32_t Radar_bench_run(uint8_t rounds, const char* filter, pRadar_bench_Report_t report); /* kernels run */
+void Radar_bench_print(const Radar_bench_result_t* result); /* "bench_<kernel>_cycles_per_<unit> value" lines */
+
+#endif
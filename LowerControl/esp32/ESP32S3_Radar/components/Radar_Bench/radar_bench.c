@@ -0,0 +1,428 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "mod_bus.h"
+#include "atk_ms53l0m.h"
+#include "steering_control.h"
+#include "sweep_cartesian.h"
+#include "sweep_codec.h"
+#include "sweep_change.h"
+#include "sweep_query.h"
+#include "occupancy_grid.h"
+#include "radar_bench.h"
+
+#define BENCH_ROUNDS_MAX        31
+#define BENCH_SWEEP_COUNT       181     /* 180° scope at 1° step */
+#define BENCH_FRAME_MAX         255     /* Modbus data field */
+#define BENCH_WRITE_DATA_LEN    64      /* Data of the parsed write request and of the encoded answer */
+#define BENCH_GRID_SIZE         64      /* Occupancy grid edge (cells) */
+#define BENCH_GRID_RESOLUTION   50      /* mm */
+
+static const char *TAG = "radar_bench";
+
+/* Inputs and state of every kernel, on the heap for the run only */
+typedef struct {
+    Radar_sweep_t sweep[2];                 /* Two noisy scans of the same room */
+    Sweep_cartesian_table_t table;
+    Sweep_point_xy_t xy[RADAR_SWEEP_POINT_MAX];
+    Sweep_change_t change;
+    Sweep_query_t query;
+    Occupancy_grid_t grid;
+    void* grid_memory;
+    xSteering_arguments_t servo;
+    Modbus_reply_t reply;                   /* Answers go to Radar_bench_sink */
+    Modbus_request_t request;
+    uint8_t data[BENCH_FRAME_MAX];          /* Checksum input and answer data */
+    uint8_t frame[BENCH_FRAME_MAX + 10];    /* Encoder output */
+    uint8_t modbus_read[9];                 /* Device address read */
+    uint8_t modbus_write[2 + BENCH_WRITE_DATA_LEN + 9];    /* Two bytes of line noise, then a write */
+    uint8_t atk_answer[12];                 /* Measurement answer */
+} Radar_bench_ctx_t;
+
+typedef struct {
+    const char* name;
+    const char* unit;
+    uint32_t (*fun)(Radar_bench_ctx_t* ctx);   /* One round, returns the bytes or points handled */
+} Radar_bench_kernel_t;
+
+static volatile uint32_t g_bench_sink;      /* Every result ends here, so no kernel is optimized away */
+static uint32_t g_bench_rand = 0x12345678;
+
+static float Radar_bench_rand(void)
+{
+    g_bench_rand ^= g_bench_rand << 13;
+    g_bench_rand ^= g_bench_rand >> 17;
+    g_bench_rand ^= g_bench_rand << 5;
+    return (float)g_bench_rand / 4294967296.0f;
+}
+
+/**
+ * @brief       Transport send function of the bench reply handle
+ */
+static void Radar_bench_sink(const Modbus_reply_t* reply, const uint8_t* data, size_t len)
+{
+    (void)reply;
+    g_bench_sink += data[len - 1];
+}
+
+/**
+ * @brief       Close a frame with the additive checksum of every byte before it
+ */
+static void Radar_bench_close_frame(uint8_t* frame, size_t len)
+{
+    uint16_t sum = 0;
+
+    for (size_t i = 0; i < len; i++)
+        sum += frame[i];
+    frame[len] = (uint8_t)(sum >> 8);
+    frame[len + 1] = (uint8_t)(sum & 0xFF);
+}
+
+/**
+ * @brief       A 4 m x 3 m room seen from the middle of a wall, a box in front, 3 mm noise
+ *              and a few failed measurements
+ */
+static void Radar_bench_make_sweep(Radar_sweep_t* sweep, uint32_t sequence)
+{
+    memset(sweep, 0, sizeof(*sweep));
+    sweep->sequence = sequence;
+    sweep->step = 1;
+    sweep->direction = 1;
+    sweep->count = BENCH_SWEEP_COUNT;
+    for (uint16_t i = 0; i < BENCH_SWEEP_COUNT; i++)
+    {
+        float a = (float)i * (float)M_PI / 180.0f;
+        float c = fabsf(cosf(a));
+        float s = sinf(a);
+        float d = 8000.0f;
+
+        if (c > 1e-3f)
+            d = 2000.0f / c;
+        if ((s > 1e-3f) && (3000.0f / s < d))
+            d = 3000.0f / s;
+        if ((i >= 80) && (i <= 100))
+            d = 600.0f;
+        d += (Radar_bench_rand() * 2.0f - 1.0f) * 3.0f;
+        sweep->distance[i] = (Radar_bench_rand() < 0.02f) ? RADAR_SWEEP_INVALID_DISTANCE
+                                                          : (uint16_t)(d > 8000.0f ? 8000.0f : d);
+    }
+}
+
+/**
+ * @brief       Build the inputs of every kernel
+ */
+static bool Radar_bench_prepare(Radar_bench_ctx_t* ctx)
+{
+    Occupancy_grid_config_t grid_config = {
+        .resolution_mm = BENCH_GRID_RESOLUTION,
+        .width = BENCH_GRID_SIZE,
+        .height = BENCH_GRID_SIZE,
+        .origin_x = BENCH_GRID_SIZE / 2,
+        .origin_y = 0,
+    };
+    float total_duty = (float)(1u << CONFIG_STEERING_DUTY_RESOLUTION);
+    uint16_t dat;
+    uint8_t* p;
+
+    for (size_t i = 0; i < sizeof(ctx->data); i++)
+        ctx->data[i] = (uint8_t)(i * 37 + 11);
+    Radar_bench_make_sweep(&ctx->sweep[0], 0);
+    Radar_bench_make_sweep(&ctx->sweep[1], 1);
+    Sweep_cartesian_table_init(&ctx->table, 0, 1, BENCH_SWEEP_COUNT);
+    Sweep_query_init(&ctx->query, 0, 1, BENCH_SWEEP_COUNT);
+    ctx->grid_memory = malloc(Occupancy_grid_memory_size(&grid_config));
+    if (Occupancy_grid_init(&ctx->grid, &grid_config, ctx->grid_memory) != OCCUPANCY_EOK)
+        return false;
+
+    /* The servo arguments of vSteering_init */
+    ctx->servo.angle_scope = CONFIG_STEERING_ANGLE_SCOPE;
+    ctx->servo.angle_base_dutyNum = (float)CONFIG_STEERING_MIN_HIGH_TIME * (float)CONFIG_STEERING_BASE_FREQUENCY *
+                                    total_duty / 1000000.0f;
+    ctx->servo.angle_max_dutyNum = (float)CONFIG_STEERING_MAX_HIGH_TIME * (float)CONFIG_STEERING_BASE_FREQUENCY *
+                                   total_duty / 1000000.0f;
+    ctx->servo.angle_step_long = (ctx->servo.angle_max_dutyNum - ctx->servo.angle_base_dutyNum) /
+                                 CONFIG_STEERING_ANGLE_SCOPE;
+
+    ctx->reply.send = Radar_bench_sink;     /* timing all 0: no latency records */
+
+    /* 51 0B addr(2) 00 fun len cs(2) */
+    p = ctx->modbus_read;
+    p[0] = MODBUS_MASTER_FRAME_HEAD;
+    p[1] = MODBUS_SENSOR_TYPE;
+    p[2] = 0x00;
+    p[3] = 0x01;
+    p[4] = MODBUS_OPT_READ;
+    p[5] = MODBUS_FUNCODE_IDSET;
+    p[6] = 2;
+    Radar_bench_close_frame(p, 7);
+
+    /* noise(2) 51 0B addr(2) 01 fun len data cs(2) */
+    p = ctx->modbus_write;
+    p[0] = 0x00;
+    p[1] = 0x55;
+    p += 2;
+    p[0] = MODBUS_MASTER_FRAME_HEAD;
+    p[1] = MODBUS_SENSOR_TYPE;
+    p[2] = 0x00;
+    p[3] = 0x01;
+    p[4] = MODBUS_OPT_WRITE;
+    p[5] = MODBUS_FUNCODE_CAPTURE;
+    p[6] = BENCH_WRITE_DATA_LEN;
+    memcpy(&p[7], ctx->data, BENCH_WRITE_DATA_LEN);
+    Radar_bench_close_frame(p, 7 + BENCH_WRITE_DATA_LEN);
+
+    /* 55 0B addr(2) 00 fun status len data(2) cs(2) */
+    p = ctx->atk_answer;
+    p[0] = ATK_MS53L0M_SLAVE_FRAME_HEAD;
+    p[1] = ATK_MS53L0M_SENSOR_TYPE;
+    p[2] = 0x00;
+    p[3] = 0x01;
+    p[4] = ATK_MS53L0M_OPT_READ;
+    p[5] = ATK_MS53L0M_FUNCODE_MEAUDATA;
+    p[6] = 0x00;
+    p[7] = 2;
+    p[8] = 0x05;
+    p[9] = 0xE2;
+    Radar_bench_close_frame(p, 10);
+
+    /* The parsers must take their success path, or the numbers are those of the error paths */
+    return (Modbus_bench_judgment_recv_data(&ctx->request, ctx->modbus_read, sizeof(ctx->modbus_read)) == MODBUS_EOK) &&
+           (Modbus_bench_judgment_recv_data(&ctx->request, ctx->modbus_write, sizeof(ctx->modbus_write)) == MODBUS_EOK) &&
+           (atk_ms53l0m_bench_parse_recv_data(&dat, ctx->atk_answer, sizeof(ctx->atk_answer)) == ATK_MS53L0M_EOK);
+}
+
+static uint32_t Radar_bench_modbus_checksum(Radar_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 64; i++)
+        g_bench_sink += Modbus_bench_check_sum(ctx->data, sizeof(ctx->data));
+    return 64 * sizeof(ctx->data);
+}
+
+static uint32_t Radar_bench_atk_checksum(Radar_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 64; i++)
+        g_bench_sink += atk_ms53l0m_bench_check_sum(ctx->data, sizeof(ctx->data));
+    return 64 * sizeof(ctx->data);
+}
+
+static uint32_t Radar_bench_modbus_parse_read(Radar_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 1024; i++)
+        g_bench_sink += Modbus_bench_judgment_recv_data(&ctx->request, ctx->modbus_read, sizeof(ctx->modbus_read));
+    return 1024 * sizeof(ctx->modbus_read);
+}
+
+static uint32_t Radar_bench_modbus_parse_write(Radar_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 256; i++)
+        g_bench_sink += Modbus_bench_judgment_recv_data(&ctx->request, ctx->modbus_write, sizeof(ctx->modbus_write));
+    return 256 * sizeof(ctx->modbus_write);
+}
+
+static uint32_t Radar_bench_atk_parse_answer(Radar_bench_ctx_t* ctx)
+{
+    uint16_t dat;
+
+    for (int i = 0; i < 1024; i++)
+    {
+        g_bench_sink += atk_ms53l0m_bench_parse_recv_data(&dat, ctx->atk_answer, sizeof(ctx->atk_answer));
+        g_bench_sink += dat;
+    }
+    return 1024 * sizeof(ctx->atk_answer);
+}
+
+/* Frame bytes written, 10 around the data */
+static uint32_t Radar_bench_modbus_encode_buffer(Radar_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 256; i++)
+        Modbus_back_read_buffer(&ctx->reply, MODBUS_FUNCODE_CAPTURE, ctx->data, BENCH_WRITE_DATA_LEN);
+    return 256 * (BENCH_WRITE_DATA_LEN + 10);
+}
+
+static uint32_t Radar_bench_modbus_encode_message(Radar_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 1024; i++)
+        Modbus_back_read_message(&ctx->reply, MODBUS_FUNCODE_IDSET, 2, (uint16_t)i);
+    return 1024 * 12;
+}
+
+static uint32_t Radar_bench_servo_duty(Radar_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 16; i++)
+    {
+        for (uint16_t angle = 0; angle < BENCH_SWEEP_COUNT; angle++)
+            g_bench_sink += iSteering_bench_AngleToDutyNum(&ctx->servo, angle);
+    }
+    return 16 * BENCH_SWEEP_COUNT;
+}
+
+static uint32_t Radar_bench_sweep_fletcher16(Radar_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 64; i++)
+        g_bench_sink += Sweep_codec_fletcher16(ctx->data, sizeof(ctx->data));
+    return 64 * sizeof(ctx->data);
+}
+
+static uint32_t Radar_bench_sweep_cartesian(Radar_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 32; i++)
+        g_bench_sink += Sweep_cartesian_to_xy(&ctx->table, &ctx->sweep[i & 1], 0, BENCH_SWEEP_COUNT, ctx->xy);
+    return 32 * BENCH_SWEEP_COUNT;
+}
+
+static uint32_t Radar_bench_sweep_codec(Radar_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 32; i++)
+    {
+        uint16_t first_bin = 0;
+
+        while (first_bin < BENCH_SWEEP_COUNT)
+            g_bench_sink += Sweep_codec_encode(&ctx->sweep[i & 1], &first_bin, ctx->frame, BENCH_FRAME_MAX);
+    }
+    return 32 * BENCH_SWEEP_COUNT;
+}
+
+/* Alternating the two scans, every sweep after the keyframe is a delta of the noisy bins */
+static uint32_t Radar_bench_sweep_change(Radar_bench_ctx_t* ctx)
+{
+    Sweep_change_init(&ctx->change, 2, 0);
+    for (int i = 0; i < 32; i++)
+    {
+        size_t len;
+
+        ctx->sweep[i & 1].sequence = i;
+        do
+        {
+            len = Sweep_change_encode(&ctx->change, &ctx->sweep[i & 1], ctx->frame, BENCH_FRAME_MAX);
+            g_bench_sink += len;
+        } while ((len > 2) && (ctx->frame[2] & SWEEP_CHANGE_FLAG_MORE));
+    }
+    return 32 * BENCH_SWEEP_COUNT;
+}
+
+static uint32_t Radar_bench_sweep_query(Radar_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 32; i++)
+    {
+        for (uint16_t bin = 0; bin < BENCH_SWEEP_COUNT; bin++)
+            Sweep_query_update(&ctx->query, bin, ctx->sweep[i & 1].distance[bin]);
+    }
+    g_bench_sink += ctx->query.node[1].min;
+    return 32 * BENCH_SWEEP_COUNT;
+}
+
+static uint32_t Radar_bench_occupancy(Radar_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 4; i++)
+        Occupancy_grid_update(&ctx->grid, &ctx->sweep[i & 1]);
+    g_bench_sink += ctx->grid.version;
+    return 4 * BENCH_SWEEP_COUNT;
+}
+
+static const Radar_bench_kernel_t g_bench_kernels[] = {
+    { "modbus_checksum",        "byte",  Radar_bench_modbus_checksum },
+    { "atk_checksum",           "byte",  Radar_bench_atk_checksum },
+    { "modbus_parse_read",      "byte",  Radar_bench_modbus_parse_read },
+    { "modbus_parse_write",     "byte",  Radar_bench_modbus_parse_write },
+    { "atk_parse_answer",       "byte",  Radar_bench_atk_parse_answer },
+    { "modbus_encode_buffer",   "byte",  Radar_bench_modbus_encode_buffer },
+    { "modbus_encode_message",  "byte",  Radar_bench_modbus_encode_message },
+    { "servo_angle_to_duty",    "point", Radar_bench_servo_duty },
+    { "sweep_fletcher16",       "byte",  Radar_bench_sweep_fletcher16 },
+    { "sweep_cartesian_xy",     "point", Radar_bench_sweep_cartesian },
+    { "sweep_codec_encode",     "point", Radar_bench_sweep_codec },
+    { "sweep_change_encode",    "point", Radar_bench_sweep_change },
+    { "sweep_query_update",     "point", Radar_bench_sweep_query },
+    { "occupancy_update",       "point", Radar_bench_occupancy },
+};
+
+/**
+ * @brief       Time one kernel: a warm-up round, then rounds timed with the cycle counter
+ */
+static void Radar_bench_time(Radar_bench_ctx_t* ctx, const Radar_bench_kernel_t* kernel, uint8_t rounds,
+                             Radar_bench_result_t* result)
+{
+    uint32_t cycles[BENCH_ROUNDS_MAX];
+    uint32_t units = kernel->fun(ctx);
+
+    for (uint8_t r = 0; r < rounds; r++)
+    {
+        esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+
+        kernel->fun(ctx);
+        cycles[r] = (uint32_t)(esp_cpu_get_cycle_count() - start);
+    }
+    /* insertion sort, a handful of rounds */
+    for (uint8_t i = 1; i < rounds; i++)
+    {
+        uint32_t c = cycles[i];
+        uint8_t j = i;
+
+        for (; (j > 0) && (cycles[j - 1] > c); j--)
+            cycles[j] = cycles[j - 1];
+        cycles[j] = c;
+    }
+    result->name = kernel->name;
+    result->unit = kernel->unit;
+    result->units = units;
+    result->cycles_per_unit = (float)cycles[rounds / 2] / (float)units;
+    result->min_cycles_per_unit = (float)cycles[0] / (float)units;
+}
+
+/**
+ * @brief       Run the kernels and report each
+ * @param       rounds : timed rounds per kernel, 1 .. 31
+ * @param       filter : run only the kernels whose name contains it, NULL for all
+ * @param       report : called once per kernel, e.g. Radar_bench_print
+ *
+ * @retval      number of kernels run, 0 when out of memory or a parser rejects its input
+ */
+uint32_t Radar_bench_run(uint8_t rounds, const char* filter, pRadar_bench_Report_t report)
+{
+    Radar_bench_ctx_t* ctx = calloc(1, sizeof(Radar_bench_ctx_t));
+    Radar_bench_result_t result;
+    uint32_t num = 0;
+
+    if (rounds == 0)
+        rounds = 1;
+    if (rounds > BENCH_ROUNDS_MAX)
+        rounds = BENCH_ROUNDS_MAX;
+    if (ctx == NULL)
+    {
+        ESP_LOGE(TAG, "no memory for the benchmarks");
+        return 0;
+    }
+    if (!Radar_bench_prepare(ctx))
+    {
+        ESP_LOGE(TAG, "benchmark inputs rejected");
+        free(ctx->grid_memory);
+        free(ctx);
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(g_bench_kernels) / sizeof(g_bench_kernels[0]); i++)
+    {
+        if ((filter != NULL) && (strstr(g_bench_kernels[i].name, filter) == NULL))
+            continue;
+        Radar_bench_time(ctx, &g_bench_kernels[i], rounds, &result);
+        report(&result);
+        num++;
+    }
+    free(ctx->grid_memory);
+    free(ctx);
+    return num;
+}
+
+/**
+ * @brief       Print a result as two "key value" lines on stdout, median then fastest round
+ */
+void Radar_bench_print(const Radar_bench_result_t* result)
+{
+    printf("bench_%s_cycles_per_%s %.2f\n", result->name, result->unit, result->cycles_per_unit);
+    printf("bench_%s_cycles_per_%s_min %.2f\n", result->name, result->unit, result->min_cycles_per_unit);
+}
@@ -0,0 +1,47 @@
+#ifndef _OCCUPANCY_GRID_H_
+#define _OCCUPANCY_GRID_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "radar_sweep.h"
+#include "sweep_cartesian.h"
+
+#define OCCUPANCY_TILE_SIZE         8       /* Tile edge (cells), a tile is the unit of a delta */
+#define OCCUPANCY_TILE_CELLS        (OCCUPANCY_TILE_SIZE * OCCUPANCY_TILE_SIZE)
+
+/* Log-odds of a cell, int8: 0 = unknown, > 0 occupied, < 0 free */
+#define OCCUPANCY_LOGODDS_HIT       6       /* Added to the cell that holds the hit */
+#define OCCUPANCY_LOGODDS_MISS      (-2)    /* Added to every cell the ray passes through */
+#define OCCUPANCY_LOGODDS_MAX       100
+#define OCCUPANCY_LOGODDS_MIN       (-100)
+
+/* Definitions for error constants */
+#define OCCUPANCY_EOK               0       /* no error */
+#define OCCUPANCY_ECONFIG           1       /* configuration error */
+
+typedef struct {
+    uint16_t resolution_mm;     /* Cell edge (mm) */
+    uint16_t width;             /* Cells along x, multiple of OCCUPANCY_TILE_SIZE */
+    uint16_t height;            /* Cells along y, multiple of OCCUPANCY_TILE_SIZE */
+    uint16_t origin_x;          /* Cell holding the sensor */
+    uint16_t origin_y;
+} Occupancy_grid_config_t;
+
+typedef struct {
+    Occupancy_grid_config_t config;
+    uint32_t version;           /* Incremented by every update */
+    uint16_t tiles_x;           /* Tiles along x */
+    uint16_t tiles_y;           /* Tiles along y */
+    int8_t* cells;              /* Tile-major, the cells of one tile are contiguous */
+    uint32_t* tile_version;     /* Grid version of the last change of each tile */
+    Sweep_cartesian_table_t table; /* Hit positions */
+} Occupancy_grid_t;
+
+size_t Occupancy_grid_memory_size(const Occupancy_grid_config_t* config); /* memory needed for cells and tile versions */
+uint8_t Occupancy_grid_init(Occupancy_grid_t* grid, const Occupancy_grid_config_t* config, void* memory); /* init grid on caller memory */
+void Occupancy_grid_update(Occupancy_grid_t* grid, const Radar_sweep_t* sweep); /* cast every ray of a sweep */
+int8_t Occupancy_grid_get(const Occupancy_grid_t* grid, uint16_t x, uint16_t y); /* log-odds of one cell */
+size_t Occupancy_grid_encode_tiles(const Occupancy_grid_t* grid, uint32_t since_version, uint16_t* tile_index,
+                                   uint8_t* buf, size_t capacity); /* tiles changed after a version */
+
+#endif
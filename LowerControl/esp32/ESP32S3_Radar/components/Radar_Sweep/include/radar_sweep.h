@@ -0,0 +1,45 @@
+#ifndef _RADAR_SWEEP_H_
+#define _RADAR_SWEEP_H_
+
+#include <stdint.h>
+
+/*
+ * Sweep data shared by the firmware and the Linux host tools.
+ * Nothing in this component may depend on ESP-IDF headers.
+ */
+
+#define RADAR_SWEEP_POINT_MAX       361     /* 360° scope at 1° step, plus the closing bin */
+#define RADAR_SWEEP_INVALID_DISTANCE 0      /* Distance reported for a failed measurement */
+
+/* Sweep output format, selectable per output channel */
+enum
+{
+    RADAR_SWEEP_FORMAT_POLAR        = 0x00, /* uint16 distance per angle bin */
+    RADAR_SWEEP_FORMAT_CARTESIAN_XY = 0x01, /* int16 x, y (mm) per angle bin */
+    RADAR_SWEEP_FORMAT_CARTESIAN_XYZ= 0x02, /* int16 x, y, z (mm) per angle bin, uses the tilt angle */
+    RADAR_SWEEP_FORMAT_DELTA        = 0x03, /* changed bins only, with periodic keyframes */
+    RADAR_SWEEP_FORMAT_COMPACT      = 0x04, /* delta + zig-zag varint distances, run-length invalid spans */
+    RADAR_SWEEP_FORMAT_POLAR_LE     = 0x05, /* uint16 distance per angle bin, low byte first: the sweep buffer as is */
+    RADAR_SWEEP_FORMAT_LASERSCAN    = 0x06, /* sensor_msgs/LaserScan fields and float32 ranges (m), little-endian */
+    RADAR_SWEEP_FORMAT_NUM,
+};
+
+/*
+ * One completed sweep of the pan servo
+ * Bin i holds the distance measured at angle (start_angle + i * step),
+ * whatever the direction the servo travelled in.
+ */
+typedef struct {
+    uint32_t sequence;          /* Sweep sequence number, incremented on every publish */
+    int64_t timestamp_us;       /* Time of the first sample */
+    uint32_t duration_us;       /* Time from the first to the last sample */
+    uint32_t period_us;         /* Time from the first sample of the previous sweep, 0 if unknown */
+    uint16_t start_angle;       /* Angle of bin 0 (°) */
+    uint8_t step;               /* Angle between two bins (°) */
+    uint8_t direction;          /* 1 when the servo scanned from minimum to maximum angle */
+    int16_t tilt_angle;         /* Tilt servo elevation (°), 0 without a tilt servo */
+    uint16_t count;             /* Number of angle bins */
+    uint16_t distance[RADAR_SWEEP_POINT_MAX]; /* Distance (mm), RADAR_SWEEP_INVALID_DISTANCE if not measured */
+} Radar_sweep_t;
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef _SWEEP_CARTESIAN_H_
+#define _SWEEP_CARTESIAN_H_
+
+#include <stdint.h>
+#include "radar_sweep.h"
+
+#define SWEEP_CARTESIAN_Q15_ONE     32767   /* 1.0 in Q15 */
+
+/* Cartesian point, millimetres. (0, 0) marks an invalid measurement */
+typedef struct {
+    int16_t x;
+    int16_t y;
+} Sweep_point_xy_t;
+
+typedef struct {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+} Sweep_point_xyz_t;
+
+/* sin/cos of every angle bin in Q15, rebuilt only when the angle grid changes */
+typedef struct {
+    uint16_t start_angle;                   /* Angle grid the table was built for */
+    uint8_t step;
+    uint16_t count;
+    int16_t cos_q15[RADAR_SWEEP_POINT_MAX]; /* cos(start_angle + i * step) */
+    int16_t sin_q15[RADAR_SWEEP_POINT_MAX]; /* sin(start_angle + i * step) */
+} Sweep_cartesian_table_t;
+
+void Sweep_cartesian_table_init(Sweep_cartesian_table_t* table, uint16_t start_angle, uint8_t step, uint16_t count); /* build sin/cos table */
+uint16_t Sweep_cartesian_to_xy(Sweep_cartesian_table_t* table, const Radar_sweep_t* sweep,
+                               uint16_t first, uint16_t num, Sweep_point_xy_t* out);   /* convert bins to x/y */
+uint16_t Sweep_cartesian_to_xyz(Sweep_cartesian_table_t* table, const Radar_sweep_t* sweep,
+                                uint16_t first, uint16_t num, Sweep_point_xyz_t* out); /* convert bins to x/y/z */
+
+#endif
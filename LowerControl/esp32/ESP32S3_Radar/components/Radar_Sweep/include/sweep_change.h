@@ -0,0 +1,40 @@
+#ifndef _SWEEP_CHANGE_H_
+#define _SWEEP_CHANGE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "radar_sweep.h"
+
+/*
+ * Delta frame, all fields high byte first:
+ * sequence(2) flags(1) start_angle(2) step(1) count(2) first_bin(2) num(2), then
+ *   keyframe : num distances(2) of bins first_bin .. first_bin + num - 1
+ *   delta    : num pairs of bin(2) + distance(2)
+ * A sweep larger than one frame is continued by encoding the same sweep again
+ * until SWEEP_CHANGE_FLAG_MORE is clear.
+ */
+#define SWEEP_CHANGE_HEAD_LEN       12
+#define SWEEP_CHANGE_FLAG_KEYFRAME  0x01    /* Every bin is sent, the receiver resets its model */
+#define SWEEP_CHANGE_FLAG_MORE      0x02    /* The sweep continues in the next frame */
+
+/* Change detector of one receiver, the reference is the value the receiver holds for every bin */
+typedef struct {
+    uint16_t tolerance;             /* A bin changed when it moved more than this (mm) */
+    uint16_t keyframe_interval;     /* Sweeps between two keyframes, 0 for the first sweep only */
+    uint32_t sequence;              /* Sweep being encoded */
+    uint16_t next_bin;              /* First bin not yet looked at in this sweep */
+    uint16_t sweeps_since_key;      /* Sweeps sent since the last keyframe */
+    bool keyframe;                  /* This sweep is sent as a keyframe */
+    bool valid;                     /* The reference holds a keyframe */
+    uint16_t start_angle;           /* Angle grid of the reference */
+    uint8_t step;
+    uint16_t count;
+    uint16_t reference[RADAR_SWEEP_POINT_MAX];
+} Sweep_change_t;
+
+void Sweep_change_init(Sweep_change_t* change, uint16_t tolerance, uint16_t keyframe_interval); /* next sweep is a keyframe */
+size_t Sweep_change_encode(Sweep_change_t* change, const Radar_sweep_t* sweep,
+                           uint8_t* buf, size_t capacity); /* encode the next frame of a sweep */
+
+#endif
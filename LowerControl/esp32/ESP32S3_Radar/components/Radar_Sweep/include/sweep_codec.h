@@ -0,0 +1,33 @@
+#ifndef _SWEEP_CODEC_H_
+#define _SWEEP_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "radar_sweep.h"
+
+/*
+ * Compact sweep frame, header fields high byte first:
+ * sequence(2) start_angle(2) step(1) count(2) first_bin(2) num(2) tokens... fletcher16(2)
+ *
+ * The angle grid is implicit: token i describes bin first_bin + i.
+ * Each token is an LEB128 varint u:
+ *   u & 1 == 0 : valid distance, zig-zag(distance - previous valid distance) = u >> 1
+ *   u & 1 == 1 : (u >> 1) + 1 consecutive invalid bins
+ * The previous distance starts at 0 in every frame, so each frame decodes on its own.
+ * The Fletcher-16 checksum covers every byte before it.
+ */
+#define SWEEP_CODEC_HEAD_LEN        11
+#define SWEEP_CODEC_TAIL_LEN        2
+#define SWEEP_CODEC_TOKEN_MAX       3       /* Longest token: 17-bit zig-zag delta + flag bit */
+
+/* Definitions for error constants */
+#define SWEEP_CODEC_EOK             0       /* no error */
+#define SWEEP_CODEC_EFRAME          3       /* frame error */
+#define SWEEP_CODEC_ECRC            4       /* checksum error */
+
+uint16_t Sweep_codec_fletcher16(const uint8_t* buf, size_t len); /* frame checksum */
+size_t Sweep_codec_encode(const Radar_sweep_t* sweep, uint16_t* first_bin,
+                          uint8_t* buf, size_t capacity); /* encode bins from *first_bin on, as many as fit */
+uint8_t Sweep_codec_decode(const uint8_t* buf, size_t len, Radar_sweep_t* sweep); /* reference decoder */
+
+#endif
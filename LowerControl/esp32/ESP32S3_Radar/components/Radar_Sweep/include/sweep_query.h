@@ -0,0 +1,44 @@
+#ifndef _SWEEP_QUERY_H_
+#define _SWEEP_QUERY_H_
+
+#include <stdint.h>
+#include "radar_sweep.h"
+
+#define SWEEP_QUERY_NO_BIN          0xFFFF  /* argmin of a sector without a valid sample */
+
+/* Definitions for error constants */
+#define SWEEP_QUERY_EOK             0       /* no error */
+#define SWEEP_QUERY_ERANGE          1       /* sector outside the angle grid */
+
+/* Segment tree node, covers a range of angle bins */
+typedef struct {
+    uint16_t min;       /* Minimum valid distance, UINT16_MAX if none */
+    uint16_t argmin;    /* Bin of the minimum */
+    uint16_t valid;     /* Number of valid samples */
+    uint32_t sum;       /* Sum of valid samples */
+} Sweep_query_node_t;
+
+typedef struct {
+    uint16_t min;       /* Minimum distance (mm), UINT16_MAX if no valid sample */
+    uint16_t argmin;    /* Angle of the minimum (°), SWEEP_QUERY_NO_BIN if no valid sample */
+    uint16_t mean;      /* Mean of the valid samples (mm), 0 if none */
+    uint16_t valid;     /* Number of valid samples in the sector */
+} Sweep_query_result_t;
+
+/*
+ * Bottom-up segment tree over the angle bins, holding the most recent sample of every bin.
+ * Leaves are node[count .. 2 * count - 1], node 1 is the root.
+ */
+typedef struct {
+    uint16_t start_angle;   /* Angle grid of the leaves */
+    uint8_t step;
+    uint16_t count;
+    Sweep_query_node_t node[2 * RADAR_SWEEP_POINT_MAX];
+} Sweep_query_t;
+
+void Sweep_query_init(Sweep_query_t* query, uint16_t start_angle, uint8_t step, uint16_t count); /* empty tree for an angle grid */
+void Sweep_query_update(Sweep_query_t* query, uint16_t bin, uint16_t distance); /* O(log n) sample update */
+uint8_t Sweep_query_bins(const Sweep_query_t* query, uint16_t first, uint16_t last, Sweep_query_result_t* result); /* bins [first, last] */
+uint8_t Sweep_query_sector(const Sweep_query_t* query, uint16_t angle_a, uint16_t angle_b, Sweep_query_result_t* result); /* sector [a, b] (°) */
+
+#endif
@@ -0,0 +1,224 @@
+#include <string.h>
+
+#include "occupancy_grid.h"
+
+#define OCCUPANCY_CONVERT_CHUNK     32  /* Rays converted per call to the Cartesian stage */
+
+/**
+ * @brief       Index of a cell in the tile-major cell array
+ * @param       grid : grid
+ * @param       x    : cell x
+ * @param       y    : cell y
+ *
+ * @retval      cell index
+ */
+static inline uint32_t Occupancy_grid_cell_index(const Occupancy_grid_t* grid, uint16_t x, uint16_t y)
+{
+    uint32_t tile = (uint32_t)(y / OCCUPANCY_TILE_SIZE) * grid->tiles_x + (x / OCCUPANCY_TILE_SIZE);
+
+    return tile * OCCUPANCY_TILE_CELLS + (y % OCCUPANCY_TILE_SIZE) * OCCUPANCY_TILE_SIZE + (x % OCCUPANCY_TILE_SIZE);
+}
+
+/**
+ * @brief       Add a log-odds increment to a cell, marking its tile dirty if the value changed
+ * @param       grid  : grid
+ * @param       x     : cell x
+ * @param       y     : cell y
+ * @param       delta : log-odds increment
+ *
+ * @retval      void
+ */
+static void Occupancy_grid_add(Occupancy_grid_t* grid, uint16_t x, uint16_t y, int8_t delta)
+{
+    uint32_t index = Occupancy_grid_cell_index(grid, x, y);
+    int16_t value = (int16_t)grid->cells[index] + delta;
+
+    if (value > OCCUPANCY_LOGODDS_MAX)
+        value = OCCUPANCY_LOGODDS_MAX;
+    if (value < OCCUPANCY_LOGODDS_MIN)
+        value = OCCUPANCY_LOGODDS_MIN;
+    if (value == grid->cells[index])
+        return; /* saturated, a static scene leaves its tiles clean */
+
+    grid->cells[index] = (int8_t)value;
+    grid->tile_version[index / OCCUPANCY_TILE_CELLS] = grid->version;
+}
+
+/**
+ * @brief       Millimetres to a cell coordinate, rounding towards minus infinity
+ * @param       mm         : coordinate (mm)
+ * @param       resolution : cell edge (mm)
+ * @param       origin     : cell holding the sensor
+ *
+ * @retval      cell coordinate, may be outside the grid
+ */
+static inline int32_t Occupancy_grid_mm_to_cell(int32_t mm, int32_t resolution, int32_t origin)
+{
+    if (mm >= 0)
+        return origin + mm / resolution;
+    return origin - (resolution - 1 - mm) / resolution;
+}
+
+/**
+ * @brief       Integer Bresenham walk from the sensor to a hit
+ *              Cells before the hit become more free, the hit cell more occupied.
+ *              The walk stops at the grid border, a hit outside the grid only clears the cells on the way.
+ * @param       grid : grid
+ * @param       x1   : hit cell x
+ * @param       y1   : hit cell y
+ *
+ * @retval      void
+ */
+static void Occupancy_grid_cast_ray(Occupancy_grid_t* grid, int32_t x1, int32_t y1)
+{
+    int32_t x = grid->config.origin_x;
+    int32_t y = grid->config.origin_y;
+    int32_t dx = x1 > x ? x1 - x : x - x1;
+    int32_t dy = y1 > y ? y - y1 : y1 - y;  /* -|dy| */
+    int32_t sx = x < x1 ? 1 : -1;
+    int32_t sy = y < y1 ? 1 : -1;
+    int32_t err = dx + dy;
+    int32_t err2;
+
+    while ((x != x1) || (y != y1))
+    {
+        Occupancy_grid_add(grid, (uint16_t)x, (uint16_t)y, OCCUPANCY_LOGODDS_MISS);
+
+        err2 = 2 * err;
+        if (err2 >= dy)
+        {
+            err += dy;
+            x += sx;
+        }
+        if (err2 <= dx)
+        {
+            err += dx;
+            y += sy;
+        }
+        if ((x < 0) || (y < 0) || (x >= grid->config.width) || (y >= grid->config.height))
+            return; /* left the grid */
+    }
+    Occupancy_grid_add(grid, (uint16_t)x, (uint16_t)y, OCCUPANCY_LOGODDS_HIT);
+}
+
+/**
+ * @brief       Memory needed for cells and tile versions
+ * @param       config : grid configuration
+ *
+ * @retval      bytes
+ */
+size_t Occupancy_grid_memory_size(const Occupancy_grid_config_t* config)
+{
+    size_t tiles = (size_t)(config->width / OCCUPANCY_TILE_SIZE) * (config->height / OCCUPANCY_TILE_SIZE);
+
+    return tiles * sizeof(uint32_t) + tiles * OCCUPANCY_TILE_CELLS;
+}
+
+/**
+ * @brief       init grid on caller memory, every cell unknown
+ * @param       grid   : grid
+ * @param       config : grid configuration
+ * @param       memory : Occupancy_grid_memory_size bytes, 4-byte aligned
+ *
+ * @retval      OCCUPANCY_EOK     : No error
+ * @retval      OCCUPANCY_ECONFIG : configuration error
+ */
+uint8_t Occupancy_grid_init(Occupancy_grid_t* grid, const Occupancy_grid_config_t* config, void* memory)
+{
+    size_t tiles;
+
+    if ((config->resolution_mm == 0) || (config->width == 0) || (config->height == 0) ||
+        (config->width % OCCUPANCY_TILE_SIZE) || (config->height % OCCUPANCY_TILE_SIZE) ||
+        (config->origin_x >= config->width) || (config->origin_y >= config->height) || (memory == NULL))
+        return OCCUPANCY_ECONFIG;
+
+    grid->config = *config;
+    grid->version = 0;
+    grid->tiles_x = config->width / OCCUPANCY_TILE_SIZE;
+    grid->tiles_y = config->height / OCCUPANCY_TILE_SIZE;
+    tiles = (size_t)grid->tiles_x * grid->tiles_y;
+    grid->tile_version = (uint32_t*)memory;
+    grid->cells = (int8_t*)&grid->tile_version[tiles];
+    memset(memory, 0, Occupancy_grid_memory_size(config));
+    memset(&grid->table, 0, sizeof(grid->table));
+
+    return OCCUPANCY_EOK;
+}
+
+/**
+ * @brief       Cast every valid ray of a sweep into the grid
+ * @param       grid  : grid
+ * @param       sweep : published sweep
+ *
+ * @retval      void
+ */
+void Occupancy_grid_update(Occupancy_grid_t* grid, const Radar_sweep_t* sweep)
+{
+    Sweep_point_xyz_t hit[OCCUPANCY_CONVERT_CHUNK];
+    int32_t resolution = grid->config.resolution_mm;
+    uint16_t num;
+
+    grid->version++;
+    for (uint16_t first = 0; first < sweep->count; first += num)
+    {
+        num = Sweep_cartesian_to_xyz(&grid->table, sweep, first, OCCUPANCY_CONVERT_CHUNK, hit);
+        for (uint16_t i = 0; i < num; i++)
+        {
+            if (sweep->distance[first + i] == RADAR_SWEEP_INVALID_DISTANCE)
+                continue;
+            Occupancy_grid_cast_ray(grid,
+                                    Occupancy_grid_mm_to_cell(hit[i].x, resolution, grid->config.origin_x),
+                                    Occupancy_grid_mm_to_cell(hit[i].y, resolution, grid->config.origin_y));
+        }
+        if (num == 0)
+            break;
+    }
+}
+
+/**
+ * @brief       Log-odds of one cell
+ * @param       grid : grid
+ * @param       x    : cell x
+ * @param       y    : cell y
+ *
+ * @retval      log-odds, 0 outside the grid
+ */
+int8_t Occupancy_grid_get(const Occupancy_grid_t* grid, uint16_t x, uint16_t y)
+{
+    if ((x >= grid->config.width) || (y >= grid->config.height))
+        return 0;
+    return grid->cells[Occupancy_grid_cell_index(grid, x, y)];
+}
+
+/**
+ * @brief       Encode the tiles changed after a version, starting at a tile index
+ *              Each tile is: tile index(2, high byte first) + OCCUPANCY_TILE_CELLS log-odds bytes, row by row
+ * @param       grid          : grid
+ * @param       since_version : 0 for the whole grid
+ * @param       tile_index    : in, first tile to look at; out, first tile not looked at
+ * @param       buf           : destination
+ * @param       capacity      : size of buf
+ *
+ * @retval      encoded length, the scan is complete when *tile_index reaches tiles_x * tiles_y
+ */
+size_t Occupancy_grid_encode_tiles(const Occupancy_grid_t* grid, uint32_t since_version, uint16_t* tile_index,
+                                   uint8_t* buf, size_t capacity)
+{
+    uint16_t tiles = grid->tiles_x * grid->tiles_y;
+    uint16_t tile = *tile_index;
+    size_t len = 0;
+
+    for (; tile < tiles; tile++)
+    {
+        if ((since_version != 0) && (grid->tile_version[tile] <= since_version))
+            continue;
+        if (len + 2 + OCCUPANCY_TILE_CELLS > capacity)
+            break;
+        buf[len++] = (uint8_t)(tile >> 8);
+        buf[len++] = (uint8_t)(tile & 0xFF);
+        memcpy(&buf[len], &grid->cells[(uint32_t)tile * OCCUPANCY_TILE_CELLS], OCCUPANCY_TILE_CELLS);
+        len += OCCUPANCY_TILE_CELLS;
+    }
+    *tile_index = tile;
+    return len;
+}
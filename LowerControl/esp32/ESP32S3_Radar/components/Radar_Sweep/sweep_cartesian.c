@@ -0,0 +1,132 @@
+#include <math.h>
+#include <stddef.h>
+
+#include "sweep_cartesian.h"
+
+#define SWEEP_DEG_TO_RAD    (3.14159265358979f / 180.0f)
+
+/**
+ * @brief       Multiply a distance by a Q15 factor and saturate to int16
+ * @param       value   : value to scale
+ * @param       q15     : Q15 factor
+ *
+ * @retval      rounded, saturated product
+ */
+static inline int16_t Sweep_mul_q15_sat(int32_t value, int32_t q15)
+{
+    int32_t product = (value * q15 + (1 << 14)) >> 15;
+
+    product = product > INT16_MAX ? INT16_MAX : product;
+    product = product < INT16_MIN ? INT16_MIN : product;
+    return (int16_t)product;
+}
+
+/**
+ * @brief       Clamp the requested bin range to the sweep and make sure the table matches its angle grid
+ * @param       table   : sin/cos table
+ * @param       sweep   : sweep to convert
+ * @param       first   : first bin
+ * @param       num     : number of bins requested
+ *
+ * @retval      number of bins that can be converted
+ */
+static uint16_t Sweep_cartesian_prepare(Sweep_cartesian_table_t* table, const Radar_sweep_t* sweep,
+                                        uint16_t first, uint16_t num)
+{
+    if ((table->start_angle != sweep->start_angle) || (table->step != sweep->step) || (table->count < sweep->count))
+        Sweep_cartesian_table_init(table, sweep->start_angle, sweep->step, sweep->count);
+
+    if (first >= sweep->count)
+        return 0;
+    if (num > sweep->count - first)
+        num = sweep->count - first;
+    return num;
+}
+
+/**
+ * @brief       Build the sin/cos table for an angle grid
+ *              Only called when the scan step changes, never per sweep
+ * @param       table       : table to fill
+ * @param       start_angle : angle of bin 0 (°)
+ * @param       step        : angle between two bins (°)
+ * @param       count       : number of bins
+ *
+ * @retval      void
+ */
+void Sweep_cartesian_table_init(Sweep_cartesian_table_t* table, uint16_t start_angle, uint8_t step, uint16_t count)
+{
+    if (count > RADAR_SWEEP_POINT_MAX)
+        count = RADAR_SWEEP_POINT_MAX;
+
+    table->start_angle = start_angle;
+    table->step = step;
+    table->count = count;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        float rad = (float)(start_angle + i * step) * SWEEP_DEG_TO_RAD;
+        table->cos_q15[i] = (int16_t)lrintf(cosf(rad) * SWEEP_CARTESIAN_Q15_ONE);
+        table->sin_q15[i] = (int16_t)lrintf(sinf(rad) * SWEEP_CARTESIAN_Q15_ONE);
+    }
+}
+
+/**
+ * @brief       Convert a range of angle bins to x/y points
+ *              The loop has no branches on the data so the compiler can unroll and pipeline it
+ * @param       table   : sin/cos table, rebuilt if it does not match the sweep
+ * @param       sweep   : sweep to convert
+ * @param       first   : first bin
+ * @param       num     : number of bins
+ * @param       out     : converted points, invalid distances give (0, 0)
+ *
+ * @retval      number of points written
+ */
+uint16_t Sweep_cartesian_to_xy(Sweep_cartesian_table_t* table, const Radar_sweep_t* sweep,
+                               uint16_t first, uint16_t num, Sweep_point_xy_t* out)
+{
+    num = Sweep_cartesian_prepare(table, sweep, first, num);
+
+    const uint16_t* restrict distance = &sweep->distance[first];
+    const int16_t* restrict cos_q15 = &table->cos_q15[first];
+    const int16_t* restrict sin_q15 = &table->sin_q15[first];
+
+    for (uint16_t i = 0; i < num; i++)
+    {
+        out[i].x = Sweep_mul_q15_sat(distance[i], cos_q15[i]);
+        out[i].y = Sweep_mul_q15_sat(distance[i], sin_q15[i]);
+    }
+    return num;
+}
+
+/**
+ * @brief       Convert a range of angle bins to x/y/z points using the sweep tilt angle
+ * @param       table   : sin/cos table, rebuilt if it does not match the sweep
+ * @param       sweep   : sweep to convert
+ * @param       first   : first bin
+ * @param       num     : number of bins
+ * @param       out     : converted points, invalid distances give (0, 0, 0)
+ *
+ * @retval      number of points written
+ */
+uint16_t Sweep_cartesian_to_xyz(Sweep_cartesian_table_t* table, const Radar_sweep_t* sweep,
+                                uint16_t first, uint16_t num, Sweep_point_xyz_t* out)
+{
+    num = Sweep_cartesian_prepare(table, sweep, first, num);
+
+    /* The tilt is constant over a sweep, so it costs one sinf/cosf per call */
+    float tilt_rad = (float)sweep->tilt_angle * SWEEP_DEG_TO_RAD;
+    int32_t tilt_cos_q15 = (int32_t)lrintf(cosf(tilt_rad) * SWEEP_CARTESIAN_Q15_ONE);
+    int32_t tilt_sin_q15 = (int32_t)lrintf(sinf(tilt_rad) * SWEEP_CARTESIAN_Q15_ONE);
+
+    const uint16_t* restrict distance = &sweep->distance[first];
+    const int16_t* restrict cos_q15 = &table->cos_q15[first];
+    const int16_t* restrict sin_q15 = &table->sin_q15[first];
+
+    for (uint16_t i = 0; i < num; i++)
+    {
+        int32_t horizontal = Sweep_mul_q15_sat(distance[i], tilt_cos_q15); /* projection on the scan plane */
+        out[i].x = Sweep_mul_q15_sat(horizontal, cos_q15[i]);
+        out[i].y = Sweep_mul_q15_sat(horizontal, sin_q15[i]);
+        out[i].z = Sweep_mul_q15_sat(distance[i], tilt_sin_q15);
+    }
+    return num;
+}
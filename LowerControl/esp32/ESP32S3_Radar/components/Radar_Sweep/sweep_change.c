@@ -0,0 +1,128 @@
+#include <string.h>
+
+#include "sweep_change.h"
+
+/**
+ * @brief       Write a 16-bit value, high byte first
+ */
+static inline void Sweep_change_put_u16(uint8_t* buf, uint16_t value)
+{
+    buf[0] = (uint8_t)(value >> 8);
+    buf[1] = (uint8_t)(value & 0xFF);
+}
+
+/**
+ * @brief       Compare a sample with the reference of its bin
+ * @param       reference : value the receiver holds (mm)
+ * @param       distance  : new sample (mm)
+ * @param       tolerance : allowed movement (mm)
+ *
+ * @retval      true when the receiver must be told
+ */
+static inline bool Sweep_change_differs(uint16_t reference, uint16_t distance, uint16_t tolerance)
+{
+    if ((reference == RADAR_SWEEP_INVALID_DISTANCE) || (distance == RADAR_SWEEP_INVALID_DISTANCE))
+        return reference != distance; /* appeared or disappeared */
+    return (reference > distance ? reference - distance : distance - reference) > tolerance;
+}
+
+/**
+ * @brief       init a change detector, the next sweep is sent as a keyframe
+ * @param       change            : change detector
+ * @param       tolerance         : allowed movement (mm)
+ * @param       keyframe_interval : sweeps between two keyframes
+ *
+ * @retval      void
+ */
+void Sweep_change_init(Sweep_change_t* change, uint16_t tolerance, uint16_t keyframe_interval)
+{
+    memset(change, 0, sizeof(*change));
+    change->tolerance = tolerance;
+    change->keyframe_interval = keyframe_interval;
+}
+
+/**
+ * @brief       Encode the next frame of a sweep: a keyframe, or only the bins that changed
+ *              Called again with the same sweep, continues where the previous frame stopped
+ * @param       change   : change detector of the receiver
+ * @param       sweep    : sweep to send
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : buf too small
+ * @retval      other : encoded length
+ */
+size_t Sweep_change_encode(Sweep_change_t* change, const Radar_sweep_t* sweep,
+                           uint8_t* buf, size_t capacity)
+{
+    uint8_t* p = &buf[SWEEP_CHANGE_HEAD_LEN];
+    uint8_t* end = buf + capacity;
+    uint16_t first_bin;
+    uint16_t bin;
+    uint16_t num = 0;
+    uint8_t flags = 0;
+
+    if (capacity < SWEEP_CHANGE_HEAD_LEN + 4)
+        return 0;
+
+    if (sweep->sequence != change->sequence)
+    {
+        /* New sweep, decide whether it is a keyframe */
+        if (change->keyframe && (change->next_bin < change->count))
+            change->valid = false; /* the previous keyframe was cut short, send another one */
+        change->sequence = sweep->sequence;
+        change->next_bin = 0;
+        change->sweeps_since_key++;
+        change->keyframe = (!change->valid) ||
+                           (change->start_angle != sweep->start_angle) || (change->step != sweep->step) ||
+                           (change->count != sweep->count) ||
+                           (change->keyframe_interval && (change->sweeps_since_key >= change->keyframe_interval));
+        if (change->keyframe)
+        {
+            change->sweeps_since_key = 0;
+            change->start_angle = sweep->start_angle;
+            change->step = sweep->step;
+            change->count = sweep->count;
+            change->valid = true;
+        }
+    }
+
+    first_bin = change->next_bin;
+    if (change->keyframe)
+    {
+        flags |= SWEEP_CHANGE_FLAG_KEYFRAME;
+        for (bin = first_bin; (bin < sweep->count) && (p + 2 <= end); bin++, p += 2, num++)
+        {
+            Sweep_change_put_u16(p, sweep->distance[bin]);
+            change->reference[bin] = sweep->distance[bin];
+        }
+    }
+    else
+    {
+        for (bin = first_bin; bin < sweep->count; bin++)
+        {
+            if (!Sweep_change_differs(change->reference[bin], sweep->distance[bin], change->tolerance))
+                continue;
+            if (p + 4 > end)
+                break;
+            Sweep_change_put_u16(p, bin);
+            Sweep_change_put_u16(p + 2, sweep->distance[bin]);
+            change->reference[bin] = sweep->distance[bin];
+            p += 4;
+            num++;
+        }
+    }
+    change->next_bin = bin;
+    if (bin < sweep->count)
+        flags |= SWEEP_CHANGE_FLAG_MORE;
+
+    Sweep_change_put_u16(&buf[0], (uint16_t)sweep->sequence);
+    buf[2] = flags;
+    Sweep_change_put_u16(&buf[3], sweep->start_angle);
+    buf[5] = sweep->step;
+    Sweep_change_put_u16(&buf[6], sweep->count);
+    Sweep_change_put_u16(&buf[8], first_bin);
+    Sweep_change_put_u16(&buf[10], num);
+
+    return (size_t)(p - buf);
+}
@@ -0,0 +1,197 @@
+#include <string.h>
+
+#include "sweep_codec.h"
+
+/**
+ * @brief       Write a 16-bit value, high byte first
+ */
+static inline void Sweep_codec_put_u16(uint8_t* buf, uint16_t value)
+{
+    buf[0] = (uint8_t)(value >> 8);
+    buf[1] = (uint8_t)(value & 0xFF);
+}
+
+/**
+ * @brief       Read a 16-bit value, high byte first
+ */
+static inline uint16_t Sweep_codec_get_u16(const uint8_t* buf)
+{
+    return ((uint16_t)buf[0] << 8) | buf[1];
+}
+
+/**
+ * @brief       Write an LEB128 varint
+ * @param       p     : destination, at least SWEEP_CODEC_TOKEN_MAX bytes
+ * @param       value : value, at most 21 bits
+ *
+ * @retval      address after the varint
+ */
+static inline uint8_t* Sweep_codec_put_varint(uint8_t* p, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *p++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+/**
+ * @brief       Fletcher-16 checksum
+ *              Unlike the additive Modbus checksum it also catches reordered bytes,
+ *              which matters once a single byte error shifts every following token
+ * @param       buf : data
+ * @param       len : data len
+ *
+ * @retval      checksum
+ */
+uint16_t Sweep_codec_fletcher16(const uint8_t* buf, size_t len)
+{
+    uint32_t sum1 = 0;
+    uint32_t sum2 = 0;
+
+    while (len)
+    {
+        size_t block = len > 5802 ? 5802 : len; /* largest block without 32-bit overflow */
+        len -= block;
+        while (block--)
+        {
+            sum1 += *buf++;
+            sum2 += sum1;
+        }
+        sum1 %= 255;
+        sum2 %= 255;
+    }
+    return (uint16_t)((sum2 << 8) | sum1);
+}
+
+/**
+ * @brief       Encode the bins of a sweep from *first_bin on, as many as fit in buf
+ * @param       sweep     : sweep to encode
+ * @param       first_bin : in, first bin to encode; out, first bin not encoded (sweep->count when done)
+ * @param       buf       : destination
+ * @param       capacity  : size of buf
+ *
+ * @retval      0     : buf too small for one token
+ * @retval      other : encoded length
+ */
+size_t Sweep_codec_encode(const Radar_sweep_t* sweep, uint16_t* first_bin,
+                          uint8_t* buf, size_t capacity)
+{
+    const uint16_t* distance = sweep->distance;
+    uint8_t* p = &buf[SWEEP_CODEC_HEAD_LEN];
+    uint8_t* limit;
+    uint16_t bin = *first_bin;
+    uint16_t run = 0;   /* pending invalid bins */
+    int32_t previous = 0;
+    int32_t delta;
+
+    if (capacity < SWEEP_CODEC_HEAD_LEN + 2 * SWEEP_CODEC_TOKEN_MAX + SWEEP_CODEC_TAIL_LEN)
+        return 0;
+    /* Always keep room to flush a pending run */
+    limit = buf + capacity - SWEEP_CODEC_TAIL_LEN - SWEEP_CODEC_TOKEN_MAX;
+
+    for (; bin < sweep->count; bin++)
+    {
+        if (distance[bin] == RADAR_SWEEP_INVALID_DISTANCE)
+        {
+            run++;
+            continue;
+        }
+        if (p + (run ? SWEEP_CODEC_TOKEN_MAX : 0) + SWEEP_CODEC_TOKEN_MAX > limit)
+            break;
+        if (run)
+        {
+            p = Sweep_codec_put_varint(p, ((uint32_t)(run - 1) << 1) | 1);
+            run = 0;
+        }
+        delta = (int32_t)distance[bin] - previous;
+        previous = distance[bin];
+        p = Sweep_codec_put_varint(p, (((uint32_t)delta << 1) ^ -(uint32_t)(delta < 0)) << 1); /* zig-zag */
+    }
+    if (run)
+        p = Sweep_codec_put_varint(p, ((uint32_t)(run - 1) << 1) | 1);
+
+    Sweep_codec_put_u16(&buf[0], (uint16_t)sweep->sequence);
+    Sweep_codec_put_u16(&buf[2], sweep->start_angle);
+    buf[4] = sweep->step;
+    Sweep_codec_put_u16(&buf[5], sweep->count);
+    Sweep_codec_put_u16(&buf[7], *first_bin);
+    Sweep_codec_put_u16(&buf[9], bin - *first_bin);
+    Sweep_codec_put_u16(p, Sweep_codec_fletcher16(buf, (size_t)(p - buf)));
+    p += SWEEP_CODEC_TAIL_LEN;
+
+    *first_bin = bin;
+    return (size_t)(p - buf);
+}
+
+/**
+ * @brief       Reference decoder, fills the bins carried by one frame
+ *              Sequence, angle grid and the decoded bins of sweep are overwritten, other bins are left alone
+ * @param       buf   : frame
+ * @param       len   : frame len
+ * @param       sweep : decoded sweep
+ *
+ * @retval      SWEEP_CODEC_EOK    : No error
+ * @retval      SWEEP_CODEC_EFRAME : Frame format error
+ * @retval      SWEEP_CODEC_ECRC   : checksum error
+ */
+uint8_t Sweep_codec_decode(const uint8_t* buf, size_t len, Radar_sweep_t* sweep)
+{
+    const uint8_t* p = &buf[SWEEP_CODEC_HEAD_LEN];
+    const uint8_t* end;
+    uint16_t count;
+    uint16_t bin;
+    uint16_t last;
+    int32_t previous = 0;
+
+    if (len < SWEEP_CODEC_HEAD_LEN + SWEEP_CODEC_TAIL_LEN)
+        return SWEEP_CODEC_EFRAME;
+    end = buf + len - SWEEP_CODEC_TAIL_LEN;
+    if (Sweep_codec_fletcher16(buf, len - SWEEP_CODEC_TAIL_LEN) != Sweep_codec_get_u16(end))
+        return SWEEP_CODEC_ECRC;
+
+    count = Sweep_codec_get_u16(&buf[5]);
+    bin = Sweep_codec_get_u16(&buf[7]);
+    last = bin + Sweep_codec_get_u16(&buf[9]);
+    if ((count > RADAR_SWEEP_POINT_MAX) || (last > count) || (buf[4] == 0))
+        return SWEEP_CODEC_EFRAME;
+
+    sweep->sequence = Sweep_codec_get_u16(&buf[0]);
+    sweep->start_angle = Sweep_codec_get_u16(&buf[2]);
+    sweep->step = buf[4];
+    sweep->count = count;
+
+    while (bin < last)
+    {
+        uint32_t token = 0;
+        uint8_t shift = 0;
+
+        do
+        {
+            if ((p >= end) || (shift > 14))
+                return SWEEP_CODEC_EFRAME;
+            token |= (uint32_t)(*p & 0x7F) << shift;
+            shift += 7;
+        } while (*p++ & 0x80);
+
+        if (token & 1)
+        {
+            uint32_t run = (token >> 1) + 1;
+            if (run > (uint32_t)(last - bin))
+                return SWEEP_CODEC_EFRAME;
+            while (run--)
+                sweep->distance[bin++] = RADAR_SWEEP_INVALID_DISTANCE;
+        }
+        else
+        {
+            uint32_t zigzag = token >> 1;
+            previous += (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+            if ((previous <= 0) || (previous > UINT16_MAX))
+                return SWEEP_CODEC_EFRAME;
+            sweep->distance[bin++] = (uint16_t)previous;
+        }
+    }
+    return p == end ? SWEEP_CODEC_EOK : SWEEP_CODEC_EFRAME;
+}
@@ -0,0 +1,144 @@
+#include <string.h>
+
+#include "sweep_query.h"
+
+/**
+ * @brief       Combine two nodes, the lower bin wins a tie
+ * @param       out : combined node, may alias a or b
+ * @param       a   : node
+ * @param       b   : node
+ *
+ * @retval      void
+ */
+static inline void Sweep_query_merge(Sweep_query_node_t* out, const Sweep_query_node_t* a, const Sweep_query_node_t* b)
+{
+    const Sweep_query_node_t* pmin = a;
+
+    if ((b->min < a->min) || ((b->min == a->min) && (b->argmin < a->argmin)))
+        pmin = b;
+    out->sum = a->sum + b->sum;
+    out->valid = a->valid + b->valid;
+    out->argmin = pmin->argmin;
+    out->min = pmin->min;
+}
+
+/**
+ * @brief       Empty tree for an angle grid
+ * @param       query       : tree
+ * @param       start_angle : angle of bin 0 (°)
+ * @param       step        : angle between two bins (°)
+ * @param       count       : number of bins
+ *
+ * @retval      void
+ */
+void Sweep_query_init(Sweep_query_t* query, uint16_t start_angle, uint8_t step, uint16_t count)
+{
+    if (count > RADAR_SWEEP_POINT_MAX)
+        count = RADAR_SWEEP_POINT_MAX;
+    query->start_angle = start_angle;
+    query->step = step ? step : 1;
+    query->count = count;
+    for (uint16_t i = 0; i < 2 * count; i++)
+    {
+        query->node[i].min = UINT16_MAX;
+        query->node[i].argmin = SWEEP_QUERY_NO_BIN;
+        query->node[i].valid = 0;
+        query->node[i].sum = 0;
+    }
+}
+
+/**
+ * @brief       Replace the sample of one bin and update its ancestors
+ * @param       query    : tree
+ * @param       bin      : angle bin
+ * @param       distance : new sample (mm), RADAR_SWEEP_INVALID_DISTANCE removes the bin from the answers
+ *
+ * @retval      void
+ */
+void Sweep_query_update(Sweep_query_t* query, uint16_t bin, uint16_t distance)
+{
+    uint16_t i;
+
+    if (bin >= query->count)
+        return;
+
+    i = bin + query->count;
+    if (distance == RADAR_SWEEP_INVALID_DISTANCE)
+    {
+        query->node[i].min = UINT16_MAX;
+        query->node[i].valid = 0;
+        query->node[i].sum = 0;
+    }
+    else
+    {
+        query->node[i].min = distance;
+        query->node[i].valid = 1;
+        query->node[i].sum = distance;
+    }
+    query->node[i].argmin = bin;
+
+    for (i >>= 1; i >= 1; i >>= 1)
+        Sweep_query_merge(&query->node[i], &query->node[2 * i], &query->node[2 * i + 1]);
+}
+
+/**
+ * @brief       Minimum, argmin and mean over bins [first, last]
+ * @param       query  : tree
+ * @param       first  : first bin
+ * @param       last   : last bin, included
+ * @param       result : answer, argmin as an angle
+ *
+ * @retval      SWEEP_QUERY_EOK    : No error
+ * @retval      SWEEP_QUERY_ERANGE : empty or out of range bins
+ */
+uint8_t Sweep_query_bins(const Sweep_query_t* query, uint16_t first, uint16_t last, Sweep_query_result_t* result)
+{
+    Sweep_query_node_t acc = { UINT16_MAX, SWEEP_QUERY_NO_BIN, 0, 0 };
+    uint16_t lo;
+    uint16_t hi;
+
+    if ((first > last) || (last >= query->count))
+        return SWEEP_QUERY_ERANGE;
+
+    /* Half-open [lo, hi) on the leaves, O(log n) nodes */
+    for (lo = first + query->count, hi = last + 1 + query->count; lo < hi; lo >>= 1, hi >>= 1)
+    {
+        if (lo & 1)
+            Sweep_query_merge(&acc, &acc, &query->node[lo++]);
+        if (hi & 1)
+            Sweep_query_merge(&acc, &acc, &query->node[--hi]);
+    }
+
+    result->min = acc.min;
+    result->valid = acc.valid;
+    result->mean = acc.valid ? (uint16_t)(acc.sum / acc.valid) : 0;
+    result->argmin = acc.valid ? query->start_angle + acc.argmin * query->step : SWEEP_QUERY_NO_BIN;
+    return SWEEP_QUERY_EOK;
+}
+
+/**
+ * @brief       Minimum, argmin and mean over the bins inside the sector [angle_a, angle_b]
+ * @param       query   : tree
+ * @param       angle_a : sector start (°)
+ * @param       angle_b : sector end (°), included
+ * @param       result  : answer
+ *
+ * @retval      SWEEP_QUERY_EOK    : No error
+ * @retval      SWEEP_QUERY_ERANGE : no bin inside the sector
+ */
+uint8_t Sweep_query_sector(const Sweep_query_t* query, uint16_t angle_a, uint16_t angle_b, Sweep_query_result_t* result)
+{
+    uint16_t first;
+    uint16_t last;
+
+    if ((angle_b < angle_a) || (angle_b < query->start_angle) || (query->count == 0))
+        return SWEEP_QUERY_ERANGE;
+    if (angle_a < query->start_angle)
+        angle_a = query->start_angle;
+
+    first = (angle_a - query->start_angle + query->step - 1) / query->step;
+    last = (angle_b - query->start_angle) / query->step;
+    if (last >= query->count)
+        last = query->count - 1;
+    return Sweep_query_bins(query, first, last, result);
+}
@@ -37,5 +37,8 @@ void vSteering_ResetAngle(void);
 void vSteering_ChangeAngle(xSteering_arguments_t *parguments, const uint16_t angle);
 void vSteering_ChangeDutyNum(xSteering_arguments_t *parguments, const uint32_t duty);
 void vSteering_Calibration(const uint16_t sreeringname, const uint32_t timeNum, const bool High_or_Low);
+#if CONFIG_RADAR_BENCH
+uint32_t iSteering_bench_AngleToDutyNum(xSteering_arguments_t *parguments, const uint16_t angle);
+#endif
 
 #endif 
@@ -1,6 +1,8 @@
 #include "driver/ledc.h"
 #include "esp_log.h"
 #include "steering_control.h"
+#include "radar_counters.h"
+#include "radar_trace.h"
 #include "sdkconfig.h"
 
 #define STEERING_NUM CONFIG_STEERING_NUM
@@ -173,10 +175,20 @@ static uint32_t iAngleToDutyNum(xSteering_arguments_t *parguments, const uint16_
     return DutyNum;
 }
 
+#if CONFIG_RADAR_BENCH
+/* iAngleToDutyNum for the benchmarks of components/Radar_Bench */
+uint32_t iSteering_bench_AngleToDutyNum(xSteering_arguments_t *parguments, const uint16_t angle)
+{
+    return iAngleToDutyNum(parguments, angle);
+}
+#endif
+
 //changing the PWM duty cycle by angle
 void vSteering_ChangeAngle(xSteering_arguments_t *parguments, const uint16_t angle)
 {
     parguments->angle_now = angle;
+    Radar_counter_inc(RADAR_COUNTER_SERVO_COMMAND);
+    Radar_trace(RADAR_TRACE_SERVO, angle, 0);
 
     ESP_ERROR_CHECK(ledc_set_duty(parguments->speedmode, parguments->channel, 
                                     iAngleToDutyNum(parguments, parguments->angle_now)));
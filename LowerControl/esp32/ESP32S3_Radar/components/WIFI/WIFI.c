@@ -6,6 +6,7 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "esp_smartconfig.h"
 
@@ -33,7 +34,8 @@
 #define ESP_WIFI_SCAN_AUTH_MODE_THRESHOLD WIFI_AUTH_WAPI_PSK
 #endif
 
-static wifi_config_t g_wifi_config = {
+/* Built-in station configuration, tried after the SmartConfig one saved in NVS */
+static const wifi_config_t s_builtin_wifi_config = {
         .sta = {
             .ssid = "xxx",//ESP_DEFAULT_WIFI_SSID,
             .password = "123",//ESP_DEFAULT_WIFI_PASS,
@@ -46,6 +48,7 @@ static wifi_config_t g_wifi_config = {
             .sae_pwe_h2e = WPA3_SAE_PWE_BOTH,
         },
     };
+static wifi_config_t g_wifi_config;
 
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_wifi_event_group;
@@ -60,28 +63,49 @@ static EventGroupHandle_t s_wifi_event_group;
 #define NVS_SPACE_NAME "WiFi_cfg"
 #define NVS_KEY_SSID "wifi_ssid"
 #define NVS_KEY_PASSED "wifi_passwd"
+#define NVS_KEY_FAST "wifi_fast"
+
+#define WIFI_FAST_VERSION 1
+
+/* Last successful connection, kept in NVS to skip the scan (and DHCP) on the next boot */
+typedef struct {
+    uint8_t version;
+    uint8_t channel;
+    uint8_t bssid[6];
+    uint8_t ssid[32];
+    esp_netif_ip_info_t ip_info;
+} wifi_fast_cache_t;
 
 static const char *TAG = "wifi station";
 
 static int s_retry_num = 0;
 
-SemaphoreHandle_t smartconfig_Semaphore = NULL;
+static esp_netif_t* s_sta_netif = NULL;
+static wifi_fast_cache_t s_fast_cache;
+static bool s_fast_connect = false; /* connecting to the cached AP, a failure falls back to a full scan */
+static bool s_nvs_config = false;   /* g_wifi_config holds the NVS credentials, not the built-in ones */
+static TaskHandle_t s_smart_task_Handle = NULL;
 
 static void smartconfig_task(void * parm);
 static void event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data);
 static esp_err_t NVSread_to_wifi_config( const char* namespace_name );
 static void NVSupdate_data(const char* namespace_name, smartconfig_event_got_ssid_pswd_t* data);
+static esp_err_t wifi_config_switch(void);
+static void wifi_fast_connect_prepare(void);
+static void wifi_fast_connect_fallback(void);
+static void wifi_fast_cache_update(const esp_netif_ip_info_t* ip_info);
 
+/**
+ * @brief       Start the WiFi station without waiting for the connection,
+ *              wait for it with wifi_wait_connected
+ *              NVS must be initialized (Modbus_init does it)
+ * @param       void
+ *
+ * @retval      ESP_OK : started
+ */
 esp_err_t wifi_init_sta(void)
 {
-    //Initialize NVS
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-      ESP_ERROR_CHECK(nvs_flash_erase());
-      ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
     ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
 
     s_wifi_event_group = xEventGroupCreate();
@@ -89,53 +113,132 @@ esp_err_t wifi_init_sta(void)
     ESP_ERROR_CHECK(esp_netif_init());
 
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    s_sta_netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    /* the configuration comes from Kconfig or our own NVS keys, no need for the driver to write it to flash */
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
 
     ESP_ERROR_CHECK( esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL) );
     ESP_ERROR_CHECK( esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL) );
     ESP_ERROR_CHECK( esp_event_handler_register(SC_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL) );
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
+    /* the SmartConfig credentials first, the fast connect cache is matched against them */
+    g_wifi_config = s_builtin_wifi_config;
+    if (NVSread_to_wifi_config(NVS_SPACE_NAME) != ESP_OK)
+        ESP_LOGI(TAG, "no NVS config, built-in SSID first");
+    wifi_fast_connect_prepare();
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &g_wifi_config) );
     ESP_ERROR_CHECK(esp_wifi_start() );
 
     ESP_LOGI(TAG, "wifi_init_sta finished.");
+    return ESP_OK;
+}
 
-    /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
-     * number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see above) */
+/**
+ * @brief       Wait until the station has an IP address
+ *              When every configuration failed, SmartConfig runs meanwhile
+ * @param       xTicksToWait : wait time
+ *
+ * @retval      ESP_OK          : connected
+ * @retval      ESP_ERR_TIMEOUT : not connected yet
+ */
+esp_err_t wifi_wait_connected(TickType_t xTicksToWait)
+{
     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                                           WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+                                           WIFI_CONNECTED_BIT,
                                            pdFALSE,
                                            pdFALSE,
-                                           portMAX_DELAY);
-
-    /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
-     * happened. */
-    if (bits & WIFI_CONNECTED_BIT) { //successed
-        ESP_LOGI(TAG, "connected to ap SSID:%s",
-                 g_wifi_config.sta.ssid);
-        return ESP_OK;
-    } else if (bits & WIFI_FAIL_BIT) { // start smartconfig
-        ESP_LOGW(TAG, "Failed to connect to SSID:%s",
-                 g_wifi_config.sta.ssid);
-        ESP_LOGW(TAG, "Start SmartConfig!");
-        smartconfig_Semaphore = xSemaphoreCreateBinary();
-        TaskHandle_t smart_task_Handle;
-        xTaskCreatePinnedToCore(smartconfig_task, "smartconfig_task", 4096, NULL, 12, &smart_task_Handle, 0);
-        if (xSemaphoreTake(smartconfig_Semaphore, portMAX_DELAY) == pdTRUE) // wait smartconfig
-            return ESP_OK;
-        else {
-            vTaskDelete(smart_task_Handle);
-            esp_smartconfig_stop();
-            return ESP_ERR_NOT_FOUND;
-        }
-    } else { // other error
-        ESP_LOGE(TAG, "UNEXPECTED EVENT");
-        return ESP_FAIL;
+                                           xTicksToWait);
+
+    return (bits & WIFI_CONNECTED_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+// try the other configuration: the built-in one after the NVS one,
+// the NVS one after the built-in one
+static esp_err_t wifi_config_switch(void)
+{
+    if (!s_nvs_config)
+        return NVSread_to_wifi_config(NVS_SPACE_NAME);
+    g_wifi_config = s_builtin_wifi_config;
+    s_nvs_config = false;
+    return esp_wifi_set_config(WIFI_IF_STA, &g_wifi_config);
+}
+
+// read the cached connection of the SSID about to be joined
+// and aim the first connect at it: one channel, one BSSID, no full scan
+static void wifi_fast_connect_prepare(void)
+{
+    nvs_handle_t wifi_config_HandleNvs;
+    size_t len = sizeof(s_fast_cache);
+
+    if (nvs_open(NVS_SPACE_NAME, NVS_READONLY, &wifi_config_HandleNvs) != ESP_OK)
+        return;
+    if ((nvs_get_blob(wifi_config_HandleNvs, NVS_KEY_FAST, &s_fast_cache, &len) != ESP_OK) ||
+        (len != sizeof(s_fast_cache)) || (s_fast_cache.version != WIFI_FAST_VERSION) ||
+        (memcmp(s_fast_cache.ssid, g_wifi_config.sta.ssid, sizeof(s_fast_cache.ssid)) != 0)) {
+        memset(&s_fast_cache, 0, sizeof(s_fast_cache));
+        nvs_close(wifi_config_HandleNvs);
+        return;
+    }
+    nvs_close(wifi_config_HandleNvs);
+
+    g_wifi_config.sta.channel = s_fast_cache.channel;
+    g_wifi_config.sta.bssid_set = true;
+    memcpy(g_wifi_config.sta.bssid, s_fast_cache.bssid, sizeof(g_wifi_config.sta.bssid));
+    g_wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+#if CONFIG_RADAR_WIFI_REUSE_LEASE
+    if (s_fast_cache.ip_info.ip.addr != 0) {
+        esp_netif_dhcpc_stop(s_sta_netif);
+        esp_netif_set_ip_info(s_sta_netif, &s_fast_cache.ip_info);
     }
+#endif
+    s_fast_connect = true;
+    ESP_LOGI(TAG, "fast connect to " MACSTR " on channel %d", MAC2STR(s_fast_cache.bssid), s_fast_cache.channel);
+}
+
+// the cached AP did not answer (moved, other channel)
+// forget it for this boot and scan every channel
+static void wifi_fast_connect_fallback(void)
+{
+    s_fast_connect = false;
+    g_wifi_config.sta.channel = 0;
+    g_wifi_config.sta.bssid_set = false;
+    g_wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+#if CONFIG_RADAR_WIFI_REUSE_LEASE
+    esp_netif_dhcpc_start(s_sta_netif);
+#endif
+    ESP_ERROR_CHECK( esp_wifi_set_config(WIFI_IF_STA, &g_wifi_config) );
+    ESP_LOGI(TAG, "fast connect failed, scanning");
+}
+
+// write the connection to NVS
+// only when it changed, a boot on the same AP costs no flash write
+static void wifi_fast_cache_update(const esp_netif_ip_info_t* ip_info)
+{
+    wifi_fast_cache_t cache = { 0 };
+    wifi_ap_record_t ap_info;
+    nvs_handle_t wifi_config_HandleNvs;
+
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK)
+        return;
+    cache.version = WIFI_FAST_VERSION;
+    cache.channel = ap_info.primary;
+    memcpy(cache.bssid, ap_info.bssid, sizeof(cache.bssid));
+    memcpy(cache.ssid, g_wifi_config.sta.ssid, sizeof(cache.ssid));
+    cache.ip_info = *ip_info;
+    if (memcmp(&cache, &s_fast_cache, sizeof(cache)) == 0)
+        return;
+
+    s_fast_cache = cache;
+    if (nvs_open(NVS_SPACE_NAME, NVS_READWRITE, &wifi_config_HandleNvs) != ESP_OK)
+        return;
+    if ((nvs_set_blob(wifi_config_HandleNvs, NVS_KEY_FAST, &cache, sizeof(cache)) != ESP_OK) ||
+        (nvs_commit(wifi_config_HandleNvs) != ESP_OK))
+        ESP_LOGW(TAG, "fast connect cache not saved");
+    nvs_close(wifi_config_HandleNvs);
 }
 
 static void event_handler(void* arg, esp_event_base_t event_base,
@@ -147,16 +250,21 @@ static void event_handler(void* arg, esp_event_base_t event_base,
         }
         if (event_id == WIFI_EVENT_STA_DISCONNECTED) { //retry
             ESP_LOGI(TAG,"connect to the AP fail");
-            if (s_retry_num < ESP_WIFI_MAXIMUM_RETRY) {
+            xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+            if (s_fast_connect) {
+                //cached AP first, without counting it as a retry
+                wifi_fast_connect_fallback();
+                esp_wifi_connect();
+            } else if (s_retry_num < ESP_WIFI_MAXIMUM_RETRY) {
                 //user config SSID and PASSWORD
                 s_retry_num++;
                 ESP_LOGI(TAG, "retry to connect to the AP");
                 esp_wifi_connect();
             } else if (s_retry_num < ESP_WIFI_MAXIMUM_RETRY * 2) {
-                //if over max_try_num, use config in NVS to try ESP_WIFI_MAXIMUM_RETRY
-                if (ESP_OK == NVSread_to_wifi_config("WiFi_cfg")) {
+                //if over max_try_num, switch once to the other config and try it ESP_WIFI_MAXIMUM_RETRY
+                if ((s_retry_num > ESP_WIFI_MAXIMUM_RETRY) || (ESP_OK == wifi_config_switch())) {
                     s_retry_num++;
-                    ESP_LOGI(TAG, "retry to connect to the AP by NVSconfig");
+                    ESP_LOGI(TAG, "retry to connect to the AP by %s config", s_nvs_config ? "NVS" : "built-in");
                     esp_wifi_connect();
                 }
                 else {
@@ -168,15 +276,24 @@ static void event_handler(void* arg, esp_event_base_t event_base,
                 ESP_LOGW(TAG, "Here!");
                 xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
             }
+            if ((xEventGroupGetBits(s_wifi_event_group) & WIFI_FAIL_BIT) && (s_smart_task_Handle == NULL)) {
+                ESP_LOGW(TAG, "Failed to connect to SSID:%s", g_wifi_config.sta.ssid);
+                ESP_LOGW(TAG, "Start SmartConfig!");
+                xTaskCreatePinnedToCore(smartconfig_task, "smartconfig_task", 4096, NULL, 12, &s_smart_task_Handle, 0);
+            }
         }
     }
 
     if (event_base == IP_EVENT) {
         if (event_id == IP_EVENT_STA_GOT_IP) {
             ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-            ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+            ESP_LOGI(TAG, "got ip:" IPSTR " %lld ms after boot", IP2STR(&event->ip_info.ip),
+                     (long long)(esp_timer_get_time() / 1000));
             s_retry_num = 0;
+            s_fast_connect = false;
+            xEventGroupClearBits(s_wifi_event_group, WIFI_FAIL_BIT);
             xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+            wifi_fast_cache_update(&event->ip_info);
         }
     }
 
@@ -207,20 +324,18 @@ static void smartconfig_task(void * parm)
     ESP_ERROR_CHECK(esp_esptouch_set_timeout(255));
     ESP_ERROR_CHECK(esp_smartconfig_start(&cfg));
     ESP_LOGI(TAG, "smartconfig start .......");
-    while (1) {
-        uxBits = xEventGroupWaitBits(s_wifi_event_group, 
-                                        WIFI_CONNECTED_BIT | WIFI_SMART_CONFIG_BIT, 
-                                            true, false, portMAX_DELAY);
-        if(uxBits & WIFI_CONNECTED_BIT) {
-            ESP_LOGI(TAG, "WiFi Connected to ap");
-        }
-        if(uxBits & WIFI_SMART_CONFIG_BIT) {
-            ESP_LOGI(TAG, "smartconfig over");
-            //esp_smartconfig_stop();
-            xSemaphoreGive(smartconfig_Semaphore);
-            //vTaskDelete(NULL);
-        }
+    uxBits = xEventGroupWaitBits(s_wifi_event_group,
+                                    WIFI_SMART_CONFIG_BIT,
+                                        true, false, portMAX_DELAY);
+    if(uxBits & WIFI_SMART_CONFIG_BIT) {
+        ESP_LOGI(TAG, "smartconfig over");
     }
+    /* WIFI_CONNECTED_BIT stays set for wifi_wait_connected */
+    xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, false, false, portMAX_DELAY);
+    ESP_LOGI(TAG, "WiFi Connected to ap");
+    esp_smartconfig_stop();
+    s_smart_task_Handle = NULL;
+    vTaskDelete(NULL);
 }
 
 // read NVS config
@@ -234,8 +349,7 @@ static esp_err_t NVSread_to_wifi_config( const char* namespace_name )
     esp_err_t err = nvs_open(namespace_name, NVS_READONLY, &wifi_config_HandleNvs);
     if (err != ESP_OK)
     {
-        ESP_LOGW("NVS", "open fail!");
-        nvs_close(wifi_config_HandleNvs);
+        ESP_LOGW("NVS", "open fail!"); /* no handle to close */
         return err;
     } else {
         ESP_LOGI(TAG, "get NVS config");
@@ -259,6 +373,7 @@ static esp_err_t NVSread_to_wifi_config( const char* namespace_name )
     memcpy(g_wifi_config.sta.ssid, wifi_ssid, sizeof(g_wifi_config.sta.ssid));
     memcpy(g_wifi_config.sta.password, wifi_passwd, sizeof(g_wifi_config.sta.password));
     ESP_ERROR_CHECK( esp_wifi_set_config(WIFI_IF_STA, &g_wifi_config) );
+    s_nvs_config = true;
 
     nvs_close(wifi_config_HandleNvs);
     return ESP_OK;
@@ -300,6 +415,7 @@ static void NVSupdate_data(const char* namespace_name, smartconfig_event_got_ssi
     ESP_ERROR_CHECK( nvs_set_str(wifi_config_HandleNvs, NVS_KEY_PASSED, password) );
     ESP_ERROR_CHECK( nvs_commit(wifi_config_HandleNvs) );
     nvs_close(wifi_config_HandleNvs);
+    s_nvs_config = true;
     ESP_ERROR_CHECK( esp_wifi_disconnect() );
     ESP_ERROR_CHECK( esp_wifi_set_config(WIFI_IF_STA, &g_wifi_config) );
 }
\ No newline at end of file
@@ -2,8 +2,10 @@
 #define _WIFI_H_
 
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
 
-esp_err_t wifi_init_sta(void);
+esp_err_t wifi_init_sta(void); /* start the station, does not wait for the connection */
+esp_err_t wifi_wait_connected(TickType_t xTicksToWait); /* wait for an IP address */
 
 void udp_client_task(void *pvParameters);
 
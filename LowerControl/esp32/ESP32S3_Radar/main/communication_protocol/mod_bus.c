@@ -1,24 +1,27 @@
+#define RADAR_LOG_LEVEL CONFIG_RADAR_LOG_LEVEL_MODBUS
+
 #include <stdio.h>
+#include <string.h>
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "driver/uart.h"
 #include "mod_bus.h"
+#include "radar_counters.h"
+#include "radar_trace.h"
+#include "radar_log.h"
 
 static const char *TAG = "mod_bus";
 
-static Modbus_uart_rx_data g_uart_rx_modbus_frame = {0};    /* Data in valid frames */
+static uint16_t g_device_address = 0;          /* Device address, 0 until init */
+static QueueHandle_t g_request_queue = NULL;    /* Valid requests from every transport */
 
-static uint8_t g_abnormal_message[8] = {    /* Abnormal message format */
-    MODBUS_SLAVE_FRAME_HEAD,
-    MODBUS_SENSOR_TYPE,
-    MODBUS_OPT_ERROR,
-    MODBUS_OPT_ERROR,
-    MODBUS_OPT_ERROR,
-    /* Fill in the remaining three bytes according to the actual situation */
-};
+static Modbus_reply_t g_event_sink[MODBUS_EVENT_SINK_MAX];  /* Peers receiving unsolicited messages */
+static uint8_t g_event_sink_num = 0;
+static portMUX_TYPE g_event_sink_lock = portMUX_INITIALIZER_UNLOCKED;
 
 /**
  * @brief       Copy String to Frame receive buffer
@@ -58,7 +61,7 @@ static inline uint16_t Modbus_crc_check_sum(const uint8_t *buf, const uint16_t l
  * @brief       unpack receive data and
  *              copy the section of the frame from the start of the read/write operation code 
                 to the end of the data to the provided address
- * @param       pvalid_dat  : Address where the parsed data is stored
+ * @param       request     : Address where the parsed data is stored
  * @param       recv_dat    : receive data
  * @param       recv_len    : receive data len
  * 
@@ -66,7 +69,7 @@ static inline uint16_t Modbus_crc_check_sum(const uint8_t *buf, const uint16_t l
  * @retval      MODBUS_EOK    : No error
  * @retval      MODBUS_EFRAME : Frame format error
 */
-static uint8_t Modbus_judgment_recv_data(const uint8_t* recv_dat, const size_t recv_len)
+static uint8_t Modbus_judgment_recv_data(Modbus_request_t* request, const uint8_t* recv_dat, const size_t recv_len)
 {
     uint16_t frame_loop = 0;
     uint16_t frame_head_index;
@@ -77,6 +80,7 @@ static uint8_t Modbus_judgment_recv_data(const uint8_t* recv_dat, const size_t r
     if ((recv_len < MODBUS_FRAME_LEN_MIN) || (recv_len > MODBUS_FRAME_LEN_MAX))
     {
         /* received data length error */
+        Radar_counter_inc(RADAR_COUNTER_MODBUS_ERR_LENGTH);
         return MODBUS_EFRAME;
     }
 
@@ -96,7 +100,8 @@ static uint8_t Modbus_judgment_recv_data(const uint8_t* recv_dat, const size_t r
         else
         {
             /* Frame error */
-            printf("MODBUS HERE!");
+            RADAR_LOGD(TAG, "[no frame head]");
+            Radar_counter_inc(RADAR_COUNTER_MODBUS_ERR_HEAD);
             return MODBUS_EFRAME;
         }
     } while (1);
@@ -106,6 +111,7 @@ static uint8_t Modbus_judgment_recv_data(const uint8_t* recv_dat, const size_t r
     if ((frame_len < MODBUS_FRAME_LEN_MIN) || (frame_len > MODBUS_FRAME_LEN_MAX))
     {
         /* received data length error */
+        Radar_counter_inc(RADAR_COUNTER_MODBUS_ERR_LENGTH);
         return MODBUS_EFRAME;
     }
 
@@ -116,14 +122,17 @@ static uint8_t Modbus_judgment_recv_data(const uint8_t* recv_dat, const size_t r
         frame_check_sum = Modbus_crc_check_sum(&recv_dat[frame_head_index], 7);   /* Calculate CRC checksum */
         check_sum = ((uint16_t)recv_dat[frame_head_index + 7] << 8) + (uint16_t)recv_dat[frame_head_index + 8]; /* Frame CRC checksum */
         if (frame_check_sum != check_sum)
+        {
+            Radar_counter_inc(RADAR_COUNTER_MODBUS_ERR_CHECKSUM);
             return MODBUS_EFRAME;/* Frame error */
+        }
         else
         {
             /* Copy the section of the frame from the start of the read/write operation code 
             to the end of the data to the provided address */
-            g_uart_rx_modbus_frame.opt_type = opt_type;   /* Record Operation Type */
-            g_uart_rx_modbus_frame.fun_code = recv_dat[frame_head_index + 5];   /* Record Modebus funcation code */
-            g_uart_rx_modbus_frame.len      = recv_dat[frame_head_index + 6];   /* in read operation, Record number of bytes requested by the host */
+            request->opt_type = opt_type;   /* Record Operation Type */
+            request->fun_code = recv_dat[frame_head_index + 5];   /* Record Modebus funcation code */
+            request->len      = recv_dat[frame_head_index + 6];   /* in read operation, Record number of bytes requested by the host */
 
             return MODBUS_EOK;
         }
@@ -132,20 +141,24 @@ static uint8_t Modbus_judgment_recv_data(const uint8_t* recv_dat, const size_t r
         if ((dat_len + 9) > frame_len)
         {
             /* Frame error */
+            Radar_counter_inc(RADAR_COUNTER_MODBUS_ERR_LENGTH);
             return MODBUS_EFRAME;
         }
         frame_check_sum = Modbus_crc_check_sum(&recv_dat[frame_head_index], dat_len + 7);   /* Calculate CRC checksum */
         check_sum = ((uint16_t)recv_dat[frame_head_index + dat_len + 7] << 8) + (uint16_t)recv_dat[frame_head_index + dat_len + 8]; /* Frame CRC checksum */
         if (frame_check_sum != check_sum)
+        {
+            Radar_counter_inc(RADAR_COUNTER_MODBUS_ERR_CHECKSUM);
             return MODBUS_EFRAME;/* Frame error */
+        }
         else
         {
             /* Copy the section of the frame from the start of the read/write operation code 
             to the end of the data to the provided address */
-            g_uart_rx_modbus_frame.opt_type = opt_type;     /* Record Operation Type */
-            g_uart_rx_modbus_frame.fun_code = recv_dat[frame_head_index + 5];   /* Record Modebus funcation code */
-            g_uart_rx_modbus_frame.len      = recv_dat[frame_head_index + 6];   /* in write operation, Record the length of data sent by the host */
-            Modbus_copy_to_Framebuffer(g_uart_rx_modbus_frame.buf, 
+            request->opt_type = opt_type;     /* Record Operation Type */
+            request->fun_code = recv_dat[frame_head_index + 5];   /* Record Modebus funcation code */
+            request->len      = recv_dat[frame_head_index + 6];   /* in write operation, Record the length of data sent by the host */
+            Modbus_copy_to_Framebuffer(request->buf, 
                                        &recv_dat[frame_head_index + 7], 
                                        recv_dat[frame_head_index + 6]); /* copy receive data */
 
@@ -153,10 +166,24 @@ static uint8_t Modbus_judgment_recv_data(const uint8_t* recv_dat, const size_t r
         }
     } else {
         /* Frame error */
+        Radar_counter_inc(RADAR_COUNTER_MODBUS_ERR_OPT);
         return MODBUS_EFRAME;
     }
 }
 
+/**
+ * @brief       UART send function of the reply handle
+ * @param       reply   : reply handle, handle is the UART port number
+ * @param       data    : frame
+ * @param       len     : frame len
+ *
+ * @retval      void
+*/
+static void Modbus_uart_send(const Modbus_reply_t* reply, const uint8_t* data, size_t len)
+{
+    uart_write_bytes((uart_port_t)reply->handle, data, len);
+}
+
 /**
  * @brief       Processing data received by UART
  * @param       uart_num    UART port number
@@ -167,21 +194,84 @@ static uint8_t Modbus_judgment_recv_data(const uint8_t* recv_dat, const size_t r
 */
 static void Modbus_uart_DataHand(const uart_port_t uart_num, uint8_t* dat, size_t Len)
 {
-    g_uart_rx_modbus_frame.uart_num = uart_num;    /* Received UART port number */
-    ESP_LOGI(TAG, "[receive data]");
+    Modbus_reply_t reply = {
+        .send = Modbus_uart_send,
+        .handle = uart_num,     /* Received UART port number */
+        .timing.received_us = Radar_uart_event_time(uart_num),
+    };
+    RADAR_LOGD(TAG, "[receive data]");
+    if (reply.timing.received_us)
+        Radar_latency_record(RADAR_LATENCY_UART_EVENT, Radar_latency_now() - reply.timing.received_us);
+    Modbus_submit(dat, Len, &reply);
+}
+
+/**
+ * @brief       Parse a frame received by any transport and queue it for the execution task
+ *              Frame errors and a full queue are answered at once on the reply path,
+ *              so one busy or faulty peer never holds up the others
+ * @param       dat     : Received data address
+ * @param       len     : Received data Len
+ * @param       reply   : answer path of the request, copied; a transport that has no receive stamp
+ *                        leaves timing.received_us at 0 and the request is timed from here
+ *              Uses about 300 bytes of the caller stack
+ * 
+ * @retval      MODBUS_EOK    : queued
+ * @retval      MODBUS_EFRAME : Frame format error
+ * @retval      MODBUS_ERROR  : queue full or uninitialized
+*/
+uint8_t Modbus_submit(const uint8_t* dat, size_t len, const Modbus_reply_t* reply)
+{
+    Modbus_request_t request;   /* on the caller stack, so transports never wait for each other */
+    int64_t start = Radar_latency_now();
+
+    if (g_request_queue == NULL)
+        return MODBUS_ERROR;
+
+    request.reply = *reply;
+    if (request.reply.timing.received_us == 0)
+        request.reply.timing.received_us = start;
+    request.reply.timing.taken_us = 0;
     /* unpack receive data */
-    if (Modbus_judgment_recv_data(dat, Len))
+    if (Modbus_judgment_recv_data(&request, dat, len))
     {
-        ESP_LOGI(TAG, "[frame err!]");
-        Modbus_transmit_ErrCode(MODBUS_STATUSCODE_ERR_FRAME);  /* Illegal data frame */
-    } else {
-        /* give semaphore */
-        if ( (pdTRUE != xSemaphoreGive(g_uart_rx_modbus_frame.xBinarySemaphore)) && g_uart_rx_modbus_frame.status )
-        {
-            ESP_LOGI(TAG, "[busy!]");
-            Modbus_transmit_ErrCode(MODBUS_STATUSCODE_ERR_BUSY);   /* busy */
-        }
+        Radar_trace(RADAR_TRACE_FRAME_REJECTED, MODBUS_EFRAME, (uint32_t)len);
+        RADAR_LOGD(TAG, "[frame err!]");
+        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_FRAME);  /* Illegal data frame */
+        return MODBUS_EFRAME;
     }
+    /* give the request to the execution task */
+    request.reply.timing.parsed_us = Radar_latency_now();
+    if (xQueueSend(g_request_queue, &request, 0) != pdTRUE)
+    {
+        Radar_trace(RADAR_TRACE_FRAME_REJECTED, MODBUS_ERROR, (uint32_t)len);
+        RADAR_LOGW(TAG, "[busy!]");
+        Radar_counter_inc(RADAR_COUNTER_MODBUS_BUSY);
+        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_BUSY);   /* busy */
+        return MODBUS_ERROR;
+    }
+    Radar_latency_record(RADAR_LATENCY_PARSE, request.reply.timing.parsed_us - start);
+    Radar_counter_inc(RADAR_COUNTER_MODBUS_FRAME_OK);
+    Radar_trace(RADAR_TRACE_FRAME_PARSED, (uint16_t)((request.fun_code << 8) | request.opt_type), (uint32_t)len);
+    return MODBUS_EOK;
+}
+
+/**
+ * @brief       Take the next request, blocking before obtaining data
+ * @param       request      : where the request is copied
+ * @param       xTicksToWait : wait time
+ * 
+ * @retval      true  : request obtained
+ * @retval      false : time out
+*/
+bool Modbus_receive(Modbus_request_t* request, TickType_t xTicksToWait)
+{
+    if (g_request_queue == NULL)
+        return false;
+    if (xQueueReceive(g_request_queue, request, xTicksToWait) != pdTRUE)
+        return false;
+    request->reply.timing.taken_us = Radar_latency_now();
+    Radar_latency_record(RADAR_LATENCY_QUEUE, request->reply.timing.taken_us - request->reply.timing.parsed_us);
+    return true;
 }
 
 /**
@@ -193,12 +283,18 @@ static void Modbus_uart_DataHand(const uart_port_t uart_num, uint8_t* dat, size_
 */
 uint8_t Modbus_init(uart_port_t uart_num)
 {
-    if ( g_uart_rx_modbus_frame.device_address )
+    if ( g_device_address )
         return MODBUS_EOK;
     esp_err_t err;
     nvs_handle_t DeviceAddress_nvs_handle;
-    /* Creating semaphores */
-    g_uart_rx_modbus_frame.xBinarySemaphore = xSemaphoreCreateBinary();
+    Modbus_reply_t uart_reply = {
+        .send = Modbus_uart_send,
+        .handle = uart_num,
+    };
+    /* Creating request queue */
+    g_request_queue = xQueueCreate(MODBUS_REQUEST_QUEUE_LEN, sizeof(Modbus_request_t));
+    if (g_request_queue == NULL)
+        return MODBUS_ERROR;
     // Initialize NVS
     err = nvs_flash_init();
     if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -208,71 +304,135 @@ uint8_t Modbus_init(uart_port_t uart_num)
         err = nvs_flash_init();
     }
     ESP_ERROR_CHECK( err );
+    uint16_t device_address = MODBUS_INITIAL_DEVICE_ADDRESS;
     err = nvs_open("MODEBUS", NVS_READWRITE, &DeviceAddress_nvs_handle);
-    if (err != ESP_OK) {
-        g_uart_rx_modbus_frame.device_address = MODBUS_INITIAL_DEVICE_ADDRESS;
-    } else {
+    if (err == ESP_OK) {
         uint16_t DeviceAddress; 
         err = nvs_get_u16(DeviceAddress_nvs_handle, "DeviceAddress", &DeviceAddress); // get stored address
-        if (err != ESP_OK) {
-            /*  address will default to 0x0001, if not set yet in NVS */
-            g_uart_rx_modbus_frame.device_address = MODBUS_INITIAL_DEVICE_ADDRESS; // no stored values
-        } else {
-            g_uart_rx_modbus_frame.device_address = DeviceAddress;  
-        }
+        if (err == ESP_OK) {
+            device_address = DeviceAddress;
+        } /* else address will default to 0x0001, if not set yet in NVS */
+        nvs_close(DeviceAddress_nvs_handle);
     }
-    nvs_close(DeviceAddress_nvs_handle);
-    /* init data processing status */
-    g_uart_rx_modbus_frame.status = true;
     /* Register the processing function corresponding to the port number */
     err = radar_UART_ChangeFunbyNum(uart_num, Modbus_uart_DataHand);
     if (err == ESP_FAIL)
         return MODBUS_ERROR;    /* port number error */
-    else
-        /* Record the UART port number for establishing the connection */
-        g_uart_rx_modbus_frame.uart_num = uart_num; 
+    /* The host UART receives unsolicited messages, as before network transports existed */
+    Modbus_subscribe_events(&uart_reply);
+    g_device_address = device_address;
     ESP_LOGI(TAG, "connent UART%d", uart_num);
 
     return MODBUS_EOK;
 }
 
 /**
- * @brief       get data address
+ * @brief       get device address
  * @param       void
  * 
- * @retval      NULL : uninitialized
+ * @retval      0 : uninitialized
  * @retval      other : address
 */
-Modbus_uart_rx_data* Modbus_Get_rx_Data_Address(void)
+uint16_t Modbus_get_device_address(void)
 {
-    if ( g_uart_rx_modbus_frame.device_address )
-        return &g_uart_rx_modbus_frame;
-    else
-        return NULL;
+    return g_device_address;
+}
+
+/**
+ * @brief       Send unsolicited messages (Modbus_push_event) to this peer too
+ *              A peer already subscribed is ignored, the oldest network peer is replaced when the table is full
+ * @param       reply : answer path of a request from the peer, copied
+ * 
+ * @retval      void
+*/
+void Modbus_subscribe_events(const Modbus_reply_t* reply)
+{
+    uint8_t slot;
+
+    if (reply->send == NULL)
+        return;
+    taskENTER_CRITICAL(&g_event_sink_lock);
+    for (slot = 0; slot < g_event_sink_num; slot++)
+    {
+        if ((g_event_sink[slot].send == reply->send) && (g_event_sink[slot].handle == reply->handle) &&
+            (g_event_sink[slot].addr_len == reply->addr_len) &&
+            (memcmp(g_event_sink[slot].addr, reply->addr, reply->addr_len) == 0))
+            break;
+    }
+    if (slot == g_event_sink_num)
+    {
+        if (g_event_sink_num < MODBUS_EVENT_SINK_MAX)
+            g_event_sink_num++;
+        else
+        {
+            /* keep the host UART in slot 0 */
+            memmove(&g_event_sink[1], &g_event_sink[2], (MODBUS_EVENT_SINK_MAX - 2) * sizeof(Modbus_reply_t));
+            slot = MODBUS_EVENT_SINK_MAX - 1;
+        }
+        g_event_sink[slot] = *reply;
+        memset(&g_event_sink[slot].timing, 0, sizeof(g_event_sink[slot].timing)); /* events are not timed */
+    }
+    taskEXIT_CRITICAL(&g_event_sink_lock);
+}
+
+/**
+ * @brief       Send a frame on a reply path
+ *              The answer to a request taken by the execution task closes its dispatch stage,
+ *              the send itself is the reply stage
+ * @param       reply   : answer path
+ * @param       data    : frame
+ * @param       len     : frame len
+*/
+static inline void Modbus_reply_send(const Modbus_reply_t* reply, const uint8_t* data, size_t len)
+{
+    int64_t start;
+    int64_t end;
+
+    if ((reply == NULL) || (reply->send == NULL))
+        return;
+    start = Radar_latency_now();
+    reply->send(reply, data, len);
+    if (reply->timing.taken_us == 0)
+        return; /* frame error, busy or unsolicited message */
+    end = Radar_latency_now();
+    Radar_latency_record(RADAR_LATENCY_DISPATCH, start - reply->timing.taken_us);
+    Radar_latency_record(RADAR_LATENCY_REPLY, end - start);
+    Radar_latency_record(RADAR_LATENCY_REQUEST, end - reply->timing.received_us);
 }
 
 /**
  * @brief       transmit in abnormal message
+ * @param       reply    The answer path of the request
  * @param       err_code The working status code contained in the slave return message
 */
-void Modbus_transmit_ErrCode(uint8_t err_code)
+void Modbus_transmit_ErrCode(const Modbus_reply_t* reply, uint8_t err_code)
 {
     uint16_t check_sum;
-    g_abnormal_message[5] = err_code;
-    check_sum = Modbus_crc_check_sum(g_abnormal_message, 6);
-    g_abnormal_message[6] = (uint8_t)(check_sum >> 8);
-    g_abnormal_message[7] = (uint8_t)(check_sum & 0xFF);
-    uart_write_bytes(g_uart_rx_modbus_frame.uart_num, g_abnormal_message, 8);
+    uint8_t abnormal_message[8] = {    /* Abnormal message format */
+        MODBUS_SLAVE_FRAME_HEAD,
+        MODBUS_SENSOR_TYPE,
+        MODBUS_OPT_ERROR,
+        MODBUS_OPT_ERROR,
+        MODBUS_OPT_ERROR,
+        /* Fill in the remaining three bytes according to the actual situation */
+    };
+
+    abnormal_message[5] = err_code;
+    check_sum = Modbus_crc_check_sum(abnormal_message, 6);
+    abnormal_message[6] = (uint8_t)(check_sum >> 8);
+    abnormal_message[7] = (uint8_t)(check_sum & 0xFF);
+    Modbus_reply_send(reply, abnormal_message, 8);
 }
 
 /**
  * @brief       Return read message to the host(Up to two bytes of data)
  * 
+ * @param       reply   : answer path of the request
  * @param       fun_code: function code    
  * 
  * @retval      void
 */
-void Modbus_back_read_message(uint8_t fun_code, uint8_t len, uint16_t data)
+void Modbus_back_read_message(const Modbus_reply_t* reply, uint8_t fun_code, uint8_t len, uint16_t data)
 {
     uint16_t check_sum;
     if ( len == 0x01 ) /* 1 byte data */
@@ -281,8 +441,8 @@ void Modbus_back_read_message(uint8_t fun_code, uint8_t len, uint16_t data)
         
         buf[0] = MODBUS_SLAVE_FRAME_HEAD;                   /* Slave response frame header */
         buf[1] = MODBUS_SENSOR_TYPE;                        /* Type code */
-        buf[2] = (uint8_t)(g_uart_rx_modbus_frame.device_address >> 8);     /* Device address，High 8 bits */
-        buf[3] = (uint8_t)(g_uart_rx_modbus_frame.device_address & 0xFF);   /* Device address，low 8 bits */
+        buf[2] = (uint8_t)(g_device_address >> 8);          /* Device address，High 8 bits */
+        buf[3] = (uint8_t)(g_device_address & 0xFF);        /* Device address，low 8 bits */
         buf[4] = MODBUS_OPT_READ;                            /* read operation */
         buf[5] = MODBUS_STATUSCODE_NORMAL;                   /* Work status code */
         buf[6] = fun_code;                                   /* function code */
@@ -295,15 +455,15 @@ void Modbus_back_read_message(uint8_t fun_code, uint8_t len, uint16_t data)
         buf[9] = (uint8_t)(check_sum >> 8);                /* CRC check code, high 8 bits */
         buf[10] = (uint8_t)(check_sum & 0xFF);              /* CRC check code, low 8 bits */
     
-        uart_write_bytes(g_uart_rx_modbus_frame.uart_num, buf, 11); /* send data */
+        Modbus_reply_send(reply, buf, 11); /* send data */
     } else if ( len == 0x02 ) /* 2 byte data */
     {
         uint8_t buf[12];
 
         buf[0] = MODBUS_SLAVE_FRAME_HEAD;                   /* Slave response frame header */
         buf[1] = MODBUS_SENSOR_TYPE;                        /* Type code */
-        buf[2] = (uint8_t)(g_uart_rx_modbus_frame.device_address >> 8);     /* Device address，High 8 bits */
-        buf[3] = (uint8_t)(g_uart_rx_modbus_frame.device_address & 0xFF);   /* Device address，low 8 bits */
+        buf[2] = (uint8_t)(g_device_address >> 8);          /* Device address，High 8 bits */
+        buf[3] = (uint8_t)(g_device_address & 0xFF);        /* Device address，low 8 bits */
         buf[4] = MODBUS_OPT_READ;                            /* read operation */
         buf[5] = MODBUS_STATUSCODE_NORMAL;                   /* Work status code */
         buf[6] = fun_code;                                   /* function code */
@@ -317,33 +477,129 @@ void Modbus_back_read_message(uint8_t fun_code, uint8_t len, uint16_t data)
         buf[10] = (uint8_t)(check_sum >> 8);                /* CRC check code, high 8 bits */
         buf[11] = (uint8_t)(check_sum & 0xFF);              /* CRC check code, low 8 bits */
 
-        uart_write_bytes(g_uart_rx_modbus_frame.uart_num, buf, 12); /* send data */
+        Modbus_reply_send(reply, buf, 12); /* send data */
     }
 }
 
 /**
  * @brief       Return write message to the host
  * 
+ * @param       reply   : answer path of the request
  * @param       fun_code: function code    
  * 
  * @retval      void
 */
-void Modbus_back_write_message(uint8_t fun_code)
+void Modbus_back_write_message(const Modbus_reply_t* reply, uint8_t fun_code)
 {
     uint16_t check_sum;
     uint8_t buf[8];
     
-    buf[0] = MODBUS_SLAVE_FRAME_HEAD;                                   /* Slave response frame header */
-    buf[1] = MODBUS_SENSOR_TYPE;                                        /* Type code */
-    buf[2] = (uint8_t)(g_uart_rx_modbus_frame.device_address >> 8);     /* Device address，High 8 bits */
-    buf[3] = (uint8_t)(g_uart_rx_modbus_frame.device_address & 0xFF);   /* Device address，low 8 bits */
-    buf[4] = MODBUS_OPT_WRITE;                                          /* Write operation */
-    buf[5] = fun_code;                                                  /* function code */
+    buf[0] = MODBUS_SLAVE_FRAME_HEAD;                   /* Slave response frame header */
+    buf[1] = MODBUS_SENSOR_TYPE;                        /* Type code */
+    buf[2] = (uint8_t)(g_device_address >> 8);          /* Device address，High 8 bits */
+    buf[3] = (uint8_t)(g_device_address & 0xFF);        /* Device address，low 8 bits */
+    buf[4] = MODBUS_OPT_WRITE;                          /* Write operation */
+    buf[5] = fun_code;                                  /* function code */
     
-    check_sum = Modbus_crc_check_sum(buf, 7);           /* Calculate CRC checksum */
+    check_sum = Modbus_crc_check_sum(buf, 6);           /* Calculate CRC checksum */
      
     buf[6] = (uint8_t)(check_sum >> 8);                  /* CRC check code, high 8 bits */
     buf[7] = (uint8_t)(check_sum & 0xFF);                /* CRC check code, low 8 bits */
 
-    uart_write_bytes(g_uart_rx_modbus_frame.uart_num, buf, 9); /* send data */
-}
\ No newline at end of file
+    Modbus_reply_send(reply, buf, 8); /* send data */
+}
+
+/**
+ * @brief       Return read message to the host(Up to 255 bytes of data)
+ *              The checksum covers every byte before it
+ * 
+ * @param       reply   : answer path of the request
+ * @param       fun_code: function code
+ * @param       data    : data to return
+ * @param       len     : data len
+ * 
+ * @retval      void
+*/
+void Modbus_back_read_buffer(const Modbus_reply_t* reply, uint8_t fun_code, const uint8_t* data, uint8_t len)
+{
+    uint16_t check_sum;
+    static uint8_t buf[UINT8_MAX + 10]; /* only called from the execution task */
+
+    buf[0] = MODBUS_SLAVE_FRAME_HEAD;                   /* Slave response frame header */
+    buf[1] = MODBUS_SENSOR_TYPE;                        /* Type code */
+    buf[2] = (uint8_t)(g_device_address >> 8);          /* Device address，High 8 bits */
+    buf[3] = (uint8_t)(g_device_address & 0xFF);        /* Device address，low 8 bits */
+    buf[4] = MODBUS_OPT_READ;                            /* read operation */
+    buf[5] = MODBUS_STATUSCODE_NORMAL;                   /* Work status code */
+    buf[6] = fun_code;                                   /* function code */
+    buf[7] = len;                                        /* data len */
+    memcpy(&buf[8], data, len);                          /* data */
+
+    check_sum = Modbus_crc_check_sum(buf, len + 8);      /* Calculate CRC checksum */
+
+    buf[len + 8] = (uint8_t)(check_sum >> 8);            /* CRC check code, high 8 bits */
+    buf[len + 9] = (uint8_t)(check_sum & 0xFF);          /* CRC check code, low 8 bits */
+
+    Modbus_reply_send(reply, buf, len + 10); /* send data */
+}
+
+/**
+ * @brief       Send an unsolicited read message to every subscribed peer(Up to 16 bytes of data)
+ *              Safe to call from any task, the frame is built on the stack
+ *              and every transport keeps one call contiguous on the wire
+ * 
+ * @param       fun_code: function code identifying the event
+ * @param       data    : event data
+ * @param       len     : data len
+ * 
+ * @retval      void
+*/
+void Modbus_push_event(uint8_t fun_code, const uint8_t* data, uint8_t len)
+{
+    uint16_t check_sum;
+    uint8_t buf[16 + 10];
+    Modbus_reply_t sink[MODBUS_EVENT_SINK_MAX];
+    uint8_t sink_num;
+
+    if (len > 16)
+        return;
+
+    buf[0] = MODBUS_SLAVE_FRAME_HEAD;                   /* Slave response frame header */
+    buf[1] = MODBUS_SENSOR_TYPE;                        /* Type code */
+    buf[2] = (uint8_t)(g_device_address >> 8);          /* Device address，High 8 bits */
+    buf[3] = (uint8_t)(g_device_address & 0xFF);        /* Device address，low 8 bits */
+    buf[4] = MODBUS_OPT_READ;                            /* read operation */
+    buf[5] = MODBUS_STATUSCODE_NORMAL;                   /* Work status code */
+    buf[6] = fun_code;                                   /* function code */
+    buf[7] = len;                                        /* data len */
+    memcpy(&buf[8], data, len);                          /* data */
+
+    check_sum = Modbus_crc_check_sum(buf, len + 8);      /* Calculate CRC checksum */
+
+    buf[len + 8] = (uint8_t)(check_sum >> 8);            /* CRC check code, high 8 bits */
+    buf[len + 9] = (uint8_t)(check_sum & 0xFF);          /* CRC check code, low 8 bits */
+
+    /* send outside the lock, a network send may block */
+    taskENTER_CRITICAL(&g_event_sink_lock);
+    sink_num = g_event_sink_num;
+    memcpy(sink, g_event_sink, sink_num * sizeof(Modbus_reply_t));
+    taskEXIT_CRITICAL(&g_event_sink_lock);
+
+    for (uint8_t i = 0; i < sink_num; i++)
+        Modbus_reply_send(&sink[i], buf, len + 10); /* send data */
+}
+
+#if CONFIG_RADAR_BENCH
+/**
+ * @brief       The static kernels of this file, for the benchmarks of components/Radar_Bench
+ */
+uint16_t Modbus_bench_check_sum(const uint8_t* buf, uint16_t len)
+{
+    return Modbus_crc_check_sum(buf, len);
+}
+
+uint8_t Modbus_bench_judgment_recv_data(Modbus_request_t* request, const uint8_t* recv_dat, size_t recv_len)
+{
+    return Modbus_judgment_recv_data(request, recv_dat, recv_len);
+}
+#endif
@@ -2,6 +2,8 @@
 #define _MOD_BUS_H_
 
 #include "radar_uart.h"
+#include "radar_latency.h"
+#include "sdkconfig.h"
 /* fun_code */
 enum
 {
@@ -13,6 +15,17 @@ enum
     MODBUS_FUNCODE_WORKMODE         = 0x06, /* Work mode */
     MODBUS_FUNCODE_MEASUREMODE      = 0x07, /* Measurement mode settings */
     MODBUS_FUNCODE_CALIMODE         = 0x08, /* Calibration Mode */
+    MODBUS_FUNCODE_OUTPUTFORMAT     = 0x09, /* Sweep output format of this channel */
+    MODBUS_FUNCODE_SWEEPDATA        = 0x0A, /* Obtain one page of the latest sweep */
+    MODBUS_FUNCODE_OCCUPANCY        = 0x0B, /* Occupancy grid information and tile delta */
+    MODBUS_FUNCODE_SECTORQUERY      = 0x0C, /* Minimum, argmin and mean distance of a sector */
+    MODBUS_FUNCODE_SECTORALARM      = 0x0D, /* Sector threshold alarm, also the code of alarm events */
+    MODBUS_FUNCODE_STREAMSTATS      = 0x0E, /* Scan stream loss and recovery counters */
+    MODBUS_FUNCODE_LATENCY          = 0x0F, /* Per-stage latency histograms */
+    MODBUS_FUNCODE_COUNTERS         = 0x10, /* Health block: uptime, heap and event counters */
+    MODBUS_FUNCODE_TASKSTATS        = 0x11, /* Task CPU load, stack headroom and core idle time */
+    MODBUS_FUNCODE_TRACE            = 0x12, /* Hot-path event trace control and dump */
+    MODBUS_FUNCODE_CAPTURE          = 0x13, /* Raw UART capture dump, load and replay */
 };
 
 /* Work status code */
@@ -110,22 +123,48 @@ enum
 
 #define MODBUS_WAITTIME (100 / portTICK_PERIOD_MS) /* Maximum waiting time */
 
+#define MODBUS_REQUEST_QUEUE_LEN   8       /* Requests waiting for the execution task, from every transport */
+#define MODBUS_REPLY_ADDR_MAX      28      /* Largest transport address kept in a reply handle (sockaddr_in6) */
+#define MODBUS_EVENT_SINK_MAX      4       /* Reply handles receiving unsolicited messages */
+
+typedef struct Modbus_reply Modbus_reply_t;
+
+/* Transport send function, writes one whole frame to the peer described by the reply handle */
+typedef void(* pModbus_Send_t)(const Modbus_reply_t* reply, const uint8_t* data, size_t len);
+
+/* Where the answer to a request goes: filled by the transport that received it, copied with the request */
+struct Modbus_reply {
+    pModbus_Send_t send;                /* Transport send function, NULL for no answer */
+    int handle;                         /* UART port number, socket... */
+    uint8_t channel;                    /* Sweep output channel of the peer, see sweep_output.h */
+    uint8_t addr_len;                   /* Length of addr, 0 when the handle is enough */
+    uint8_t addr[MODBUS_REPLY_ADDR_MAX];/* Peer address, e.g. the UDP source of the request; not aligned, copy it out before use */
+    Radar_latency_stamps_t timing;      /* Stage stamps of the request, all 0 for unsolicited messages */
+};
+
 typedef struct {
-    bool status;                        /* Structure state, true represents completion of data processing */
-    uint16_t device_address;            /* Device address, Address Range：0x0001~0xFFFE */
-    uart_port_t uart_num;               /* UART port number */
-    SemaphoreHandle_t xBinarySemaphore; /* Binary semaphores are used to determine the arrival of data  */
+    Modbus_reply_t reply;               /* Answer path of this request */
     uint8_t opt_type;                   /* Operation type: 0x00 = read, 0x01 = write, 0xFF = error */
     uint8_t fun_code;                   /* Modebus funcation code */
     size_t len;                         /* Frame receive data Len */
-    uint8_t buf[RX_BUF_SIZE];           /* Frame receive data buffer */
-} Modbus_uart_rx_data;
+    uint8_t buf[UINT8_MAX];             /* Frame receive data buffer */
+} Modbus_request_t;
 
 
 uint8_t Modbus_init(uart_port_t uart_num); /* init Modbus */
-Modbus_uart_rx_data* Modbus_Get_rx_Data_Address(void); /* get data address */
-void Modbus_transmit_ErrCode(uint8_t work_code);   /* transmit in abnormal message */
-void Modbus_back_read_message(uint8_t fun_code, uint8_t len, uint16_t data); /* Return read message to the host(include 2 byte data) */
-void Modbus_back_write_message(uint8_t fun_code); /* Return write message to the host */
-
-#endif
\ No newline at end of file
+uint16_t Modbus_get_device_address(void); /* get device address */
+uint8_t Modbus_submit(const uint8_t* dat, size_t len, const Modbus_reply_t* reply); /* parse a frame from any transport and queue it */
+bool Modbus_receive(Modbus_request_t* request, TickType_t xTicksToWait); /* take the next request */
+void Modbus_subscribe_events(const Modbus_reply_t* reply); /* send unsolicited messages to this peer too */
+void Modbus_transmit_ErrCode(const Modbus_reply_t* reply, uint8_t work_code);   /* transmit in abnormal message */
+void Modbus_back_read_message(const Modbus_reply_t* reply, uint8_t fun_code, uint8_t len, uint16_t data); /* Return read message to the host(include 2 byte data) */
+void Modbus_back_write_message(const Modbus_reply_t* reply, uint8_t fun_code); /* Return write message to the host */
+void Modbus_back_read_buffer(const Modbus_reply_t* reply, uint8_t fun_code, const uint8_t* data, uint8_t len); /* Return read message to the host(up to 255 bytes of data) */
+void Modbus_push_event(uint8_t fun_code, const uint8_t* data, uint8_t len); /* Send an unsolicited read message(up to 16 bytes of data) */
+
+#if CONFIG_RADAR_BENCH
+uint16_t Modbus_bench_check_sum(const uint8_t* buf, uint16_t len); /* checksum kernel, for components/Radar_Bench */
+uint8_t Modbus_bench_judgment_recv_data(Modbus_request_t* request, const uint8_t* recv_dat, size_t recv_len); /* frame parser kernel */
+#endif
+
+#endif
@@ -0,0 +1,59 @@
+#include "freertos/FreeRTOS.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#include "radar_counters.h"
+
+uint32_t g_radar_counters[portNUM_PROCESSORS][RADAR_COUNTER_NUM];
+
+/**
+ * @brief       Read one counter
+ *              The rows are read one after the other, the sum may miss increments made meanwhile
+ * @param       counter : counter
+ *
+ * @retval      sum of the counts of every core, 0 if the counter does not exist
+ */
+uint32_t Radar_counter_get(uint8_t counter)
+{
+    uint32_t sum = 0;
+
+    if (counter >= RADAR_COUNTER_NUM)
+        return 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+        sum += __atomic_load_n(&g_radar_counters[core][counter], __ATOMIC_RELAXED);
+    return sum;
+}
+
+/**
+ * @brief       Write a 32-bit value, high byte first
+ */
+static inline void Radar_counters_put_u32(uint8_t* buf, uint32_t value)
+{
+    buf[0] = (uint8_t)(value >> 24);
+    buf[1] = (uint8_t)(value >> 16);
+    buf[2] = (uint8_t)(value >> 8);
+    buf[3] = (uint8_t)(value & 0xFF);
+}
+
+/**
+ * @brief       Encode the health block, see radar_counters.h
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : buf is too small
+ * @retval      other : RADAR_COUNTERS_ANSWER_LEN
+ */
+size_t Radar_counters_encode(uint8_t* buf, size_t capacity)
+{
+    if (capacity < RADAR_COUNTERS_ANSWER_LEN)
+        return 0;
+
+    Radar_counters_put_u32(&buf[0], (uint32_t)(esp_timer_get_time() / 1000000));
+    Radar_counters_put_u32(&buf[4], esp_get_free_heap_size());
+    Radar_counters_put_u32(&buf[8], esp_get_minimum_free_heap_size());
+    buf[12] = (uint8_t)esp_reset_reason();
+    buf[13] = RADAR_COUNTER_NUM;
+    for (uint8_t i = 0; i < RADAR_COUNTER_NUM; i++)
+        Radar_counters_put_u32(&buf[14 + 4 * i], Radar_counter_get(i));
+    return RADAR_COUNTERS_ANSWER_LEN;
+}
@@ -0,0 +1,73 @@
+#ifndef _RADAR_COUNTERS_H_
+#define _RADAR_COUNTERS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+#define RADAR_COUNTER_UART_PORTS    3       /* UART0..UART2 of the ESP32-S3 */
+
+/* Event counters, they only ever count up and wrap at 2^32 */
+enum
+{
+    RADAR_COUNTER_MODBUS_FRAME_OK       = 0x00, /* Frames parsed and queued */
+    RADAR_COUNTER_MODBUS_ERR_LENGTH     = 0x01, /* Rejected: frame or data length out of range */
+    RADAR_COUNTER_MODBUS_ERR_HEAD       = 0x02, /* Rejected: no frame head */
+    RADAR_COUNTER_MODBUS_ERR_CHECKSUM   = 0x03, /* Rejected: checksum mismatch */
+    RADAR_COUNTER_MODBUS_ERR_OPT        = 0x04, /* Rejected: unknown operation type */
+    RADAR_COUNTER_MODBUS_BUSY           = 0x05, /* BUSY replies, request queue full */
+    RADAR_COUNTER_UART_FIFO_OVF         = 0x06, /* HW FIFO overflows, one counter per port */
+    RADAR_COUNTER_UART_BUFFER_FULL      = RADAR_COUNTER_UART_FIFO_OVF + RADAR_COUNTER_UART_PORTS,  /* Ring buffer full, per port */
+    RADAR_COUNTER_UART_LINE_ERR         = RADAR_COUNTER_UART_BUFFER_FULL + RADAR_COUNTER_UART_PORTS, /* Break, parity and frame errors, per port */
+    RADAR_COUNTER_SENSOR_READ           = RADAR_COUNTER_UART_LINE_ERR + RADAR_COUNTER_UART_PORTS,  /* Sensor measurements requested */
+    RADAR_COUNTER_SENSOR_TIMEOUT,               /* Sensor did not answer */
+    RADAR_COUNTER_SENSOR_FRAME,                 /* Sensor answer with a frame error */
+    RADAR_COUNTER_SENSOR_CRC,                   /* Sensor answer with a CRC error */
+    RADAR_COUNTER_SENSOR_OPT,                   /* Sensor reported an operation error */
+    RADAR_COUNTER_SENSOR_LATE,                  /* Scan step stored without a measurement in time */
+    RADAR_COUNTER_SERVO_COMMAND,                /* Servo angle commands */
+    RADAR_COUNTER_SWEEP_COMPLETE,               /* Sweeps published */
+    RADAR_COUNTER_SWEEP_DROPPED,                /* Sweeps not started, every buffer held by a reader */
+    RADAR_COUNTER_POINT_DROPPED,                /* Samples without a sweep being filled or out of its bins */
+    RADAR_COUNTER_SECTOR_ALARM_DROPPED,         /* Sector alarm events lost, event queue full */
+    RADAR_COUNTER_NUM,
+};
+
+/*
+ * Health block answer, all fields high byte first:
+ * uptime_s(4) free_heap(4) min_free_heap(4) reset_reason(1) counter_num(1) counters(4 * counter_num)
+ */
+#define RADAR_COUNTERS_ANSWER_LEN   (14 + 4 * RADAR_COUNTER_NUM)
+
+extern uint32_t g_radar_counters[portNUM_PROCESSORS][RADAR_COUNTER_NUM];
+
+/**
+ * @brief       Count one event
+ *              Each core has its own row, so increments never contend for a cache line or a lock;
+ *              the add is atomic because a task may be preempted by another one on the same core
+ * @param       counter : counter, see above
+ *
+ * @retval      void
+ */
+static inline void Radar_counter_inc(uint8_t counter)
+{
+    __atomic_fetch_add(&g_radar_counters[xPortGetCoreID()][counter], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief       Count one event of a UART port
+ * @param       counter  : RADAR_COUNTER_UART_FIFO_OVF, RADAR_COUNTER_UART_BUFFER_FULL or RADAR_COUNTER_UART_LINE_ERR
+ * @param       uart_num : port
+ *
+ * @retval      void
+ */
+static inline void Radar_counter_inc_port(uint8_t counter, int uart_num)
+{
+    if ((uart_num >= 0) && (uart_num < RADAR_COUNTER_UART_PORTS))
+        Radar_counter_inc((uint8_t)(counter + uart_num));
+}
+
+uint32_t Radar_counter_get(uint8_t counter); /* sum of the cores */
+size_t Radar_counters_encode(uint8_t* buf, size_t capacity); /* health block answer */
+
+#endif
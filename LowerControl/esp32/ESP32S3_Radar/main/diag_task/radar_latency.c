@@ -0,0 +1,111 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#include "radar_latency.h"
+
+typedef struct {
+    uint32_t count;                             /* Samples recorded */
+    uint32_t max_us;                            /* Longest sample */
+    uint64_t sum_us;                            /* Sum of the samples, for the mean */
+    uint32_t bucket[RADAR_LATENCY_BUCKET_NUM];  /* Samples per log2 bucket */
+} Radar_latency_histogram_t;
+
+static Radar_latency_histogram_t g_latency[RADAR_LATENCY_STAGE_NUM];
+static portMUX_TYPE g_latency_lock = portMUX_INITIALIZER_UNLOCKED; /* Stages are recorded from both cores */
+
+#if CONFIG_RADAR_LATENCY_HISTOGRAMS
+/**
+ * @brief       Add one sample to the histogram of a stage
+ *              A few instructions under a spinlock, safe from any task
+ * @param       stage      : stage, see radar_latency.h
+ * @param       elapsed_us : time spent in the stage, negative values (stamps from before a reset) are dropped
+ *
+ * @retval      void
+ */
+void Radar_latency_record(uint8_t stage, int64_t elapsed_us)
+{
+    Radar_latency_histogram_t* histogram;
+    uint32_t us;
+    uint8_t bucket;
+
+    if ((stage >= RADAR_LATENCY_STAGE_NUM) || (elapsed_us < 0))
+        return;
+    us = (elapsed_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed_us;
+    bucket = (us == 0) ? 0 : (uint8_t)(32 - __builtin_clz(us));
+    if (bucket >= RADAR_LATENCY_BUCKET_NUM)
+        bucket = RADAR_LATENCY_BUCKET_NUM - 1;
+
+    histogram = &g_latency[stage];
+    taskENTER_CRITICAL(&g_latency_lock);
+    histogram->count++;
+    histogram->sum_us += us;
+    if (us > histogram->max_us)
+        histogram->max_us = us;
+    histogram->bucket[bucket]++;
+    taskEXIT_CRITICAL(&g_latency_lock);
+}
+#endif
+
+/**
+ * @brief       Clear the histogram of a stage
+ * @param       stage : stage, or RADAR_LATENCY_ALL_STAGES
+ *
+ * @retval      ESP_OK              : success
+ * @retval      ESP_ERR_INVALID_ARG : stage does not exist
+ */
+esp_err_t Radar_latency_reset(uint8_t stage)
+{
+    if ((stage >= RADAR_LATENCY_STAGE_NUM) && (stage != RADAR_LATENCY_ALL_STAGES))
+        return ESP_ERR_INVALID_ARG;
+    taskENTER_CRITICAL(&g_latency_lock);
+    if (stage == RADAR_LATENCY_ALL_STAGES)
+        memset(g_latency, 0, sizeof(g_latency));
+    else
+        memset(&g_latency[stage], 0, sizeof(g_latency[stage]));
+    taskEXIT_CRITICAL(&g_latency_lock);
+    return ESP_OK;
+}
+
+/**
+ * @brief       Write a 32-bit value, high byte first
+ */
+static inline void Radar_latency_put_u32(uint8_t* buf, uint32_t value)
+{
+    buf[0] = (uint8_t)(value >> 24);
+    buf[1] = (uint8_t)(value >> 16);
+    buf[2] = (uint8_t)(value >> 8);
+    buf[3] = (uint8_t)(value & 0xFF);
+}
+
+/**
+ * @brief       Encode the histogram of a stage, see radar_latency.h
+ *              The histogram is copied under the lock so the answer is consistent
+ * @param       stage    : stage
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : stage does not exist or buf is too small
+ * @retval      other : RADAR_LATENCY_ANSWER_LEN
+ */
+size_t Radar_latency_encode(uint8_t stage, uint8_t* buf, size_t capacity)
+{
+    Radar_latency_histogram_t histogram;
+
+    if ((stage >= RADAR_LATENCY_STAGE_NUM) || (capacity < RADAR_LATENCY_ANSWER_LEN))
+        return 0;
+    taskENTER_CRITICAL(&g_latency_lock);
+    histogram = g_latency[stage];
+    taskEXIT_CRITICAL(&g_latency_lock);
+
+    buf[0] = stage;
+    buf[1] = RADAR_LATENCY_BUCKET_NUM;
+    Radar_latency_put_u32(&buf[2], histogram.count);
+    Radar_latency_put_u32(&buf[6], (uint32_t)(histogram.sum_us >> 32));
+    Radar_latency_put_u32(&buf[10], (uint32_t)histogram.sum_us);
+    Radar_latency_put_u32(&buf[14], histogram.max_us);
+    for (uint8_t i = 0; i < RADAR_LATENCY_BUCKET_NUM; i++)
+        Radar_latency_put_u32(&buf[18 + 4 * i], histogram.bucket[i]);
+    return RADAR_LATENCY_ANSWER_LEN;
+}
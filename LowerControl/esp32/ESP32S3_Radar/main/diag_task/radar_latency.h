@@ -0,0 +1,61 @@
+#ifndef _RADAR_LATENCY_H_
+#define _RADAR_LATENCY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+/* Stages timed with esp_timer, each one feeds its own histogram */
+enum
+{
+    RADAR_LATENCY_UART_EVENT        = 0x00, /* UART event to the frame handed to Modbus (uart_read_bytes, logs) */
+    RADAR_LATENCY_PARSE             = 0x01, /* Frame parsing and queueing in Modbus_submit */
+    RADAR_LATENCY_QUEUE             = 0x02, /* Wait in the request queue for the execution task */
+    RADAR_LATENCY_DISPATCH          = 0x03, /* Radar_manager_Modbus_carry_out, request taken to reply ready */
+    RADAR_LATENCY_REPLY             = 0x04, /* Reply emission by the transport */
+    RADAR_LATENCY_REQUEST           = 0x05, /* Whole request, UART event or network receive to reply sent */
+    RADAR_LATENCY_SERVO             = 0x06, /* Servo move and settle time of one scan step */
+    RADAR_LATENCY_SENSOR            = 0x07, /* Sensor round trip of atk_ms53l0m_read_data */
+    RADAR_LATENCY_STAGE_NUM,
+};
+
+/*
+ * Log-scale buckets: bucket 0 counts samples under 1 µs, bucket i samples of [2^(i-1), 2^i) µs,
+ * the last one everything from 2^(RADAR_LATENCY_BUCKET_NUM - 2) µs on (about 4 s)
+ */
+#define RADAR_LATENCY_BUCKET_NUM    24
+
+/*
+ * Histogram answer, all fields high byte first:
+ * stage(1) bucket_num(1) count(4) sum_us(8) max_us(4) bucket counts(4 * bucket_num)
+ */
+#define RADAR_LATENCY_ANSWER_LEN    (18 + 4 * RADAR_LATENCY_BUCKET_NUM)
+#define RADAR_LATENCY_ALL_STAGES    0xFF    /* Stage of a reset of every histogram */
+
+/* Stamps carried with a request through the stages, 0 when a stage was not reached */
+typedef struct {
+    int64_t received_us;                /* UART event or network receive */
+    int64_t parsed_us;                  /* Parsed and queued */
+    int64_t taken_us;                   /* Taken by the execution task */
+} Radar_latency_stamps_t;
+
+/**
+ * @brief       Time stamp of a stage boundary
+ * @retval      µs since boot
+ */
+static inline int64_t Radar_latency_now(void)
+{
+    return esp_timer_get_time();
+}
+
+#if CONFIG_RADAR_LATENCY_HISTOGRAMS
+void Radar_latency_record(uint8_t stage, int64_t elapsed_us); /* add one sample to a stage */
+#else
+static inline void Radar_latency_record(uint8_t stage, int64_t elapsed_us) { (void)stage; (void)elapsed_us; }
+#endif
+esp_err_t Radar_latency_reset(uint8_t stage); /* clear one stage, or RADAR_LATENCY_ALL_STAGES */
+size_t Radar_latency_encode(uint8_t stage, uint8_t* buf, size_t capacity); /* histogram answer of a stage */
+
+#endif
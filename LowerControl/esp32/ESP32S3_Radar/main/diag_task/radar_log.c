@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#include "radar_log.h"
+
+#define LOG_TASK_STACK      3072    /* one formatted line on the stack */
+#define LOG_LINE_MAX        160
+
+typedef struct {
+    uint32_t timestamp;             /* esp_log_timestamp() when logged */
+    const char* tag;
+    const char* format;
+    uint32_t args[RADAR_LOG_ARG_MAX];
+    uint8_t level;
+} Radar_log_entry_t;
+
+static QueueHandle_t g_log_queue = NULL;
+static uint32_t g_log_dropped = 0;      /* lines lost to a full queue, reported by the task */
+
+/**
+ * @brief       Format and write one line, in the format of ESP_LOGx without colours
+ * @param       entry : deferred line
+ *
+ * @retval      void
+ */
+static void Radar_log_write(const Radar_log_entry_t* entry)
+{
+    static const char letter[] = { 'N', 'E', 'W', 'I', 'D', 'V' };
+    char line[LOG_LINE_MAX];
+
+    /* unused arguments are ignored by snprintf */
+    snprintf(line, sizeof(line), entry->format, entry->args[0], entry->args[1], entry->args[2], entry->args[3]);
+    esp_log_write((esp_log_level_t)entry->level, entry->tag, "%c (%lu) %s: %s\n",
+                  letter[entry->level < sizeof(letter) ? entry->level : 0], (unsigned long)entry->timestamp,
+                  entry->tag, line);
+}
+
+/**
+ * @brief       Formatting task, lowest priority above idle so that logging never delays the hot path
+ */
+static void Radar_log_task(void* pvParameters)
+{
+    Radar_log_entry_t entry;
+    uint32_t dropped;
+
+    while (1)
+    {
+        if (xQueueReceive(g_log_queue, &entry, portMAX_DELAY) != pdTRUE)
+            continue;
+        Radar_log_write(&entry);
+        dropped = __atomic_exchange_n(&g_log_dropped, 0, __ATOMIC_RELAXED);
+        if (dropped)
+            esp_log_write(ESP_LOG_WARN, "RadarLog", "W (%lu) RadarLog: %lu lines dropped\n",
+                          (unsigned long)esp_log_timestamp(), (unsigned long)dropped);
+    }
+}
+
+/**
+ * @brief       Create the queue and start the formatting task
+ * @param       void
+ *
+ * @retval      ESP_OK          : success
+ * @retval      ESP_ERR_NO_MEM  : out of memory, lines keep being written at once
+ */
+esp_err_t Radar_log_init(void)
+{
+    if (g_log_queue != NULL)
+        return ESP_OK;
+    g_log_queue = xQueueCreate(CONFIG_RADAR_LOG_QUEUE_LEN, sizeof(Radar_log_entry_t));
+    if (g_log_queue == NULL)
+        return ESP_ERR_NO_MEM;
+    if (xTaskCreatePinnedToCore(Radar_log_task, "radar_log", LOG_TASK_STACK, NULL,
+                                tskIDLE_PRIORITY + 1, NULL, tskNO_AFFINITY) != pdPASS)
+    {
+        vQueueDelete(g_log_queue);
+        g_log_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief       Queue one line for the formatting task, called through RADAR_LOGx
+ *              Never blocks: when the queue is full the line is counted and dropped
+ * @param       level  : RADAR_LOG_xxx
+ * @param       tag    : module tag, a string that lives forever
+ * @param       format : string literal
+ * @param       args   : integer arguments
+ * @param       num    : number of arguments, at most RADAR_LOG_ARG_MAX
+ *
+ * @retval      void
+ */
+void Radar_log_defer(uint8_t level, const char* tag, const char* format, const uint32_t* args, uint8_t num)
+{
+    Radar_log_entry_t entry = {
+        .timestamp = esp_log_timestamp(),
+        .tag       = tag,
+        .format    = format,
+        .level     = level,
+    };
+
+    if (level > esp_log_level_get(tag))
+        return; /* lowered at run time with esp_log_level_set */
+    memcpy(entry.args, args, num * sizeof(uint32_t));
+    if (g_log_queue == NULL)
+        Radar_log_write(&entry);    /* before init */
+    else if (xQueueSend(g_log_queue, &entry, 0) != pdTRUE)
+        __atomic_fetch_add(&g_log_dropped, 1, __ATOMIC_RELAXED);
+}
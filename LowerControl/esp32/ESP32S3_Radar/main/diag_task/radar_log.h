@@ -0,0 +1,52 @@
+#ifndef _RADAR_LOG_H_
+#define _RADAR_LOG_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+/* Levels, the values of esp_log_level_t */
+#define RADAR_LOG_NONE      0
+#define RADAR_LOG_ERROR     1
+#define RADAR_LOG_WARN      2
+#define RADAR_LOG_INFO      3
+#define RADAR_LOG_DEBUG     4
+#define RADAR_LOG_VERBOSE   5
+
+/*
+ * Hot-path logging. A module defines RADAR_LOG_LEVEL to its CONFIG_RADAR_LOG_LEVEL_xxx before including
+ * this header: calls above that level are constant-false and removed by the compiler, arguments and
+ * format string included. The calls left only copy their arguments into a queue, the line is formatted
+ * and written by a low-priority task.
+ * format must be a string literal, with at most RADAR_LOG_ARG_MAX integer arguments of up to 32 bits
+ * (%d %u %x %c); no %s, the string may be gone by the time it is formatted.
+ */
+#ifndef RADAR_LOG_LEVEL
+#define RADAR_LOG_LEVEL     RADAR_LOG_WARN
+#endif
+
+#define RADAR_LOG_ARG_MAX   4
+
+#define RADAR_LOG_AT(level, tag, format, ...)                                                           \
+    do {                                                                                                \
+        if (RADAR_LOG_LEVEL >= (level))                                                                 \
+        {                                                                                               \
+            const uint32_t radar_log_args_[] = { 0, ##__VA_ARGS__ };                                    \
+            _Static_assert(sizeof(radar_log_args_) <= (RADAR_LOG_ARG_MAX + 1) * sizeof(uint32_t),       \
+                           "too many log arguments");                                                   \
+            Radar_log_defer((level), (tag), (format), &radar_log_args_[1],                              \
+                            (uint8_t)(sizeof(radar_log_args_) / sizeof(uint32_t) - 1));                 \
+        }                                                                                               \
+    } while (0)
+
+#define RADAR_LOGE(tag, format, ...)    RADAR_LOG_AT(RADAR_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define RADAR_LOGW(tag, format, ...)    RADAR_LOG_AT(RADAR_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define RADAR_LOGI(tag, format, ...)    RADAR_LOG_AT(RADAR_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define RADAR_LOGD(tag, format, ...)    RADAR_LOG_AT(RADAR_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define RADAR_LOGV(tag, format, ...)    RADAR_LOG_AT(RADAR_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+esp_err_t Radar_log_init(void); /* start the formatting task, lines logged before are written at once */
+void Radar_log_defer(uint8_t level, const char* tag, const char* format, const uint32_t* args, uint8_t num);
+
+#endif
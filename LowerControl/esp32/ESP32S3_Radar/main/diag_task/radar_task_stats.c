@@ -0,0 +1,285 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_idf_version.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#include "radar_task_stats.h"
+
+#ifdef CONFIG_RADAR_TASK_STATS
+static const char *TAG = "RadarTaskStats";
+
+#define TASK_STATS_PERIOD_MS    CONFIG_RADAR_TASK_STATS_PERIOD_MS
+#define TASK_STATS_TASK_STACK   2560    /* the TaskStatus_t array is static */
+#define TASK_STATS_FULL_LOAD    10000   /* 100 % of one core */
+
+typedef struct {
+    char name[RADAR_TASK_STATS_NAME_LEN];   /* Zero padded, not terminated when it fills the field */
+    uint16_t load;                          /* 0.01 % of one core over the last period */
+    uint16_t stack_free;                    /* Stack bytes never used since the task started */
+    uint8_t priority;
+    uint8_t core;                           /* Core of the task, RADAR_TASK_STATS_CORE_ANY if it has none */
+} Radar_task_stats_record_t;
+
+typedef struct {
+    TaskHandle_t handle;
+    uint32_t run_time;                      /* Run time counter at the previous sample */
+} Radar_task_stats_prev_t;
+
+/* Sampling task only */
+static TaskStatus_t g_task_status[RADAR_TASK_STATS_MAX];
+static Radar_task_stats_prev_t g_task_prev[RADAR_TASK_STATS_MAX];
+static uint8_t g_task_prev_num = 0;
+static uint32_t g_total_prev = 0;
+
+/* Last sample, published under the lock */
+static Radar_task_stats_record_t g_task_record[RADAR_TASK_STATS_MAX];
+static uint8_t g_task_record_num = 0;
+static uint16_t g_idle_load[RADAR_TASK_STATS_CORE_MAX];
+static uint32_t g_task_samples = 0;
+static portMUX_TYPE g_task_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief       Core a task is pinned to
+ */
+static inline uint8_t Radar_task_stats_core(TaskHandle_t handle)
+{
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+    BaseType_t core = xTaskGetCoreID(handle);
+#else
+    BaseType_t core = xTaskGetAffinity(handle);
+#endif
+    return ((core < 0) || (core >= RADAR_TASK_STATS_CORE_MAX)) ? RADAR_TASK_STATS_CORE_ANY : (uint8_t)core;
+}
+
+/**
+ * @brief       Idle task of a core
+ */
+static inline TaskHandle_t Radar_task_stats_idle(int core)
+{
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+    return xTaskGetIdleTaskHandleForCore(core);
+#else
+    return xTaskGetIdleTaskHandleForCPU(core);
+#endif
+}
+
+/**
+ * @brief       Run time of a task since the previous sample
+ *              A task created during the period ran for its whole counter
+ * @param       status : task status of this sample
+ *
+ * @retval      run time (µs)
+ */
+static uint32_t Radar_task_stats_delta(const TaskStatus_t* status)
+{
+    for (uint8_t i = 0; i < g_task_prev_num; i++)
+    {
+        if (g_task_prev[i].handle == status->xHandle)
+            return status->ulRunTimeCounter - g_task_prev[i].run_time;
+    }
+    return status->ulRunTimeCounter;
+}
+
+/**
+ * @brief       Load of a run time over the period
+ */
+static inline uint16_t Radar_task_stats_load(uint32_t run_time, uint32_t total)
+{
+    uint64_t load;
+
+    if (total == 0)
+        return 0;
+    load = (uint64_t)run_time * TASK_STATS_FULL_LOAD / total;
+    return (load > TASK_STATS_FULL_LOAD) ? TASK_STATS_FULL_LOAD : (uint16_t)load;
+}
+
+/**
+ * @brief       Take one sample of every task and publish the loads over the period
+ * @param       void
+ *
+ * @retval      void
+ */
+static void Radar_task_stats_sample(void)
+{
+    static Radar_task_stats_record_t record[RADAR_TASK_STATS_MAX];
+    uint16_t idle[RADAR_TASK_STATS_CORE_MAX] = {0};
+    uint32_t total_now;
+    uint32_t total;
+    UBaseType_t num;
+
+    num = uxTaskGetSystemState(g_task_status, RADAR_TASK_STATS_MAX, &total_now);
+    if (num == 0)
+    {
+        ESP_LOGW(TAG, "more than %d tasks, not sampled", RADAR_TASK_STATS_MAX);
+        return;
+    }
+    total = total_now - g_total_prev; /* the run time counter is µs and wraps, the difference does not */
+
+    for (UBaseType_t i = 0; i < num; i++)
+    {
+        const TaskStatus_t* status = &g_task_status[i];
+        uint16_t load = Radar_task_stats_load(Radar_task_stats_delta(status), total);
+
+        memset(record[i].name, 0, sizeof(record[i].name));
+        strncpy(record[i].name, status->pcTaskName, sizeof(record[i].name));
+        record[i].load       = load;
+        record[i].stack_free = (status->usStackHighWaterMark > UINT16_MAX) ? UINT16_MAX : (uint16_t)status->usStackHighWaterMark;
+        record[i].priority   = (uint8_t)status->uxCurrentPriority;
+        record[i].core       = Radar_task_stats_core(status->xHandle);
+        for (int core = 0; core < RADAR_TASK_STATS_CORE_MAX; core++)
+        {
+            if (status->xHandle == Radar_task_stats_idle(core))
+                idle[core] = load;
+        }
+    }
+
+    /* Previous counters for the next period, deleted tasks drop out */
+    for (UBaseType_t i = 0; i < num; i++)
+    {
+        g_task_prev[i].handle   = g_task_status[i].xHandle;
+        g_task_prev[i].run_time = g_task_status[i].ulRunTimeCounter;
+    }
+    g_task_prev_num = (uint8_t)num;
+    g_total_prev = total_now;
+
+    taskENTER_CRITICAL(&g_task_stats_lock);
+    memcpy(g_task_record, record, num * sizeof(record[0]));
+    g_task_record_num = (uint8_t)num;
+    memcpy(g_idle_load, idle, sizeof(g_idle_load));
+    g_task_samples++;
+    taskEXIT_CRITICAL(&g_task_stats_lock);
+}
+
+/**
+ * @brief       Sampling task, one sample every CONFIG_RADAR_TASK_STATS_PERIOD_MS
+ */
+static void Radar_task_stats_task(void* pvParameters)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+
+    Radar_task_stats_sample(); /* reference counters */
+    while (1)
+    {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(TASK_STATS_PERIOD_MS));
+        Radar_task_stats_sample();
+    }
+}
+#endif
+
+/**
+ * @brief       Start the sampling task
+ * @param       void
+ *
+ * @retval      ESP_OK                  : success
+ * @retval      ESP_ERR_NOT_SUPPORTED   : task telemetry disabled in menuconfig
+ * @retval      ESP_ERR_NO_MEM          : task not created
+ */
+esp_err_t Radar_task_stats_init(void)
+{
+#ifdef CONFIG_RADAR_TASK_STATS
+    /* lowest priority above idle, so that it only measures and never disturbs */
+    if (xTaskCreatePinnedToCore(Radar_task_stats_task, "task_stats", TASK_STATS_TASK_STACK, NULL,
+                                tskIDLE_PRIORITY + 1, NULL, tskNO_AFFINITY) != pdPASS)
+        return ESP_ERR_NO_MEM;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       Encode the summary of the last sample, see radar_task_stats.h
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : telemetry disabled, nothing sampled yet or buf too small
+ * @retval      other : RADAR_TASK_STATS_SUMMARY_LEN
+ */
+size_t Radar_task_stats_encode_summary(uint8_t* buf, size_t capacity)
+{
+#ifdef CONFIG_RADAR_TASK_STATS
+    uint16_t idle[RADAR_TASK_STATS_CORE_MAX];
+    uint32_t samples;
+    uint8_t num;
+
+    if (capacity < RADAR_TASK_STATS_SUMMARY_LEN)
+        return 0;
+    taskENTER_CRITICAL(&g_task_stats_lock);
+    samples = g_task_samples;
+    num = g_task_record_num;
+    memcpy(idle, g_idle_load, sizeof(idle));
+    taskEXIT_CRITICAL(&g_task_stats_lock);
+    if (samples == 0)
+        return 0;
+
+    buf[0] = (uint8_t)(TASK_STATS_PERIOD_MS >> 8);
+    buf[1] = (uint8_t)(TASK_STATS_PERIOD_MS & 0xFF);
+    buf[2] = (uint8_t)(samples >> 24);
+    buf[3] = (uint8_t)(samples >> 16);
+    buf[4] = (uint8_t)(samples >> 8);
+    buf[5] = (uint8_t)(samples & 0xFF);
+    buf[6] = num;
+    buf[7] = RADAR_TASK_STATS_CORE_MAX;
+    for (int core = 0; core < RADAR_TASK_STATS_CORE_MAX; core++)
+    {
+        buf[8 + 2 * core] = (uint8_t)(idle[core] >> 8);
+        buf[9 + 2 * core] = (uint8_t)(idle[core] & 0xFF);
+    }
+    return RADAR_TASK_STATS_SUMMARY_LEN;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief       Encode the records of the last sample from task first on, see radar_task_stats.h
+ *              Tasks are in the order of uxTaskGetSystemState, read pages until first + num reaches task_num
+ * @param       first    : index of the first task
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : telemetry disabled, nothing sampled yet, first out of range or buf too small
+ * @retval      other : encoded length
+ */
+size_t Radar_task_stats_encode_page(uint8_t first, uint8_t* buf, size_t capacity)
+{
+#ifdef CONFIG_RADAR_TASK_STATS
+    uint8_t num;
+    uint8_t* p = &buf[2];
+
+    if (capacity < RADAR_TASK_STATS_PAGE_LEN)
+        return 0;
+    taskENTER_CRITICAL(&g_task_stats_lock);
+    if (first >= g_task_record_num)
+    {
+        taskEXIT_CRITICAL(&g_task_stats_lock);
+        return 0;
+    }
+    num = g_task_record_num - first;
+    if (num > RADAR_TASK_STATS_PAGE_TASKS)
+        num = RADAR_TASK_STATS_PAGE_TASKS;
+    for (uint8_t i = 0; i < num; i++, p += RADAR_TASK_STATS_RECORD_LEN)
+    {
+        const Radar_task_stats_record_t* record = &g_task_record[first + i];
+
+        memcpy(p, record->name, RADAR_TASK_STATS_NAME_LEN);
+        p[RADAR_TASK_STATS_NAME_LEN + 0] = (uint8_t)(record->load >> 8);
+        p[RADAR_TASK_STATS_NAME_LEN + 1] = (uint8_t)(record->load & 0xFF);
+        p[RADAR_TASK_STATS_NAME_LEN + 2] = (uint8_t)(record->stack_free >> 8);
+        p[RADAR_TASK_STATS_NAME_LEN + 3] = (uint8_t)(record->stack_free & 0xFF);
+        p[RADAR_TASK_STATS_NAME_LEN + 4] = record->priority;
+        p[RADAR_TASK_STATS_NAME_LEN + 5] = record->core;
+    }
+    taskEXIT_CRITICAL(&g_task_stats_lock);
+
+    buf[0] = first;
+    buf[1] = num;
+    return 2 + num * RADAR_TASK_STATS_RECORD_LEN;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,32 @@
+#ifndef _RADAR_TASK_STATS_H_
+#define _RADAR_TASK_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#define RADAR_TASK_STATS_MAX            32      /* Tasks kept per sample, the others are not reported */
+#define RADAR_TASK_STATS_NAME_LEN       12      /* Task name bytes in a record, zero padded */
+#define RADAR_TASK_STATS_CORE_ANY       0xFF    /* Core of a task without affinity */
+#define RADAR_TASK_STATS_CORE_MAX       2
+
+/*
+ * Summary answer, all fields high byte first, loads in 0.01 % of one core over the last period:
+ * period_ms(2) samples(4) task_num(1) core_num(1) idle load of each core(2 * core_num)
+ */
+#define RADAR_TASK_STATS_SUMMARY_LEN    (8 + 2 * RADAR_TASK_STATS_CORE_MAX)
+
+/*
+ * Task page answer: first(1) num(1) then num records of
+ * name(RADAR_TASK_STATS_NAME_LEN) load(2) stack_free(2, bytes never used) priority(1) core(1)
+ */
+#define RADAR_TASK_STATS_RECORD_LEN     (RADAR_TASK_STATS_NAME_LEN + 6)
+#define RADAR_TASK_STATS_PAGE_TASKS     13      /* 2 + 13 * 18 bytes fit a read answer */
+#define RADAR_TASK_STATS_PAGE_LEN       (2 + RADAR_TASK_STATS_PAGE_TASKS * RADAR_TASK_STATS_RECORD_LEN)
+
+esp_err_t Radar_task_stats_init(void); /* start the sampling task */
+size_t Radar_task_stats_encode_summary(uint8_t* buf, size_t capacity);
+size_t Radar_task_stats_encode_page(uint8_t first, uint8_t* buf, size_t capacity); /* records from task first on */
+
+#endif
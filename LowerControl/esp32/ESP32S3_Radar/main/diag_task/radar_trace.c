@@ -0,0 +1,129 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#include "radar_trace.h"
+
+#if CONFIG_RADAR_TRACE
+Radar_trace_record_t g_radar_trace_ring[RADAR_TRACE_CORE_NUM][RADAR_TRACE_RING_LEN];
+uint32_t g_radar_trace_head[RADAR_TRACE_CORE_NUM];
+volatile bool g_radar_trace_enabled = true;   /* a flight recorder, always on until stopped for a dump */
+
+/**
+ * @brief       Write a 32-bit value, high byte first
+ */
+static inline void Radar_trace_put_u32(uint8_t* buf, uint32_t value)
+{
+    buf[0] = (uint8_t)(value >> 24);
+    buf[1] = (uint8_t)(value >> 16);
+    buf[2] = (uint8_t)(value >> 8);
+    buf[3] = (uint8_t)(value & 0xFF);
+}
+#endif
+
+/**
+ * @brief       Stop, start or clear the trace
+ *              Stopping does not wait for a record being written on the other core,
+ *              the dump of the newest slot may be torn once in a while
+ * @param       cmd : RADAR_TRACE_CMD_xxx
+ *
+ * @retval      true  : done
+ * @retval      false : unknown command, or tracing compiled out
+ */
+bool Radar_trace_command(uint8_t cmd)
+{
+#if CONFIG_RADAR_TRACE
+    switch (cmd)
+    {
+        case RADAR_TRACE_CMD_STOP:
+            g_radar_trace_enabled = false;
+            return true;
+        case RADAR_TRACE_CMD_START:
+            g_radar_trace_enabled = true;
+            return true;
+        case RADAR_TRACE_CMD_CLEAR:
+            for (int core = 0; core < RADAR_TRACE_CORE_NUM; core++)
+                __atomic_store_n(&g_radar_trace_head[core], 0, __ATOMIC_RELAXED);
+            memset(g_radar_trace_ring, 0, sizeof(g_radar_trace_ring));
+            return true;
+        default:
+            return false;
+    }
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief       Encode the trace information, see radar_trace.h
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : tracing compiled out or buf too small
+ * @retval      other : RADAR_TRACE_INFO_LEN
+ */
+size_t Radar_trace_encode_info(uint8_t* buf, size_t capacity)
+{
+#if CONFIG_RADAR_TRACE
+    if (capacity < RADAR_TRACE_INFO_LEN)
+        return 0;
+    buf[0] = g_radar_trace_enabled;
+    buf[1] = RADAR_TRACE_CORE_NUM;
+    buf[2] = (uint8_t)(RADAR_TRACE_RING_LEN >> 8);
+    buf[3] = (uint8_t)(RADAR_TRACE_RING_LEN & 0xFF);
+    buf[4] = RADAR_TRACE_RECORD_LEN;
+    for (int core = 0; core < RADAR_TRACE_CORE_NUM; core++)
+        Radar_trace_put_u32(&buf[5 + 4 * core], __atomic_load_n(&g_radar_trace_head[core], __ATOMIC_RELAXED));
+    return RADAR_TRACE_INFO_LEN;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief       Encode records of a core from slot first on, see radar_trace.h
+ *              Read while the trace is stopped, or records may be overwritten during the dump
+ * @param       core     : core
+ * @param       first    : first slot
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : tracing compiled out, core or slot out of range, or buf too small
+ * @retval      other : encoded length
+ */
+size_t Radar_trace_encode_page(uint8_t core, uint16_t first, uint8_t* buf, size_t capacity)
+{
+#if CONFIG_RADAR_TRACE
+    uint8_t* p = &buf[4];
+    uint8_t num = RADAR_TRACE_PAGE_RECORDS;
+
+    if ((core >= RADAR_TRACE_CORE_NUM) || (first >= RADAR_TRACE_RING_LEN) || (capacity < RADAR_TRACE_PAGE_LEN))
+        return 0;
+    if (first + num > RADAR_TRACE_RING_LEN)
+        num = (uint8_t)(RADAR_TRACE_RING_LEN - first);
+
+    buf[0] = core;
+    buf[1] = (uint8_t)(first >> 8);
+    buf[2] = (uint8_t)(first & 0xFF);
+    buf[3] = num;
+    for (uint8_t i = 0; i < num; i++, p += RADAR_TRACE_RECORD_LEN)
+    {
+        const Radar_trace_record_t* record = &g_radar_trace_ring[core][first + i];
+
+        Radar_trace_put_u32(&p[0], record->time_us);
+        p[4] = record->event;
+        p[5] = record->core;
+        p[6] = (uint8_t)(record->arg0 >> 8);
+        p[7] = (uint8_t)(record->arg0 & 0xFF);
+        Radar_trace_put_u32(&p[8], record->arg1);
+    }
+    return 4 + num * RADAR_TRACE_RECORD_LEN;
+#else
+    (void)core;
+    (void)first;
+    (void)buf;
+    (void)capacity;
+    return 0;
+#endif
+}
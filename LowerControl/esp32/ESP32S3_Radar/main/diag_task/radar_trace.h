@@ -0,0 +1,98 @@
+#ifndef _RADAR_TRACE_H_
+#define _RADAR_TRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+/* Hot-path events, arguments in brackets */
+enum
+{
+    RADAR_TRACE_UART_RX             = 0x01, /* UART data event (port, size) */
+    RADAR_TRACE_FRAME_PARSED        = 0x02, /* Request queued (fun_code << 8 | opt_type, frame length) */
+    RADAR_TRACE_FRAME_REJECTED      = 0x03, /* Request not queued (MODBUS_EFRAME or MODBUS_ERROR, frame length) */
+    RADAR_TRACE_DISPATCH_BEGIN      = 0x04, /* Request taken by the execution task (fun_code << 8 | opt_type, 0) */
+    RADAR_TRACE_DISPATCH_END        = 0x05, /* Request carried out (fun_code << 8 | opt_type, 0) */
+    RADAR_TRACE_SERVO               = 0x06, /* Servo angle command (angle, 0) */
+    RADAR_TRACE_SENSOR_TX           = 0x07, /* Sensor request sent (fun_code, address) */
+    RADAR_TRACE_SENSOR_RX           = 0x08, /* Sensor answer unpacked (ATK_MS53L0M_Exxx, value) */
+    RADAR_TRACE_SWEEP_PUBLISH       = 0x09, /* Sweep published (point count, sequence) */
+};
+
+/*
+ * Record, 12 bytes; on the wire all fields high byte first:
+ * time_us(4, low 32 bits of esp_timer) event(1) core(1) arg0(2) arg1(4)
+ */
+typedef struct {
+    uint32_t time_us;
+    uint8_t event;
+    uint8_t core;
+    uint16_t arg0;
+    uint32_t arg1;
+} Radar_trace_record_t;
+
+#define RADAR_TRACE_RECORD_LEN      12
+#define RADAR_TRACE_CORE_NUM        portNUM_PROCESSORS
+#if CONFIG_RADAR_TRACE
+#define RADAR_TRACE_RING_LEN        (1u << CONFIG_RADAR_TRACE_RING_ORDER)   /* Records per core */
+#endif
+
+/* Trace commands, one byte written with the trace function code */
+#define RADAR_TRACE_CMD_STOP        0x00    /* Freeze the rings, before a dump */
+#define RADAR_TRACE_CMD_START       0x01
+#define RADAR_TRACE_CMD_CLEAR       0x02
+
+/*
+ * Information answer: enabled(1) core_num(1) ring_len(2) record_len(1) then for each core
+ * the number of records ever written(4); slot i of a core holds record n when n % ring_len == i
+ */
+#define RADAR_TRACE_INFO_LEN        (5 + 4 * RADAR_TRACE_CORE_NUM)
+
+/* Dump answer: core(1) first slot(2) num(1) then num records */
+#define RADAR_TRACE_PAGE_RECORDS    20
+#define RADAR_TRACE_PAGE_LEN        (4 + RADAR_TRACE_PAGE_RECORDS * RADAR_TRACE_RECORD_LEN)
+
+#if CONFIG_RADAR_TRACE
+extern Radar_trace_record_t g_radar_trace_ring[RADAR_TRACE_CORE_NUM][RADAR_TRACE_RING_LEN];
+extern uint32_t g_radar_trace_head[RADAR_TRACE_CORE_NUM];
+extern volatile bool g_radar_trace_enabled;
+
+/**
+ * @brief       Record one event in the ring of the current core
+ *              No lock: the slot is reserved with an atomic add, so tasks and interrupts
+ *              preempting each other on a core, or a task moved to the other core, never share one
+ * @param       event : event, see above
+ * @param       arg0  : first argument
+ * @param       arg1  : second argument
+ *
+ * @retval      void
+ */
+static inline void Radar_trace(uint8_t event, uint16_t arg0, uint32_t arg1)
+{
+    Radar_trace_record_t* record;
+    uint8_t core;
+    uint32_t slot;
+
+    if (!g_radar_trace_enabled)
+        return;
+    core = (uint8_t)xPortGetCoreID();
+    slot = __atomic_fetch_add(&g_radar_trace_head[core], 1, __ATOMIC_RELAXED) & (RADAR_TRACE_RING_LEN - 1);
+    record = &g_radar_trace_ring[core][slot];
+    record->time_us = (uint32_t)esp_timer_get_time();
+    record->event   = event;
+    record->core    = core;
+    record->arg0    = arg0;
+    record->arg1    = arg1;
+}
+#else
+static inline void Radar_trace(uint8_t event, uint16_t arg0, uint32_t arg1) { (void)event; (void)arg0; (void)arg1; }
+#endif
+
+bool Radar_trace_command(uint8_t cmd); /* RADAR_TRACE_CMD_xxx, false if unknown or tracing is compiled out */
+size_t Radar_trace_encode_info(uint8_t* buf, size_t capacity);
+size_t Radar_trace_encode_page(uint8_t core, uint16_t first, uint8_t* buf, size_t capacity); /* records from slot first on */
+
+#endif
@@ -1,31 +1,127 @@
+#define RADAR_LOG_LEVEL CONFIG_RADAR_LOG_LEVEL_MEASURE
+
 #include "esp_log.h"
 
 #include "radar_manager.h"
+#include "radar_counters.h"
+#include "radar_log.h"
+#include "radar_sweep.h"
+#include "sweep_sector.h"
 #include "atk_ms53l0m.h"
 
+#define EXECUTION_ALARM_POLL_MS 10  /* Longest delay of a sector alarm queued by the steering task */
+#define MEASURE_EVENT_REQUEST   0x1F    /* event group 0~4 bits is steering */
+#define MEASURE_EVENT_DONE      0x20    /* 5 bits is Distance Sensor */
+#define MEASURE_WAITTIME        (ATK_MS53L0M_WAITTIME + pdMS_TO_TICKS(100)) /* the sensor times out first */
+
 static Radar_status* g_pRadar_status;
 
 void Radar_input_Execution_Task(void* pvParameters)
 {
     while (1)
     {
-        Radar_manager_Modbus_carry_out(portMAX_DELAY);
+        Radar_manager_Modbus_carry_out(pdMS_TO_TICKS(EXECUTION_ALARM_POLL_MS));
+        Radar_sector_send_alarms(); /* the steering task never sends to the host itself */
     }
     vTaskDelete(NULL);
 }
 
+/**
+ * @brief       Count a failed sensor read
+ * @param       ret : return of atk_ms53l0m_modbus_get_data
+ *
+ * @retval      void
+ */
+static void Radar_input_count_sensor_error(uint8_t ret)
+{
+    switch (ret)
+    {
+        case ATK_MS53L0M_ETIMEOUT:
+            Radar_counter_inc(RADAR_COUNTER_SENSOR_TIMEOUT);
+            break;
+        case ATK_MS53L0M_ECRC:
+            Radar_counter_inc(RADAR_COUNTER_SENSOR_CRC);
+            break;
+        case ATK_MS53L0M_EOPT:
+            Radar_counter_inc(RADAR_COUNTER_SENSOR_OPT);
+            break;
+        default:
+            Radar_counter_inc(RADAR_COUNTER_SENSOR_FRAME);
+            break;
+    }
+}
+
 void Radar_input_measure_Task(void* pRadar_status)
 {
+    uint8_t ret;
+    uint16_t request;
+    uint16_t distance;
+
     g_pRadar_status = (Radar_status*)pRadar_status;
 
     while (1)
     {
         /* wait steering Task */
-        xEventGroupWaitBits(g_pRadar_status->Task_EventGroup, 0x1F, pdTRUE, pdTRUE, portMAX_DELAY); 
+        xEventGroupWaitBits(g_pRadar_status->Task_EventGroup, MEASURE_EVENT_REQUEST, pdTRUE, pdTRUE, portMAX_DELAY); 
+        request = __atomic_load_n(&g_pRadar_status->measure_request, __ATOMIC_ACQUIRE);
         /* get measure data */
-        atk_ms53l0m_modbus_get_data(g_pRadar_status->Measurement_sensor_address, &g_pRadar_status->measure_data); 
-        ESP_LOGI("measure Task", "distance: %d", g_pRadar_status->measure_data);
-        /* Use EventGroup to inform measurement completion */
-        xEventGroupSetBits(g_pRadar_status->Task_EventGroup, 0x20); /* event group 0~4 bits is steering, 5 bits is Distance Sensor */
+        Radar_counter_inc(RADAR_COUNTER_SENSOR_READ);
+        ret = atk_ms53l0m_modbus_get_data(g_pRadar_status->Measurement_sensor_address, &distance); 
+        if (ret != ATK_MS53L0M_EOK)
+        {
+            Radar_input_count_sensor_error(ret);
+            distance = RADAR_SWEEP_INVALID_DISTANCE; /* never store the previous distance again */
+        }
+        RADAR_LOGD("measure Task", "request: %u distance: %d", request, distance);
+        /* Use EventGroup to inform measurement completion, the result carries the request it answers */
+        __atomic_store_n(&g_pRadar_status->measure_result, ((uint32_t)request << 16) | distance, __ATOMIC_RELEASE);
+        xEventGroupSetBits(g_pRadar_status->Task_EventGroup, MEASURE_EVENT_DONE);
+    }
+}
+
+/**
+ * @brief       Start a measurement
+ * @param       pRadar_status : radar status holding the measurement handshake
+ *
+ * @retval      request sequence to pass to Radar_input_measure_wait
+ */
+uint16_t Radar_input_measure_request(Radar_status* pRadar_status)
+{
+    uint16_t request = __atomic_add_fetch(&pRadar_status->measure_request, 1, __ATOMIC_RELEASE);
+
+    /* a completion still set belongs to an earlier request, the measure task has not seen this one yet */
+    xEventGroupClearBits(pRadar_status->Task_EventGroup, MEASURE_EVENT_DONE);
+    xEventGroupSetBits(pRadar_status->Task_EventGroup, MEASURE_EVENT_REQUEST);
+    return request;
+}
+
+/**
+ * @brief       Wait for the measurement of a request, answers of earlier requests are discarded
+ *              The wait is longer than the sensor timeout, so a lost sensor answer still ends it
+ * @param       pRadar_status : radar status holding the measurement handshake
+ * @param       request       : return of Radar_input_measure_request
+ * @param       distance      : measured distance, RADAR_SWEEP_INVALID_DISTANCE after a sensor error
+ *
+ * @retval      true    the measurement of the request is done
+ * @retval      false   no measurement of the request in time
+ */
+bool Radar_input_measure_wait(Radar_status* pRadar_status, uint16_t request, uint16_t* distance)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t waited;
+    uint32_t result;
+
+    while (1)
+    {
+        result = __atomic_load_n(&pRadar_status->measure_result, __ATOMIC_ACQUIRE);
+        if ((uint16_t)(result >> 16) == request)
+        {
+            *distance = (uint16_t)result;
+            return true;
+        }
+        waited = xTaskGetTickCount() - start;
+        if (waited >= MEASURE_WAITTIME)
+            return false;
+        xEventGroupWaitBits(pRadar_status->Task_EventGroup, MEASURE_EVENT_DONE, pdTRUE, pdTRUE, MEASURE_WAITTIME - waited);
     }
-}
\ No newline at end of file
+}
@@ -1,3 +1,5 @@
+#define RADAR_LOG_LEVEL CONFIG_RADAR_LOG_LEVEL_DISPATCH
+
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
@@ -15,6 +17,19 @@
 #include "radar_uart.h"
 #include "steering_control.h"
 #include "steering_task.h"
+#include "sweep_publish.h"
+#include "sweep_output.h"
+#include "sweep_occupancy.h"
+#include "sweep_sector.h"
+#include "WIFI.h"
+#include "UDP_clinet.h"
+#include "scan_server.h"
+#include "radar_latency.h"
+#include "radar_counters.h"
+#include "radar_task_stats.h"
+#include "radar_trace.h"
+#include "radar_log.h"
+#include "radar_uart_capture.h"
 
 #define MODBUS_UART 1
 #define ATK_MS53L0M_UART 2
@@ -22,10 +37,24 @@
 static const char* TAG = "RadarManager";
 
 static Radar_status g_Radar_status;
+static Modbus_request_t g_Radar_request;   /* Request being executed, only used by the execution task */
+static bool g_scan_running;                 /* The steering task scans, only used by the execution task */
 
 static uint8_t get_UART_baudrate_to_settings(uart_port_t uart_num);
+static uint8_t interval_to_backrate(uint32_t interval_ms);
 static esp_err_t Processing_Funcode_0_write_data(void);
+static esp_err_t Processing_Funcode_1_write_data(void);
 static esp_err_t Processing_Funcode_5_write_data(void);
+static esp_err_t Processing_Funcode_9_write_data(void);
+static esp_err_t Processing_Funcode_A_write_data(void);
+static esp_err_t Processing_Funcode_B_write_data(void);
+static esp_err_t Processing_Funcode_C_write_data(void);
+static esp_err_t Processing_Funcode_D_write_data(void);
+static esp_err_t Processing_Funcode_F_write_data(void);
+static esp_err_t Processing_Funcode_11_write_data(void);
+static esp_err_t Processing_Funcode_12_write_data(void);
+static esp_err_t Processing_Funcode_13_write_data(void);
+static void sector_alarm_push(const uint8_t* event, uint8_t len);
 static void steering_Task_run(void);
 static void steering_Task_Suspend(void);
 static void steering_Task_reset(void);
@@ -56,12 +85,38 @@ esp_err_t Radar_manager_init(void)
     if (err)
         return ESP_ERR_NOT_FOUND; /* UART number err */
 
-    g_Radar_status.p_uart_data = Modbus_Get_rx_Data_Address(); /* get receive address */
-    if (g_Radar_status.p_uart_data == NULL)
-        return ESP_ERR_NOT_FOUND;
+    err = wifi_init_sta(); /* needs NVS from Modbus_init, connects while the rest is set up */
+    if (err != ESP_OK)
+        return err;
+
+    g_Radar_status.p_request = &g_Radar_request; /* requests are executed one at a time */
 
     g_Radar_status.p_steering = vSteering_init(); /* init steering */
 
+    err = Radar_sweep_init(); /* init sweep buffers */
+    if (err != ESP_OK)
+        return err;
+
+    err = Radar_output_init(); /* init sweep output formats */
+    if (err != ESP_OK)
+        return err;
+
+    err = Radar_sector_init(sector_alarm_push); /* sector queries and alarms */
+    if (err != ESP_OK)
+        return err;
+
+    err = Radar_occupancy_init(); /* optional, needs to subscribe before the steering task runs */
+    if ((err != ESP_OK) && (err != ESP_ERR_NOT_SUPPORTED))
+        ESP_LOGW(TAG, "occupancy grid init error:%s", esp_err_to_name(err));
+
+    err = udp_stream_init(); /* WiFi scan streaming */
+    if (err != ESP_OK)
+        return err;
+
+    err = scan_server_init(); /* TCP/WebSocket scan clients */
+    if (err != ESP_OK)
+        return err;
+
     err = atk_ms53l0m_init(ATK_MS53L0M_UART, &g_Radar_status.Measurement_sensor_address); /* init measure sensor */
     if (err != ATK_MS53L0M_EOK)
         return ESP_FAIL;
@@ -94,6 +149,10 @@ esp_err_t Radar_manager_init(void)
                             &g_Radar_status.input_Execution_Task_Handle, 
                             0);
 
+    err = Radar_task_stats_init(); /* optional telemetry */
+    if ((err != ESP_OK) && (err != ESP_ERR_NOT_SUPPORTED))
+        ESP_LOGW(TAG, "task statistics init error:%s", esp_err_to_name(err));
+
     return ESP_OK;
 }
 
@@ -107,114 +166,263 @@ esp_err_t Radar_manager_init(void)
 */
 esp_err_t Radar_manager_Modbus_carry_out(TickType_t xTicksToWait)
 {
-    if ( pdTRUE == xSemaphoreTake(g_Radar_status.p_uart_data->xBinarySemaphore, xTicksToWait) )
+    const Modbus_reply_t* reply = &g_Radar_status.p_request->reply; /* answers go back the way the request came */
+
+    uint16_t trace_request;
+
+    if ( Modbus_receive(g_Radar_status.p_request, xTicksToWait) )
     {
-        g_Radar_status.p_uart_data->status = false; /* Processing data */
+        trace_request = (uint16_t)((g_Radar_status.p_request->fun_code << 8) | g_Radar_status.p_request->opt_type);
+        Radar_trace(RADAR_TRACE_DISPATCH_BEGIN, trace_request, 0);
 
-        if ( g_Radar_status.p_uart_data->opt_type == MODBUS_OPT_READ ) { /* Read operation */
-            switch ( g_Radar_status.p_uart_data->fun_code )
+        if ( g_Radar_status.p_request->opt_type == MODBUS_OPT_READ ) { /* Read operation */
+            switch ( g_Radar_status.p_request->fun_code )
             {
                 case (uint8_t)MODBUS_FUNCODE_SYS:
-                    printf("READ System settings.");
-                    Modbus_transmit_ErrCode(MODBUS_STATUSCODE_ERR_OPR); /* Reading system settings is meaningless */
+                    RADAR_LOGD(TAG, "READ System settings.");
+                    Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_OPR); /* Reading system settings is meaningless */
                     break;
 
                 case (uint8_t)MODBUS_FUNCODE_SCANRATE:
-                    printf("READ Scan ratt.");
-                    Modbus_back_read_message(MODBUS_FUNCODE_SCANRATE, 1, (uint16_t)g_Radar_status.scan_rate); /* return scan rate */
+                    RADAR_LOGD(TAG, "READ Scan ratt.");
+                    if (reply->channel == RADAR_OUTPUT_CHANNEL_UART)
+                        Modbus_back_read_message(reply, MODBUS_FUNCODE_SCANRATE, 1, (uint16_t)g_Radar_status.scan_rate); /* return scan rate */
+                    else
+                        Modbus_back_read_message(reply, MODBUS_FUNCODE_SCANRATE, 1, 
+                                                 (uint16_t)interval_to_backrate(Radar_output_get_interval(reply->channel)));
                     break;
 
                 case (uint8_t)MODBUS_FUNCODE_BAUDRATE:
-                    printf("READ BPS rate setting.");
-                    uint8_t baudrateCODE = get_UART_baudrate_to_settings(g_Radar_status.p_uart_data->uart_num);
-                    Modbus_back_read_message(MODBUS_FUNCODE_BAUDRATE, 1, (uint16_t)baudrateCODE); /* return BPS rate */
+                    RADAR_LOGD(TAG, "READ BPS rate setting.");
+                    uint8_t baudrateCODE = get_UART_baudrate_to_settings(MODBUS_UART);
+                    Modbus_back_read_message(reply, MODBUS_FUNCODE_BAUDRATE, 1, (uint16_t)baudrateCODE); /* return BPS rate */
                     break;
 
                 case (uint8_t)MODBUS_FUNCODE_IDSET:
-                    printf("READ Device Address Settings.");
-                    Modbus_back_read_message(MODBUS_FUNCODE_IDSET, 2, g_Radar_status.p_uart_data->device_address);
+                    RADAR_LOGD(TAG, "READ Device Address Settings.");
+                    Modbus_back_read_message(reply, MODBUS_FUNCODE_IDSET, 2, Modbus_get_device_address());
                     break;
 
                 case (uint8_t)MODBUS_FUNCODE_APPOINTDATA:
-                    printf("READ Obtain specified azimuth data.");
+                    RADAR_LOGD(TAG, "READ Obtain specified azimuth data.");
                     break;
 
                 case (uint8_t)MODBUS_FUNCODE_WORKMODE:
-                    printf("READ Work mode.");
-                    Modbus_back_read_message(MODBUS_FUNCODE_WORKMODE, 1, (uint16_t)g_Radar_status.work_mode);
+                    RADAR_LOGD(TAG, "READ Work mode.");
+                    Modbus_back_read_message(reply, MODBUS_FUNCODE_WORKMODE, 1, (uint16_t)g_Radar_status.work_mode);
                     break;
 
                 case (uint8_t)MODBUS_FUNCODE_MEASUREMODE:
-                    printf("READ Measurement mode settings.");
-                    Modbus_back_read_message(MODBUS_FUNCODE_MEASUREMODE, 1, (uint16_t)g_Radar_status.Measure_mode);
+                    RADAR_LOGD(TAG, "READ Measurement mode settings.");
+                    Modbus_back_read_message(reply, MODBUS_FUNCODE_MEASUREMODE, 1, (uint16_t)g_Radar_status.Measure_mode);
                     break;
 
                 case (uint8_t)MODBUS_FUNCODE_CALIMODE:
-                    printf("READ Calibration Mode.");
+                    RADAR_LOGD(TAG, "READ Calibration Mode.");
+                    break;
+
+                case (uint8_t)MODBUS_FUNCODE_OUTPUTFORMAT:
+                    RADAR_LOGD(TAG, "READ Sweep output format.");
+                    Modbus_back_read_message(reply, MODBUS_FUNCODE_OUTPUTFORMAT, 1, 
+                                             (uint16_t)Radar_output_get_format(reply->channel));
+                    break;
+
+                case (uint8_t)MODBUS_FUNCODE_OCCUPANCY:
+                    RADAR_LOGD(TAG, "READ Occupancy grid information.");
+                    {
+                        uint8_t info[RADAR_OCCUPANCY_INFO_LEN];
+                        if (Radar_occupancy_encode_info(info, sizeof(info)))
+                            Modbus_back_read_buffer(reply, MODBUS_FUNCODE_OCCUPANCY, info, sizeof(info));
+                        else
+                            Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_OPR); /* grid disabled */
+                    }
+                    break;
+
+                case (uint8_t)MODBUS_FUNCODE_STREAMSTATS:
+                    RADAR_LOGD(TAG, "READ Stream counters.");
+                    {
+                        uint8_t stats[RADAR_STREAM_STATS_LEN];
+                        udp_stream_encode_stats(stats, sizeof(stats));
+                        Modbus_back_read_buffer(reply, MODBUS_FUNCODE_STREAMSTATS, stats, sizeof(stats));
+                    }
+                    break;
+
+                case (uint8_t)MODBUS_FUNCODE_LATENCY:
+                    RADAR_LOGD(TAG, "READ Latency stages.");
+                    Modbus_back_read_message(reply, MODBUS_FUNCODE_LATENCY, 1, RADAR_LATENCY_STAGE_NUM);
+                    break;
+
+                case (uint8_t)MODBUS_FUNCODE_COUNTERS:
+                    RADAR_LOGD(TAG, "READ Health counters.");
+                    {
+                        uint8_t health[RADAR_COUNTERS_ANSWER_LEN];
+                        Radar_counters_encode(health, sizeof(health));
+                        Modbus_back_read_buffer(reply, MODBUS_FUNCODE_COUNTERS, health, sizeof(health));
+                    }
+                    break;
+
+                case (uint8_t)MODBUS_FUNCODE_TASKSTATS:
+                    RADAR_LOGD(TAG, "READ Task statistics summary.");
+                    {
+                        uint8_t summary[RADAR_TASK_STATS_SUMMARY_LEN];
+                        if (Radar_task_stats_encode_summary(summary, sizeof(summary)))
+                            Modbus_back_read_buffer(reply, MODBUS_FUNCODE_TASKSTATS, summary, sizeof(summary));
+                        else
+                            Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_OPR); /* disabled or not sampled yet */
+                    }
+                    break;
+
+                case (uint8_t)MODBUS_FUNCODE_TRACE:
+                    RADAR_LOGD(TAG, "READ Trace information.");
+                    {
+                        uint8_t info[RADAR_TRACE_INFO_LEN];
+                        if (Radar_trace_encode_info(info, sizeof(info)))
+                            Modbus_back_read_buffer(reply, MODBUS_FUNCODE_TRACE, info, sizeof(info));
+                        else
+                            Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_OPR); /* trace compiled out */
+                    }
+                    break;
+
+                case (uint8_t)MODBUS_FUNCODE_CAPTURE:
+                    RADAR_LOGD(TAG, "READ Capture information.");
+                    {
+                        uint8_t info[RADAR_CAPTURE_INFO_LEN];
+                        if (Radar_uart_capture_encode_info(info, sizeof(info)))
+                            Modbus_back_read_buffer(reply, MODBUS_FUNCODE_CAPTURE, info, sizeof(info));
+                        else
+                            Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_OPR); /* capture compiled out */
+                    }
                     break;
 
                 default:
-                    printf("READ ERROR!");
-                    Modbus_transmit_ErrCode(MODBUS_STATUSCODE_ERR_FUNCODE);
+                    RADAR_LOGW(TAG, "READ ERROR!");
+                    Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_FUNCODE);
                     break;
             }
-        } else if ( g_Radar_status.p_uart_data->opt_type == MODBUS_OPT_WRITE ) { /* Write operation */
-            switch ( g_Radar_status.p_uart_data->fun_code )
+        } else if ( g_Radar_status.p_request->opt_type == MODBUS_OPT_WRITE ) { /* Write operation */
+            switch ( g_Radar_status.p_request->fun_code )
             {
                 /* 0x00 System settings */
                 case (uint8_t)MODBUS_FUNCODE_SYS:
-                    ESP_LOGI(TAG, "[WRITE System settings]");
+                    RADAR_LOGD(TAG, "[WRITE System settings]");
                     if (Processing_Funcode_0_write_data()) {
-                        Modbus_transmit_ErrCode(MODBUS_STATUSCODE_ERR_DATA);
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DATA);
                     } else {
-                        Modbus_back_write_message(MODBUS_FUNCODE_SYS);
+                        Modbus_back_write_message(reply, MODBUS_FUNCODE_SYS);
                     }
                     break;
                 /*  */
                 case (uint8_t)MODBUS_FUNCODE_SCANRATE:
-                    printf("WRITE Scan ratt.");
+                    RADAR_LOGD(TAG, "WRITE Scan ratt.");
+                    if (Processing_Funcode_1_write_data())
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DATA);
+                    else
+                        Modbus_back_write_message(reply, MODBUS_FUNCODE_SCANRATE);
                     break;
 
                 case (uint8_t)MODBUS_FUNCODE_BAUDRATE:
-                    printf("WRITE BPS rate setting.");
+                    RADAR_LOGD(TAG, "WRITE BPS rate setting.");
                     break;
 
                 case (uint8_t)MODBUS_FUNCODE_IDSET:
-                    printf("WRITE Device Address Settings.");
+                    RADAR_LOGD(TAG, "WRITE Device Address Settings.");
                     break;
                 /* 0x05 Obtain specified azimuth data */
                 case (uint8_t)MODBUS_FUNCODE_APPOINTDATA:
-                    printf("WRITE Obtain specified azimuth data.");
-                    if (Processing_Funcode_5_write_data()) /* data error */
-                        Modbus_transmit_ErrCode(MODBUS_STATUSCODE_ERR_DATA);
+                    RADAR_LOGD(TAG, "WRITE Obtain specified azimuth data.");
+                    if (g_scan_running) /* the scan owns the steering gear and the sensor */
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_BUSY);
+                    else if (Processing_Funcode_5_write_data()) /* data error */
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DATA);
                     else 
                         steering_Task_Specify_Angle(); /* Special here, returning a read message, include 2 bytes measure data */
                     break;
                 /*  */
                 case (uint8_t)MODBUS_FUNCODE_WORKMODE:
-                    printf("WRITE Work mode.");
+                    RADAR_LOGD(TAG, "WRITE Work mode.");
                     break;
 
                 case (uint8_t)MODBUS_FUNCODE_MEASUREMODE:
-                    printf("WRITE Measurement mode settings.");
+                    RADAR_LOGD(TAG, "WRITE Measurement mode settings.");
                     break;
 
                 case (uint8_t)MODBUS_FUNCODE_CALIMODE:
-                    printf("WRITE Calibration Mode.");
+                    RADAR_LOGD(TAG, "WRITE Calibration Mode.");
+                    break;
+                /* 0x09 Sweep output format of this channel */
+                case (uint8_t)MODBUS_FUNCODE_OUTPUTFORMAT:
+                    RADAR_LOGD(TAG, "WRITE Sweep output format.");
+                    if (Processing_Funcode_9_write_data())
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DATA);
+                    else
+                        Modbus_back_write_message(reply, MODBUS_FUNCODE_OUTPUTFORMAT);
+                    break;
+                /* 0x0A Obtain one page of the latest sweep */
+                case (uint8_t)MODBUS_FUNCODE_SWEEPDATA:
+                    RADAR_LOGD(TAG, "WRITE Obtain sweep page.");
+                    if (Processing_Funcode_A_write_data()) /* data error */
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DATA);
+                    break;
+                /* 0x0B Occupancy grid tiles changed after a version */
+                case (uint8_t)MODBUS_FUNCODE_OCCUPANCY:
+                    RADAR_LOGD(TAG, "WRITE Obtain occupancy tiles.");
+                    if (Processing_Funcode_B_write_data()) /* data error */
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DATA);
+                    break;
+                /* 0x0C Minimum, argmin and mean distance of a sector */
+                case (uint8_t)MODBUS_FUNCODE_SECTORQUERY:
+                    RADAR_LOGD(TAG, "WRITE Sector query.");
+                    if (Processing_Funcode_C_write_data()) /* data error */
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DATA);
+                    break;
+                /* 0x0D Sector threshold alarm */
+                case (uint8_t)MODBUS_FUNCODE_SECTORALARM:
+                    RADAR_LOGD(TAG, "WRITE Sector alarm.");
+                    if (Processing_Funcode_D_write_data()) /* data error */
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DATA);
+                    else
+                    {
+                        Modbus_subscribe_events(reply); /* alarm events go to the peer that set the alarm */
+                        Modbus_back_write_message(reply, MODBUS_FUNCODE_SECTORALARM);
+                    }
+                    break;
+                /* 0x0F Per-stage latency histograms */
+                case (uint8_t)MODBUS_FUNCODE_LATENCY:
+                    RADAR_LOGD(TAG, "WRITE Latency histogram.");
+                    if (Processing_Funcode_F_write_data()) /* data error */
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DATA);
+                    break;
+                /* 0x11 Task CPU load and stack headroom */
+                case (uint8_t)MODBUS_FUNCODE_TASKSTATS:
+                    RADAR_LOGD(TAG, "WRITE Task statistics page.");
+                    if (Processing_Funcode_11_write_data()) /* data error */
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DATA);
+                    break;
+                /* 0x12 Hot-path event trace */
+                case (uint8_t)MODBUS_FUNCODE_TRACE:
+                    RADAR_LOGD(TAG, "WRITE Trace.");
+                    if (Processing_Funcode_12_write_data()) /* data error */
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DATA);
+                    break;
+                /* 0x13 Raw UART capture and replay */
+                case (uint8_t)MODBUS_FUNCODE_CAPTURE:
+                    RADAR_LOGD(TAG, "WRITE Capture.");
+                    if (Processing_Funcode_13_write_data()) /* data error */
+                        Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DATA);
                     break;
 
                 default:
-                    printf("WRITE ERROR!");
-                    Modbus_transmit_ErrCode(MODBUS_STATUSCODE_ERR_FUNCODE);
+                    RADAR_LOGW(TAG, "WRITE ERROR!");
+                    Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_FUNCODE);
                     break;
 
             }
         }
 
-        g_Radar_status.p_uart_data->status = true; /* Data processing completed */
+        Radar_trace(RADAR_TRACE_DISPATCH_END, trace_request, 0);
         return ESP_OK;
     } else {
-        printf("Modbus timeout!");
+        RADAR_LOGD(TAG, "Modbus timeout!");
         return ESP_ERR_TIMEOUT;
     }
 }
@@ -257,6 +465,57 @@ static uint8_t get_UART_baudrate_to_settings(uart_port_t uart_num)
     }
 }
 
+/* Time between two sweeps of each automatic scanning rate setting (ms) */
+static const uint32_t g_backrate_interval_ms[] = {
+    [MODBUS_BACKRATE_01HZ]  = 10000,
+    [MODBUS_BACKRATE_02HZ]  = 5000,
+    [MODBUS_BACKRATE_05HZ]  = 2000,
+    [MODBUS_BACKRATE_1HZ]   = 1000,
+    [MODBUS_BACKRATE_2HZ]   = 500,
+    [MODBUS_BACKRATE_5HZ]   = 200,
+    [MODBUS_BACKRATE_10HZ]  = 100,
+    [MODBUS_BACKRATE_20HZ]  = 50,
+    [MODBUS_BACKRATE_50HZ]  = 20,
+    [MODBUS_BACKRATE_100HZ] = 10,
+};
+
+/**
+ * @brief       Convert the sweep interval of a channel to Modbus parameter
+ * 
+ * @param       interval_ms sweep interval
+ * 
+ * @retval      automatic scanning rate settings parameters, MODBUS_OPT_ERROR when not limited
+*/
+static uint8_t interval_to_backrate(uint32_t interval_ms)
+{
+    for (uint8_t i = 0; i < sizeof(g_backrate_interval_ms) / sizeof(g_backrate_interval_ms[0]); i++)
+    {
+        if (g_backrate_interval_ms[i] == interval_ms)
+            return i;
+    }
+    return MODBUS_OPT_ERROR;
+}
+
+/**
+ * @brief       When receiving the 0x01 function code, this function processes the data within it
+ *              1 byte of data: automatic scanning rate settings parameter, the highest rate
+ *              at which sweeps are pushed to this channel
+ * @retval      ESP_FAIL: data error
+ * @retval      ESP_OK: OK
+*/
+static esp_err_t Processing_Funcode_1_write_data(void)
+{
+    uint8_t rate = g_Radar_status.p_request->buf[0];
+
+    if ((g_Radar_status.p_request->len != 1) || (rate > MODBUS_BACKRATE_100HZ))
+        return ESP_FAIL;
+    if (Radar_output_set_interval(g_Radar_status.p_request->reply.channel, g_backrate_interval_ms[rate]) != ESP_OK)
+        return ESP_FAIL;
+    if (g_Radar_status.p_request->reply.channel == RADAR_OUTPUT_CHANNEL_UART)
+        g_Radar_status.scan_rate = rate;
+    return ESP_OK;
+}
+
 /**
  * @brief       When receiving the 0x00 function code, this function processes the data within it
  * @retval      ESP_FAIL: data error
@@ -264,18 +523,18 @@ static uint8_t get_UART_baudrate_to_settings(uart_port_t uart_num)
 */
 static esp_err_t Processing_Funcode_0_write_data(void)
 {
-    if (g_Radar_status.p_uart_data->len != 1)
+    if (g_Radar_status.p_request->len != 1)
         return ESP_FAIL;
     else {
-        if (g_Radar_status.p_uart_data->buf[0] == MODBUS_SYS_RUN) {
+        if (g_Radar_status.p_request->buf[0] == MODBUS_SYS_RUN) {
             steering_Task_run();
             return ESP_OK;
-        } else if (g_Radar_status.p_uart_data->buf[0] == MODBUS_SYS_PARAM_RESET) {
+        } else if (g_Radar_status.p_request->buf[0] == MODBUS_SYS_PARAM_RESET) {
             return ESP_OK;
-        } else if (g_Radar_status.p_uart_data->buf[0] == MODBUS_SYS_RESET) {
+        } else if (g_Radar_status.p_request->buf[0] == MODBUS_SYS_RESET) {
             steering_Task_reset();
             return ESP_OK;
-        } else if (g_Radar_status.p_uart_data->buf[0] == MODBUS_SYS_SUSPEND) {
+        } else if (g_Radar_status.p_request->buf[0] == MODBUS_SYS_SUSPEND) {
             steering_Task_Suspend();
             return ESP_OK;
         } else 
@@ -290,22 +549,22 @@ static esp_err_t Processing_Funcode_0_write_data(void)
 */
 static esp_err_t Processing_Funcode_5_write_data(void)
 {
-    if (g_Radar_status.p_uart_data->len % 2 || g_Radar_status.p_uart_data->len > 10) /* Every 2 bytes describe a servo angle */
+    if (g_Radar_status.p_request->len % 2 || g_Radar_status.p_request->len > 10) /* Every 2 bytes describe a servo angle */
         return ESP_FAIL;
 
     uint8_t steering_name;
     uint16_t steering_angle;
-    for (int i = 0; i < g_Radar_status.p_uart_data->len; i += 2)
+    for (int i = 0; i < g_Radar_status.p_request->len; i += 2)
     {   
         /* The high 7 bits indicate the steering gear number */
-        steering_name = g_Radar_status.p_uart_data->buf[i] >> 1; 
+        steering_name = g_Radar_status.p_request->buf[i] >> 1; 
         if (steering_name > g_Radar_status.p_steering->steering_totalNum - 1) 
         {
             /* The steering gear does not exist */
             return ESP_FAIL;
         }
         /* High 9 bits indicate angle */
-        steering_angle = (((uint16_t)g_Radar_status.p_uart_data->buf[i] & 1) << 8) + (uint16_t)g_Radar_status.p_uart_data->buf[i + 1];
+        steering_angle = (((uint16_t)g_Radar_status.p_request->buf[i] & 1) << 8) + (uint16_t)g_Radar_status.p_request->buf[i + 1];
         if (steering_angle > g_Radar_status.p_steering->steering_arr[steering_name].angle_scope)
         {
             /* Exceeding maximum angle */
@@ -317,6 +576,254 @@ static esp_err_t Processing_Funcode_5_write_data(void)
     return ESP_OK;
 }
 
+/**
+ * @brief       When receiving the 0x09 function code, this function processes the data within it
+ * @retval      ESP_FAIL: data error
+ * @retval      ESP_OK: OK
+*/
+static esp_err_t Processing_Funcode_9_write_data(void)
+{
+    if (g_Radar_status.p_request->len != 1)
+        return ESP_FAIL;
+    if (Radar_output_set_format(g_Radar_status.p_request->reply.channel, g_Radar_status.p_request->buf[0]) != ESP_OK)
+        return ESP_FAIL; /* format does not exist */
+    return ESP_OK;
+}
+
+/**
+ * @brief       When receiving the 0x0A function code, this function processes the data within it
+ *              The 1 byte of data is the page index, the page is returned as a read message
+ * @retval      ESP_FAIL: data error
+ * @retval      ESP_OK: OK
+*/
+static esp_err_t Processing_Funcode_A_write_data(void)
+{
+    const Modbus_reply_t* reply = &g_Radar_status.p_request->reply;
+    static uint8_t page_buf[UINT8_MAX]; /* only used by the execution task */
+    const Radar_sweep_t* psweep;
+    size_t len;
+
+    if (g_Radar_status.p_request->len != 1)
+        return ESP_FAIL;
+
+    psweep = Radar_sweep_acquire_latest();
+    if (psweep == NULL)
+        return ESP_FAIL; /* no sweep published yet */
+    len = Radar_output_encode_page(reply->channel, psweep, g_Radar_status.p_request->buf[0],
+                                   page_buf, sizeof(page_buf));
+    Radar_sweep_release(psweep);
+    if (len == 0)
+        return ESP_FAIL; /* page does not exist */
+
+    Modbus_back_read_buffer(reply, MODBUS_FUNCODE_SWEEPDATA, page_buf, (uint8_t)len);
+    return ESP_OK;
+}
+
+/**
+ * @brief       When receiving the 0x0B function code, this function processes the data within it
+ *              6 bytes of data: grid version the host has(4) + first tile(2), high byte first.
+ *              The tiles are returned as a read message, the host repeats the request with
+ *              the returned next tile until it is RADAR_OCCUPANCY_LAST_TILE
+ * @retval      ESP_FAIL: data error
+ * @retval      ESP_OK: OK
+*/
+static esp_err_t Processing_Funcode_B_write_data(void)
+{
+    const Modbus_reply_t* reply = &g_Radar_status.p_request->reply;
+    static uint8_t delta_buf[UINT8_MAX]; /* only used by the execution task */
+    const uint8_t* buf = g_Radar_status.p_request->buf;
+    uint32_t since_version;
+    uint16_t start_tile;
+    size_t len;
+
+    if (g_Radar_status.p_request->len != 6)
+        return ESP_FAIL;
+
+    since_version = ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | buf[3];
+    start_tile = ((uint16_t)buf[4] << 8) | buf[5];
+    len = Radar_occupancy_encode_delta(since_version, start_tile, delta_buf, sizeof(delta_buf));
+    if (len == 0)
+        return ESP_FAIL; /* grid disabled */
+
+    Modbus_back_read_buffer(reply, MODBUS_FUNCODE_OCCUPANCY, delta_buf, (uint8_t)len);
+    return ESP_OK;
+}
+
+/**
+ * @brief       When receiving the 0x0C function code, this function processes the data within it
+ *              4 bytes of data: sector start angle(2) + sector end angle(2), high byte first.
+ *              The answer is returned as a read message, without moving the servo
+ * @retval      ESP_FAIL: data error
+ * @retval      ESP_OK: OK
+*/
+static esp_err_t Processing_Funcode_C_write_data(void)
+{
+    const Modbus_reply_t* reply = &g_Radar_status.p_request->reply;
+    const uint8_t* buf = g_Radar_status.p_request->buf;
+    Sweep_query_result_t result;
+    uint8_t answer[RADAR_SECTOR_RESULT_LEN];
+
+    if (g_Radar_status.p_request->len != 4)
+        return ESP_FAIL;
+    if (Radar_sector_query(((uint16_t)buf[0] << 8) | buf[1], ((uint16_t)buf[2] << 8) | buf[3], &result) != ESP_OK)
+        return ESP_FAIL; /* no bin inside the sector */
+
+    Radar_sector_encode_result(&result, answer);
+    Modbus_back_read_buffer(reply, MODBUS_FUNCODE_SECTORQUERY, answer, sizeof(answer));
+    return ESP_OK;
+}
+
+/**
+ * @brief       When receiving the 0x0D function code, this function processes the data within it
+ *              7 bytes of data: slot(1) + sector start angle(2) + sector end angle(2) + limit(2), high byte first.
+ *              A limit of 0 disables the slot
+ * @retval      ESP_FAIL: data error
+ * @retval      ESP_OK: OK
+*/
+static esp_err_t Processing_Funcode_D_write_data(void)
+{
+    const uint8_t* buf = g_Radar_status.p_request->buf;
+
+    if (g_Radar_status.p_request->len != 7)
+        return ESP_FAIL;
+    if (Radar_sector_set_alarm(buf[0], ((uint16_t)buf[1] << 8) | buf[2], ((uint16_t)buf[3] << 8) | buf[4],
+                               ((uint16_t)buf[5] << 8) | buf[6]) != ESP_OK)
+        return ESP_FAIL;
+    return ESP_OK;
+}
+
+/**
+ * @brief       When receiving the 0x0F function code, this function processes the data within it
+ *              1 byte of data: stage, its histogram is returned as a read message (see radar_latency.h).
+ *              2 bytes of data: stage + 0x01, the histogram is returned then cleared;
+ *              stage RADAR_LATENCY_ALL_STAGES clears every histogram and is acknowledged as a write
+ * @retval      ESP_FAIL: data error
+ * @retval      ESP_OK: OK
+*/
+static esp_err_t Processing_Funcode_F_write_data(void)
+{
+    const Modbus_reply_t* reply = &g_Radar_status.p_request->reply;
+    const uint8_t* buf = g_Radar_status.p_request->buf;
+    uint8_t answer[RADAR_LATENCY_ANSWER_LEN];
+    size_t len;
+
+    if ((g_Radar_status.p_request->len == 2) && (buf[1] == 0x01) && (buf[0] == RADAR_LATENCY_ALL_STAGES))
+    {
+        Radar_latency_reset(RADAR_LATENCY_ALL_STAGES);
+        Modbus_back_write_message(reply, MODBUS_FUNCODE_LATENCY);
+        return ESP_OK;
+    }
+    if ((g_Radar_status.p_request->len != 1) && ((g_Radar_status.p_request->len != 2) || (buf[1] != 0x01)))
+        return ESP_FAIL;
+    len = Radar_latency_encode(buf[0], answer, sizeof(answer));
+    if (len == 0)
+        return ESP_FAIL; /* stage does not exist */
+    if (g_Radar_status.p_request->len == 2)
+        Radar_latency_reset(buf[0]);
+
+    Modbus_back_read_buffer(reply, MODBUS_FUNCODE_LATENCY, answer, (uint8_t)len);
+    return ESP_OK;
+}
+
+/**
+ * @brief       When receiving the 0x11 function code, this function processes the data within it
+ *              1 byte of data: index of the first task, the records of the last sample from there
+ *              are returned as a read message (see radar_task_stats.h)
+ * @retval      ESP_FAIL: data error
+ * @retval      ESP_OK: OK
+*/
+static esp_err_t Processing_Funcode_11_write_data(void)
+{
+    const Modbus_reply_t* reply = &g_Radar_status.p_request->reply;
+    uint8_t page[RADAR_TASK_STATS_PAGE_LEN];
+    size_t len;
+
+    if (g_Radar_status.p_request->len != 1)
+        return ESP_FAIL;
+    len = Radar_task_stats_encode_page(g_Radar_status.p_request->buf[0], page, sizeof(page));
+    if (len == 0)
+        return ESP_FAIL; /* disabled, not sampled yet or past the last task */
+
+    Modbus_back_read_buffer(reply, MODBUS_FUNCODE_TASKSTATS, page, (uint8_t)len);
+    return ESP_OK;
+}
+
+/**
+ * @brief       When receiving the 0x12 function code, this function processes the data within it
+ *              1 byte of data: RADAR_TRACE_CMD_xxx, acknowledged as a write
+ *              3 bytes of data: core + first slot (2 bytes), the records from there are returned
+ *              as a read message (see radar_trace.h); stop the trace before dumping it
+ * @retval      ESP_FAIL: data error
+ * @retval      ESP_OK: OK
+*/
+static esp_err_t Processing_Funcode_12_write_data(void)
+{
+    const Modbus_reply_t* reply = &g_Radar_status.p_request->reply;
+    const uint8_t* buf = g_Radar_status.p_request->buf;
+    uint8_t page[RADAR_TRACE_PAGE_LEN];
+    size_t len;
+
+    if (g_Radar_status.p_request->len == 1)
+    {
+        if (!Radar_trace_command(buf[0]))
+            return ESP_FAIL;
+        Modbus_back_write_message(reply, MODBUS_FUNCODE_TRACE);
+        return ESP_OK;
+    }
+    if (g_Radar_status.p_request->len != 3)
+        return ESP_FAIL;
+    len = Radar_trace_encode_page(buf[0], ((uint16_t)buf[1] << 8) | buf[2], page, sizeof(page));
+    if (len == 0)
+        return ESP_FAIL; /* core or slot out of range, or trace compiled out */
+
+    Modbus_back_read_buffer(reply, MODBUS_FUNCODE_TRACE, page, (uint8_t)len);
+    return ESP_OK;
+}
+
+/**
+ * @brief       When receiving the 0x13 function code, this function processes the data within it
+ *              1 byte of data: RADAR_CAPTURE_CMD_xxx, acknowledged as a write
+ *              2 bytes of data: first slot, the records from there are returned as a read message
+ *              (see radar_uart_capture.h); stop the capture before dumping it
+ *              RADAR_CAPTURE_RECORD_LEN bytes of data: one record appended to the stopped capture
+ * @retval      ESP_FAIL: data error
+ * @retval      ESP_OK: OK
+*/
+static esp_err_t Processing_Funcode_13_write_data(void)
+{
+    const Modbus_reply_t* reply = &g_Radar_status.p_request->reply;
+    const uint8_t* buf = g_Radar_status.p_request->buf;
+    uint8_t page[RADAR_CAPTURE_PAGE_LEN];
+    size_t len;
+
+    if ((g_Radar_status.p_request->len == 1) || (g_Radar_status.p_request->len == RADAR_CAPTURE_RECORD_LEN))
+    {
+        if ((g_Radar_status.p_request->len == 1) ? !Radar_uart_capture_command(buf[0])
+                                                 : !Radar_uart_capture_load(buf, g_Radar_status.p_request->len))
+            return ESP_FAIL;
+        Modbus_back_write_message(reply, MODBUS_FUNCODE_CAPTURE);
+        return ESP_OK;
+    }
+    if (g_Radar_status.p_request->len != 2)
+        return ESP_FAIL;
+    len = Radar_uart_capture_encode_page(((uint16_t)buf[0] << 8) | buf[1], page, sizeof(page));
+    if (len == 0)
+        return ESP_FAIL; /* slot out of range, or capture compiled out */
+
+    Modbus_back_read_buffer(reply, MODBUS_FUNCODE_CAPTURE, page, (uint8_t)len);
+    return ESP_OK;
+}
+
+/**
+ * @brief       Push a sector alarm event to the host
+ * @param       event : alarm event
+ * @param       len   : event len
+*/
+static void sector_alarm_push(const uint8_t* event, uint8_t len)
+{
+    Modbus_push_event(MODBUS_FUNCODE_SECTORALARM, event, len);
+}
+
 /**
  * @brief       Pause Task
 */
@@ -325,8 +832,9 @@ static void steering_Task_Suspend(void)
     // Notify the steering task to suspend itself
     if (g_Radar_status.Steering_task_Handle)
     {
-        vTaskResume(g_Radar_status.Steering_task_Handle); /* The task may be delayed and needs to be awakened */
         xTaskNotify(g_Radar_status.Steering_task_Handle, STEERING_TASK_SUSPEND, eSetValueWithOverwrite);
+        vTaskResume(g_Radar_status.Steering_task_Handle); /* Then wake it, it reads the notification first thing */
+        g_scan_running = false;
     }
 }
 
@@ -338,8 +846,9 @@ static void steering_Task_run(void)
     // Notify the steering task to run
     if (g_Radar_status.Steering_task_Handle)
     {
-        vTaskResume(g_Radar_status.Steering_task_Handle); /* The task may be delayed and needs to be awakened */
         xTaskNotify(g_Radar_status.Steering_task_Handle, STEERING_TASK_RUN, eSetValueWithOverwrite);
+        vTaskResume(g_Radar_status.Steering_task_Handle); /* Then wake it, it reads the notification first thing */
+        g_scan_running = true;
     }
 }
 
@@ -351,8 +860,9 @@ static void steering_Task_reset(void)
     // Notify the steering task to reset
     if (g_Radar_status.Steering_task_Handle)
     {    
-        vTaskResume(g_Radar_status.Steering_task_Handle); /* The task may be delayed and needs to be awakened */
         xTaskNotify(g_Radar_status.Steering_task_Handle, STEERING_TASK_RESET, eSetValueWithOverwrite);
+        vTaskResume(g_Radar_status.Steering_task_Handle); /* Then wake it, it reads the notification first thing */
+        g_scan_running = false;
     }
 }
 
@@ -361,16 +871,26 @@ static void steering_Task_reset(void)
 */
 static void steering_Task_Specify_Angle(void)
 {
-    // Notify the steering task to reset
+    const Modbus_reply_t* reply = &g_Radar_status.p_request->reply;
+    uint16_t request;
+    uint16_t distance;
+
+    // Notify the steering task to turn to the specified angle
     if (g_Radar_status.Steering_task_Handle)
     {    
-        vTaskResume(g_Radar_status.Steering_task_Handle); /* The task may be delayed and needs to be awakened */
+        ulTaskNotifyTake(pdTRUE, 0); /* drop a report of an earlier request that timed out */
         xTaskNotify(g_Radar_status.Steering_task_Handle, STEERING_TASK_SPECIAL, eSetValueWithOverwrite);
-        uint32_t retval = xEventGroupWaitBits(g_Radar_status.Task_EventGroup, 0x20, pdTRUE, pdTRUE, pdMS_TO_TICKS(50));
-        if ((retval & 0x20) == 0)
-            Modbus_transmit_ErrCode(MODBUS_STATUSCODE_ERR_DEVICE);
+        vTaskResume(g_Radar_status.Steering_task_Handle); /* Then wake it, it reads the notification first thing */
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(2 * STEERING_SPECIAL_SETTLE_MS)) == 0)
+        {
+            Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DEVICE);
+            return;
+        }
+        request = Radar_input_measure_request(&g_Radar_status);
+        if (!Radar_input_measure_wait(&g_Radar_status, request, &distance) || (distance == RADAR_SWEEP_INVALID_DISTANCE))
+            Modbus_transmit_ErrCode(reply, MODBUS_STATUSCODE_ERR_DEVICE);
         else
-            Modbus_back_read_message(MODBUS_FUNCODE_APPOINTDATA, 2, g_Radar_status.measure_data);
+            Modbus_back_read_message(reply, MODBUS_FUNCODE_APPOINTDATA, 2, distance);
     }
 }
 
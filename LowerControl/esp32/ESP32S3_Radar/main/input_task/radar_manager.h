@@ -30,9 +30,10 @@ typedef struct {
     uint8_t work_mode;                  /* Work mode setting */
     uint8_t Measure_mode;               /* Measurement mode settings */
     xRadar_UART_t* Uart_listHand;       /* UART */
-    Modbus_uart_rx_data* p_uart_data;   /* Frames received by UART */
+    Modbus_request_t* p_request;        /* Request being executed, from any transport */
     uint16_t Measurement_sensor_address;/* Measurement sensor address */
-    uint16_t measure_data;              /* measure data */
+    uint16_t measure_request;           /* Sequence of the last measurement requested */
+    uint32_t measure_result;            /* Last measurement done: its request sequence << 16 | distance */
     xSteering_manager_t* p_steering;    /* Including all available steering gears */
     EventGroupHandle_t Task_EventGroup; /* 0~4 bits is steering, 5 bits is Distance Sensor*/
     TaskHandle_t Steering_task_Handle;
@@ -45,5 +46,7 @@ esp_err_t Radar_manager_Modbus_carry_out(TickType_t xTicksToWait);
 
 void Radar_input_Execution_Task(void* pvParameters);
 void Radar_input_measure_Task(void* pRadar_status);
+uint16_t Radar_input_measure_request(Radar_status* pRadar_status);
+bool Radar_input_measure_wait(Radar_status* pRadar_status, uint16_t request, uint16_t* distance);
 
 #endif
\ No newline at end of file
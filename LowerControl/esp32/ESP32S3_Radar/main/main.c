@@ -10,9 +10,11 @@
 #include "WIFI.h"
 #include "sdkconfig.h"
 #include "radar_manager.h"
+#include "radar_log.h"
 #include "radar_uart.h"
 #include "steering_control.h"
 #include "atk_ms53l0m.h"
+#include "radar_bench.h"
 
 static const char *TAG = "main";
 
@@ -26,7 +28,6 @@ void app_main(void)
     //uint8_t ret;
     //uint16_t atk_ms53l0m_addr, dat;
 
-    //xTaskCreatePinnedToCore(udp_client_task, "udp_client_task", 4096, NULL, 0, NULL, 0);
     //g_pxSteering_manager = vSteering_init();
     //ret = atk_ms53l0m_init(1, &atk_ms53l0m_addr);
     //if (ret != ATK_MS53L0M_EOK)
@@ -46,6 +47,12 @@ void app_main(void)
     //    }
     //}
 
+#if CONFIG_RADAR_BENCH_AT_BOOT
+    Radar_bench_run(CONFIG_RADAR_BENCH_ROUNDS, NULL, Radar_bench_print); /* kernel cycle counts, before the tasks start */
+#endif
+    Radar_log_init(); /* deferred hot-path logging */
     Radar_manager_init();
+    /* WiFi scan streaming, the stream task waits for the connection started by Radar_manager_init */
+    xTaskCreatePinnedToCore(udp_client_task, "udp_client_task", 4096, NULL, LOW_PRIORITY, NULL, 0);
     vTaskDelete(NULL);
 }
\ No newline at end of file
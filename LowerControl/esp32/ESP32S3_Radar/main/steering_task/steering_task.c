@@ -3,26 +3,63 @@
 #include "radar_manager.h"
 #include "steering_task.h"
 #include "atk_ms53l0m.h"
+#include "sweep_publish.h"
+#include "radar_latency.h"
+#include "radar_counters.h"
 
 #define STEERING_0 0
+#define STEERING_TILT 1
 
 static Radar_status* g_pRadar_status;
 static xSteering_manager_t* g_pxSteering_manager; //Steering gear structure,after the initialization of the steering gear, 
                                                  //the manager.c transfers it into the task function
-static EventGroupHandle_t g_xTask_EventGroup; /* event group 0~4 bits is steering, 5 bits is Distance Sensor */
 static uint8_t g_scan_step = 5;
 static uint8_t g_scan_speed = 20;
 
+/**
+ * @brief       Elevation of the tilt servo relative to its default angle
+ * @retval      tilt angle (°), 0 without a tilt servo
+*/
+static int16_t Radar_Steering_tilt_angle(void)
+{
+    if (g_pxSteering_manager->steering_totalNum <= STEERING_TILT)
+        return 0;
+    return (int16_t)g_pxSteering_manager->steering_arr[STEERING_TILT].angle_now - CONFIG_STEERING_DEFAULT_ANGLE;
+}
+
+/**
+ * @brief       Measure at the current angle and store the sample in the sweep being filled
+ * @param       angle : pan servo angle (°)
+ * @retval      distance stored in the sweep
+*/
+static uint16_t Radar_Steering_measure(uint16_t angle)
+{
+    uint16_t request;
+    uint16_t distance;
+
+    request = Radar_input_measure_request(g_pRadar_status);
+    if (!Radar_input_measure_wait(g_pRadar_status, request, &distance))
+    {
+        distance = RADAR_SWEEP_INVALID_DISTANCE;
+        Radar_counter_inc(RADAR_COUNTER_SENSOR_LATE);
+    }
+    Radar_sweep_add_point(angle, distance);
+    return distance;
+}
+
 void Radar_Steering_task(void* pRadar_status)
 {
     /* During system initialization, the servo task initializes and pauses waiting to start */
     g_pRadar_status = (Radar_status*)pRadar_status;
-    g_xTask_EventGroup = g_pRadar_status->Task_EventGroup;
     g_pxSteering_manager = g_pRadar_status->p_steering;
 
     uint32_t task_status = STEERING_TASK_SUSPEND; 
     bool* steering_direction = &g_pxSteering_manager->steering_arr[STEERING_0].steering_direction;
     int32_t loop_angle;
+    bool sweep_end;
+    uint16_t distance;
+    int64_t move_start;
+    bool sweep_open = false; /* a sweep is being filled */
 
     *steering_direction = true;
     vTaskSuspend(NULL); //Wait for first Wakeup
@@ -32,6 +69,10 @@ void Radar_Steering_task(void* pRadar_status)
         xTaskNotifyWait(0, 0, &task_status, 0); // Detect externally sent notifications per loop
 
         if (task_status == STEERING_TASK_RUN) { 
+            if (!sweep_open)
+                sweep_open = (ESP_OK == Radar_sweep_begin(CONFIG_STEERING_ANGLE_SCOPE, g_scan_step, 
+                                                          *steering_direction, Radar_Steering_tilt_angle()));
+            sweep_end = false;
             /* Determine the scanning direction of the servo */
             if (*steering_direction)
                 loop_angle = g_pxSteering_manager->steering_arr[STEERING_0].angle_now + g_scan_step;
@@ -42,30 +83,45 @@ void Radar_Steering_task(void* pRadar_status)
             {
                 *steering_direction = !*steering_direction; /* change scan direction */
                 loop_angle = CONFIG_STEERING_ANGLE_SCOPE;
+                sweep_end = true;
             }
             if (loop_angle < 0)
             {
                 *steering_direction = !*steering_direction; /* change scan direction */
                 loop_angle = 0;
+                sweep_end = true;
             }
             /* Change angle */
+            move_start = Radar_latency_now();
             vSteering_ChangeAngle(&g_pxSteering_manager->steering_arr[STEERING_0], (uint16_t)loop_angle); 
             vTaskDelay(g_scan_speed / portTICK_PERIOD_MS);
+            Radar_latency_record(RADAR_LATENCY_SERVO, Radar_latency_now() - move_start);
+            distance = Radar_Steering_measure((uint16_t)loop_angle);
+            /* At the end of the scope, publish and start the sweep in the other direction from the same sample */
+            if (sweep_end && sweep_open)
+            {
+                Radar_sweep_publish();
+                sweep_open = (ESP_OK == Radar_sweep_begin(CONFIG_STEERING_ANGLE_SCOPE, g_scan_step, 
+                                                          *steering_direction, Radar_Steering_tilt_angle()));
+                Radar_sweep_add_point((uint16_t)loop_angle, distance);
+            }
 
         } else if (task_status == STEERING_TASK_SUSPEND) {
+            sweep_open = false; /* the partial sweep is discarded on the next run */
             vTaskSuspend(NULL); /* task suspension */
 
         } else if (task_status == STEERING_TASK_RESET) {
+            sweep_open = false;
             *steering_direction = true; /* Reset scan direction */
             vSteering_ResetAngle(); /* Reset the steering angle */
             vTaskSuspend(NULL); /* task suspension */
         } else if (task_status == STEERING_TASK_SPECIAL) {
-            /*  */
+            sweep_open = false;
             vSteering_ChangeAngle(&g_pxSteering_manager->steering_arr[STEERING_0], g_pxSteering_manager->steering_arr[STEERING_0].angle_now); 
-            /* Wait for 500ms for the steering gear to rotate in place */
-            vTaskDelay(500 / portTICK_PERIOD_MS);
-            /* Report the event group that the steering gear rotation is complete */
-            xEventGroupSetBits(g_xTask_EventGroup, 0x1F); /* event group 0~4 bits is steering */
+            /* Wait for the steering gear to rotate in place */
+            vTaskDelay(STEERING_SPECIAL_SETTLE_MS / portTICK_PERIOD_MS);
+            /* Report to the execution task that the steering gear rotation is complete, it measures */
+            xTaskNotifyGive(g_pRadar_status->input_Execution_Task_Handle);
             vTaskSuspend(NULL); /* task suspension */
         }
     }
@@ -8,6 +8,8 @@ enum { //Task notification value
     STEERING_TASK_SPECIAL,
 };
 
+#define STEERING_SPECIAL_SETTLE_MS 500 /* Time for the steering gear to rotate to a specified angle */
+
 void Radar_Steering_task(void* Radar_status);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#include "occupancy_grid.h"
+#include "sweep_publish.h"
+#include "sweep_occupancy.h"
+
+#ifdef CONFIG_RADAR_OCCUPANCY_GRID
+static const char *TAG = "RadarOccupancy";
+
+/* Rounded down to whole tiles */
+#define RADAR_OCCUPANCY_WIDTH   (CONFIG_RADAR_OCCUPANCY_WIDTH / OCCUPANCY_TILE_SIZE * OCCUPANCY_TILE_SIZE)
+#define RADAR_OCCUPANCY_HEIGHT  (CONFIG_RADAR_OCCUPANCY_HEIGHT / OCCUPANCY_TILE_SIZE * OCCUPANCY_TILE_SIZE)
+#define OCCUPANCY_TASK_STACK    2048
+#endif
+
+static Occupancy_grid_t g_occupancy_grid;
+static SemaphoreHandle_t g_occupancy_mutex = NULL; /* Updated by the occupancy task, read by the execution task */
+
+#ifdef CONFIG_RADAR_OCCUPANCY_GRID
+static TaskHandle_t g_occupancy_task = NULL;        /* Woken on every published sweep */
+
+/**
+ * @brief       Publish callback, runs in the steering task: only wakes the occupancy task
+ * @param       sweep : published sweep
+ *
+ * @retval      void
+ */
+static void Radar_occupancy_on_publish(const Radar_sweep_t* sweep)
+{
+    TaskHandle_t task = g_occupancy_task;
+
+    (void)sweep;
+    if (task != NULL)
+        xTaskNotifyGive(task);
+}
+
+/**
+ * @brief       Occupancy task: casts the rays of the latest published sweep
+ *              Sweeps published while it casts are skipped, the grid only needs the latest
+ * @param       pvParameters : unused
+ *
+ * @retval      void
+ */
+static void Radar_occupancy_task(void* pvParameters)
+{
+    while (1)
+    {
+        const Radar_sweep_t* sweep;
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);    /* wait for a published sweep */
+        sweep = Radar_sweep_acquire_latest();
+        if (sweep == NULL)
+            continue;
+        xSemaphoreTake(g_occupancy_mutex, portMAX_DELAY);
+        Occupancy_grid_update(&g_occupancy_grid, sweep);
+        xSemaphoreGive(g_occupancy_mutex);
+        Radar_sweep_release(sweep);
+    }
+}
+#endif
+
+/**
+ * @brief       Allocate the grid, in PSRAM when there is some, start the occupancy task and subscribe to sweeps
+ * @param       void
+ *
+ * @retval      ESP_OK                  : success
+ * @retval      ESP_ERR_NOT_SUPPORTED   : occupancy grid disabled in menuconfig
+ * @retval      ESP_ERR_NO_MEM          : out of memory
+ * @retval      ESP_ERR_INVALID_ARG     : grid configuration error
+ */
+esp_err_t Radar_occupancy_init(void)
+{
+#ifdef CONFIG_RADAR_OCCUPANCY_GRID
+    const Occupancy_grid_config_t config = {
+        .resolution_mm = CONFIG_RADAR_OCCUPANCY_RESOLUTION_MM,
+        .width         = RADAR_OCCUPANCY_WIDTH,
+        .height        = RADAR_OCCUPANCY_HEIGHT,
+        .origin_x      = RADAR_OCCUPANCY_WIDTH / 2,  /* sensor at the centre */
+        .origin_y      = RADAR_OCCUPANCY_HEIGHT / 2,
+    };
+    size_t size = Occupancy_grid_memory_size(&config);
+    void* memory;
+
+    memory = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (memory == NULL)
+        memory = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (memory == NULL)
+        return ESP_ERR_NO_MEM;
+
+    if (Occupancy_grid_init(&g_occupancy_grid, &config, memory) != OCCUPANCY_EOK)
+    {
+        heap_caps_free(memory);
+        return ESP_ERR_INVALID_ARG;
+    }
+    g_occupancy_mutex = xSemaphoreCreateMutex();
+    if (g_occupancy_mutex == NULL)
+    {
+        heap_caps_free(memory);
+        return ESP_ERR_NO_MEM;
+    }
+    /* lowest priority above idle, ray casting must never delay a scan step */
+    if (xTaskCreatePinnedToCore(Radar_occupancy_task, "occupancy", OCCUPANCY_TASK_STACK, NULL,
+                                tskIDLE_PRIORITY + 1, &g_occupancy_task, tskNO_AFFINITY) != pdPASS)
+    {
+        vSemaphoreDelete(g_occupancy_mutex);
+        g_occupancy_mutex = NULL;
+        heap_caps_free(memory);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "[%ux%u cells, %u bytes]", (unsigned)config.width, (unsigned)config.height, (unsigned)size);
+    return Radar_sweep_register_consumer(Radar_occupancy_on_publish);
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       Encode the grid information
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : grid disabled or buf too small
+ * @retval      other : encoded length
+ */
+size_t Radar_occupancy_encode_info(uint8_t* buf, size_t capacity)
+{
+    const Occupancy_grid_config_t* config = &g_occupancy_grid.config;
+    uint32_t version;
+
+    if ((g_occupancy_mutex == NULL) || (capacity < RADAR_OCCUPANCY_INFO_LEN))
+        return 0;
+
+    xSemaphoreTake(g_occupancy_mutex, portMAX_DELAY);
+    version = g_occupancy_grid.version;
+    xSemaphoreGive(g_occupancy_mutex);
+
+    buf[0]  = (uint8_t)(version >> 24);
+    buf[1]  = (uint8_t)(version >> 16);
+    buf[2]  = (uint8_t)(version >> 8);
+    buf[3]  = (uint8_t)(version & 0xFF);
+    buf[4]  = (uint8_t)(config->resolution_mm >> 8);
+    buf[5]  = (uint8_t)(config->resolution_mm & 0xFF);
+    buf[6]  = (uint8_t)(config->width >> 8);
+    buf[7]  = (uint8_t)(config->width & 0xFF);
+    buf[8]  = (uint8_t)(config->height >> 8);
+    buf[9]  = (uint8_t)(config->height & 0xFF);
+    buf[10] = (uint8_t)(config->origin_x >> 8);
+    buf[11] = (uint8_t)(config->origin_x & 0xFF);
+    buf[12] = (uint8_t)(config->origin_y >> 8);
+    buf[13] = (uint8_t)(config->origin_y & 0xFF);
+    buf[14] = OCCUPANCY_TILE_SIZE;
+    return RADAR_OCCUPANCY_INFO_LEN;
+}
+
+/**
+ * @brief       Encode the tiles changed after a version, as many as fit in buf
+ * @param       since_version : last grid version the host has, 0 for the whole grid
+ * @param       start_tile    : first tile to look at, next_tile of the previous reply
+ * @param       buf           : destination
+ * @param       capacity      : size of buf
+ *
+ * @retval      0     : grid disabled or buf too small
+ * @retval      other : encoded length
+ */
+size_t Radar_occupancy_encode_delta(uint32_t since_version, uint16_t start_tile,
+                                    uint8_t* buf, size_t capacity)
+{
+    uint16_t tiles = g_occupancy_grid.tiles_x * g_occupancy_grid.tiles_y;
+    uint16_t next_tile = start_tile;
+    uint32_t version;
+    size_t len;
+
+    if ((g_occupancy_mutex == NULL) || (capacity < RADAR_OCCUPANCY_DELTA_HEAD_LEN))
+        return 0;
+
+    xSemaphoreTake(g_occupancy_mutex, portMAX_DELAY);
+    version = g_occupancy_grid.version;
+    len = Occupancy_grid_encode_tiles(&g_occupancy_grid, since_version, &next_tile,
+                                      &buf[RADAR_OCCUPANCY_DELTA_HEAD_LEN], capacity - RADAR_OCCUPANCY_DELTA_HEAD_LEN);
+    xSemaphoreGive(g_occupancy_mutex);
+
+    if (next_tile >= tiles)
+        next_tile = RADAR_OCCUPANCY_LAST_TILE;
+    buf[0] = (uint8_t)(version >> 24);
+    buf[1] = (uint8_t)(version >> 16);
+    buf[2] = (uint8_t)(version >> 8);
+    buf[3] = (uint8_t)(version & 0xFF);
+    buf[4] = (uint8_t)(next_tile >> 8);
+    buf[5] = (uint8_t)(next_tile & 0xFF);
+    buf[6] = (uint8_t)(len / (2 + OCCUPANCY_TILE_CELLS));
+    return RADAR_OCCUPANCY_DELTA_HEAD_LEN + len;
+}
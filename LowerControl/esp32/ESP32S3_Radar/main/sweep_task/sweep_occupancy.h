@@ -0,0 +1,26 @@
+#ifndef _SWEEP_OCCUPANCY_H_
+#define _SWEEP_OCCUPANCY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Grid information, all fields high byte first:
+ * version(4) resolution_mm(2) width(2) height(2) origin_x(2) origin_y(2) tile_size(1)
+ */
+#define RADAR_OCCUPANCY_INFO_LEN    15
+
+/*
+ * Tile delta head, followed by tile_num tiles (see Occupancy_grid_encode_tiles):
+ * version(4) next_tile(2) tile_num(1), next_tile is RADAR_OCCUPANCY_LAST_TILE once every tile was looked at
+ */
+#define RADAR_OCCUPANCY_DELTA_HEAD_LEN  7
+#define RADAR_OCCUPANCY_LAST_TILE   0xFFFF
+
+esp_err_t Radar_occupancy_init(void); /* allocate the grid and subscribe to sweeps */
+size_t Radar_occupancy_encode_info(uint8_t* buf, size_t capacity); /* grid information */
+size_t Radar_occupancy_encode_delta(uint32_t since_version, uint16_t start_tile,
+                                    uint8_t* buf, size_t capacity); /* tiles changed after a version */
+
+#endif
@@ -0,0 +1,397 @@
+#include <math.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#include "sweep_output.h"
+#include "sweep_cartesian.h"
+#include "sweep_change.h"
+#include "sweep_codec.h"
+
+#define RADAR_OUTPUT_CONVERT_MAX    64  /* Cartesian points converted per page */
+#define RADAR_OUTPUT_DEG_TO_RAD     (3.14159265358979f / 180.0f)
+
+static const char *TAG = "RadarOutput";
+
+static uint8_t g_output_format[RADAR_OUTPUT_CHANNEL_NUM];  /* Sweep format of each channel */
+static uint32_t g_output_interval[RADAR_OUTPUT_CHANNEL_NUM]; /* Minimum time between two sweeps of each channel (ms) */
+static Sweep_change_t g_output_change[RADAR_OUTPUT_CHANNEL_NUM]; /* What the receiver of each channel holds, only used by its encoding task */
+static bool g_output_change_reset[RADAR_OUTPUT_CHANNEL_NUM]; /* Restart from a keyframe before the next delta encode */
+static Sweep_cartesian_table_t g_cartesian_table;           /* Shared by all channels */
+static SemaphoreHandle_t g_cartesian_mutex = NULL;          /* Protects the table and the conversion buffer */
+static union {
+    Sweep_point_xy_t xy[RADAR_OUTPUT_CONVERT_MAX];
+    Sweep_point_xyz_t xyz[RADAR_OUTPUT_CONVERT_MAX];
+} g_cartesian_points;                                       /* Points of the page being encoded */
+static struct {
+    uint32_t sequence;
+    uint8_t page;
+    uint16_t next_bin;
+} g_compact_cursor[RADAR_OUTPUT_CHANNEL_NUM];               /* Where the last compact page of each channel ended */
+
+/**
+ * @brief       Size of one point on the wire
+ * @param       format : sweep format
+ *
+ * @retval      bytes per point
+ */
+static size_t Radar_output_point_size(uint8_t format)
+{
+    switch (format)
+    {
+        case RADAR_SWEEP_FORMAT_CARTESIAN_XY:
+        case RADAR_SWEEP_FORMAT_LASERSCAN:
+            return 4;
+        case RADAR_SWEEP_FORMAT_CARTESIAN_XYZ:
+            return 6;
+        case RADAR_SWEEP_FORMAT_POLAR:
+        default:
+            return 2;
+    }
+}
+
+/**
+ * @brief       Size of the header of a fixed-size page
+ * @param       format : sweep format
+ *
+ * @retval      bytes before the first point
+ */
+static size_t Radar_output_head_len(uint8_t format)
+{
+    if (format == RADAR_SWEEP_FORMAT_LASERSCAN)
+        return RADAR_OUTPUT_PAGE_HEAD_LEN + RADAR_OUTPUT_LASERSCAN_HEAD_LEN;
+    return RADAR_OUTPUT_PAGE_HEAD_LEN;
+}
+
+/**
+ * @brief       Write a 16-bit value, high byte first
+ * @param       buf   : destination
+ * @param       value : value to write
+ *
+ * @retval      void
+ */
+static inline void Radar_output_put_u16(uint8_t* buf, uint16_t value)
+{
+    buf[0] = (uint8_t)(value >> 8);
+    buf[1] = (uint8_t)(value & 0xFF);
+}
+
+/**
+ * @brief       Write a float32, low byte first, as a LaserScan host holds it
+ * @param       buf   : destination
+ * @param       value : value to write
+ *
+ * @retval      void
+ */
+static inline void Radar_output_put_f32le(uint8_t* buf, float value)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    buf[0] = (uint8_t)(bits & 0xFF);
+    buf[1] = (uint8_t)(bits >> 8);
+    buf[2] = (uint8_t)(bits >> 16);
+    buf[3] = (uint8_t)(bits >> 24);
+}
+
+/**
+ * @brief       Write the LaserScan fields of a sweep, see sweep_output.h
+ *              The timing is the one measured for this sweep: time_increment spreads duration_us over the bins,
+ *              scan_time is the time since the previous sweep started
+ * @param       sweep : sweep to describe
+ * @param       buf   : destination, RADAR_OUTPUT_LASERSCAN_HEAD_LEN bytes
+ *
+ * @retval      void
+ */
+static void Radar_output_encode_laserscan_head(const Radar_sweep_t* sweep, uint8_t* buf)
+{
+    float angle_min = ((float)sweep->start_angle - CONFIG_STEERING_ANGLE_SCOPE / 2.0f) * RADAR_OUTPUT_DEG_TO_RAD;
+    float angle_increment = (float)sweep->step * RADAR_OUTPUT_DEG_TO_RAD;
+    float time_increment = 0.0f;
+
+    if (sweep->count > 1)
+        time_increment = (float)sweep->duration_us * 1e-6f / (float)(sweep->count - 1);
+    if (!sweep->direction)
+        time_increment = -time_increment;   /* bin 0 was measured last */
+
+    Radar_output_put_f32le(&buf[0], angle_min);
+    Radar_output_put_f32le(&buf[4], angle_min + angle_increment * (float)(sweep->count ? sweep->count - 1 : 0));
+    Radar_output_put_f32le(&buf[8], angle_increment);
+    Radar_output_put_f32le(&buf[12], time_increment);
+    Radar_output_put_f32le(&buf[16], (float)sweep->period_us * 1e-6f);
+    Radar_output_put_f32le(&buf[20], CONFIG_RADAR_LASERSCAN_RANGE_MIN_MM * 1e-3f);
+    Radar_output_put_f32le(&buf[24], CONFIG_RADAR_LASERSCAN_RANGE_MAX_MM * 1e-3f);
+}
+
+/**
+ * @brief       Encode one compact page
+ *              Compact pages hold a variable number of bins, so the first bin of a page is only known
+ *              once the pages before it are encoded; the cursor makes reading pages in order cost one encode each
+ * @param       channel  : output channel
+ * @param       sweep    : sweep to encode
+ * @param       page     : page index
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : page does not exist or buf is too small
+ * @retval      other : encoded length
+ */
+static size_t Radar_output_encode_compact(uint8_t channel, const Radar_sweep_t* sweep, uint8_t page,
+                                          uint8_t* buf, size_t capacity)
+{
+    uint16_t bin = 0;
+    uint8_t index = 0;
+    size_t len = 0;
+
+    if ((g_compact_cursor[channel].sequence == sweep->sequence) && (page != 0) &&
+        (g_compact_cursor[channel].page == page - 1))
+    {
+        bin = g_compact_cursor[channel].next_bin;
+        index = page;
+    }
+    for (; index <= page; index++)
+    {
+        if ((bin >= sweep->count) && !((bin == 0) && (index == 0)))
+            return 0;
+        len = Sweep_codec_encode(sweep, &bin, buf, capacity);
+        if (len == 0)
+            return 0;
+    }
+    g_compact_cursor[channel].sequence = sweep->sequence;
+    g_compact_cursor[channel].page = page;
+    g_compact_cursor[channel].next_bin = bin;
+    return len;
+}
+
+/**
+ * @brief       init output formats, every channel starts in polar format without rate limit
+ * @param       void
+ *
+ * @retval      ESP_OK      : success
+ * @retval      ESP_FAIL    : mutex create fail
+ */
+esp_err_t Radar_output_init(void)
+{
+    if (g_cartesian_mutex == NULL)
+        g_cartesian_mutex = xSemaphoreCreateMutex();
+    if (g_cartesian_mutex == NULL)
+        return ESP_FAIL;
+    memset(g_output_format, RADAR_SWEEP_FORMAT_POLAR, sizeof(g_output_format));
+    memset(g_output_interval, 0, sizeof(g_output_interval));
+    for (int i = 0; i < RADAR_OUTPUT_CHANNEL_NUM; i++)
+    {
+        Sweep_change_init(&g_output_change[i], CONFIG_RADAR_CHANGE_TOLERANCE_MM, CONFIG_RADAR_CHANGE_KEYFRAME_INTERVAL);
+        g_output_change_reset[i] = false;
+    }
+    ESP_LOGI(TAG, "[init done!]");
+    return ESP_OK;
+}
+
+/**
+ * @brief       Select the sweep format of a channel
+ *              Any task may call it: selecting the delta format only marks the change detector for a reset,
+ *              which the task encoding the channel applies before its next frame
+ * @param       channel : output channel
+ * @param       format  : sweep format
+ *
+ * @retval      ESP_OK              : success
+ * @retval      ESP_ERR_INVALID_ARG : channel or format does not exist
+ */
+esp_err_t Radar_output_set_format(uint8_t channel, uint8_t format)
+{
+    if ((channel >= RADAR_OUTPUT_CHANNEL_NUM) || (format >= RADAR_SWEEP_FORMAT_NUM))
+        return ESP_ERR_INVALID_ARG;
+    if (format == RADAR_SWEEP_FORMAT_DELTA) /* the receiver starts from a keyframe */
+        __atomic_store_n(&g_output_change_reset[channel], true, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_output_format[channel], format, __ATOMIC_RELEASE); /* the reset is seen with the format */
+    return ESP_OK;
+}
+
+/**
+ * @brief       Get the sweep format of a channel
+ * @param       channel : output channel
+ *
+ * @retval      sweep format, polar for an unknown channel
+ */
+uint8_t Radar_output_get_format(uint8_t channel)
+{
+    if (channel >= RADAR_OUTPUT_CHANNEL_NUM)
+        return RADAR_SWEEP_FORMAT_POLAR;
+    return __atomic_load_n(&g_output_format[channel], __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief       Limit the sweep rate of a channel, for the channels that push sweeps
+ * @param       channel     : output channel
+ * @param       interval_ms : minimum time between two sweeps, 0 for every sweep
+ *
+ * @retval      ESP_OK              : success
+ * @retval      ESP_ERR_INVALID_ARG : channel does not exist
+ */
+esp_err_t Radar_output_set_interval(uint8_t channel, uint32_t interval_ms)
+{
+    if (channel >= RADAR_OUTPUT_CHANNEL_NUM)
+        return ESP_ERR_INVALID_ARG;
+    g_output_interval[channel] = interval_ms;
+    return ESP_OK;
+}
+
+/**
+ * @brief       Get the minimum time between two sweeps of a channel
+ * @param       channel : output channel
+ *
+ * @retval      interval (ms), 0 for every sweep or an unknown channel
+ */
+uint32_t Radar_output_get_interval(uint8_t channel)
+{
+    if (channel >= RADAR_OUTPUT_CHANNEL_NUM)
+        return 0;
+    return g_output_interval[channel];
+}
+
+/**
+ * @brief       Write the header of one page and tell which bins it holds, for the fixed-size formats
+ *              A sender that references the points in place (polar LE) only needs this
+ * @param       channel  : output channel
+ * @param       sweep    : sweep to encode
+ * @param       page     : page index
+ * @param       capacity : size of the whole page, header included
+ * @param       buf      : destination of the header, RADAR_OUTPUT_PAGE_HEAD_LEN bytes
+ *                         (plus RADAR_OUTPUT_LASERSCAN_HEAD_LEN in LaserScan format)
+ * @param       first    : first bin of the page
+ * @param       num      : number of bins in the page
+ *
+ * @retval      0     : page does not exist, capacity is too small or the format has no fixed-size pages
+ * @retval      other : header length
+ */
+size_t Radar_output_encode_page_head(uint8_t channel, const Radar_sweep_t* sweep, uint8_t page, size_t capacity,
+                                     uint8_t* buf, uint16_t* first, uint16_t* num)
+{
+    uint8_t format = Radar_output_get_format(channel);
+    size_t point_size = Radar_output_point_size(format);
+    size_t head_len = Radar_output_head_len(format);
+    uint16_t per_page;
+    uint16_t page_count;
+
+    if ((format == RADAR_SWEEP_FORMAT_DELTA) || (format == RADAR_SWEEP_FORMAT_COMPACT))
+        return 0;
+    if (capacity < head_len + point_size)
+        return 0;
+    per_page = (capacity - head_len) / point_size;
+    if (per_page > UINT8_MAX)
+        per_page = UINT8_MAX;
+    if ((format == RADAR_SWEEP_FORMAT_CARTESIAN_XY || format == RADAR_SWEEP_FORMAT_CARTESIAN_XYZ) &&
+        (per_page > RADAR_OUTPUT_CONVERT_MAX))
+        per_page = RADAR_OUTPUT_CONVERT_MAX;
+    page_count = (sweep->count + per_page - 1) / per_page;
+    if ((page >= page_count) || (page_count > UINT8_MAX))
+        return 0;
+
+    *first = page * per_page;
+    *num = sweep->count - *first;
+    if (*num > per_page)
+        *num = per_page;
+
+    Radar_output_put_u16(&buf[0], (uint16_t)sweep->sequence);
+    buf[2] = page;
+    buf[3] = (uint8_t)page_count;
+    buf[4] = format;
+    Radar_output_put_u16(&buf[5], sweep->start_angle + *first * sweep->step);
+    buf[7] = sweep->step;
+    buf[8] = (uint8_t)*num;
+    if (format == RADAR_SWEEP_FORMAT_LASERSCAN)
+        Radar_output_encode_laserscan_head(sweep, &buf[RADAR_OUTPUT_PAGE_HEAD_LEN]);
+
+    return head_len;
+}
+
+/**
+ * @brief       Encode one page of a sweep in the format selected for the channel
+ *              In delta format the page index is ignored: each call continues the sweep
+ *              (see Sweep_change_encode), or sends the changes of a newer sweep.
+ *              In compact format pages hold as many bins as fit (see Sweep_codec_encode)
+ * @param       channel  : output channel
+ * @param       sweep    : sweep to encode
+ * @param       page     : page index
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : page does not exist or buf is too small
+ * @retval      other : encoded length
+ */
+size_t Radar_output_encode_page(uint8_t channel, const Radar_sweep_t* sweep, uint8_t page,
+                                uint8_t* buf, size_t capacity)
+{
+    uint8_t format = Radar_output_get_format(channel);
+    uint16_t first;
+    uint16_t num;
+    size_t head_len;
+    uint8_t* p;
+
+    if (format == RADAR_SWEEP_FORMAT_DELTA)
+    {
+        if (__atomic_exchange_n(&g_output_change_reset[channel], false, __ATOMIC_ACQUIRE))
+            Sweep_change_init(&g_output_change[channel], CONFIG_RADAR_CHANGE_TOLERANCE_MM,
+                              CONFIG_RADAR_CHANGE_KEYFRAME_INTERVAL);
+        return Sweep_change_encode(&g_output_change[channel], sweep, buf, capacity);
+    }
+    if (format == RADAR_SWEEP_FORMAT_COMPACT)
+        return Radar_output_encode_compact(channel, sweep, page, buf, capacity);
+
+    head_len = Radar_output_encode_page_head(channel, sweep, page, capacity, buf, &first, &num);
+    if (head_len == 0)
+        return 0;
+    p = &buf[head_len];
+
+    if (format == RADAR_SWEEP_FORMAT_LASERSCAN)
+    {
+        for (uint16_t i = 0; i < num; i++, p += 4)
+        {
+            uint16_t distance = sweep->distance[first + i];
+            Radar_output_put_f32le(p, (distance == RADAR_SWEEP_INVALID_DISTANCE) ? NAN : (float)distance * 1e-3f);
+        }
+    }
+    else if (format == RADAR_SWEEP_FORMAT_POLAR_LE)
+    {
+        for (uint16_t i = 0; i < num; i++, p += 2)
+        {
+            p[0] = (uint8_t)(sweep->distance[first + i] & 0xFF);
+            p[1] = (uint8_t)(sweep->distance[first + i] >> 8);
+        }
+    }
+    else if (format == RADAR_SWEEP_FORMAT_POLAR)
+    {
+        for (uint16_t i = 0; i < num; i++, p += 2)
+            Radar_output_put_u16(p, sweep->distance[first + i]);
+    }
+    else
+    {
+        xSemaphoreTake(g_cartesian_mutex, portMAX_DELAY);
+        if (format == RADAR_SWEEP_FORMAT_CARTESIAN_XY)
+        {
+            Sweep_cartesian_to_xy(&g_cartesian_table, sweep, first, num, g_cartesian_points.xy);
+            for (uint16_t i = 0; i < num; i++, p += 4)
+            {
+                Radar_output_put_u16(p, (uint16_t)g_cartesian_points.xy[i].x);
+                Radar_output_put_u16(p + 2, (uint16_t)g_cartesian_points.xy[i].y);
+            }
+        }
+        else
+        {
+            Sweep_cartesian_to_xyz(&g_cartesian_table, sweep, first, num, g_cartesian_points.xyz);
+            for (uint16_t i = 0; i < num; i++, p += 6)
+            {
+                Radar_output_put_u16(p, (uint16_t)g_cartesian_points.xyz[i].x);
+                Radar_output_put_u16(p + 2, (uint16_t)g_cartesian_points.xyz[i].y);
+                Radar_output_put_u16(p + 4, (uint16_t)g_cartesian_points.xyz[i].z);
+            }
+        }
+        xSemaphoreGive(g_cartesian_mutex);
+    }
+
+    return (size_t)(p - buf);
+}
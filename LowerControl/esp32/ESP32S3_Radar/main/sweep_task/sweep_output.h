@@ -0,0 +1,45 @@
+#ifndef _SWEEP_OUTPUT_H_
+#define _SWEEP_OUTPUT_H_
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#include "radar_sweep.h"
+
+/* Output channels, each one selects its own sweep format */
+enum
+{
+    RADAR_OUTPUT_CHANNEL_UART       = 0x00, /* Modbus host UART */
+    RADAR_OUTPUT_CHANNEL_UDP        = 0x01, /* WiFi streaming */
+    RADAR_OUTPUT_CHANNEL_CLIENT     = 0x02, /* First scan server client, one channel per client */
+    RADAR_OUTPUT_CHANNEL_NUM        = RADAR_OUTPUT_CHANNEL_CLIENT + CONFIG_RADAR_SERVER_CLIENT_MAX,
+};
+
+/*
+ * Sweep page, all fields high byte first:
+ * sequence(2) page(1) page_count(1) format(1) first_angle(2) step(1) point_num(1) points...
+ * The delta format uses the frame of sweep_change.h instead, the compact format the frame of sweep_codec.h
+ */
+#define RADAR_OUTPUT_PAGE_HEAD_LEN  9
+
+/*
+ * LaserScan page: the page header, then the sensor_msgs/LaserScan fields of the whole sweep and the
+ * ranges of the page, every value a little-endian IEEE-754 float32 that a host copies as is:
+ * angle_min angle_max angle_increment time_increment scan_time range_min range_max (rad, s, m) ranges... (m)
+ * Angles are centred on the middle of CONFIG_STEERING_ANGLE_SCOPE; time_increment is negative for sweeps
+ * scanned from maximum to minimum angle; a failed measurement is a NaN range.
+ */
+#define RADAR_OUTPUT_LASERSCAN_HEAD_LEN 28
+
+esp_err_t Radar_output_init(void); /* init output formats */
+esp_err_t Radar_output_set_format(uint8_t channel, uint8_t format); /* select the sweep format of a channel */
+uint8_t Radar_output_get_format(uint8_t channel); /* get the sweep format of a channel */
+esp_err_t Radar_output_set_interval(uint8_t channel, uint32_t interval_ms); /* limit the sweep rate of a channel */
+uint32_t Radar_output_get_interval(uint8_t channel); /* get the minimum time between two sweeps of a channel */
+size_t Radar_output_encode_page_head(uint8_t channel, const Radar_sweep_t* sweep, uint8_t page, size_t capacity,
+                                     uint8_t* buf, uint16_t* first, uint16_t* num); /* header of one fixed-size page */
+size_t Radar_output_encode_page(uint8_t channel, const Radar_sweep_t* sweep, uint8_t page,
+                                uint8_t* buf, size_t capacity); /* encode one page of a sweep */
+
+#endif
@@ -0,0 +1,251 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include "sweep_publish.h"
+#include "radar_counters.h"
+#include "radar_trace.h"
+
+static const char *TAG = "RadarSweep";
+
+typedef struct {
+    Radar_sweep_t sweep;    /* Must stay the first member, readers get its address */
+    uint8_t refcount;       /* Number of readers holding this buffer */
+} Radar_sweep_buffer_t;
+
+static Radar_sweep_buffer_t g_sweep_pool[RADAR_SWEEP_BUFFER_NUM];
+static Radar_sweep_buffer_t* g_sweep_filling = NULL;    /* Written by the steering task only */
+static Radar_sweep_buffer_t* g_sweep_latest = NULL;     /* Last published sweep */
+static uint32_t g_sweep_sequence = 0;
+static int64_t g_sweep_last_timestamp = 0;              /* First sample of the last published sweep */
+static portMUX_TYPE g_sweep_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static pRadar_sweep_Consumer_t g_sweep_consumer[RADAR_SWEEP_CONSUMER_MAX];
+static uint8_t g_sweep_consumer_num = 0;
+static pRadar_sweep_Sample_t g_sweep_sample[RADAR_SWEEP_CONSUMER_MAX];
+static uint8_t g_sweep_sample_num = 0;
+
+/**
+ * @brief       init sweep buffers
+ * @param       void
+ *
+ * @retval      ESP_OK
+ */
+esp_err_t Radar_sweep_init(void)
+{
+    memset(g_sweep_pool, 0, sizeof(g_sweep_pool));
+    g_sweep_filling = NULL;
+    g_sweep_latest = NULL;
+    ESP_LOGI(TAG, "[init done!]");
+    return ESP_OK;
+}
+
+/**
+ * @brief       Register a function called each time a sweep is published
+ *              Must be called before the steering task runs
+ * @param       consumer : publish callback
+ *
+ * @retval      ESP_OK          : success
+ * @retval      ESP_ERR_NO_MEM  : too many consumers
+ */
+esp_err_t Radar_sweep_register_consumer(pRadar_sweep_Consumer_t consumer)
+{
+    if (g_sweep_consumer_num >= RADAR_SWEEP_CONSUMER_MAX)
+        return ESP_ERR_NO_MEM;
+    g_sweep_consumer[g_sweep_consumer_num++] = consumer;
+    return ESP_OK;
+}
+
+/**
+ * @brief       Register a function called for every sample stored in the sweep being filled
+ *              Must be called before the steering task runs
+ * @param       sample : sample callback
+ *
+ * @retval      ESP_OK          : success
+ * @retval      ESP_ERR_NO_MEM  : too many callbacks
+ */
+esp_err_t Radar_sweep_register_sample(pRadar_sweep_Sample_t sample)
+{
+    if (g_sweep_sample_num >= RADAR_SWEEP_CONSUMER_MAX)
+        return ESP_ERR_NO_MEM;
+    g_sweep_sample[g_sweep_sample_num++] = sample;
+    return ESP_OK;
+}
+
+/**
+ * @brief       Start filling a new sweep, an unpublished sweep is discarded
+ * @param       scope       : angle scope of the pan servo (°)
+ * @param       step        : scan step (°)
+ * @param       direction   : true when scanning from minimum to maximum angle
+ * @param       tilt_angle  : tilt servo elevation (°)
+ *
+ * @retval      ESP_OK          : success
+ * @retval      ESP_ERR_NO_MEM  : every buffer is held by a reader
+ */
+esp_err_t Radar_sweep_begin(uint16_t scope, uint8_t step, bool direction, int16_t tilt_angle)
+{
+    Radar_sweep_buffer_t* pbuffer = g_sweep_filling;
+
+    if (step == 0)
+        step = 1;
+
+    if (pbuffer == NULL)
+    {
+        taskENTER_CRITICAL(&g_sweep_lock);
+        for (int i = 0; i < RADAR_SWEEP_BUFFER_NUM; i++)
+        {
+            if ((&g_sweep_pool[i] != g_sweep_latest) && (g_sweep_pool[i].refcount == 0))
+            {
+                pbuffer = &g_sweep_pool[i];
+                break;
+            }
+        }
+        taskEXIT_CRITICAL(&g_sweep_lock);
+        if (pbuffer == NULL)
+        {
+            Radar_counter_inc(RADAR_COUNTER_SWEEP_DROPPED);
+            return ESP_ERR_NO_MEM;
+        }
+        g_sweep_filling = pbuffer;
+    }
+
+    pbuffer->sweep.timestamp_us = 0;
+    pbuffer->sweep.duration_us  = 0;
+    pbuffer->sweep.period_us    = 0;
+    pbuffer->sweep.start_angle  = 0;
+    pbuffer->sweep.step         = step;
+    pbuffer->sweep.direction    = direction;
+    pbuffer->sweep.tilt_angle   = tilt_angle;
+    pbuffer->sweep.count        = (scope + step - 1) / step + 1;
+    if (pbuffer->sweep.count > RADAR_SWEEP_POINT_MAX)
+        pbuffer->sweep.count = RADAR_SWEEP_POINT_MAX;
+    memset(pbuffer->sweep.distance, 0, sizeof(pbuffer->sweep.distance)); /* RADAR_SWEEP_INVALID_DISTANCE */
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       Store one sample in the sweep being filled
+ * @param       angle    : pan servo angle (°)
+ * @param       distance : measured distance (mm)
+ *
+ * @retval      void
+ */
+void Radar_sweep_add_point(uint16_t angle, uint16_t distance)
+{
+    Radar_sweep_t* psweep;
+    uint16_t bin;
+    int64_t now = esp_timer_get_time();
+
+    if (g_sweep_filling == NULL)
+    {
+        Radar_counter_inc(RADAR_COUNTER_POINT_DROPPED);
+        return;
+    }
+    psweep = &g_sweep_filling->sweep;
+
+    /* The last angle may not be a multiple of the step, round up so it gets its own bin */
+    bin = (angle - psweep->start_angle + psweep->step - 1) / psweep->step;
+    if (bin >= psweep->count)
+    {
+        Radar_counter_inc(RADAR_COUNTER_POINT_DROPPED);
+        return;
+    }
+
+    if (psweep->timestamp_us == 0)
+        psweep->timestamp_us = now;
+    psweep->duration_us = (uint32_t)(now - psweep->timestamp_us);
+    psweep->distance[bin] = distance;
+
+    for (int i = 0; i < g_sweep_sample_num; i++)
+        g_sweep_sample[i](psweep, bin);
+}
+
+/**
+ * @brief       Publish the sweep being filled and call every consumer
+ * @param       void
+ *
+ * @retval      void
+ */
+void Radar_sweep_publish(void)
+{
+    Radar_sweep_buffer_t* pbuffer = g_sweep_filling;
+
+    if ((pbuffer == NULL) || (pbuffer->sweep.timestamp_us == 0))
+        return; /* nothing measured */
+
+    pbuffer->sweep.sequence = ++g_sweep_sequence;
+    Radar_counter_inc(RADAR_COUNTER_SWEEP_COMPLETE);
+    Radar_trace(RADAR_TRACE_SWEEP_PUBLISH, pbuffer->sweep.count, pbuffer->sweep.sequence);
+    if ((g_sweep_last_timestamp != 0) && (pbuffer->sweep.timestamp_us - g_sweep_last_timestamp <= UINT32_MAX))
+        pbuffer->sweep.period_us = (uint32_t)(pbuffer->sweep.timestamp_us - g_sweep_last_timestamp);
+    g_sweep_last_timestamp = pbuffer->sweep.timestamp_us;
+
+    taskENTER_CRITICAL(&g_sweep_lock);
+    g_sweep_latest = pbuffer;
+    g_sweep_filling = NULL;
+    taskEXIT_CRITICAL(&g_sweep_lock);
+
+    /* The latest buffer is only replaced by the next publish, which runs in this task */
+    for (int i = 0; i < g_sweep_consumer_num; i++)
+        g_sweep_consumer[i](&pbuffer->sweep);
+}
+
+/**
+ * @brief       Hold the latest sweep so that it is not reused while being read
+ * @param       void
+ *
+ * @retval      NULL  : no sweep published yet
+ * @retval      other : latest sweep, give it back with Radar_sweep_release
+ */
+const Radar_sweep_t* Radar_sweep_acquire_latest(void)
+{
+    Radar_sweep_buffer_t* pbuffer;
+
+    taskENTER_CRITICAL(&g_sweep_lock);
+    pbuffer = g_sweep_latest;
+    if (pbuffer)
+        pbuffer->refcount++;
+    taskEXIT_CRITICAL(&g_sweep_lock);
+
+    return pbuffer ? &pbuffer->sweep : NULL;
+}
+
+/**
+ * @brief       Take one more reference on a held sweep, for a reader that hands it over
+ *              to code completing later (e.g. a network driver)
+ * @param       sweep : sweep held by the caller
+ *
+ * @retval      void
+ */
+void Radar_sweep_retain(const Radar_sweep_t* sweep)
+{
+    Radar_sweep_buffer_t* pbuffer = (Radar_sweep_buffer_t*)sweep;
+
+    if (pbuffer == NULL)
+        return;
+    taskENTER_CRITICAL(&g_sweep_lock);
+    pbuffer->refcount++;
+    taskEXIT_CRITICAL(&g_sweep_lock);
+}
+
+/**
+ * @brief       Release a sweep obtained from Radar_sweep_acquire_latest or Radar_sweep_retain
+ * @param       sweep : held sweep
+ *
+ * @retval      void
+ */
+void Radar_sweep_release(const Radar_sweep_t* sweep)
+{
+    Radar_sweep_buffer_t* pbuffer = (Radar_sweep_buffer_t*)sweep;
+
+    if (pbuffer == NULL)
+        return;
+    taskENTER_CRITICAL(&g_sweep_lock);
+    if (pbuffer->refcount)
+        pbuffer->refcount--;
+    taskEXIT_CRITICAL(&g_sweep_lock);
+}
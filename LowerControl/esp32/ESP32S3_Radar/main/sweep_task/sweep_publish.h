@@ -0,0 +1,28 @@
+#ifndef _SWEEP_PUBLISH_H_
+#define _SWEEP_PUBLISH_H_
+
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#include "radar_sweep.h"
+
+#define RADAR_SWEEP_BUFFER_NUM      6   /* One being filled, one latest, two kept by the UDP retransmit window, the rest held by readers */
+#define RADAR_SWEEP_CONSUMER_MAX    8   /* Maximum number of publish callbacks */
+
+/* Called in the steering task each time a sweep is published, must not block */
+typedef void(* pRadar_sweep_Consumer_t)(const Radar_sweep_t* sweep);
+/* Called in the steering task for every sample stored in the sweep being filled, must not block */
+typedef void(* pRadar_sweep_Sample_t)(const Radar_sweep_t* sweep, uint16_t bin);
+
+esp_err_t Radar_sweep_init(void); /* init sweep buffers */
+esp_err_t Radar_sweep_register_consumer(pRadar_sweep_Consumer_t consumer); /* register a publish callback */
+esp_err_t Radar_sweep_register_sample(pRadar_sweep_Sample_t sample); /* register a sample callback */
+esp_err_t Radar_sweep_begin(uint16_t scope, uint8_t step, bool direction, int16_t tilt_angle); /* start filling a sweep */
+void Radar_sweep_add_point(uint16_t angle, uint16_t distance); /* store one sample in the sweep being filled */
+void Radar_sweep_publish(void); /* make the sweep being filled the latest one */
+const Radar_sweep_t* Radar_sweep_acquire_latest(void); /* hold the latest sweep, NULL if none */
+void Radar_sweep_retain(const Radar_sweep_t* sweep); /* one more reference on a held sweep */
+void Radar_sweep_release(const Radar_sweep_t* sweep); /* release a held sweep */
+
+#endif
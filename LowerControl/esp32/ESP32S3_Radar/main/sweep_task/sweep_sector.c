@@ -0,0 +1,211 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include "radar_counters.h"
+#include "sweep_publish.h"
+#include "sweep_sector.h"
+
+#define RADAR_SECTOR_EVENT_QUEUE_LEN    8   /* Raised alarms waiting for Radar_sector_send_alarms */
+
+static const char *TAG = "RadarSector";
+
+typedef struct {
+    uint16_t angle_a;   /* Sector start (°) */
+    uint16_t angle_b;   /* Sector end (°), included */
+    uint16_t limit;     /* Distance limit (mm), 0 when the slot is free */
+    bool active;        /* The minimum is below the limit, re-armed once it rises above */
+} Radar_sector_alarm_t;
+
+typedef struct {
+    uint8_t data[RADAR_SECTOR_EVENT_LEN];
+} Radar_sector_event_t;
+
+static Sweep_query_t g_sector_query;
+static Radar_sector_alarm_t g_sector_alarm[RADAR_SECTOR_ALARM_MAX];
+static portMUX_TYPE g_sector_lock = portMUX_INITIALIZER_UNLOCKED; /* Updated by the steering task, queried by the execution task */
+static QueueHandle_t g_sector_event_queue = NULL;
+static pRadar_sector_Alarm_t g_sector_alarm_fun = NULL;
+
+/**
+ * @brief       Write a 16-bit value, high byte first
+ */
+static inline void Radar_sector_put_u16(uint8_t* buf, uint16_t value)
+{
+    buf[0] = (uint8_t)(value >> 8);
+    buf[1] = (uint8_t)(value & 0xFF);
+}
+
+/**
+ * @brief       Check the alarms whose sector holds a bin, called inside the critical section
+ * @param       angle : angle of the updated bin (°)
+ * @param       event : filled with one event per alarm raised
+ *
+ * @retval      number of alarms raised
+ */
+static uint8_t Radar_sector_check_alarm(uint16_t angle, Radar_sector_event_t* event)
+{
+    Sweep_query_result_t result;
+    uint8_t raised = 0;
+
+    for (uint8_t slot = 0; slot < RADAR_SECTOR_ALARM_MAX; slot++)
+    {
+        Radar_sector_alarm_t* palarm = &g_sector_alarm[slot];
+
+        if ((palarm->limit == 0) || (angle < palarm->angle_a) || (angle > palarm->angle_b))
+            continue;
+        if (Sweep_query_sector(&g_sector_query, palarm->angle_a, palarm->angle_b, &result) != SWEEP_QUERY_EOK)
+            continue;
+
+        if (result.valid && (result.min < palarm->limit))
+        {
+            if (!palarm->active)
+            {
+                palarm->active = true;
+                event[raised].data[0] = slot;
+                Radar_sector_put_u16(&event[raised].data[1], result.min);
+                Radar_sector_put_u16(&event[raised].data[3], result.argmin);
+                raised++;
+            }
+        }
+        else
+        {
+            palarm->active = false;
+        }
+    }
+    return raised;
+}
+
+/**
+ * @brief       Sample consumer, keeps the tree on the latest sample of every bin
+ *              Runs in the steering task and never blocks: raised alarms are queued for
+ *              Radar_sector_send_alarms, dropped and counted when the queue is full
+ * @param       sweep : sweep being filled
+ * @param       bin   : bin just stored
+ *
+ * @retval      void
+ */
+static void Radar_sector_sample(const Radar_sweep_t* sweep, uint16_t bin)
+{
+    Radar_sector_event_t event[RADAR_SECTOR_ALARM_MAX];
+    uint8_t raised;
+
+    taskENTER_CRITICAL(&g_sector_lock);
+    if ((g_sector_query.start_angle != sweep->start_angle) || (g_sector_query.step != sweep->step) ||
+        (g_sector_query.count != sweep->count))
+        Sweep_query_init(&g_sector_query, sweep->start_angle, sweep->step, sweep->count); /* scan step changed */
+    Sweep_query_update(&g_sector_query, bin, sweep->distance[bin]);
+    raised = Radar_sector_check_alarm(sweep->start_angle + bin * sweep->step, event);
+    taskEXIT_CRITICAL(&g_sector_lock);
+
+    for (uint8_t i = 0; i < raised; i++)
+    {
+        if (xQueueSend(g_sector_event_queue, &event[i], 0) != pdTRUE)
+            Radar_counter_inc(RADAR_COUNTER_SECTOR_ALARM_DROPPED);
+    }
+}
+
+/**
+ * @brief       Send the queued alarm events, in the task that owns the host links
+ * @param       void
+ *
+ * @retval      number of events sent
+ */
+uint8_t Radar_sector_send_alarms(void)
+{
+    Radar_sector_event_t event;
+    uint8_t sent = 0;
+
+    if (g_sector_event_queue == NULL)
+        return 0;
+    while (xQueueReceive(g_sector_event_queue, &event, 0) == pdTRUE)
+    {
+        if (g_sector_alarm_fun)
+            g_sector_alarm_fun(event.data, RADAR_SECTOR_EVENT_LEN);
+        sent++;
+    }
+    return sent;
+}
+
+/**
+ * @brief       Subscribe to samples
+ * @param       alarm_fun : sends an alarm event to the host, called by Radar_sector_send_alarms
+ *
+ * @retval      ESP_OK          : success
+ * @retval      ESP_ERR_NO_MEM  : out of memory
+ */
+esp_err_t Radar_sector_init(pRadar_sector_Alarm_t alarm_fun)
+{
+    g_sector_event_queue = xQueueCreate(RADAR_SECTOR_EVENT_QUEUE_LEN, sizeof(Radar_sector_event_t));
+    if (g_sector_event_queue == NULL)
+        return ESP_ERR_NO_MEM;
+    memset(g_sector_alarm, 0, sizeof(g_sector_alarm));
+    Sweep_query_init(&g_sector_query, 0, 1, 0);
+    g_sector_alarm_fun = alarm_fun;
+    ESP_LOGI(TAG, "[init done!]");
+    return Radar_sweep_register_sample(Radar_sector_sample);
+}
+
+/**
+ * @brief       Minimum, argmin and mean distance in a sector, over the latest sample of every bin
+ * @param       angle_a : sector start (°)
+ * @param       angle_b : sector end (°), included
+ * @param       result  : answer
+ *
+ * @retval      ESP_OK              : success
+ * @retval      ESP_ERR_INVALID_ARG : no bin inside the sector
+ */
+esp_err_t Radar_sector_query(uint16_t angle_a, uint16_t angle_b, Sweep_query_result_t* result)
+{
+    uint8_t ret;
+
+    if (g_sector_event_queue == NULL)
+        return ESP_ERR_INVALID_STATE;
+    taskENTER_CRITICAL(&g_sector_lock);
+    ret = Sweep_query_sector(&g_sector_query, angle_a, angle_b, result);
+    taskEXIT_CRITICAL(&g_sector_lock);
+
+    return ret == SWEEP_QUERY_EOK ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+/**
+ * @brief       Set a threshold alarm, an event is sent each time the sector minimum drops below the limit
+ * @param       slot    : alarm slot
+ * @param       angle_a : sector start (°)
+ * @param       angle_b : sector end (°), included
+ * @param       limit   : distance limit (mm), 0 disables the slot
+ *
+ * @retval      ESP_OK              : success
+ * @retval      ESP_ERR_INVALID_ARG : slot does not exist or empty sector
+ */
+esp_err_t Radar_sector_set_alarm(uint8_t slot, uint16_t angle_a, uint16_t angle_b, uint16_t limit)
+{
+    if ((slot >= RADAR_SECTOR_ALARM_MAX) || (angle_b < angle_a) || (g_sector_event_queue == NULL))
+        return ESP_ERR_INVALID_ARG;
+
+    taskENTER_CRITICAL(&g_sector_lock);
+    g_sector_alarm[slot].angle_a = angle_a;
+    g_sector_alarm[slot].angle_b = angle_b;
+    g_sector_alarm[slot].limit = limit;
+    g_sector_alarm[slot].active = false;
+    taskEXIT_CRITICAL(&g_sector_lock);
+    return ESP_OK;
+}
+
+/**
+ * @brief       Encode a sector answer, RADAR_SECTOR_RESULT_LEN bytes
+ * @param       result : answer
+ * @param       buf    : destination
+ *
+ * @retval      void
+ */
+void Radar_sector_encode_result(const Sweep_query_result_t* result, uint8_t* buf)
+{
+    Radar_sector_put_u16(&buf[0], result->min);
+    Radar_sector_put_u16(&buf[2], result->argmin);
+    Radar_sector_put_u16(&buf[4], result->mean);
+    Radar_sector_put_u16(&buf[6], result->valid);
+}
@@ -0,0 +1,32 @@
+#ifndef _SWEEP_SECTOR_H_
+#define _SWEEP_SECTOR_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#include "sweep_query.h"
+
+#define RADAR_SECTOR_ALARM_MAX      4   /* Number of threshold alarms */
+
+/*
+ * Sector answer, all fields high byte first:
+ * min(2) argmin_angle(2) mean(2) valid(2)
+ */
+#define RADAR_SECTOR_RESULT_LEN     8
+
+/*
+ * Alarm event, all fields high byte first:
+ * slot(1) min(2) argmin_angle(2)
+ */
+#define RADAR_SECTOR_EVENT_LEN      5
+
+/* Called by Radar_sector_send_alarms for each time the minimum of an alarm sector dropped below its limit */
+typedef void(* pRadar_sector_Alarm_t)(const uint8_t* event, uint8_t len);
+
+esp_err_t Radar_sector_init(pRadar_sector_Alarm_t alarm_fun); /* subscribe to samples */
+uint8_t Radar_sector_send_alarms(void); /* send the queued alarm events */
+esp_err_t Radar_sector_query(uint16_t angle_a, uint16_t angle_b, Sweep_query_result_t* result); /* sector answer */
+esp_err_t Radar_sector_set_alarm(uint8_t slot, uint16_t angle_a, uint16_t angle_b, uint16_t limit); /* limit 0 disables */
+void Radar_sector_encode_result(const Sweep_query_result_t* result, uint8_t* buf); /* RADAR_SECTOR_RESULT_LEN bytes */
+
+#endif
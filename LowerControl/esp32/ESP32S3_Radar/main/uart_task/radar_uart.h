@@ -42,5 +42,6 @@ xRadar_UART_t* radar_UART_Find_by_Num(uart_port_t uart_num);/* find UART structu
 esp_err_t radar_UART_ChangeFunbyNum(uart_port_t uart_num, pRadar_UART_DataHand_t UART_DataHand);/* Change the processing function */
 
 void Radar_uart_default_receive_task(void *pvParameters);
+int64_t Radar_uart_event_time(uart_port_t uart_num); /* esp_timer time of the last data event of a port */
 
 #endif
\ No newline at end of file
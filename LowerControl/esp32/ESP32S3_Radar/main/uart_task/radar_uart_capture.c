@@ -0,0 +1,396 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "radar_uart.h"
+#include "radar_uart_capture.h"
+
+#define REPLAY_TASK_STACK       3072
+#define REPLAY_TIMEOUT_MS       1000    /* a port that takes longer for one event is not answering */
+
+#if CONFIG_RADAR_UART_CAPTURE
+#define CAPTURE_RING_MASK       (RADAR_CAPTURE_RING_LEN - 1)
+
+static Radar_capture_record_t g_capture_ring[RADAR_CAPTURE_RING_LEN];
+static uint32_t g_capture_head;
+#ifdef CONFIG_RADAR_UART_CAPTURE_AT_BOOT
+volatile bool g_radar_capture_enabled = true;
+#else
+volatile bool g_radar_capture_enabled = false;
+#endif
+
+static TaskHandle_t g_replay_task = NULL;
+static volatile bool g_replay_running = false;
+static bool g_replay_fast;
+static uart_port_t g_replay_port;               /* event being handed to a receive task */
+static size_t g_replay_len;
+static uint8_t g_replay_buf[RX_BUF_SIZE];
+static Radar_capture_replay_stats_t g_replay_stats;
+
+/**
+ * @brief       Write a 32-bit value, high byte first
+ */
+static inline void Radar_capture_put_u32(uint8_t* buf, uint32_t value)
+{
+    buf[0] = (uint8_t)(value >> 24);
+    buf[1] = (uint8_t)(value >> 16);
+    buf[2] = (uint8_t)(value >> 8);
+    buf[3] = (uint8_t)(value & 0xFF);
+}
+
+/**
+ * @brief       Record the bytes of one data event, see Radar_uart_capture
+ *              The records of an event are reserved with one atomic add, so the events of
+ *              two ports never interleave; an event longer than the ring keeps its start only
+ */
+void Radar_uart_capture_record(uart_port_t uart_num, const uint8_t* data, size_t size, int64_t time_us)
+{
+    uint32_t num = (uint32_t)((size + RADAR_CAPTURE_DATA_LEN - 1) / RADAR_CAPTURE_DATA_LEN);
+    uint32_t n;
+
+    if (num == 0)
+        return;
+    if (num > RADAR_CAPTURE_RING_LEN)
+        num = RADAR_CAPTURE_RING_LEN;
+    n = __atomic_fetch_add(&g_capture_head, num, __ATOMIC_RELAXED);
+    for (uint32_t i = 0; i < num; i++, n++)
+    {
+        Radar_capture_record_t* record = &g_capture_ring[n & CAPTURE_RING_MASK];
+        uint8_t len = (uint8_t)((size < RADAR_CAPTURE_DATA_LEN) ? size : RADAR_CAPTURE_DATA_LEN);
+
+        record->time_us = (uint32_t)time_us;
+        record->port    = (uint8_t)uart_num;
+        record->flags   = i ? RADAR_CAPTURE_FLAG_CONTINUED : 0;
+        record->len     = len;
+        memcpy(record->data, data, len);
+        data += len;
+        size -= len;
+    }
+}
+
+/**
+ * @brief       Wait for the recorded time of an event, to the tick
+ */
+static void Radar_uart_replay_wait(int64_t at_us)
+{
+    int64_t left = at_us - esp_timer_get_time();
+
+    if (left >= (int64_t)portTICK_PERIOD_MS * 1000)
+        vTaskDelay((TickType_t)(left / ((int64_t)portTICK_PERIOD_MS * 1000)));
+}
+
+/**
+ * @brief       Hand one event to the receive task of its port and wait until its handler is done
+ */
+static void Radar_uart_replay_event(uart_port_t uart_num, size_t len)
+{
+    xRadar_UART_t* uart = radar_UART_Find_by_Num(uart_num);
+    uart_event_t event = {
+        .type = RADAR_UART_REPLAY_DATA,
+        .size = len,
+    };
+
+    if ((uart == NULL) || (uart->pUart_queue == NULL) || (len == 0))
+    {
+        g_replay_stats.skipped++;
+        return;
+    }
+    g_replay_port = uart_num;
+    g_replay_len = len;
+    ulTaskNotifyTake(pdTRUE, 0);
+    if ((xQueueSend(*(uart->pUart_queue), &event, pdMS_TO_TICKS(REPLAY_TIMEOUT_MS)) != pdTRUE) ||
+        (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(REPLAY_TIMEOUT_MS)) == 0))
+        g_replay_stats.skipped++;
+}
+
+/**
+ * @brief       Replay task: the events of the ring oldest first, then it deletes itself
+ *              The oldest event may have lost its first records to the ring, it is skipped
+ */
+static void Radar_uart_replay_task(void* pvParameters)
+{
+    uint32_t head = __atomic_load_n(&g_capture_head, __ATOMIC_RELAXED);
+    uint32_t n = (head > RADAR_CAPTURE_RING_LEN) ? head - RADAR_CAPTURE_RING_LEN : 0;
+    int64_t start_us = esp_timer_get_time();
+    uint32_t first_us = 0;
+    bool first = true;
+
+    g_replay_task = xTaskGetCurrentTaskHandle();
+    while ((n != head) && (g_capture_ring[n & CAPTURE_RING_MASK].flags & RADAR_CAPTURE_FLAG_CONTINUED))
+        n++;
+    while (n != head)
+    {
+        const Radar_capture_record_t* record = &g_capture_ring[n & CAPTURE_RING_MASK];
+        uart_port_t uart_num = (uart_port_t)record->port;
+        uint32_t time_us = record->time_us;
+        size_t len = 0;
+
+        do
+        {
+            record = &g_capture_ring[n & CAPTURE_RING_MASK];
+            if (len + record->len <= sizeof(g_replay_buf))
+            {
+                memcpy(&g_replay_buf[len], record->data, record->len);
+                len += record->len;
+            }
+            n++;
+        } while ((n != head) && (g_capture_ring[n & CAPTURE_RING_MASK].flags & RADAR_CAPTURE_FLAG_CONTINUED));
+
+        if (!g_replay_fast)
+        {
+            if (first)
+                first_us = time_us;
+            Radar_uart_replay_wait(start_us + (uint32_t)(time_us - first_us));   /* 32-bit us wraps every 71 minutes */
+        }
+        first = false;
+        Radar_uart_replay_event(uart_num, len);
+    }
+    g_replay_task = NULL;
+    g_replay_running = false;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief       Start a replay of the ring, the capture is stopped first
+ */
+static bool Radar_uart_replay_start(bool fast)
+{
+    if (g_replay_running || (__atomic_load_n(&g_capture_head, __ATOMIC_RELAXED) == 0))
+        return false;
+    g_radar_capture_enabled = false;
+    g_replay_fast = fast;
+    memset(&g_replay_stats, 0, sizeof(g_replay_stats));
+    g_replay_running = true;
+    if (xTaskCreatePinnedToCore(Radar_uart_replay_task, "uart_replay", REPLAY_TASK_STACK, NULL,
+                                tskIDLE_PRIORITY + 2, NULL, tskNO_AFFINITY) != pdPASS)
+    {
+        g_replay_running = false;
+        return false;
+    }
+    return true;
+}
+#endif
+
+/**
+ * @brief       Stop, start, clear or replay the capture
+ *              Stopping does not wait for an event being recorded by another port task,
+ *              the newest record of a dump may be torn once in a while
+ * @param       cmd : RADAR_CAPTURE_CMD_xxx
+ *
+ * @retval      true  : done, or replay started
+ * @retval      false : unknown command, a replay running, nothing to replay, or capture compiled out
+ */
+bool Radar_uart_capture_command(uint8_t cmd)
+{
+#if CONFIG_RADAR_UART_CAPTURE
+    switch (cmd)
+    {
+        case RADAR_CAPTURE_CMD_STOP:
+            g_radar_capture_enabled = false;
+            return true;
+        case RADAR_CAPTURE_CMD_START:
+            if (g_replay_running)
+                return false;
+            g_radar_capture_enabled = true;
+            return true;
+        case RADAR_CAPTURE_CMD_CLEAR:
+            if (g_replay_running)
+                return false;
+            __atomic_store_n(&g_capture_head, 0, __ATOMIC_RELAXED);
+            memset(g_capture_ring, 0, sizeof(g_capture_ring));
+            return true;
+        case RADAR_CAPTURE_CMD_REPLAY:
+        case RADAR_CAPTURE_CMD_REPLAY_FAST:
+            return Radar_uart_replay_start(cmd == RADAR_CAPTURE_CMD_REPLAY_FAST);
+        default:
+            return false;
+    }
+#else
+    (void)cmd;
+    return false;
+#endif
+}
+
+/**
+ * @brief       Append one record, e.g. of a capture taken elsewhere, to replay it here
+ * @param       record : record as on the wire, see radar_uart_capture.h
+ * @param       len    : RADAR_CAPTURE_RECORD_LEN
+ *
+ * @retval      true  : appended
+ * @retval      false : bad record, capture or replay running, or capture compiled out
+ */
+bool Radar_uart_capture_load(const uint8_t* record, size_t len)
+{
+#if CONFIG_RADAR_UART_CAPTURE
+    Radar_capture_record_t* slot;
+
+    if ((len != RADAR_CAPTURE_RECORD_LEN) || (record[6] > RADAR_CAPTURE_DATA_LEN) ||
+        g_radar_capture_enabled || g_replay_running)
+        return false;
+    slot = &g_capture_ring[g_capture_head & CAPTURE_RING_MASK];
+    slot->time_us = ((uint32_t)record[0] << 24) | ((uint32_t)record[1] << 16) | ((uint32_t)record[2] << 8) | record[3];
+    slot->port    = record[4];
+    slot->flags   = record[5];
+    slot->len     = record[6];
+    memcpy(slot->data, &record[7], RADAR_CAPTURE_DATA_LEN);
+    __atomic_fetch_add(&g_capture_head, 1, __ATOMIC_RELAXED);
+    return true;
+#else
+    (void)record;
+    (void)len;
+    return false;
+#endif
+}
+
+/**
+ * @brief       Encode the capture information, see radar_uart_capture.h
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : capture compiled out or buf too small
+ * @retval      other : RADAR_CAPTURE_INFO_LEN
+ */
+size_t Radar_uart_capture_encode_info(uint8_t* buf, size_t capacity)
+{
+#if CONFIG_RADAR_UART_CAPTURE
+    if (capacity < RADAR_CAPTURE_INFO_LEN)
+        return 0;
+    buf[0] = g_radar_capture_enabled;
+    buf[1] = g_replay_running;
+    buf[2] = (uint8_t)(RADAR_CAPTURE_RING_LEN >> 8);
+    buf[3] = (uint8_t)(RADAR_CAPTURE_RING_LEN & 0xFF);
+    buf[4] = RADAR_CAPTURE_RECORD_LEN;
+    Radar_capture_put_u32(&buf[5], __atomic_load_n(&g_capture_head, __ATOMIC_RELAXED));
+    Radar_capture_put_u32(&buf[9], g_replay_stats.events);
+    Radar_capture_put_u32(&buf[13], g_replay_stats.bytes);
+    Radar_capture_put_u32(&buf[17], g_replay_stats.handler_us);
+    Radar_capture_put_u32(&buf[21], g_replay_stats.skipped);
+    return RADAR_CAPTURE_INFO_LEN;
+#else
+    (void)buf;
+    (void)capacity;
+    return 0;
+#endif
+}
+
+/**
+ * @brief       Encode records from slot first on, see radar_uart_capture.h
+ *              Read while the capture is stopped, or records may be overwritten during the dump
+ * @param       first    : first slot
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : capture compiled out, slot out of range, or buf too small
+ * @retval      other : encoded length
+ */
+size_t Radar_uart_capture_encode_page(uint16_t first, uint8_t* buf, size_t capacity)
+{
+#if CONFIG_RADAR_UART_CAPTURE
+    uint8_t* p = &buf[3];
+    uint8_t num = RADAR_CAPTURE_PAGE_RECORDS;
+
+    if ((first >= RADAR_CAPTURE_RING_LEN) || (capacity < RADAR_CAPTURE_PAGE_LEN))
+        return 0;
+    if (first + num > RADAR_CAPTURE_RING_LEN)
+        num = (uint8_t)(RADAR_CAPTURE_RING_LEN - first);
+
+    buf[0] = (uint8_t)(first >> 8);
+    buf[1] = (uint8_t)(first & 0xFF);
+    buf[2] = num;
+    for (uint8_t i = 0; i < num; i++, p += RADAR_CAPTURE_RECORD_LEN)
+    {
+        const Radar_capture_record_t* record = &g_capture_ring[first + i];
+
+        Radar_capture_put_u32(&p[0], record->time_us);
+        p[4] = record->port;
+        p[5] = record->flags;
+        p[6] = record->len;
+        memcpy(&p[7], record->data, RADAR_CAPTURE_DATA_LEN);
+    }
+    return 3 + num * RADAR_CAPTURE_RECORD_LEN;
+#else
+    (void)first;
+    (void)buf;
+    (void)capacity;
+    return 0;
+#endif
+}
+
+/**
+ * @brief       Whether a replay is running
+ */
+bool Radar_uart_replay_running(void)
+{
+#if CONFIG_RADAR_UART_CAPTURE
+    return g_replay_running;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief       Counters of the last replay, the running one included
+ * @param       stats : copied there
+ */
+void Radar_uart_replay_get_stats(Radar_capture_replay_stats_t* stats)
+{
+#if CONFIG_RADAR_UART_CAPTURE
+    *stats = g_replay_stats;
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+/**
+ * @brief       Bytes of the replayed event announced to a port, called by its receive task
+ * @param       uart_num : port of the receive task
+ * @param       buf      : destination
+ * @param       capacity : size of buf
+ *
+ * @retval      0     : no replayed event for this port
+ * @retval      other : number of bytes copied
+ */
+size_t Radar_uart_replay_take(uart_port_t uart_num, uint8_t* buf, size_t capacity)
+{
+#if CONFIG_RADAR_UART_CAPTURE
+    size_t len = g_replay_len;
+
+    if (!g_replay_running || (uart_num != g_replay_port))
+        return 0;
+    if (len > capacity)
+        len = capacity;
+    memcpy(buf, g_replay_buf, len);
+    return len;
+#else
+    (void)uart_num;
+    (void)buf;
+    (void)capacity;
+    return 0;
+#endif
+}
+
+/**
+ * @brief       The handler of a port is done with the replayed event, the next one can come
+ * @param       uart_num   : port of the receive task
+ * @param       handler_us : time spent in the handler
+ */
+void Radar_uart_replay_done(uart_port_t uart_num, int64_t handler_us)
+{
+#if CONFIG_RADAR_UART_CAPTURE
+    TaskHandle_t task = g_replay_task;
+
+    (void)uart_num;
+    g_replay_stats.events++;
+    g_replay_stats.bytes += (uint32_t)g_replay_len;
+    g_replay_stats.handler_us += (uint32_t)handler_us;
+    if (task != NULL)
+        xTaskNotifyGive(task);
+#else
+    (void)uart_num;
+    (void)handler_us;
+#endif
+}
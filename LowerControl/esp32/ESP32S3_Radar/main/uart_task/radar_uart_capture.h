@@ -0,0 +1,98 @@
+#ifndef _RADAR_UART_CAPTURE_H_
+#define _RADAR_UART_CAPTURE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/uart.h"
+#include "sdkconfig.h"
+
+/*
+ * Record, 32 bytes; on the wire all fields high byte first:
+ * time_us(4, low 32 bits of esp_timer when the data event was taken) port(1) flags(1) len(1) data(25)
+ * A data event longer than 25 bytes takes consecutive records, all but the first flagged CONTINUED
+ */
+#define RADAR_CAPTURE_DATA_LEN          25
+#define RADAR_CAPTURE_RECORD_LEN        (7 + RADAR_CAPTURE_DATA_LEN)
+#define RADAR_CAPTURE_FLAG_CONTINUED    0x01
+
+typedef struct {
+    uint32_t time_us;
+    uint8_t port;
+    uint8_t flags;
+    uint8_t len;
+    uint8_t data[RADAR_CAPTURE_DATA_LEN];
+} Radar_capture_record_t;
+
+#if CONFIG_RADAR_UART_CAPTURE
+#define RADAR_CAPTURE_RING_LEN          (1u << CONFIG_RADAR_UART_CAPTURE_RING_ORDER)
+#endif
+
+/* Capture commands, one byte written with the capture function code */
+#define RADAR_CAPTURE_CMD_STOP          0x00    /* Freeze the ring, before a dump or a load */
+#define RADAR_CAPTURE_CMD_START         0x01
+#define RADAR_CAPTURE_CMD_CLEAR         0x02
+#define RADAR_CAPTURE_CMD_REPLAY        0x03    /* Feed the ring back to the port handlers at the recorded pace */
+#define RADAR_CAPTURE_CMD_REPLAY_FAST   0x04    /* The same, each event as soon as the previous one is handled */
+
+/*
+ * Information answer: enabled(1) replaying(1) ring_len(2) record_len(1) then the number of records
+ * ever written(4); slot i holds record n when n % ring_len == i. Then the last replay: events(4)
+ * bytes(4) handler time(4, us) events skipped(4, port without a receive task or not answering)
+ */
+#define RADAR_CAPTURE_INFO_LEN          25
+
+/* Dump answer: first slot(2) num(1) then num records */
+#define RADAR_CAPTURE_PAGE_RECORDS      7
+#define RADAR_CAPTURE_PAGE_LEN          (3 + RADAR_CAPTURE_PAGE_RECORDS * RADAR_CAPTURE_RECORD_LEN)
+
+/* Event type of a replayed data event in the port event queues, after the ones of the driver */
+#define RADAR_UART_REPLAY_DATA          ((uart_event_type_t)(UART_EVENT_MAX + 1))
+
+typedef struct {
+    uint32_t events;
+    uint32_t bytes;
+    uint32_t handler_us;                /* Time spent in the port handlers */
+    uint32_t skipped;
+} Radar_capture_replay_stats_t;
+
+#if CONFIG_RADAR_UART_CAPTURE
+extern volatile bool g_radar_capture_enabled;
+
+void Radar_uart_capture_record(uart_port_t uart_num, const uint8_t* data, size_t size, int64_t time_us);
+
+/**
+ * @brief       Record the bytes of one data event, called by the receive task before the handler
+ *              A volatile flag test when the capture is stopped
+ * @param       uart_num : port
+ * @param       data     : bytes read
+ * @param       size     : number of bytes
+ * @param       time_us  : esp_timer time the event was taken
+ *
+ * @retval      void
+ */
+static inline void Radar_uart_capture(uart_port_t uart_num, const uint8_t* data, size_t size, int64_t time_us)
+{
+    if (g_radar_capture_enabled)
+        Radar_uart_capture_record(uart_num, data, size, time_us);
+}
+#else
+static inline void Radar_uart_capture(uart_port_t uart_num, const uint8_t* data, size_t size, int64_t time_us)
+{
+    (void)uart_num; (void)data; (void)size; (void)time_us;
+}
+#endif
+
+bool Radar_uart_capture_command(uint8_t cmd); /* RADAR_CAPTURE_CMD_xxx, false if unknown, busy or compiled out */
+bool Radar_uart_capture_load(const uint8_t* record, size_t len); /* append one record as on the wire, capture stopped */
+size_t Radar_uart_capture_encode_info(uint8_t* buf, size_t capacity);
+size_t Radar_uart_capture_encode_page(uint16_t first, uint8_t* buf, size_t capacity); /* records from slot first on */
+bool Radar_uart_replay_running(void);
+void Radar_uart_replay_get_stats(Radar_capture_replay_stats_t* stats);
+
+/* Receive task side of a replayed event */
+size_t Radar_uart_replay_take(uart_port_t uart_num, uint8_t* buf, size_t capacity);
+void Radar_uart_replay_done(uart_port_t uart_num, int64_t handler_us);
+
+#endif
@@ -1,14 +1,45 @@
+#define RADAR_LOG_LEVEL CONFIG_RADAR_LOG_LEVEL_UART
+
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/uart.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "sdkconfig.h"
 
 #include "radar_uart.h"
+#include "radar_uart_capture.h"
+#include "radar_counters.h"
+#include "radar_trace.h"
+#include "radar_log.h"
 
 static const char *TAG = "RadarUART";
 static uint8_t pcDataBuff[RX_BUF_SIZE] = {0};
+static int64_t g_uart_event_us[UART_NUM_MAX];  /* When the data event being handled was taken */
+
+// time the data event being handled was taken from the event queue,
+// for the handler to time its request from there
+int64_t Radar_uart_event_time(uart_port_t uart_num)
+{
+    if (uart_num >= UART_NUM_MAX)
+        return 0;
+    return g_uart_event_us[uart_num];
+}
+
+// replayed data event: the bytes come from the capture instead of the driver,
+// and go to the same handler as live ones
+static void Radar_uart_replay_event(const xRadar_UART_t* pxUart_Opr)
+{
+    size_t size = Radar_uart_replay_take(pxUart_Opr->uart_num, pcDataBuff, sizeof(pcDataBuff));
+    int64_t start;
+
+    if (size == 0)
+        return;
+    start = esp_timer_get_time();
+    (pxUart_Opr->DateHand_fun)((pxUart_Opr->uart_num), pcDataBuff, size);
+    Radar_uart_replay_done(pxUart_Opr->uart_num, esp_timer_get_time() - start);
+}
 
 // event processing task
 // created by default when the app calls the run function
@@ -19,20 +50,27 @@ void Radar_uart_default_receive_task(void *pxRadar_uart_Opr)
     const xRadar_UART_t* const pxUart_Opr = (xRadar_UART_t*)pxRadar_uart_Opr;
     uart_event_t event;
     for(;;) {
-        bzero(pcDataBuff, RX_BUF_SIZE);
         //Waiting for UART event.
         if(xQueueReceive(*(pxUart_Opr->pUart_queue), (void * )&event, (TickType_t)portMAX_DELAY)) {
-            ESP_LOGI(TAG, "uart[%d] event:", pxUart_Opr->uart_num);
+            g_uart_event_us[pxUart_Opr->uart_num] = esp_timer_get_time();
+            RADAR_LOGD(TAG, "uart[%d] event:", pxUart_Opr->uart_num);
+            if(event.type == RADAR_UART_REPLAY_DATA) {
+                Radar_uart_replay_event(pxUart_Opr);
+                continue;
+            }
             switch(event.type) {
                 //Event of UART receving data
                 case UART_DATA:
+                    Radar_trace(RADAR_TRACE_UART_RX, (uint16_t)pxUart_Opr->uart_num, (uint32_t)event.size);
                     uart_read_bytes(pxUart_Opr->uart_num, pcDataBuff, event.size, portMAX_DELAY);
-                    ESP_LOGI(TAG, "[Recv str]: %s, [Len]: %d", (const char*) pcDataBuff, event.size);
+                    Radar_uart_capture(pxUart_Opr->uart_num, pcDataBuff, event.size, g_uart_event_us[pxUart_Opr->uart_num]);
+                    RADAR_LOGD(TAG, "[Recv]: %d bytes", event.size);
                     (pxUart_Opr->DateHand_fun)((pxUart_Opr->uart_num), pcDataBuff, event.size);//Execute the corresponding processing function
                     break;
                 //Event of HW FIFO overflow detected
                 case UART_FIFO_OVF:
-                    ESP_LOGI(TAG, "hw fifo overflow");
+                    RADAR_LOGW(TAG, "uart[%d] hw fifo overflow", pxUart_Opr->uart_num);
+                    Radar_counter_inc_port(RADAR_COUNTER_UART_FIFO_OVF, pxUart_Opr->uart_num);
                     // If fifo overflow happened, you should consider adding flow control for your application.
                     // The ISR has already reset the rx FIFO,
                     // As an example, we directly flush the rx buffer here in order to read more data.
@@ -41,7 +79,8 @@ void Radar_uart_default_receive_task(void *pxRadar_uart_Opr)
                     break;
                 //Event of UART ring buffer full
                 case UART_BUFFER_FULL:
-                    ESP_LOGI(TAG, "ring buffer full");
+                    RADAR_LOGW(TAG, "uart[%d] ring buffer full", pxUart_Opr->uart_num);
+                    Radar_counter_inc_port(RADAR_COUNTER_UART_BUFFER_FULL, pxUart_Opr->uart_num);
                     // If buffer full happened, you should consider encreasing your buffer size
                     // As an example, we directly flush the rx buffer here in order to read more data.
                     uart_flush_input(pxUart_Opr->uart_num);
@@ -49,19 +88,22 @@ void Radar_uart_default_receive_task(void *pxRadar_uart_Opr)
                     break;
                 //Event of UART RX break detected
                 case UART_BREAK:
-                    ESP_LOGI(TAG, "uart rx break");
+                    RADAR_LOGD(TAG, "uart rx break");
+                    Radar_counter_inc_port(RADAR_COUNTER_UART_LINE_ERR, pxUart_Opr->uart_num);
                     break;
                 //Event of UART parity check error
                 case UART_PARITY_ERR:
-                    ESP_LOGI(TAG, "uart parity error");
+                    RADAR_LOGW(TAG, "uart[%d] parity error", pxUart_Opr->uart_num);
+                    Radar_counter_inc_port(RADAR_COUNTER_UART_LINE_ERR, pxUart_Opr->uart_num);
                     break;
                 //Event of UART frame error
                 case UART_FRAME_ERR:
-                    ESP_LOGI(TAG, "uart frame error");
+                    RADAR_LOGW(TAG, "uart[%d] frame error", pxUart_Opr->uart_num);
+                    Radar_counter_inc_port(RADAR_COUNTER_UART_LINE_ERR, pxUart_Opr->uart_num);
                     break;
                 //Others
                 default:
-                    ESP_LOGI(TAG, "uart event type: %d", event.type);
+                    RADAR_LOGD(TAG, "uart event type: %d", event.type);
                     break;
             }
         }
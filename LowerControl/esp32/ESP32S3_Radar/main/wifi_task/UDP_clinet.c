@@ -9,15 +9,33 @@
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
 
 #include "lwip/err.h"
 #include "lwip/sockets.h"
 #include "lwip/sys.h"
 #include <lwip/netdb.h>
+#if CONFIG_RADAR_STREAM_ZERO_COPY
+#include "lwip/api.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/priv/tcpip_priv.h"
+#endif
 
 #include "WIFI.h"
+#include "UDP_clinet.h"
+#include "scan_server.h"
+#include "discovery.h"
+#include "time_sync.h"
+#include "mod_bus.h"
+#include "sweep_publish.h"
+#include "sweep_output.h"
+#include "sweep_change.h"
 
-#if defined(CONFIG_EXAMPLE_IPV4)
+#if CONFIG_RADAR_STREAM_MULTICAST
+#define HOST_IP_ADDR CONFIG_RADAR_STREAM_GROUP  /* one datagram reaches every host of the site */
+#elif defined(CONFIG_EXAMPLE_IPV4)
 #define HOST_IP_ADDR CONFIG_EXAMPLE_IPV4_ADDR //"192.168.137.1"
 #elif defined(CONFIG_EXAMPLE_IPV6)
 #define HOST_IP_ADDR CONFIG_EXAMPLE_IPV6_ADDR
@@ -27,102 +45,1068 @@
 
 #define PORT CONFIG_EXAMPLE_PORT
 
+#define STREAM_DATAGRAM_LEN     CONFIG_RADAR_STREAM_DATAGRAM_LEN
+#define STREAM_SLICE_INTERVAL   pdMS_TO_TICKS(CONFIG_RADAR_STREAM_SLICE_INTERVAL_MS)
+#define STREAM_FEC_GROUP        CONFIG_RADAR_STREAM_FEC_GROUP
+#if STREAM_FEC_GROUP
+/* a parity datagram holds the slice index and the longest payload of its group after its own head */
+#define STREAM_PAYLOAD_LEN      (STREAM_DATAGRAM_LEN - RADAR_STREAM_HEAD_LEN - RADAR_STREAM_PARITY_HEAD_LEN - 1)
+#else
+#define STREAM_PAYLOAD_LEN      (STREAM_DATAGRAM_LEN - RADAR_STREAM_HEAD_LEN)
+#endif
+#define STREAM_WINDOW_SWEEPS    2   /* Sweeps whose slices can be sent again: the loss of the last
+                                       slices of a sweep only shows with the first slice of the next */
+#define STREAM_WINDOW_LEN       32  /* Slices of each of them */
+#define STREAM_RETRANSMIT_MAX   2   /* Times one slice is sent again, several receivers may ask for it */
+#define STREAM_NACK_QUEUE_LEN   32  /* Datagrams asked for and not served yet */
+
 static const char *TAG = "UDP";
-static const char *payload = "Hello ! ";
 
-// 
-void udp_client_task(void *pvParameters)
+#define CONTROL_PORT            CONFIG_RADAR_CONTROL_PORT
+#define CONTROL_TASK_STACK      4096    /* Modbus_submit keeps a request on the stack */
+
+static TaskHandle_t g_stream_task = NULL;           /* Woken on every published sweep and NACK */
+static udp_stream_stats_t g_stream_stats;           /* Written by the stream task, nack by the control task */
+static uint32_t g_stream_seq = 0;                   /* datagram_seq of the next datagram */
+static uint8_t g_stream_datagram[STREAM_DATAGRAM_LEN]; /* Only used by the stream task */
+
+/* Slices of the last sweeps sent, each sweep stays held until it leaves the window. Stream task only */
+typedef struct {
+    uint32_t seq;
+    uint8_t slice;
+    uint8_t retransmits;
+} udp_stream_window_entry_t;
+
+typedef struct {
+    const Radar_sweep_t* sweep;
+    uint8_t format;
+    bool resynced;          /* A keyframe was already forced for this sweep */
+    uint8_t num;
+    udp_stream_window_entry_t entry[STREAM_WINDOW_LEN];
+} udp_stream_window_t;
+
+static udp_stream_window_t g_stream_window[STREAM_WINDOW_SWEEPS];   /* Newest first */
+
+/* datagram_seq asked for by NACKs, filled by the control task */
+static uint32_t g_stream_nack[STREAM_NACK_QUEUE_LEN];
+static uint8_t g_stream_nack_head = 0;
+static uint8_t g_stream_nack_num = 0;
+static uint32_t g_stream_nack_overflow = 0;
+static portMUX_TYPE g_stream_nack_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if STREAM_FEC_GROUP
+/* Parity of the group being sent, xor from RADAR_STREAM_HEAD_LEN + RADAR_STREAM_PARITY_HEAD_LEN. Stream task only */
+static uint8_t g_stream_parity[STREAM_DATAGRAM_LEN];
+static uint32_t g_stream_parity_base = 0;
+static uint8_t g_stream_parity_num = 0;
+static uint16_t g_stream_parity_len = 0;        /* Longest slice(1) payload... of the group */
+static uint16_t g_stream_parity_len_xor = 0;
+
+static int udp_stream_parity_flush(const Radar_sweep_t* sweep, uint8_t format);
+#endif
+
+#if CONFIG_RADAR_STREAM_ZERO_COPY
+
+#if !LWIP_SUPPORT_CUSTOM_PBUF
+#error "zero-copy streaming needs LWIP_SUPPORT_CUSTOM_PBUF"
+#endif
+
+#define STREAM_REF_NUM          8   /* Slices referencing a sweep in place that lwIP may hold at once */
+
+/* PBUF_REF on the points of a held sweep, the sweep is released when lwIP frees the pbuf */
+typedef struct {
+    struct pbuf_custom pbuf;    /* Must stay the first member, lwIP frees it by its address */
+    const Radar_sweep_t* sweep;
+} udp_stream_ref_t;
+
+static udp_stream_ref_t g_stream_ref[STREAM_REF_NUM];
+static udp_stream_ref_t* g_stream_ref_free[STREAM_REF_NUM];
+static uint8_t g_stream_ref_free_num = 0;
+static portMUX_TYPE g_stream_ref_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct netconn* g_stream_conn = NULL;
+
+#else
+
+static int g_stream_sock = -1;
+#if defined(CONFIG_EXAMPLE_IPV6)
+static struct sockaddr_in6 g_stream_dest_addr;
+#else
+static struct sockaddr_in g_stream_dest_addr;
+#endif
+
+#endif
+
+/**
+ * @brief       Publish callback, runs in the steering task: only wakes the stream task
+ * @param       sweep : published sweep
+ *
+ * @retval      void
+ */
+static void udp_stream_on_publish(const Radar_sweep_t* sweep)
 {
-    if (wifi_init_sta() == ESP_OK) {
-        ESP_LOGI(TAG, "WIFI Connent !");
+    TaskHandle_t task = g_stream_task;
+
+    (void)sweep;
+    if (task != NULL)
+        xTaskNotifyGive(task);
+}
+
+/**
+ * @brief       Subscribe the streamer to published sweeps
+ *              Must be called before the steering task runs
+ * @param       void
+ *
+ * @retval      ESP_OK          : success
+ * @retval      ESP_ERR_NO_MEM  : too many consumers
+ */
+esp_err_t udp_stream_init(void)
+{
+    return Radar_sweep_register_consumer(udp_stream_on_publish);
+}
+
+/**
+ * @brief       Destination of the scan stream, for the discovery announce
+ * @param       port : out, destination port
+ *
+ * @retval      0     : not an IPv4 destination
+ * @retval      other : IPv4 address, network byte order
+ */
+uint32_t udp_stream_get_dest(uint16_t* port)
+{
+    *port = PORT;
+#if defined(CONFIG_EXAMPLE_IPV6) && !CONFIG_RADAR_STREAM_MULTICAST
+    return 0;
+#else
+    return inet_addr(HOST_IP_ADDR);
+#endif
+}
+
+/**
+ * @brief       Write the datagram header in front of a slice, also used by the scan server messages
+ * @param       head   : destination, RADAR_STREAM_HEAD_LEN bytes
+ * @param       sweep  : sweep being sent
+ * @param       format : format of the payload
+ * @param       slice  : slice index
+ * @param       seq    : datagram_seq, 0 over the scan server
+ * @param       flags  : RADAR_STREAM_FLAG_xxx
+ *
+ * @retval      void
+ */
+void udp_stream_put_head(uint8_t* head, const Radar_sweep_t* sweep, uint8_t format, uint8_t slice,
+                         uint32_t seq, uint8_t flags)
+{
+    uint8_t* p = head;
+    uint16_t device_id = Modbus_get_device_address();
+    uint8_t quality;
+    uint64_t timestamp = (uint64_t)time_sync_to_shared(sweep->timestamp_us, &quality);
+
+    p[0] = (uint8_t)(RADAR_STREAM_MAGIC >> 8);
+    p[1] = (uint8_t)(RADAR_STREAM_MAGIC & 0xFF);
+    p[2] = RADAR_STREAM_VERSION;
+    p[3] = format;
+    p[4] = (uint8_t)(device_id >> 8);
+    p[5] = (uint8_t)(device_id & 0xFF);
+    for (int i = 0; i < 4; i++)
+        p[6 + i] = (uint8_t)(sweep->sequence >> (24 - 8 * i));
+    for (int i = 0; i < 8; i++)
+        p[10 + i] = (uint8_t)(timestamp >> (56 - 8 * i));
+    p[18] = slice;
+    for (int i = 0; i < 4; i++)
+        p[19 + i] = (uint8_t)(sweep->duration_us >> (24 - 8 * i));
+    p[23] = quality;
+    for (int i = 0; i < 4; i++)
+        p[24 + i] = (uint8_t)(seq >> (24 - 8 * i));
+    p[28] = flags;
+}
+
+/**
+ * @brief       Read the stream counters
+ * @param       stats : out, counters
+ *
+ * @retval      void
+ */
+void udp_stream_get_stats(udp_stream_stats_t* stats)
+{
+    *stats = g_stream_stats;
+    stats->missed += g_stream_nack_overflow;    /* asked for while the queue was full */
+}
+
+/**
+ * @brief       Encode the stream counters for the Modbus read, each one high byte first
+ *              sent, dropped, parity, nack, retransmitted, missed, resync
+ * @param       buf : destination
+ * @param       len : destination len
+ *
+ * @retval      0     : buffer too small
+ * @retval      other : RADAR_STREAM_STATS_LEN
+ */
+size_t udp_stream_encode_stats(uint8_t* buf, size_t len)
+{
+    udp_stream_stats_t stats;
+    uint32_t value[RADAR_STREAM_STATS_LEN / 4];
+
+    if (len < RADAR_STREAM_STATS_LEN)
+        return 0;
+    udp_stream_get_stats(&stats);
+    value[0] = stats.sent;
+    value[1] = stats.dropped;
+    value[2] = stats.parity;
+    value[3] = stats.nack;
+    value[4] = stats.retransmitted;
+    value[5] = stats.missed;
+    value[6] = stats.resync;
+    for (int i = 0; i < RADAR_STREAM_STATS_LEN / 4; i++) {
+        for (int j = 0; j < 4; j++)
+            buf[4 * i + j] = (uint8_t)(value[i] >> (24 - 8 * j));
+    }
+    return RADAR_STREAM_STATS_LEN;
+}
+
+/**
+ * @brief       Queue the datagrams asked for by a NACK, runs in the control task
+ * @param       data : NACK datagram
+ * @param       len  : datagram len
+ *
+ * @retval      void
+ */
+static void udp_stream_on_nack(const uint8_t* data, size_t len)
+{
+    uint8_t count = data[3];
+    TaskHandle_t task = g_stream_task;
+
+    if ((data[2] != RADAR_STREAM_VERSION) || (len < RADAR_STREAM_NACK_HEAD_LEN + 4 * (size_t)count))
+        return;
+    taskENTER_CRITICAL(&g_stream_nack_lock);
+    for (uint8_t i = 0; i < count; i++) {
+        const uint8_t* p = &data[RADAR_STREAM_NACK_HEAD_LEN + 4 * i];
+        if (g_stream_nack_num < STREAM_NACK_QUEUE_LEN) {
+            g_stream_nack[(g_stream_nack_head + g_stream_nack_num++) % STREAM_NACK_QUEUE_LEN] =
+                ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        } else {
+            g_stream_nack_overflow++;
+        }
+    }
+    g_stream_stats.nack += count;
+    taskEXIT_CRITICAL(&g_stream_nack_lock);
+    if (task != NULL)
+        xTaskNotifyGive(task);
+}
+
+/**
+ * @brief       Take the next datagram asked for
+ * @param       seq : out, datagram_seq
+ *
+ * @retval      true when one was queued
+ */
+static bool udp_stream_nack_pop(uint32_t* seq)
+{
+    bool found = false;
+
+    taskENTER_CRITICAL(&g_stream_nack_lock);
+    if (g_stream_nack_num) {
+        *seq = g_stream_nack[g_stream_nack_head];
+        g_stream_nack_head = (g_stream_nack_head + 1) % STREAM_NACK_QUEUE_LEN;
+        g_stream_nack_num--;
+        found = true;
+    }
+    taskEXIT_CRITICAL(&g_stream_nack_lock);
+    return found;
+}
+
+/**
+ * @brief       Add a sweep to the retransmit window, the oldest one is released
+ * @param       sweep  : held sweep about to be sent, retained by the window
+ * @param       format : format it is sent in
+ *
+ * @retval      void
+ */
+static void udp_stream_window_open(const Radar_sweep_t* sweep, uint8_t format)
+{
+    udp_stream_window_t* window = &g_stream_window[0];
+
+    if (g_stream_window[STREAM_WINDOW_SWEEPS - 1].sweep != NULL)
+        Radar_sweep_release(g_stream_window[STREAM_WINDOW_SWEEPS - 1].sweep);
+    memmove(&g_stream_window[1], &g_stream_window[0], (STREAM_WINDOW_SWEEPS - 1) * sizeof(g_stream_window[0]));
+    Radar_sweep_retain(sweep);
+    window->sweep = sweep;
+    window->format = format;
+    window->resynced = false;
+    window->num = 0;
+}
+
+/**
+ * @brief       Give the next datagram_seq to a slice and remember it in the window
+ * @param       slice : slice index
+ *
+ * @retval      datagram_seq
+ */
+static uint32_t udp_stream_window_add(uint8_t slice)
+{
+    udp_stream_window_t* window = &g_stream_window[0];
+    uint32_t seq = g_stream_seq++;
+
+    if (window->num < STREAM_WINDOW_LEN) {
+        window->entry[window->num].seq = seq;
+        window->entry[window->num].slice = slice;
+        window->entry[window->num].retransmits = 0;
+        window->num++;
+    }
+    return seq;
+}
+
+#if STREAM_FEC_GROUP
+
+/**
+ * @brief       XOR part of a slice into the parity of its group
+ * @param       offset : offset in slice(1) payload...
+ * @param       data   : bytes
+ * @param       len    : bytes len
+ *
+ * @retval      void
+ */
+static void udp_stream_parity_xor(size_t offset, const uint8_t* data, size_t len)
+{
+    uint8_t* p = &g_stream_parity[RADAR_STREAM_HEAD_LEN + RADAR_STREAM_PARITY_HEAD_LEN + offset];
+
+    for (size_t i = 0; i < len; i++)
+        p[i] ^= data[i];
+}
+
+/**
+ * @brief       Count a slice in the parity of its group, once its payload is XORed in
+ * @param       seq         : datagram_seq of the slice
+ * @param       slice       : slice index
+ * @param       payload_len : payload len
+ *
+ * @retval      void
+ */
+static void udp_stream_parity_count(uint32_t seq, uint8_t slice, size_t payload_len)
+{
+    if (g_stream_parity_num == 0)
+        g_stream_parity_base = seq;
+    udp_stream_parity_xor(0, &slice, 1);
+    g_stream_parity_num++;
+    g_stream_parity_len = MAX(g_stream_parity_len, (uint16_t)(1 + payload_len));
+    g_stream_parity_len_xor ^= (uint16_t)payload_len;
+}
+
+#endif
+
+/**
+ * @brief       Whether an encoded slice is the last one of its sweep, for the formats
+ *              that cannot tell before encoding the next slice
+ * @param       format  : format of the payload
+ * @param       payload : encoded slice
+ *
+ * @retval      true when no slice follows
+ */
+static inline bool udp_stream_slice_last(uint8_t format, const uint8_t* payload)
+{
+    /* a delta sweep continues in the same sweep until the receiver is up to date */
+    return (format == RADAR_SWEEP_FORMAT_DELTA) && !(payload[2] & SWEEP_CHANGE_FLAG_MORE);
+}
+
+#if CONFIG_RADAR_STREAM_ZERO_COPY
+
+/**
+ * @brief       lwIP free function of the in-place pbufs, runs in the lwIP or WiFi task
+ *              once the datagram left the driver or was dropped
+ * @param       p : pbuf_custom of a udp_stream_ref_t
+ *
+ * @retval      void
+ */
+static void udp_stream_ref_free(struct pbuf* p)
+{
+    udp_stream_ref_t* ref = (udp_stream_ref_t*)p;
+
+    Radar_sweep_release(ref->sweep);
+    taskENTER_CRITICAL(&g_stream_ref_lock);
+    g_stream_ref_free[g_stream_ref_free_num++] = ref;
+    taskEXIT_CRITICAL(&g_stream_ref_lock);
+}
+
+/**
+ * @brief       Build a PBUF_REF on points of a held sweep, the pbuf holds its own sweep reference
+ * @param       sweep   : held sweep
+ * @param       payload : first byte referenced, inside the sweep
+ * @param       len     : bytes referenced
+ *
+ * @retval      NULL  : every reference is in flight
+ * @retval      other : pbuf
+ */
+static struct pbuf* udp_stream_ref_alloc(const Radar_sweep_t* sweep, const void* payload, uint16_t len)
+{
+    udp_stream_ref_t* ref = NULL;
+
+    taskENTER_CRITICAL(&g_stream_ref_lock);
+    if (g_stream_ref_free_num)
+        ref = g_stream_ref_free[--g_stream_ref_free_num];
+    taskEXIT_CRITICAL(&g_stream_ref_lock);
+    if (ref == NULL)
+        return NULL;
+
+    Radar_sweep_retain(sweep);
+    ref->sweep = sweep;
+    ref->pbuf.custom_free_function = udp_stream_ref_free;
+    return pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &ref->pbuf, (void*)payload, len);
+}
+
+/**
+ * @brief       Whether a sweep referenced in place is still held by lwIP
+ *              At most one sweep is lent to the stack at a time, so that acquisition always finds a buffer
+ *
+ * @retval      true when in-place pbufs are still in flight
+ */
+static bool udp_stream_ref_busy(void)
+{
+    bool busy;
+
+    taskENTER_CRITICAL(&g_stream_ref_lock);
+    busy = g_stream_ref_free_num != STREAM_REF_NUM;
+    taskEXIT_CRITICAL(&g_stream_ref_lock);
+    return busy;
+}
+
+#if CONFIG_RADAR_STREAM_MULTICAST && LWIP_MULTICAST_TX_OPTIONS
+/**
+ * @brief       Set the multicast TTL of the stream pcb, run by tcpip_api_call in the thread that owns it
+ * @param       call : unused
+ *
+ * @retval      ERR_OK
+ */
+static err_t udp_stream_set_multicast_ttl(struct tcpip_api_call_data* call)
+{
+    (void)call;
+    udp_set_multicast_ttl(g_stream_conn->pcb.udp, CONFIG_RADAR_MULTICAST_TTL);
+    return ERR_OK;
+}
+#endif
+
+/**
+ * @brief       Open the stream connection to the host
+ * @param       void
+ *
+ * @retval      0  : success
+ * @retval      -1 : error
+ */
+static int udp_stream_open(void)
+{
+    ip_addr_t host;
+
+    if (g_stream_ref_free_num == 0) {
+        for (int i = 0; i < STREAM_REF_NUM; i++)
+            g_stream_ref_free[i] = &g_stream_ref[i];
+        g_stream_ref_free_num = STREAM_REF_NUM;
+    }
+
+    if (!ipaddr_aton(HOST_IP_ADDR, &host)) {
+        ESP_LOGE(TAG, "Invalid host address %s", HOST_IP_ADDR);
+        return -1;
+    }
+    g_stream_conn = netconn_new(IP_IS_V6(&host) ? NETCONN_UDP_IPV6 : NETCONN_UDP);
+    if (g_stream_conn == NULL) {
+        ESP_LOGE(TAG, "Unable to create netconn");
+        return -1;
+    }
+    if (netconn_connect(g_stream_conn, &host, PORT) != ERR_OK) {
+        ESP_LOGE(TAG, "Unable to connect netconn");
+        netconn_delete(g_stream_conn);
+        g_stream_conn = NULL;
+        return -1;
+    }
+#if CONFIG_RADAR_STREAM_MULTICAST && LWIP_MULTICAST_TX_OPTIONS
+    {
+        struct tcpip_api_call_data call;
+
+        /* the pcb is not ours to change: LOCK_TCPIP_CORE is empty without LWIP_TCPIP_CORE_LOCKING */
+        tcpip_api_call(udp_stream_set_multicast_ttl, &call);
+    }
+#endif
+    return 0;
+}
+
+/**
+ * @brief       Close the stream connection
+ * @param       void
+ *
+ * @retval      void
+ */
+static void udp_stream_close(void)
+{
+    if (g_stream_conn != NULL) {
+        netconn_delete(g_stream_conn);
+        g_stream_conn = NULL;
+    }
+}
+
+/**
+ * @brief       Build one slice as a pbuf chain without copying through a user buffer, header left blank
+ *              Polar LE references the points in the sweep buffer, other formats are encoded
+ *              straight into a pool-allocated pbuf
+ * @param       sweep   : held sweep
+ * @param       format  : format of the UDP channel
+ * @param       slice   : slice index
+ * @param       in_place: the points may be referenced in place
+ * @param       last    : out, no slice follows
+ *
+ * @retval      NULL  : no such slice, or no memory (counted as dropped)
+ * @retval      other : datagram
+ */
+static struct pbuf* udp_stream_build_slice(const Radar_sweep_t* sweep, uint8_t format, uint8_t slice,
+                                           bool in_place, bool* last)
+{
+    struct pbuf* head;
+    size_t len;
+
+    *last = false;
+    if (in_place && (format == RADAR_SWEEP_FORMAT_POLAR_LE)) {
+        struct pbuf* points;
+        uint16_t first;
+        uint16_t num;
+
+        head = pbuf_alloc(PBUF_TRANSPORT, RADAR_STREAM_HEAD_LEN + RADAR_OUTPUT_PAGE_HEAD_LEN, PBUF_RAM);
+        if (head == NULL)
+            goto drop;
+        if (Radar_output_encode_page_head(RADAR_OUTPUT_CHANNEL_UDP, sweep, slice, STREAM_PAYLOAD_LEN,
+                                          (uint8_t*)head->payload + RADAR_STREAM_HEAD_LEN, &first, &num) == 0) {
+            pbuf_free(head);
+            *last = true;
+            return NULL;
+        }
+        points = udp_stream_ref_alloc(sweep, &sweep->distance[first], num * sizeof(uint16_t)); /* little-endian target */
+        if (points == NULL) {
+            pbuf_free(head);
+            goto drop;
+        }
+        pbuf_cat(head, points);
     } else {
-        ESP_LOGW(TAG, "WIFI Connent Fail!");
-        vTaskDelete(NULL);
+        head = pbuf_alloc(PBUF_TRANSPORT, STREAM_DATAGRAM_LEN, PBUF_RAM);
+        if (head == NULL)
+            goto drop;
+        len = Radar_output_encode_page(RADAR_OUTPUT_CHANNEL_UDP, sweep, slice,
+                                       (uint8_t*)head->payload + RADAR_STREAM_HEAD_LEN, STREAM_PAYLOAD_LEN);
+        if (len == 0) {
+            pbuf_free(head);
+            *last = true;
+            return NULL;
+        }
+        *last = udp_stream_slice_last(format, (uint8_t*)head->payload + RADAR_STREAM_HEAD_LEN);
+        pbuf_realloc(head, RADAR_STREAM_HEAD_LEN + len);
+    }
+    return head;    /* the caller writes the header */
+
+drop:
+    g_stream_stats.dropped++;
+    return NULL;
+}
+
+/**
+ * @brief       Send one datagram, never blocks
+ * @param       p : datagram, freed here
+ *
+ * @retval      0  : sent
+ * @retval      1  : dropped, the stack could not take it
+ * @retval      -1 : connection error, the connection must be reopened
+ */
+static int udp_stream_send_pbuf(struct pbuf* p)
+{
+    struct netbuf* buf = netbuf_new();
+    err_t err;
+
+    if (buf == NULL) {
+        pbuf_free(p);
+        g_stream_stats.dropped++;
+        return 1;
+    }
+    buf->p = buf->ptr = p;
+    err = netconn_send(g_stream_conn, buf);
+    netbuf_delete(buf); /* lwIP keeps its own reference while the datagram is queued */
+    if (err == ERR_OK)
+        return 0;
+    if ((err == ERR_MEM) || (err == ERR_BUF) || (err == ERR_WOULDBLOCK)) {
+        g_stream_stats.dropped++;
+        return 1;
     }
+    ESP_LOGE(TAG, "Error occurred during sending: err %d", err);
+    return -1;
+}
+
+/**
+ * @brief       Send one datagram built in a user buffer, for parity and retransmissions
+ * @param       datagram : datagram
+ * @param       len      : datagram len
+ *
+ * @retval      0  : sent
+ * @retval      1  : dropped
+ * @retval      -1 : connection error
+ */
+static int udp_stream_send_buffer(const uint8_t* datagram, size_t len)
+{
+    struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+
+    if (p == NULL) {
+        g_stream_stats.dropped++;
+        return 1;
+    }
+    memcpy(p->payload, datagram, len);
+    return udp_stream_send_pbuf(p);
+}
+
+#if STREAM_FEC_GROUP
+
+/**
+ * @brief       XOR the payload of a slice into the parity of its group, across the pbuf chain
+ * @param       p     : datagram
+ * @param       seq   : datagram_seq of the slice
+ * @param       slice : slice index
+ *
+ * @retval      void
+ */
+static void udp_stream_parity_add_pbuf(const struct pbuf* p, uint32_t seq, uint8_t slice)
+{
+    size_t skip = RADAR_STREAM_HEAD_LEN;
+    size_t offset = 1;
+
+    for (const struct pbuf* q = p; q != NULL; q = q->next) {
+        if (q->len > skip) {
+            udp_stream_parity_xor(offset, (const uint8_t*)q->payload + skip, q->len - skip);
+            offset += q->len - skip;
+        }
+        skip -= MIN(skip, q->len);
+    }
+    udp_stream_parity_count(seq, slice, p->tot_len - RADAR_STREAM_HEAD_LEN);
+}
+
+#endif
+
+/**
+ * @brief       Send every slice of a sweep, one datagram each, paced by STREAM_SLICE_INTERVAL
+ *              Sends never block: a slice the stack cannot take is dropped, and can be asked for again
+ * @param       sweep : held sweep
+ *
+ * @retval      0  : success
+ * @retval      -1 : connection error, the connection must be reopened
+ */
+static int udp_stream_send_sweep(const Radar_sweep_t* sweep)
+{
+    uint8_t format = Radar_output_get_format(RADAR_OUTPUT_CHANNEL_UDP);
+    bool in_place = !udp_stream_ref_busy(); /* otherwise this sweep is copied */
+    bool last;
+
+    udp_stream_window_open(sweep, format);
+    for (uint16_t slice = 0; slice <= UINT8_MAX; slice++) {
+        struct pbuf* p = udp_stream_build_slice(sweep, format, (uint8_t)slice, in_place, &last);
+
+        if (p != NULL) {
+            uint32_t seq = udp_stream_window_add((uint8_t)slice);
+            int err;
+
+            udp_stream_put_head(p->payload, sweep, format, (uint8_t)slice, seq, 0);
+#if STREAM_FEC_GROUP
+            udp_stream_parity_add_pbuf(p, seq, (uint8_t)slice);
+#endif
+            if ((slice != 0) && STREAM_SLICE_INTERVAL)
+                vTaskDelay(STREAM_SLICE_INTERVAL);
+            err = udp_stream_send_pbuf(p);
+            if (err < 0)
+                return -1;
+            if (err == 0)
+                g_stream_stats.sent++;
+#if STREAM_FEC_GROUP
+            if ((g_stream_parity_num == STREAM_FEC_GROUP) && (udp_stream_parity_flush(sweep, format) < 0))
+                return -1;
+#endif
+        }
+        if (last)
+            break;
+    }
+#if STREAM_FEC_GROUP
+    return udp_stream_parity_flush(sweep, format);  /* groups never span sweeps */
+#else
+    return 0;
+#endif
+}
+
+#else
 
-    char rx_buffer[128];
-    char host_ip[] = HOST_IP_ADDR;
+/**
+ * @brief       Open the stream socket to the host
+ * @param       void
+ *
+ * @retval      0  : success
+ * @retval      -1 : error
+ */
+static int udp_stream_open(void)
+{
     int addr_family = 0;
     int ip_protocol = 0;
 
-    while (1) {
+#if defined(CONFIG_EXAMPLE_IPV6)
+    memset(&g_stream_dest_addr, 0, sizeof(g_stream_dest_addr));
+    inet6_aton(HOST_IP_ADDR, &g_stream_dest_addr.sin6_addr);
+    g_stream_dest_addr.sin6_family = AF_INET6;
+    g_stream_dest_addr.sin6_port = htons(PORT);
+    g_stream_dest_addr.sin6_scope_id = esp_netif_get_netif_impl_index(EXAMPLE_INTERFACE);
+    addr_family = AF_INET6;
+    ip_protocol = IPPROTO_IPV6;
+#else
+    g_stream_dest_addr.sin_addr.s_addr = inet_addr(HOST_IP_ADDR);
+    g_stream_dest_addr.sin_family = AF_INET;
+    g_stream_dest_addr.sin_port = htons(PORT);
+    addr_family = AF_INET;
+    ip_protocol = IPPROTO_IP;
+#endif
 
-#if defined(CONFIG_EXAMPLE_IPV4)
-        struct sockaddr_in dest_addr;
-        dest_addr.sin_addr.s_addr = inet_addr(HOST_IP_ADDR);
-        dest_addr.sin_family = AF_INET;
-        dest_addr.sin_port = htons(PORT);
-        addr_family = AF_INET;
-        ip_protocol = IPPROTO_IP;
-#elif defined(CONFIG_EXAMPLE_IPV6)
-        struct sockaddr_in6 dest_addr = { 0 };
-        inet6_aton(HOST_IP_ADDR, &dest_addr.sin6_addr);
-        dest_addr.sin6_family = AF_INET6;
-        dest_addr.sin6_port = htons(PORT);
-        dest_addr.sin6_scope_id = esp_netif_get_netif_impl_index(EXAMPLE_INTERFACE);
-        addr_family = AF_INET6;
-        ip_protocol = IPPROTO_IPV6;
-#elif defined(CONFIG_EXAMPLE_SOCKET_IP_INPUT_STDIN)
-        struct sockaddr_storage dest_addr = { 0 };
-        ESP_ERROR_CHECK(get_addr_from_stdin(PORT, SOCK_DGRAM, &ip_protocol, &addr_family, &dest_addr));
-#endif
-
-        int sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
-        if (sock < 0) {
-            ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
-            break;
+    g_stream_sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
+    if (g_stream_sock < 0) {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        return -1;
+    }
+#if CONFIG_RADAR_STREAM_MULTICAST
+    uint8_t ttl = CONFIG_RADAR_MULTICAST_TTL;
+    setsockopt(g_stream_sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+#endif
+    return 0;
+}
+
+/**
+ * @brief       Close the stream socket
+ * @param       void
+ *
+ * @retval      void
+ */
+static void udp_stream_close(void)
+{
+    if (g_stream_sock != -1) {
+        shutdown(g_stream_sock, 0);
+        close(g_stream_sock);
+        g_stream_sock = -1;
+    }
+}
+
+/**
+ * @brief       Send one datagram, never blocks
+ * @param       datagram : datagram
+ * @param       len      : datagram len
+ *
+ * @retval      0  : sent
+ * @retval      1  : dropped, the stack could not take it
+ * @retval      -1 : socket error, the socket must be recreated
+ */
+static int udp_stream_send_buffer(const uint8_t* datagram, size_t len)
+{
+    if (sendto(g_stream_sock, datagram, len, MSG_DONTWAIT,
+               (struct sockaddr *)&g_stream_dest_addr, sizeof(g_stream_dest_addr)) < 0) {
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != ENOMEM)) {
+            ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
+            return -1;
         }
+        g_stream_stats.dropped++;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief       Send every slice of a sweep, one datagram each, paced by STREAM_SLICE_INTERVAL
+ *              Sends never block: a slice the stack cannot take is dropped, and can be asked for again
+ * @param       sweep : held sweep
+ *
+ * @retval      0  : success
+ * @retval      -1 : socket error, the socket must be recreated
+ */
+static int udp_stream_send_sweep(const Radar_sweep_t* sweep)
+{
+    uint8_t* payload = &g_stream_datagram[RADAR_STREAM_HEAD_LEN];
+    uint8_t format = Radar_output_get_format(RADAR_OUTPUT_CHANNEL_UDP);
 
-        // Set timeout
-        //struct timeval timeout;
-        //timeout.tv_sec = 10;
-        //timeout.tv_usec = 0;
-        //setsockopt (sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    udp_stream_window_open(sweep, format);
+    for (uint16_t slice = 0; slice <= UINT8_MAX; slice++) {
+        size_t len = Radar_output_encode_page(RADAR_OUTPUT_CHANNEL_UDP, sweep, (uint8_t)slice, payload, STREAM_PAYLOAD_LEN);
+        uint32_t seq;
+        int err;
 
-        ESP_LOGI(TAG, "Socket created, sending to %s:%d", HOST_IP_ADDR, PORT);
+        if (len == 0)
+            break;   /* no more slices */
 
-        int err = sendto(sock, payload, strlen(payload), 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-        if (err < 0) {
-            ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
+        if ((slice != 0) && STREAM_SLICE_INTERVAL)
+            vTaskDelay(STREAM_SLICE_INTERVAL);
+        seq = udp_stream_window_add((uint8_t)slice);
+        udp_stream_put_head(g_stream_datagram, sweep, format, (uint8_t)slice, seq, 0);
+#if STREAM_FEC_GROUP
+        udp_stream_parity_xor(1, payload, len);
+        udp_stream_parity_count(seq, (uint8_t)slice, len);
+#endif
+
+        err = udp_stream_send_buffer(g_stream_datagram, RADAR_STREAM_HEAD_LEN + len);
+        if (err < 0)
+            return -1;
+        if (err == 0)
+            g_stream_stats.sent++;
+#if STREAM_FEC_GROUP
+        if ((g_stream_parity_num == STREAM_FEC_GROUP) && (udp_stream_parity_flush(sweep, format) < 0))
+            return -1;
+#endif
+
+        if (udp_stream_slice_last(format, payload))
             break;
+    }
+#if STREAM_FEC_GROUP
+    return udp_stream_parity_flush(sweep, format);  /* groups never span sweeps */
+#else
+    return 0;
+#endif
+}
+
+#endif
+
+#if STREAM_FEC_GROUP
+
+/**
+ * @brief       Send the parity of the group being sent, and start a new group
+ * @param       sweep  : sweep of the group
+ * @param       format : format of the group
+ *
+ * @retval      0  : success, or nothing to send
+ * @retval      -1 : connection error
+ */
+static int udp_stream_parity_flush(const Radar_sweep_t* sweep, uint8_t format)
+{
+    uint8_t* p = &g_stream_parity[RADAR_STREAM_HEAD_LEN];
+    uint16_t len = g_stream_parity_len;
+    int err;
+
+    if (g_stream_parity_num == 0)
+        return 0;
+    /* parity takes no seq of its own: every gap a receiver sees is a slice it can ask for */
+    udp_stream_put_head(g_stream_parity, sweep, format, 0, g_stream_parity_base, RADAR_STREAM_FLAG_PARITY);
+    p[0] = g_stream_parity_num;
+    p[1] = (uint8_t)(g_stream_parity_len_xor >> 8);
+    p[2] = (uint8_t)(g_stream_parity_len_xor & 0xFF);
+    err = udp_stream_send_buffer(g_stream_parity, RADAR_STREAM_HEAD_LEN + RADAR_STREAM_PARITY_HEAD_LEN + len);
+    if (err == 0)
+        g_stream_stats.parity++;
+
+    memset(&p[RADAR_STREAM_PARITY_HEAD_LEN], 0, len);
+    g_stream_parity_num = 0;
+    g_stream_parity_len = 0;
+    g_stream_parity_len_xor = 0;
+    return err < 0 ? -1 : 0;
+}
+
+#endif
+
+/**
+ * @brief       Send again the slices asked for by NACKs, from the sweeps held by the window
+ *              Delta slices depend on every slice before them: a keyframe is forced instead
+ * @param       void
+ *
+ * @retval      0  : success
+ * @retval      -1 : connection error
+ */
+static int udp_stream_serve_nacks(void)
+{
+    uint32_t seq;
+
+    while (udp_stream_nack_pop(&seq)) {
+        udp_stream_window_t* window = NULL;
+        udp_stream_window_entry_t* entry = NULL;
+        size_t len;
+        int err;
+
+        for (uint8_t w = 0; (w < STREAM_WINDOW_SWEEPS) && (entry == NULL); w++) {
+            for (uint8_t i = 0; i < g_stream_window[w].num; i++) {
+                if (g_stream_window[w].entry[i].seq == seq) {
+                    window = &g_stream_window[w];
+                    entry = &window->entry[i];
+                    break;
+                }
+            }
         }
-        ESP_LOGI(TAG, "Message sent");
+        if ((entry == NULL) || (entry->retransmits >= STREAM_RETRANSMIT_MAX) ||
+            (window->format != Radar_output_get_format(RADAR_OUTPUT_CHANNEL_UDP))) {
+            g_stream_stats.missed++;    /* older sweep, or the pages changed */
+            continue;
+        }
+        if (window->format == RADAR_SWEEP_FORMAT_DELTA) {
+            if (!g_stream_window[0].resynced) {
+                Radar_output_set_format(RADAR_OUTPUT_CHANNEL_UDP, RADAR_SWEEP_FORMAT_DELTA);
+                g_stream_window[0].resynced = true;
+                g_stream_stats.resync++;
+            }
+            continue;
+        }
+
+        /* pages are cut by the same capacity as when first sent, so the slice is the same */
+        len = Radar_output_encode_page(RADAR_OUTPUT_CHANNEL_UDP, window->sweep, entry->slice,
+                                       &g_stream_datagram[RADAR_STREAM_HEAD_LEN], STREAM_PAYLOAD_LEN);
+        if (len == 0) {
+            g_stream_stats.missed++;
+            continue;
+        }
+        udp_stream_put_head(g_stream_datagram, window->sweep, window->format, entry->slice,
+                            seq, RADAR_STREAM_FLAG_RETRANSMIT);
+        entry->retransmits++;
+        err = udp_stream_send_buffer(g_stream_datagram, RADAR_STREAM_HEAD_LEN + len);
+        if (err < 0)
+            return -1;
+        if (err == 0)
+            g_stream_stats.retransmitted++;
+    }
+    return 0;
+}
+
+/**
+ * @brief       UDP send function of the control channel reply handle
+ * @param       reply : reply handle, handle is the control socket and addr the client address
+ * @param       data  : frame
+ * @param       len   : frame len
+ *
+ * @retval      void
+ */
+static void udp_control_send(const Modbus_reply_t* reply, const uint8_t* data, size_t len)
+{
+    struct sockaddr_storage dest_addr;  /* lwip_sendto rejects a destination that is not 4-byte aligned */
+
+    memcpy(&dest_addr, reply->addr, reply->addr_len);
+    /* never wait for one client: a reply the stack cannot take is lost, the client retries */
+    if (sendto(reply->handle, data, len, MSG_DONTWAIT, (const struct sockaddr *)&dest_addr, reply->addr_len) < 0)
+        ESP_LOGD(TAG, "control reply lost: errno %d", errno);
+}
+
+/**
+ * @brief       Control channel: Modbus frames in UDP datagrams, with the same function codes as the UART.
+ *              Each datagram is one request, answered to its source address, so any number of
+ *              clients share the socket and none of them waits for another
+ * @param       pvParameters : unused
+ *
+ * @retval      void
+ */
+static void udp_control_task(void *pvParameters)
+{
+    uint8_t rx_buffer[MODBUS_FRAME_LEN_MAX];
+
+    while (1) {
+#if defined(CONFIG_EXAMPLE_IPV6)
+        struct sockaddr_in6 listen_addr = { 0 };
+        listen_addr.sin6_family = AF_INET6;
+        listen_addr.sin6_port = htons(CONTROL_PORT);
+        int sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_IPV6);
+#else
+        struct sockaddr_in listen_addr = { 0 };
+        listen_addr.sin_family = AF_INET;
+        listen_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        listen_addr.sin_port = htons(CONTROL_PORT);
+        int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+#endif
+        if (sock < 0) {
+            ESP_LOGE(TAG, "Unable to create control socket: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+        if (bind(sock, (struct sockaddr *)&listen_addr, sizeof(listen_addr)) < 0) {
+            ESP_LOGE(TAG, "Control socket unable to bind: errno %d", errno);
+            close(sock);
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+        ESP_LOGI(TAG, "Control channel on port %d", CONTROL_PORT);
 
         while (1) {
-            struct sockaddr_storage source_addr; // Large enough for both IPv4 or IPv6
+            Modbus_reply_t reply = {
+                .send = udp_control_send,
+                .handle = sock,
+                .channel = RADAR_OUTPUT_CHANNEL_UDP,   /* every control client shares the UDP stream */
+            };
+            struct sockaddr_storage source_addr;   /* reply.addr is a byte array, not aligned for the stack */
             socklen_t socklen = sizeof(source_addr);
-            int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer) - 1, 0, (struct sockaddr *)&source_addr, &socklen);
+            int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer), 0, (struct sockaddr *)&source_addr, &socklen);
 
-            // Error occurred during receiving
-            if (len < 0) { 
+            if (len < 0) {
                 ESP_LOGE(TAG, "recvfrom failed: errno %d", errno);
                 break;
             }
-            // Data received
-            else {
-                rx_buffer[len] = 0; // Null-terminate whatever we received and treat like a string
-                ESP_LOGI(TAG, "Received %d bytes from %s:", len, host_ip);
-                ESP_LOGI(TAG, "%s", rx_buffer);
-                if (strncmp(rx_buffer, "reset", 5) == 0) {
-                    ESP_LOGI(TAG, "Received expected message, reset");
-                    break;
-                } else {
-                    err = sendto(sock, payload, len, 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-                    if (err < 0) {
-                        ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
-                        break;
-                    }
-                }
+            if ((len >= RADAR_STREAM_NACK_HEAD_LEN) &&
+                (((rx_buffer[0] << 8) | rx_buffer[1]) == RADAR_STREAM_NACK_MAGIC)) {
+                udp_stream_on_nack(rx_buffer, (size_t)len);    /* a stream receiver lost datagrams */
+                continue;
             }
-
-            vTaskDelay(2000 / portTICK_PERIOD_MS);
+            reply.addr_len = (uint8_t)MIN(socklen, sizeof(reply.addr));
+            memcpy(reply.addr, &source_addr, reply.addr_len);
+            reply.timing.received_us = Radar_latency_now();
+            Modbus_submit(rx_buffer, (size_t)len, &reply);
         }
 
-        if (sock != -1) {
-            ESP_LOGE(TAG, "Shutting down socket and restarting...");
-            shutdown(sock, 0);
-            close(sock);
+        shutdown(sock, 0);
+        close(sock);
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief       Scan streamer: sends every published sweep to the host as UDP datagrams,
+ *              and starts the control channel once WiFi is up
+ *              Acquisition is never held up: the steering task only wakes this task, and a sweep
+ *              published while the previous one is being sent replaces it
+ * @param       pvParameters : unused
+ *
+ * @retval      void
+ */
+void udp_client_task(void *pvParameters)
+{
+    /* the station was started by Radar_manager_init, while the sensors were being set up */
+    if (wifi_wait_connected(portMAX_DELAY) == ESP_OK) {
+        ESP_LOGI(TAG, "WIFI Connent !");
+    } else {
+        ESP_LOGW(TAG, "WIFI Connent Fail!");
+        vTaskDelete(NULL);
+    }
+
+    uint32_t sent_sequence = 0;
+    int64_t sent_time = 0;
+
+    g_stream_task = xTaskGetCurrentTaskHandle();
+    xTaskCreatePinnedToCore(udp_control_task, "udp_control_task", CONTROL_TASK_STACK, NULL,
+                            uxTaskPriorityGet(NULL), NULL, 0);
+    scan_server_start();
+    discovery_start();
+    time_sync_start();
+
+    while (1) {
+        if (udp_stream_open() < 0)
+            break;
+        ESP_LOGI(TAG, "Streaming to %s:%d", HOST_IP_ADDR, PORT);
+
+        while (1) {
+            const Radar_sweep_t* sweep;
+            int err = 0;
+
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);    /* wait for a published sweep or a NACK */
+            if (udp_stream_serve_nacks() < 0)
+                break;
+
+            sweep = Radar_sweep_acquire_latest();
+            if (sweep == NULL)
+                continue;
+            if ((sweep->sequence != sent_sequence) &&
+                (esp_timer_get_time() - sent_time >= (int64_t)Radar_output_get_interval(RADAR_OUTPUT_CHANNEL_UDP) * 1000)) {
+                sent_sequence = sweep->sequence;
+                sent_time = esp_timer_get_time();
+                err = udp_stream_send_sweep(sweep);
+            }
+            Radar_sweep_release(sweep);
+
+            if (err < 0)
+                break;
+            if ((sent_sequence & 0xFF) == 0)
+                ESP_LOGD(TAG, "datagrams sent:%lu dropped:%lu retransmitted:%lu missed:%lu",
+                         (unsigned long)g_stream_stats.sent, (unsigned long)g_stream_stats.dropped,
+                         (unsigned long)g_stream_stats.retransmitted, (unsigned long)g_stream_stats.missed);
         }
+
+        ESP_LOGE(TAG, "Shutting down stream and restarting...");
+        udp_stream_close();
     }
+    g_stream_task = NULL;
     vTaskDelete(NULL);
 }
@@ -0,0 +1,63 @@
+#ifndef _UDP_CLINET_H_
+#define _UDP_CLINET_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#include "radar_sweep.h"
+
+/*
+ * Scan datagram, all fields high byte first:
+ * magic(2) version(1) format(1) device_id(2) sequence(4) timestamp_us(8) slice(1)
+ * duration_us(4) time_quality(1) datagram_seq(4) flags(1) payload...
+ * The payload is one page of the UDP output channel (see sweep_output.h) in the format
+ * selected for that channel, it tells by itself whether the sweep continues.
+ * Slices of one sweep share sequence and timestamp: the first sample of the sweep, in the shared
+ * timebase of time_sync.h (µs since the Unix epoch) with its time_quality, or µs since boot when
+ * time_quality is RADAR_TIME_UNSYNCHRONIZED. The last sample is duration_us later, the samples
+ * in between are taken at an even pace.
+ *
+ * datagram_seq counts every slice of the stream, a lost one shows as a gap. The receiver asks
+ * for it again with a NACK to CONFIG_RADAR_CONTROL_PORT:
+ * magic(2) version(1) count(1) datagram_seq(4) * count
+ * The slices of the last two sweeps sent are answered with the same datagram_seq and
+ * RADAR_STREAM_FLAG_RETRANSMIT; on a delta stream the next sweep starts from a keyframe instead.
+ * With CONFIG_RADAR_STREAM_FEC_GROUP, a RADAR_STREAM_FLAG_PARITY datagram follows every group of
+ * that many slices of one sweep. Its datagram_seq is the one of the first slice of the group, payload:
+ * num(1) len_xor(2) xor...
+ * xor is the XOR of slice(1) payload... of the num slices from datagram_seq, zero padded, and
+ * len_xor the XOR of their payload lengths: one lost slice of the group is rebuilt from the others.
+ * Scan server messages (scan_server.h) carry datagram_seq 0.
+ */
+#define RADAR_STREAM_MAGIC          0x5253  /* "RS" */
+#define RADAR_STREAM_VERSION        0x03
+#define RADAR_STREAM_HEAD_LEN       29
+#define RADAR_STREAM_PARITY_HEAD_LEN 3
+
+#define RADAR_STREAM_FLAG_PARITY     0x01    /* XOR of the slices of a group */
+#define RADAR_STREAM_FLAG_RETRANSMIT 0x02    /* Sent again on a NACK */
+
+#define RADAR_STREAM_NACK_MAGIC     0x524E  /* "RN" */
+#define RADAR_STREAM_NACK_HEAD_LEN  4
+#define RADAR_STREAM_STATS_LEN      28
+
+/* Stream counters since boot */
+typedef struct {
+    uint32_t sent;          /* Slices sent */
+    uint32_t dropped;       /* Datagrams the stack could not take */
+    uint32_t parity;        /* Parity datagrams sent */
+    uint32_t nack;          /* Datagrams asked for again */
+    uint32_t retransmitted; /* Datagrams sent again */
+    uint32_t missed;        /* Datagrams asked for that had left the window */
+    uint32_t resync;        /* Delta keyframes forced by a NACK */
+} udp_stream_stats_t;
+
+esp_err_t udp_stream_init(void); /* subscribe the streamer to published sweeps */
+uint32_t udp_stream_get_dest(uint16_t* port); /* IPv4 destination of the scan stream */
+void udp_stream_put_head(uint8_t* head, const Radar_sweep_t* sweep, uint8_t format, uint8_t slice,
+                         uint32_t seq, uint8_t flags); /* scan datagram header */
+void udp_stream_get_stats(udp_stream_stats_t* stats); /* loss and recovery counters */
+size_t udp_stream_encode_stats(uint8_t* buf, size_t len); /* counters for the Modbus read */
+
+#endif
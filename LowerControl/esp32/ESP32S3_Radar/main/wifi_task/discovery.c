@@ -0,0 +1,250 @@
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "sdkconfig.h"
+
+#include "lwip/sockets.h"
+
+#include "discovery.h"
+#include "UDP_clinet.h"
+#include "mod_bus.h"
+#include "sweep_publish.h"
+#include "sweep_output.h"
+
+#define DISCOVERY_PORT          CONFIG_RADAR_DISCOVERY_PORT
+#define DISCOVERY_GROUP         CONFIG_RADAR_DISCOVERY_GROUP
+#define DISCOVERY_INTERVAL_US   ((int64_t)CONFIG_RADAR_DISCOVERY_INTERVAL_MS * 1000)
+#define DISCOVERY_SPREAD_US     200000  /* Probe answers are spread over this time */
+#define DISCOVERY_TASK_STACK    3072
+
+static const char *TAG = "Discovery";
+
+/**
+ * @brief       Random delay in [0, range_us)
+ * @param       range_us : upper bound
+ *
+ * @retval      delay (µs)
+ */
+static inline int64_t discovery_jitter(int64_t range_us)
+{
+    return range_us > 0 ? (int64_t)(esp_random() % (uint32_t)range_us) : 0;
+}
+
+/**
+ * @brief       Write a big-endian 16-bit value
+ * @param       p     : destination
+ * @param       value : value
+ *
+ * @retval      next byte
+ */
+static inline uint8_t* discovery_put_u16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)(value & 0xFF);
+    return p + 2;
+}
+
+/**
+ * @brief       Write a big-endian 32-bit value
+ * @param       p     : destination
+ * @param       value : value
+ *
+ * @retval      next byte
+ */
+static inline uint8_t* discovery_put_u32(uint8_t* p, uint32_t value)
+{
+    p = discovery_put_u16(p, (uint16_t)(value >> 16));
+    return discovery_put_u16(p, (uint16_t)(value & 0xFFFF));
+}
+
+/**
+ * @brief       Build the announce of this radar
+ * @param       buf : destination, RADAR_DISCOVERY_ANNOUNCE_LEN bytes
+ *
+ * @retval      announce len
+ */
+static size_t discovery_build_announce(uint8_t* buf)
+{
+    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_ip_info_t ip_info = { 0 };
+    const Radar_sweep_t* sweep;
+    uint16_t capabilities = RADAR_DISCOVERY_CAP_CONTROL | RADAR_DISCOVERY_CAP_SERVER;
+    uint16_t stream_port;
+    uint32_t stream_addr = udp_stream_get_dest(&stream_port);
+    uint32_t interval_ms = Radar_output_get_interval(RADAR_OUTPUT_CHANNEL_UDP);
+    uint8_t* p = buf;
+
+#if CONFIG_RADAR_STREAM_MULTICAST
+    capabilities |= RADAR_DISCOVERY_CAP_MULTICAST;
+#endif
+#if CONFIG_RADAR_STREAM_ZERO_COPY
+    capabilities |= RADAR_DISCOVERY_CAP_ZERO_COPY;
+#endif
+#if CONFIG_RADAR_OCCUPANCY_GRID
+    capabilities |= RADAR_DISCOVERY_CAP_OCCUPANCY;
+#endif
+    if (netif != NULL)
+        esp_netif_get_ip_info(netif, &ip_info);
+
+    p = discovery_put_u16(p, RADAR_DISCOVERY_MAGIC);
+    *p++ = RADAR_DISCOVERY_VERSION;
+    *p++ = RADAR_DISCOVERY_TYPE_ANNOUNCE;
+    p = discovery_put_u16(p, Modbus_get_device_address());
+    if (esp_wifi_get_mac(WIFI_IF_STA, p) != ESP_OK)
+        memset(p, 0, 6);
+    p += 6;
+    p = discovery_put_u32(p, ntohl(ip_info.ip.addr));
+    p = discovery_put_u16(p, capabilities);
+    p = discovery_put_u16(p, CONFIG_RADAR_CONTROL_PORT);
+    p = discovery_put_u16(p, CONFIG_RADAR_SERVER_PORT);
+    p = discovery_put_u16(p, stream_port);
+    p = discovery_put_u32(p, ntohl(stream_addr));
+    *p++ = Radar_output_get_format(RADAR_OUTPUT_CHANNEL_UDP);
+    p = discovery_put_u16(p, interval_ms > UINT16_MAX ? UINT16_MAX : (uint16_t)interval_ms);
+
+    sweep = Radar_sweep_acquire_latest();
+    if (sweep != NULL)
+    {
+        p = discovery_put_u16(p, sweep->start_angle);
+        *p++ = sweep->step;
+        p = discovery_put_u16(p, sweep->count);
+        p = discovery_put_u16(p, (uint16_t)sweep->tilt_angle);
+        p = discovery_put_u32(p, sweep->sequence);
+        Radar_sweep_release(sweep);
+    }
+    else
+    {
+        memset(p, 0, 11);   /* not scanning yet */
+        p += 11;
+    }
+    return p - buf;
+}
+
+/**
+ * @brief       Open the discovery socket and join the discovery group
+ * @param       void
+ *
+ * @retval      -1    : error
+ * @retval      other : socket
+ */
+static int discovery_open(void)
+{
+    struct sockaddr_in listen_addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+        .sin_port = htons(DISCOVERY_PORT),
+    };
+    struct ip_mreq mreq = { 0 };
+    uint8_t ttl = CONFIG_RADAR_MULTICAST_TTL;
+    int opt = 1;
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+
+    if (sock < 0)
+    {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        return -1;
+    }
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &opt, sizeof(opt));  /* probes may be broadcast */
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    if (bind(sock, (struct sockaddr *)&listen_addr, sizeof(listen_addr)) < 0)
+    {
+        ESP_LOGE(TAG, "Unable to bind port %d: errno %d", DISCOVERY_PORT, errno);
+        close(sock);
+        return -1;
+    }
+    mreq.imr_multiaddr.s_addr = inet_addr(DISCOVERY_GROUP);
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+        ESP_LOGW(TAG, "Unable to join %s: errno %d, broadcast probes only", DISCOVERY_GROUP, errno);
+    return sock;
+}
+
+/**
+ * @brief       Discovery task: announces this radar to the group and answers probes
+ *              Announces are spread at random so that radars powered on together do not stay in step
+ * @param       pvParameters : unused
+ *
+ * @retval      void
+ */
+static void discovery_task(void *pvParameters)
+{
+    struct sockaddr_in group_addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = inet_addr(DISCOVERY_GROUP),
+        .sin_port = htons(DISCOVERY_PORT),
+    };
+    struct sockaddr_in probe_addr = { 0 };   /* source of the last probe not answered yet */
+    uint8_t buf[RADAR_DISCOVERY_ANNOUNCE_LEN];
+    int64_t announce_at = esp_timer_get_time() + discovery_jitter(DISCOVERY_SPREAD_US);
+    int64_t answer_at = 0;
+    int sock;
+
+    while ((sock = discovery_open()) < 0)
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    ESP_LOGI(TAG, "announcing on %s:%d", DISCOVERY_GROUP, DISCOVERY_PORT);
+
+    while (1)
+    {
+        int64_t now = esp_timer_get_time();
+        int64_t next = announce_at;
+        struct timeval timeout;
+        fd_set read_set;
+
+        if (DISCOVERY_INTERVAL_US && (now >= announce_at))
+        {
+            size_t len = discovery_build_announce(buf);
+            sendto(sock, buf, len, MSG_DONTWAIT, (struct sockaddr *)&group_addr, sizeof(group_addr));
+            announce_at = now + DISCOVERY_INTERVAL_US - DISCOVERY_INTERVAL_US / 8 +
+                          discovery_jitter(DISCOVERY_INTERVAL_US / 4);
+        }
+        if (answer_at && (now >= answer_at))
+        {
+            size_t len = discovery_build_announce(buf);
+            sendto(sock, buf, len, MSG_DONTWAIT, (struct sockaddr *)&probe_addr, sizeof(probe_addr));
+            answer_at = 0;
+        }
+
+        if (!DISCOVERY_INTERVAL_US || (answer_at && (answer_at < announce_at)))
+            next = answer_at ? answer_at : now + 1000000;
+        next = MAX(next - now, 1000);
+        timeout.tv_sec = next / 1000000;
+        timeout.tv_usec = next % 1000000;
+        FD_ZERO(&read_set);
+        FD_SET(sock, &read_set);
+        if (select(sock + 1, &read_set, NULL, NULL, &timeout) <= 0)
+            continue;
+
+        struct sockaddr_in source;
+        socklen_t socklen = sizeof(source);
+        int len = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *)&source, &socklen);
+
+        if ((len >= RADAR_DISCOVERY_PROBE_LEN) &&
+            (((buf[0] << 8) | buf[1]) == RADAR_DISCOVERY_MAGIC) &&
+            (buf[3] == RADAR_DISCOVERY_TYPE_PROBE))
+        {
+            /* every radar hears the probe: each answers the asker alone, after its own random delay */
+            probe_addr = source;
+            if (answer_at == 0)
+                answer_at = esp_timer_get_time() + discovery_jitter(DISCOVERY_SPREAD_US);
+        }
+    }
+}
+
+/**
+ * @brief       Start the discovery task, once the network is up
+ * @param       void
+ *
+ * @retval      void
+ */
+void discovery_start(void)
+{
+    xTaskCreatePinnedToCore(discovery_task, "discovery", DISCOVERY_TASK_STACK, NULL,
+                            uxTaskPriorityGet(NULL), NULL, 0);
+}
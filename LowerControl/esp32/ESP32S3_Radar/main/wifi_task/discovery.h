@@ -0,0 +1,36 @@
+#ifndef _DISCOVERY_H_
+#define _DISCOVERY_H_
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+/*
+ * Discovery on UDP port CONFIG_RADAR_DISCOVERY_PORT, group CONFIG_RADAR_DISCOVERY_GROUP.
+ * Every radar announces itself to the group every CONFIG_RADAR_DISCOVERY_INTERVAL_MS, and answers
+ * a probe (sent to the group or broadcast) to its source after a random delay, so that a site with
+ * many radars does not answer in one burst. All fields high byte first.
+ * probe    : magic(2) version(1) type(1)
+ * announce : magic(2) version(1) type(1) device_address(2) mac(6) ipv4(4) capabilities(2)
+ *            control_port(2) server_port(2) stream_port(2) stream_addr(4)
+ *            format(1) interval_ms(2) start_angle(2) step(1) count(2) tilt_angle(2) sequence(4)
+ * device_address is the Modbus address kept in NVS, stream_addr the destination of the UDP
+ * stream (a multicast group when CONFIG_RADAR_STREAM_MULTICAST is set), format and interval_ms
+ * those of the UDP output channel, and the scan fields describe the last published sweep.
+ */
+#define RADAR_DISCOVERY_MAGIC           0x5244  /* "RD" */
+#define RADAR_DISCOVERY_VERSION         0x01
+#define RADAR_DISCOVERY_TYPE_PROBE      0x01
+#define RADAR_DISCOVERY_TYPE_ANNOUNCE   0x02
+#define RADAR_DISCOVERY_PROBE_LEN       4
+#define RADAR_DISCOVERY_ANNOUNCE_LEN    42
+
+/* capabilities */
+#define RADAR_DISCOVERY_CAP_CONTROL     0x0001  /* UDP control channel */
+#define RADAR_DISCOVERY_CAP_SERVER      0x0002  /* TCP/WebSocket scan server */
+#define RADAR_DISCOVERY_CAP_MULTICAST   0x0004  /* Sweeps are streamed to a multicast group */
+#define RADAR_DISCOVERY_CAP_ZERO_COPY   0x0008  /* Polar LE slices are sent from the sweep buffer */
+#define RADAR_DISCOVERY_CAP_OCCUPANCY   0x0010  /* Occupancy grid function code */
+
+void discovery_start(void); /* start announcing, once the network is up */
+
+#endif
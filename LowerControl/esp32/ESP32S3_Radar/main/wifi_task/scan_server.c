@@ -0,0 +1,781 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/param.h>
+#include <sys/uio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "lwip/sockets.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+
+#include "scan_server.h"
+#include "UDP_clinet.h"
+#include "mod_bus.h"
+#include "sweep_publish.h"
+#include "sweep_output.h"
+#include "sweep_change.h"
+
+#define SERVER_PORT             CONFIG_RADAR_SERVER_PORT
+#define SERVER_CLIENT_MAX       CONFIG_RADAR_SERVER_CLIENT_MAX
+#define SERVER_RX_LEN           512     /* One WebSocket handshake or a few requests */
+#define SERVER_PREFIX_MAX       4       /* Plain length(2) or WebSocket header(2 or 4) */
+#define SERVER_PENDING_LEN      (SERVER_PREFIX_MAX + RADAR_SERVER_MESSAGE_MAX) /* One message the socket did not take */
+#define SERVER_POLL_MS          100
+#define SERVER_TASK_STACK       4096    /* Modbus_submit keeps a request on the stack */
+
+#define WEBSOCKET_GUID          "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WEBSOCKET_OP_TEXT       0x1
+#define WEBSOCKET_OP_BINARY     0x2
+#define WEBSOCKET_OP_CLOSE      0x8
+#define WEBSOCKET_OP_PING       0x9
+#define WEBSOCKET_OP_PONG       0xA
+
+enum
+{
+    SERVER_MODE_NONE        = 0x00, /* Free slot */
+    SERVER_MODE_UNKNOWN     = 0x01, /* Connected, framing not known yet */
+    SERVER_MODE_TCP         = 0x02, /* Length-prefixed messages */
+    SERVER_MODE_WEBSOCKET   = 0x03, /* One binary frame per message */
+};
+
+typedef struct {
+    int sock;
+    uint8_t mode;
+    bool broken;                    /* Write error, the server task closes the connection */
+    uint32_t generation;            /* Tells queued answers for a previous client of the slot apart */
+    SemaphoreHandle_t mutex;        /* One writer at a time: sweep sender, command answers, flush */
+    int64_t sent_us;                /* When the last sweep went out */
+    uint32_t sent_sequence;         /* Last sweep sent */
+    uint32_t dropped;               /* Messages dropped because the client was slow */
+    size_t pending_off;             /* Part of a message the socket did not take yet */
+    size_t pending_len;
+    uint8_t pending[SERVER_PENDING_LEN];
+    size_t rx_len;                  /* Received bytes not handled yet, server task only */
+    uint8_t rx[SERVER_RX_LEN];
+} scan_client_t;
+
+static const char *TAG = "ScanServer";
+
+static scan_client_t g_client[SERVER_CLIENT_MAX];
+static TaskHandle_t g_send_task = NULL;                 /* Woken on every published sweep */
+static uint8_t g_scratch[RADAR_SERVER_MESSAGE_MAX];     /* Page shared by every client of a format, sender task only */
+
+/**
+ * @brief       Publish callback, runs in the steering task: only wakes the sender task
+ * @param       sweep : published sweep
+ *
+ * @retval      void
+ */
+static void scan_server_on_publish(const Radar_sweep_t* sweep)
+{
+    TaskHandle_t task = g_send_task;
+
+    (void)sweep;
+    if (task != NULL)
+        xTaskNotifyGive(task);
+}
+
+/**
+ * @brief       Subscribe the server to published sweeps
+ *              Must be called before the steering task runs
+ * @param       void
+ *
+ * @retval      ESP_OK          : success
+ * @retval      ESP_FAIL        : mutex create fail
+ * @retval      ESP_ERR_NO_MEM  : too many consumers
+ */
+esp_err_t scan_server_init(void)
+{
+    for (int i = 0; i < SERVER_CLIENT_MAX; i++)
+    {
+        g_client[i].sock = -1;
+        g_client[i].mode = SERVER_MODE_NONE;
+        if (g_client[i].mutex == NULL)
+            g_client[i].mutex = xSemaphoreCreateMutex();
+        if (g_client[i].mutex == NULL)
+            return ESP_FAIL;
+    }
+    return Radar_sweep_register_consumer(scan_server_on_publish);
+}
+
+/**
+ * @brief       Message prefix for a body of len bytes
+ * @param       client : destination
+ * @param       opcode : WebSocket opcode, ignored in plain TCP
+ * @param       len    : body len
+ * @param       prefix : destination, SERVER_PREFIX_MAX bytes
+ *
+ * @retval      prefix len
+ */
+static size_t scan_client_prefix(const scan_client_t* client, uint8_t opcode, size_t len, uint8_t* prefix)
+{
+    if (client->mode == SERVER_MODE_WEBSOCKET)
+    {
+        prefix[0] = 0x80 | opcode;  /* FIN */
+        if (len < 126)
+        {
+            prefix[1] = (uint8_t)len;
+            return 2;
+        }
+        prefix[1] = 126;
+        prefix[2] = (uint8_t)(len >> 8);
+        prefix[3] = (uint8_t)(len & 0xFF);
+        return 4;
+    }
+    prefix[0] = (uint8_t)(len >> 8);
+    prefix[1] = (uint8_t)(len & 0xFF);
+    return 2;
+}
+
+/**
+ * @brief       Send what is left of the pending message, client mutex held
+ * @param       client : destination
+ *
+ * @retval      true when nothing is pending any more
+ */
+static bool scan_client_flush(scan_client_t* client)
+{
+    while (client->pending_off < client->pending_len)
+    {
+        int n = send(client->sock, &client->pending[client->pending_off],
+                     client->pending_len - client->pending_off, MSG_DONTWAIT);
+        if (n < 0)
+        {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+                client->broken = true;
+            return false;
+        }
+        client->pending_off += n;
+    }
+    client->pending_off = 0;
+    client->pending_len = 0;
+    return true;
+}
+
+/**
+ * @brief       Keep the part of a message the socket did not take, client mutex held
+ *              The stream must never be cut inside a message, the rest goes out before anything else
+ * @param       client : destination
+ * @param       iov    : message parts
+ * @param       iovcnt : number of parts
+ * @param       skip   : bytes already sent
+ *
+ * @retval      void
+ */
+static void scan_client_keep(scan_client_t* client, const struct iovec* iov, int iovcnt, size_t skip)
+{
+    if (client->pending_off)
+    {
+        memmove(client->pending, &client->pending[client->pending_off], client->pending_len - client->pending_off);
+        client->pending_len -= client->pending_off;
+        client->pending_off = 0;
+    }
+    for (int i = 0; i < iovcnt; i++)
+    {
+        size_t len = iov[i].iov_len;
+        const uint8_t* base = iov[i].iov_base;
+
+        if (skip >= len)
+        {
+            skip -= len;
+            continue;
+        }
+        memcpy(&client->pending[client->pending_len], base + skip, len - skip);
+        client->pending_len += len - skip;
+        skip = 0;
+    }
+}
+
+/**
+ * @brief       Write one message to a client without ever blocking
+ *              A sweep message is dropped while the previous message is still pending (slow client),
+ *              an answer waits behind it as long as there is room
+ * @param       client     : destination
+ * @param       generation : client the message is meant for
+ * @param       opcode     : WebSocket opcode
+ * @param       body       : message body parts, referenced in place
+ * @param       body_num   : number of parts, at most 2
+ * @param       droppable  : true for sweep messages
+ *
+ * @retval      true  : sent or queued
+ * @retval      false : dropped, or the client is gone
+ */
+static bool scan_client_write(scan_client_t* client, uint32_t generation, uint8_t opcode,
+                              const struct iovec* body, int body_num, bool droppable)
+{
+    struct iovec iov[3];
+    uint8_t prefix[SERVER_PREFIX_MAX];
+    size_t total = 0;
+    ssize_t sent = 0;
+    bool taken = false;
+
+    for (int i = 0; i < body_num; i++)
+        total += body[i].iov_len;
+    if ((total > RADAR_SERVER_MESSAGE_MAX) || (body_num > 2))
+        return false;
+
+    xSemaphoreTake(client->mutex, portMAX_DELAY);
+    if (((client->mode != SERVER_MODE_TCP) && (client->mode != SERVER_MODE_WEBSOCKET)) ||
+        client->broken || (client->generation != generation))
+        goto done;
+
+    iov[0].iov_base = prefix;
+    iov[0].iov_len = scan_client_prefix(client, opcode, total, prefix);
+    memcpy(&iov[1], body, body_num * sizeof(struct iovec));
+    total += iov[0].iov_len;
+
+    if (scan_client_flush(client))
+    {
+        sent = writev(client->sock, iov, body_num + 1);
+        if (sent < 0)
+        {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+            {
+                client->broken = true;
+                goto done;
+            }
+            sent = 0;
+        }
+        if ((sent == 0) && droppable)
+            goto done;  /* nothing of it left, drop it whole */
+    }
+    else if (droppable || client->broken ||
+             (client->pending_len - client->pending_off + total > SERVER_PENDING_LEN))
+    {
+        goto done;
+    }
+    scan_client_keep(client, iov, body_num + 1, (size_t)sent);
+    taken = true;
+
+done:
+    if (!taken && droppable)
+        client->dropped++;
+    xSemaphoreGive(client->mutex);
+    return taken;
+}
+
+/**
+ * @brief       Send function of the reply handles of server clients, runs in the execution task
+ * @param       reply : reply handle, handle is the client slot and addr its generation
+ * @param       data  : frame
+ * @param       len   : frame len
+ *
+ * @retval      void
+ */
+static void scan_server_reply_send(const Modbus_reply_t* reply, const uint8_t* data, size_t len)
+{
+    struct iovec body = { .iov_base = (void*)data, .iov_len = len };
+    uint32_t generation;
+
+    if ((reply->handle < 0) || (reply->handle >= SERVER_CLIENT_MAX))
+        return;
+    memcpy(&generation, reply->addr, sizeof(generation));
+    scan_client_write(&g_client[reply->handle], generation, WEBSOCKET_OP_BINARY, &body, 1, false);
+}
+
+/**
+ * @brief       Send one sweep to every due client of a format, each page is encoded once
+ *              In polar LE format the points are referenced in the sweep buffer
+ * @param       sweep   : held sweep
+ * @param       format  : sweep format
+ * @param       members : clients to send to, bit i for slot i
+ * @param       leader  : slot whose output channel encodes the pages
+ *
+ * @retval      void
+ */
+static void scan_server_send_shared(const Radar_sweep_t* sweep, uint8_t format, uint32_t members, uint8_t leader)
+{
+    uint8_t head[RADAR_STREAM_HEAD_LEN + RADAR_OUTPUT_PAGE_HEAD_LEN];
+    uint8_t channel = RADAR_OUTPUT_CHANNEL_CLIENT + leader;
+    size_t capacity = RADAR_SERVER_MESSAGE_MAX - RADAR_STREAM_HEAD_LEN;
+    struct iovec body[2];
+
+    for (uint16_t page = 0; page <= UINT8_MAX; page++)
+    {
+        if (format == RADAR_SWEEP_FORMAT_POLAR_LE)
+        {
+            uint16_t first;
+            uint16_t num;
+
+            if (Radar_output_encode_page_head(channel, sweep, (uint8_t)page, capacity,
+                                              &head[RADAR_STREAM_HEAD_LEN], &first, &num) == 0)
+                return;
+            body[0].iov_base = head;
+            body[0].iov_len = RADAR_STREAM_HEAD_LEN + RADAR_OUTPUT_PAGE_HEAD_LEN;
+            body[1].iov_base = (void*)&sweep->distance[first];    /* little-endian target */
+            body[1].iov_len = num * sizeof(uint16_t);
+        }
+        else
+        {
+            size_t len = Radar_output_encode_page(channel, sweep, (uint8_t)page, g_scratch, capacity);
+            if (len == 0)
+                return;
+            body[0].iov_base = head;
+            body[0].iov_len = RADAR_STREAM_HEAD_LEN;
+            body[1].iov_base = g_scratch;
+            body[1].iov_len = len;
+        }
+        udp_stream_put_head(head, sweep, format, (uint8_t)page, 0, 0);
+
+        for (uint8_t i = 0; i < SERVER_CLIENT_MAX; i++)
+        {
+            if (members & (1UL << i))
+                scan_client_write(&g_client[i], g_client[i].generation, WEBSOCKET_OP_BINARY, body, 2, true);
+        }
+    }
+}
+
+/**
+ * @brief       Send the changes of one sweep to a delta client
+ *              A dropped frame leaves the client model behind, so the next sweep restarts from a keyframe
+ * @param       sweep : held sweep
+ * @param       slot  : client slot
+ *
+ * @retval      void
+ */
+static void scan_server_send_delta(const Radar_sweep_t* sweep, uint8_t slot)
+{
+    uint8_t head[RADAR_STREAM_HEAD_LEN];
+    uint8_t channel = RADAR_OUTPUT_CHANNEL_CLIENT + slot;
+    struct iovec body[2];
+
+    for (uint16_t slice = 0; slice <= UINT8_MAX; slice++)
+    {
+        size_t len = Radar_output_encode_page(channel, sweep, 0, g_scratch,
+                                              RADAR_SERVER_MESSAGE_MAX - RADAR_STREAM_HEAD_LEN);
+        if (len == 0)
+            return;
+        udp_stream_put_head(head, sweep, RADAR_SWEEP_FORMAT_DELTA, (uint8_t)slice, 0, 0);
+        body[0].iov_base = head;
+        body[0].iov_len = sizeof(head);
+        body[1].iov_base = g_scratch;
+        body[1].iov_len = len;
+        if (!scan_client_write(&g_client[slot], g_client[slot].generation, WEBSOCKET_OP_BINARY, body, 2, true))
+        {
+            Radar_output_set_format(channel, RADAR_SWEEP_FORMAT_DELTA);
+            return;
+        }
+        if (!(g_scratch[2] & SWEEP_CHANGE_FLAG_MORE))
+            return;
+    }
+}
+
+/**
+ * @brief       Send a sweep to every client whose rate allows it
+ * @param       sweep : held sweep
+ *
+ * @retval      void
+ */
+static void scan_server_send_sweep(const Radar_sweep_t* sweep)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t due = 0;
+
+    for (uint8_t i = 0; i < SERVER_CLIENT_MAX; i++)
+    {
+        scan_client_t* client = &g_client[i];
+        int64_t interval_us = (int64_t)Radar_output_get_interval(RADAR_OUTPUT_CHANNEL_CLIENT + i) * 1000;
+
+        if (((client->mode != SERVER_MODE_TCP) && (client->mode != SERVER_MODE_WEBSOCKET)) ||
+            (client->sent_sequence == sweep->sequence) || (now - client->sent_us < interval_us))
+            continue;
+        client->sent_sequence = sweep->sequence;
+        client->sent_us = now;
+        due |= 1UL << i;
+    }
+
+    for (uint8_t i = 0; i < SERVER_CLIENT_MAX; i++)
+    {
+        uint8_t format;
+        uint32_t members = 0;
+
+        if (!(due & (1UL << i)))
+            continue;
+        format = Radar_output_get_format(RADAR_OUTPUT_CHANNEL_CLIENT + i);
+        if (format == RADAR_SWEEP_FORMAT_DELTA)
+        {
+            due &= ~(1UL << i);
+            scan_server_send_delta(sweep, i);
+            continue;
+        }
+        for (uint8_t j = i; j < SERVER_CLIENT_MAX; j++)
+        {
+            if ((due & (1UL << j)) && (Radar_output_get_format(RADAR_OUTPUT_CHANNEL_CLIENT + j) == format))
+                members |= 1UL << j;
+        }
+        due &= ~members;
+        scan_server_send_shared(sweep, format, members, i);
+    }
+}
+
+/**
+ * @brief       Sender task: feeds every client from the latest published sweep
+ * @param       pvParameters : unused
+ *
+ * @retval      void
+ */
+static void scan_server_send_task(void *pvParameters)
+{
+    while (1)
+    {
+        const Radar_sweep_t* sweep;
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);    /* wait for a published sweep */
+        sweep = Radar_sweep_acquire_latest();
+        if (sweep == NULL)
+            continue;
+        scan_server_send_sweep(sweep);
+        Radar_sweep_release(sweep);
+    }
+}
+
+/**
+ * @brief       Close a client connection, server task only
+ * @param       slot : client slot
+ *
+ * @retval      void
+ */
+static void scan_server_close(uint8_t slot)
+{
+    scan_client_t* client = &g_client[slot];
+
+    xSemaphoreTake(client->mutex, portMAX_DELAY);
+    ESP_LOGI(TAG, "client %d closed, %lu sweep messages dropped", slot, (unsigned long)client->dropped);
+    shutdown(client->sock, 0);
+    close(client->sock);
+    client->sock = -1;
+    client->mode = SERVER_MODE_NONE;
+    client->broken = false;
+    client->generation++;
+    client->pending_off = 0;
+    client->pending_len = 0;
+    client->rx_len = 0;
+    xSemaphoreGive(client->mutex);
+}
+
+/**
+ * @brief       Take a new connection, server task only
+ * @param       sock : accepted socket
+ *
+ * @retval      void
+ */
+static void scan_server_accept(int sock)
+{
+    int nodelay = 1;
+
+    for (uint8_t i = 0; i < SERVER_CLIENT_MAX; i++)
+    {
+        scan_client_t* client = &g_client[i];
+
+        if (client->mode != SERVER_MODE_NONE)
+            continue;
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        /* every client starts in polar format at the full rate */
+        Radar_output_set_format(RADAR_OUTPUT_CHANNEL_CLIENT + i, RADAR_SWEEP_FORMAT_POLAR);
+        Radar_output_set_interval(RADAR_OUTPUT_CHANNEL_CLIENT + i, 0);
+
+        xSemaphoreTake(client->mutex, portMAX_DELAY);
+        client->sock = sock;
+        client->mode = SERVER_MODE_UNKNOWN;
+        client->sent_us = 0;
+        client->sent_sequence = 0;
+        client->dropped = 0;
+        client->rx_len = 0;
+        xSemaphoreGive(client->mutex);
+        ESP_LOGI(TAG, "client %d connected", i);
+        return;
+    }
+    ESP_LOGW(TAG, "too many clients");
+    close(sock);
+}
+
+/**
+ * @brief       Answer a WebSocket upgrade request held in the receive buffer
+ * @param       client : client
+ * @param       end    : length of the request, blank line included
+ *
+ * @retval      true  : upgraded
+ * @retval      false : not a WebSocket request
+ */
+static bool scan_server_upgrade(scan_client_t* client, size_t end)
+{
+    static const char key_name[] = "Sec-WebSocket-Key:";
+    char response[160];
+    char key[64 + sizeof(WEBSOCKET_GUID)];
+    uint8_t digest[20];
+    uint8_t accept[32];
+    size_t accept_len = 0;
+    size_t key_len = 0;
+    const char* p = NULL;
+    int len;
+
+    client->rx[end - 1] = '\0'; /* the request ends with "\r\n\r\n", the last '\n' is not needed */
+    for (const char* s = (const char*)client->rx; *s; s++)
+    {
+        if (strncasecmp(s, key_name, sizeof(key_name) - 1) == 0)
+        {
+            p = s + sizeof(key_name) - 1;
+            break;
+        }
+    }
+    if (p == NULL)
+        return false;
+    while (*p == ' ')
+        p++;
+    while ((p[key_len] > ' ') && (key_len < 64))
+        key_len++;
+    memcpy(key, p, key_len);
+    memcpy(&key[key_len], WEBSOCKET_GUID, sizeof(WEBSOCKET_GUID) - 1);
+
+    mbedtls_sha1((const unsigned char*)key, key_len + sizeof(WEBSOCKET_GUID) - 1, digest);
+    if (mbedtls_base64_encode(accept, sizeof(accept) - 1, &accept_len, digest, sizeof(digest)) != 0)
+        return false;
+    accept[accept_len] = '\0';
+
+    len = snprintf(response, sizeof(response),
+                   "HTTP/1.1 101 Switching Protocols\r\n"
+                   "Upgrade: websocket\r\n"
+                   "Connection: Upgrade\r\n"
+                   "Sec-WebSocket-Accept: %s\r\n\r\n", (const char*)accept);
+    xSemaphoreTake(client->mutex, portMAX_DELAY);
+    if (send(client->sock, response, len, MSG_DONTWAIT) == len)
+        client->mode = SERVER_MODE_WEBSOCKET;
+    xSemaphoreGive(client->mutex);
+    return client->mode == SERVER_MODE_WEBSOCKET;
+}
+
+/**
+ * @brief       Handle the received bytes of a client, server task only
+ * @param       slot : client slot
+ *
+ * @retval      true  : ok
+ * @retval      false : protocol error, close the connection
+ */
+static bool scan_server_receive(uint8_t slot)
+{
+    scan_client_t* client = &g_client[slot];
+    Modbus_reply_t reply = {
+        .send = scan_server_reply_send,
+        .handle = slot,
+        .channel = RADAR_OUTPUT_CHANNEL_CLIENT + slot,
+        .addr_len = sizeof(uint32_t),
+        .timing.received_us = Radar_latency_now(),   /* every request of this read shares the receive stamp */
+    };
+    size_t used = 0;
+
+    memcpy(reply.addr, &client->generation, sizeof(uint32_t));
+
+    if (client->mode == SERVER_MODE_UNKNOWN)
+    {
+        if (client->rx_len < 4)
+            return true;
+        if (memcmp(client->rx, "GET ", 4) != 0)
+        {
+            client->mode = SERVER_MODE_TCP;
+        }
+        else
+        {
+            for (size_t i = 3; i < client->rx_len; i++)
+            {
+                if (memcmp(&client->rx[i - 3], "\r\n\r\n", 4) == 0)
+                {
+                    if (!scan_server_upgrade(client, i + 1))
+                        return false;
+                    used = i + 1;
+                    break;
+                }
+            }
+            if (used == 0)
+                return client->rx_len < SERVER_RX_LEN;  /* wait for the end of the request */
+        }
+    }
+
+    while (used < client->rx_len)
+    {
+        uint8_t* p = &client->rx[used];
+        size_t avail = client->rx_len - used;
+        size_t head;
+        size_t len;
+
+        if (client->mode == SERVER_MODE_TCP)
+        {
+            if (avail < 2)
+                break;
+            len = ((size_t)p[0] << 8) | p[1];
+            if (len > MODBUS_FRAME_LEN_MAX)
+                return false;
+            if (avail < 2 + len)
+                break;
+            Modbus_submit(&p[2], len, &reply);
+            used += 2 + len;
+        }
+        else
+        {
+            uint8_t opcode;
+
+            if (avail < 2)
+                break;
+            opcode = p[0] & 0x0F;
+            len = p[1] & 0x7F;
+            head = 2;
+            if (len == 127)
+                return false;   /* far larger than any request */
+            if (len == 126)
+            {
+                if (avail < 4)
+                    break;
+                len = ((size_t)p[2] << 8) | p[3];
+                head = 4;
+            }
+            if (p[1] & 0x80)
+                head += 4;      /* masking key */
+            if (head + len > SERVER_RX_LEN)
+                return false;
+            if (avail < head + len)
+                break;
+            if (p[1] & 0x80)
+            {
+                const uint8_t* mask = &p[head - 4];
+                for (size_t i = 0; i < len; i++)
+                    p[head + i] ^= mask[i & 3];
+            }
+
+            if ((opcode == WEBSOCKET_OP_BINARY) || (opcode == WEBSOCKET_OP_TEXT))
+            {
+                Modbus_submit(&p[head], len, &reply);
+            }
+            else if (opcode == WEBSOCKET_OP_PING)
+            {
+                struct iovec body = { .iov_base = &p[head], .iov_len = len };
+                scan_client_write(client, client->generation, WEBSOCKET_OP_PONG, &body, 1, false);
+            }
+            else if (opcode == WEBSOCKET_OP_CLOSE)
+            {
+                return false;
+            }
+            used += head + len;
+        }
+    }
+
+    memmove(client->rx, &client->rx[used], client->rx_len - used);
+    client->rx_len -= used;
+    return true;
+}
+
+/**
+ * @brief       Server task: accepts clients, reads their requests and flushes slow clients
+ * @param       pvParameters : unused
+ *
+ * @retval      void
+ */
+static void scan_server_task(void *pvParameters)
+{
+    struct sockaddr_in listen_addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+        .sin_port = htons(SERVER_PORT),
+    };
+    int opt = 1;
+    int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+
+    if (listen_sock < 0)
+    {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        vTaskDelete(NULL);
+    }
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if ((bind(listen_sock, (struct sockaddr *)&listen_addr, sizeof(listen_addr)) < 0) ||
+        (listen(listen_sock, SERVER_CLIENT_MAX) < 0))
+    {
+        ESP_LOGE(TAG, "Unable to listen on port %d: errno %d", SERVER_PORT, errno);
+        close(listen_sock);
+        vTaskDelete(NULL);
+    }
+    ESP_LOGI(TAG, "listening on port %d", SERVER_PORT);
+
+    while (1)
+    {
+        fd_set read_set;
+        fd_set write_set;
+        int max_fd = listen_sock;
+        struct timeval timeout = { .tv_sec = 0, .tv_usec = SERVER_POLL_MS * 1000 };
+
+        FD_ZERO(&read_set);
+        FD_ZERO(&write_set);
+        FD_SET(listen_sock, &read_set);
+        for (uint8_t i = 0; i < SERVER_CLIENT_MAX; i++)
+        {
+            if (g_client[i].mode == SERVER_MODE_NONE)
+                continue;
+            FD_SET(g_client[i].sock, &read_set);
+            if (g_client[i].pending_len)
+                FD_SET(g_client[i].sock, &write_set);
+            max_fd = MAX(max_fd, g_client[i].sock);
+        }
+
+        if (select(max_fd + 1, &read_set, &write_set, NULL, &timeout) < 0)
+        {
+            ESP_LOGE(TAG, "select failed: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(SERVER_POLL_MS));
+            continue;
+        }
+
+        if (FD_ISSET(listen_sock, &read_set))
+        {
+            int sock = accept(listen_sock, NULL, NULL);
+            if (sock >= 0)
+                scan_server_accept(sock);
+        }
+
+        for (uint8_t i = 0; i < SERVER_CLIENT_MAX; i++)
+        {
+            scan_client_t* client = &g_client[i];
+            bool alive = true;
+
+            if (client->mode == SERVER_MODE_NONE)
+                continue;
+            if (FD_ISSET(client->sock, &write_set))
+            {
+                xSemaphoreTake(client->mutex, portMAX_DELAY);
+                scan_client_flush(client);
+                xSemaphoreGive(client->mutex);
+            }
+            if (FD_ISSET(client->sock, &read_set))
+            {
+                int len = recv(client->sock, &client->rx[client->rx_len], SERVER_RX_LEN - client->rx_len, 0);
+                if ((len <= 0) && !((len < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))))
+                    alive = false;
+                else if (len > 0)
+                {
+                    client->rx_len += len;
+                    alive = scan_server_receive(i);
+                }
+            }
+            if (!alive || client->broken)
+                scan_server_close(i);
+        }
+    }
+}
+
+/**
+ * @brief       Start the server tasks, once the network is up
+ * @param       void
+ *
+ * @retval      void
+ */
+void scan_server_start(void)
+{
+    UBaseType_t priority = uxTaskPriorityGet(NULL);
+
+    xTaskCreatePinnedToCore(scan_server_send_task, "scan_server_send", SERVER_TASK_STACK, NULL,
+                            priority, &g_send_task, 0);
+    xTaskCreatePinnedToCore(scan_server_task, "scan_server", SERVER_TASK_STACK, NULL,
+                            priority, NULL, 0);
+}
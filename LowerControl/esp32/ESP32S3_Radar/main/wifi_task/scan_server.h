@@ -0,0 +1,23 @@
+#ifndef _SCAN_SERVER_H_
+#define _SCAN_SERVER_H_
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+/*
+ * TCP scan server on CONFIG_RADAR_SERVER_PORT, up to CONFIG_RADAR_SERVER_CLIENT_MAX clients.
+ * The first bytes of a connection choose the framing:
+ *   plain TCP : every message is len(2, high byte first) + body
+ *   WebSocket : HTTP upgrade ("GET "), then every message is one binary frame holding a body
+ * Body from the client: one Modbus request frame, with the same function codes as the UART.
+ * Body to the client: a Modbus answer (starts with MODBUS_SLAVE_FRAME_HEAD) or a scan message
+ * (starts with RADAR_STREAM_MAGIC, laid out like the UDP datagrams of UDP_clinet.h).
+ * Each client has its own output channel: sweep format with function code 0x09,
+ * highest sweep rate with function code 0x01.
+ */
+#define RADAR_SERVER_MESSAGE_MAX    CONFIG_RADAR_STREAM_DATAGRAM_LEN   /* Largest message body */
+
+esp_err_t scan_server_init(void); /* subscribe the server to published sweeps */
+void scan_server_start(void); /* start the server tasks, once the network is up */
+
+#endif
@@ -0,0 +1,275 @@
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "lwip/sockets.h"
+
+#include "time_sync.h"
+
+#define TIME_PORT               CONFIG_RADAR_TIME_PORT
+#define TIME_POLL_MS            CONFIG_RADAR_TIME_POLL_MS
+#define TIME_FAST_POLL_MS       200         /* Until the clock filter is full */
+#define TIME_TIMEOUT_MS         500         /* A later response is stale */
+#define TIME_FILTER_LEN         8           /* The sample with the shortest round trip of the last ones is kept */
+#define TIME_DRIFT_SPAN_US      10000000LL  /* Shortest time a drift is measured over */
+#define TIME_DRIFT_MAX_PPB      500000      /* Beyond any crystal, the server clock was set */
+#define TIME_STEP_US            100000      /* An offset this far from the model restarts the estimation */
+#define TIME_TOLERANCE_PPB      50000       /* Drift error assumed before the drift is measured */
+#define TIME_TOLERANCE_DRIFT_PPB 2000       /* Drift error assumed once it is measured */
+#define TIME_TASK_STACK         3072
+
+typedef struct {
+    int64_t local_us;   /* Radar clock halfway through the exchange */
+    int64_t offset_us;  /* Shared clock minus radar clock */
+    int64_t delay_us;   /* Round trip, without the server time */
+} time_sample_t;
+
+/* shared = local + offset_us + (local - local_us) * drift_ppb / 1e9 */
+typedef struct {
+    bool valid;
+    bool drift_valid;
+    int64_t local_us;
+    int64_t offset_us;
+    int32_t drift_ppb;  /* How much faster the shared clock runs than the radar clock */
+    int64_t error_us;   /* Error bound at local_us */
+} time_model_t;
+
+static const char *TAG = "TimeSync";
+
+static time_model_t g_time_model;                   /* Written by the sync task, read by any task */
+static portMUX_TYPE g_time_lock = portMUX_INITIALIZER_UNLOCKED;
+static time_sample_t g_time_filter[TIME_FILTER_LEN]; /* Sync task only */
+static uint8_t g_time_filter_num = 0;
+static uint8_t g_time_filter_next = 0;
+static time_sample_t g_time_drift_ref;              /* Start of the current drift measurement */
+
+/**
+ * @brief       Quality of an error bound
+ * @param       error_us : error bound (µs)
+ *
+ * @retval      smallest n with error_us < 2^n
+ */
+static uint8_t time_sync_quality(int64_t error_us)
+{
+    uint8_t n = 1;
+
+    while ((n < 62) && ((1LL << n) <= error_us))
+        n++;
+    return n;
+}
+
+/**
+ * @brief       Convert a radar clock time to the shared timebase
+ * @param       local_us : radar clock (µs since boot, esp_timer_get_time)
+ * @param       quality  : out, may be NULL; RADAR_TIME_UNSYNCHRONIZED when not synchronized yet,
+ *                         else the error is below 2^quality µs
+ *
+ * @retval      shared time (µs since the Unix epoch), or local_us when not synchronized
+ */
+int64_t time_sync_to_shared(int64_t local_us, uint8_t* quality)
+{
+    time_model_t model;
+    int64_t elapsed;
+
+    taskENTER_CRITICAL(&g_time_lock);
+    model = g_time_model;
+    taskEXIT_CRITICAL(&g_time_lock);
+
+    if (!model.valid)
+    {
+        if (quality)
+            *quality = RADAR_TIME_UNSYNCHRONIZED;
+        return local_us;
+    }
+    elapsed = local_us - model.local_us;
+    if (quality)
+        *quality = time_sync_quality(model.error_us + llabs(elapsed) *
+                   (model.drift_valid ? TIME_TOLERANCE_DRIFT_PPB : TIME_TOLERANCE_PPB) / 1000000000LL);
+    return local_us + model.offset_us + elapsed * model.drift_ppb / 1000000000LL;
+}
+
+/**
+ * @brief       Add a sample to the clock filter and update the model from the best one
+ *              The sample with the shortest round trip is the one least delayed by queueing
+ * @param       sample : new sample
+ *
+ * @retval      void
+ */
+static void time_sync_update(const time_sample_t* sample)
+{
+    time_model_t model = g_time_model;  /* only this task writes it */
+    const time_sample_t* best;
+
+    if (model.valid)
+    {
+        int64_t predicted = model.offset_us + (sample->local_us - model.local_us) * model.drift_ppb / 1000000000LL;
+        if (llabs(sample->offset_us - predicted) > TIME_STEP_US + sample->delay_us)
+        {
+            ESP_LOGW(TAG, "server clock stepped by %lld us, restarting", (long long)(sample->offset_us - predicted));
+            g_time_filter_num = 0;
+            g_time_filter_next = 0;
+            model.valid = false;
+            model.drift_valid = false;
+            model.drift_ppb = 0;
+        }
+    }
+
+    g_time_filter[g_time_filter_next] = *sample;
+    g_time_filter_next = (g_time_filter_next + 1) % TIME_FILTER_LEN;
+    if (g_time_filter_num < TIME_FILTER_LEN)
+        g_time_filter_num++;
+    best = &g_time_filter[0];
+    for (uint8_t i = 1; i < g_time_filter_num; i++)
+    {
+        if (g_time_filter[i].delay_us < best->delay_us)
+            best = &g_time_filter[i];
+    }
+
+    if (!model.valid)
+        g_time_drift_ref = *best;
+    else if (best->local_us - g_time_drift_ref.local_us >= TIME_DRIFT_SPAN_US)
+    {
+        int64_t drift = (best->offset_us - g_time_drift_ref.offset_us) * 1000000000LL /
+                        (best->local_us - g_time_drift_ref.local_us);
+        if (llabs(drift) <= TIME_DRIFT_MAX_PPB)
+        {
+            /* a quarter of each new measurement, the offset noise averages out */
+            model.drift_ppb = model.drift_valid ? (int32_t)(model.drift_ppb + (drift - model.drift_ppb) / 4) : (int32_t)drift;
+            model.drift_valid = true;
+        }
+        g_time_drift_ref = *best;
+    }
+
+    model.valid = true;
+    model.local_us = best->local_us;
+    model.offset_us = best->offset_us;
+    model.error_us = best->delay_us / 2 + 1;
+
+    taskENTER_CRITICAL(&g_time_lock);
+    g_time_model = model;
+    taskEXIT_CRITICAL(&g_time_lock);
+}
+
+/**
+ * @brief       Read a big-endian 64-bit value
+ * @param       p : source
+ *
+ * @retval      value
+ */
+static int64_t time_sync_get_i64(const uint8_t* p)
+{
+    uint64_t value = 0;
+
+    for (int i = 0; i < 8; i++)
+        value = (value << 8) | p[i];
+    return (int64_t)value;
+}
+
+/**
+ * @brief       Address of the reference server
+ * @param       void
+ *
+ * @retval      NULL  : none configured
+ * @retval      other : IPv4 address
+ */
+static const char* time_sync_server(void)
+{
+    if (CONFIG_RADAR_TIME_SERVER[0] != '\0')
+        return CONFIG_RADAR_TIME_SERVER;
+#if defined(CONFIG_EXAMPLE_IPV4)
+    return CONFIG_EXAMPLE_IPV4_ADDR;    /* the host of the UDP client configuration */
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * @brief       Time sync task: one exchange with the reference server every poll interval
+ * @param       pvParameters : unused
+ *
+ * @retval      void
+ */
+static void time_sync_task(void *pvParameters)
+{
+    const char* server = time_sync_server();
+    struct sockaddr_in server_addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(TIME_PORT),
+    };
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = TIME_TIMEOUT_MS * 1000 };
+    uint8_t buf[RADAR_TIME_RESPONSE_LEN + 1];
+    uint16_t sequence = 0;
+    int sock;
+
+    if (server == NULL)
+    {
+        ESP_LOGW(TAG, "no time server configured");
+        vTaskDelete(NULL);
+    }
+    server_addr.sin_addr.s_addr = inet_addr(server);
+    while ((sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP)) < 0)
+    {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ESP_LOGI(TAG, "syncing with %s:%d", server, TIME_PORT);
+
+    while (1)
+    {
+        int64_t t1 = esp_timer_get_time();
+        int64_t deadline = t1 + TIME_TIMEOUT_MS * 1000LL;
+
+        sequence++;
+        buf[0] = (uint8_t)(RADAR_TIME_MAGIC >> 8);
+        buf[1] = (uint8_t)(RADAR_TIME_MAGIC & 0xFF);
+        buf[2] = RADAR_TIME_VERSION;
+        buf[3] = RADAR_TIME_TYPE_REQUEST;
+        buf[4] = (uint8_t)(sequence >> 8);
+        buf[5] = (uint8_t)(sequence & 0xFF);
+        for (int i = 0; i < 8; i++)
+            buf[6 + i] = (uint8_t)((uint64_t)t1 >> (56 - 8 * i));
+        sendto(sock, buf, RADAR_TIME_REQUEST_LEN, 0, (struct sockaddr *)&server_addr, sizeof(server_addr));
+
+        while (esp_timer_get_time() < deadline)
+        {
+            int len = recv(sock, buf, sizeof(buf), 0);
+            int64_t t4 = esp_timer_get_time();
+            int64_t t2;
+            int64_t t3;
+            time_sample_t sample;
+
+            if (len < 0)
+                break;  /* timeout */
+            if ((len != RADAR_TIME_RESPONSE_LEN) ||
+                (((buf[0] << 8) | buf[1]) != RADAR_TIME_MAGIC) || (buf[3] != RADAR_TIME_TYPE_RESPONSE) ||
+                ((uint16_t)((buf[4] << 8) | buf[5]) != sequence) || (time_sync_get_i64(&buf[6]) != t1))
+                continue;   /* stray or late answer */
+            t2 = time_sync_get_i64(&buf[14]);
+            t3 = time_sync_get_i64(&buf[22]);
+            sample.local_us = t1 + (t4 - t1) / 2;
+            sample.delay_us = (t4 - t1) - (t3 - t2);
+            sample.offset_us = ((t2 + t3) - (t1 + t4)) / 2;
+            if (sample.delay_us >= 0)
+                time_sync_update(&sample);
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(g_time_filter_num < TIME_FILTER_LEN ? TIME_FAST_POLL_MS : TIME_POLL_MS));
+    }
+}
+
+/**
+ * @brief       Start the time sync client, once the network is up
+ * @param       void
+ *
+ * @retval      void
+ */
+void time_sync_start(void)
+{
+    xTaskCreatePinnedToCore(time_sync_task, "time_sync", TIME_TASK_STACK, NULL,
+                            uxTaskPriorityGet(NULL), NULL, 0);
+}
@@ -0,0 +1,31 @@
+#ifndef _TIME_SYNC_H_
+#define _TIME_SYNC_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * NTP-style exchange with the reference server on UDP port CONFIG_RADAR_TIME_PORT,
+ * all fields high byte first, times in µs:
+ * request  : magic(2) version(1) type(1) sequence(2) t1(8)
+ * response : magic(2) version(1) type(1) sequence(2) t1(8) t2(8) t3(8)
+ * t1 is the radar clock when the request left, echoed back; t2 and t3 are the server clock
+ * (µs since the Unix epoch) when the request arrived and when the response left.
+ */
+#define RADAR_TIME_MAGIC            0x5254  /* "RT" */
+#define RADAR_TIME_VERSION          0x01
+#define RADAR_TIME_TYPE_REQUEST     0x01
+#define RADAR_TIME_TYPE_RESPONSE    0x02
+#define RADAR_TIME_REQUEST_LEN      14
+#define RADAR_TIME_RESPONSE_LEN     30
+
+/*
+ * Quality of a shared timestamp: the error is below 2^quality µs,
+ * RADAR_TIME_UNSYNCHRONIZED when the timestamp is the radar clock (µs since boot)
+ */
+#define RADAR_TIME_UNSYNCHRONIZED   0
+
+void time_sync_start(void); /* start the time sync client, once the network is up */
+int64_t time_sync_to_shared(int64_t local_us, uint8_t* quality); /* radar clock to shared timebase */
+
+#endif
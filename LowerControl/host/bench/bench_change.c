@@ -0,0 +1,206 @@
+/*
+ * Delta sweep format benchmark: bytes sent against the 2-byte polar page, on synthetic indoor
+ * scenes with the firmware defaults (CONFIG_RADAR_CHANGE_TOLERANCE_MM, _KEYFRAME_INTERVAL).
+ * Every frame is applied to a receiver model, and after each sweep every bin of the model must
+ * be within the tolerance of the sweep, so a wrong detector fails the run.
+ *
+ * usage: bench_change [sweeps]
+ */
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sweep_change.h"
+
+#define BENCH_FRAME_MAX         255     /* Modbus data field */
+#define BENCH_POLAR_HEAD        9       /* RADAR_OUTPUT_PAGE_HEAD_LEN */
+#define BENCH_TOLERANCE_MM      20      /* CONFIG_RADAR_CHANGE_TOLERANCE_MM default */
+#define BENCH_KEYFRAME_INTERVAL 50      /* CONFIG_RADAR_CHANGE_KEYFRAME_INTERVAL default */
+
+typedef struct
+{
+    const char* name;
+    double noise_mm;        /* uniform measurement noise, +- */
+    double invalid_ratio;   /* chance of a bin failing its measurement */
+    double box_speed;       /* degrees per sweep the box in front moves, 0 for a static scene */
+} Bench_scene_t;
+
+static const Bench_scene_t g_scenes[] = {
+    { "static +-3mm",          3.0, 0.00, 0.0 },
+    { "static +-10mm",        10.0, 0.00, 0.0 },
+    { "static +-10mm dropout",10.0, 0.01, 0.0 },
+    { "static +-30mm",        30.0, 0.00, 0.0 },
+    { "moving box +-10mm",    10.0, 0.00, 1.0 },
+};
+
+static uint32_t g_rand_state = 0x12345678;
+
+static double Bench_rand(void)
+{
+    g_rand_state ^= g_rand_state << 13;
+    g_rand_state ^= g_rand_state >> 17;
+    g_rand_state ^= g_rand_state << 5;
+    return (double)g_rand_state / 4294967296.0;
+}
+
+/* A 4 m x 3 m room seen from its middle, with a 20° box 600 mm in front of the sensor, 180° at 1° */
+static void Bench_make_sweep(const Bench_scene_t* scene, uint32_t sequence, Radar_sweep_t* sweep)
+{
+    double box = 80.0 + fmod(scene->box_speed * sequence, 140.0);
+
+    memset(sweep, 0, sizeof(*sweep));
+    sweep->sequence = sequence;
+    sweep->step = 1;
+    sweep->count = 181;
+    for (uint16_t i = 0; i < sweep->count; i++)
+    {
+        double a = (double)i * M_PI / 180.0;
+        double c = fabs(cos(a));
+        double s = fabs(sin(a));
+        double d = 1e9;
+
+        if (c > 1e-6)
+            d = 2000.0 / c;
+        if ((s > 1e-6) && (1500.0 / s < d))
+            d = 1500.0 / s;
+        if ((i >= box) && (i <= box + 20.0))
+            d = 600.0;
+        d += (Bench_rand() * 2.0 - 1.0) * scene->noise_mm;
+
+        if (Bench_rand() < scene->invalid_ratio)
+            sweep->distance[i] = RADAR_SWEEP_INVALID_DISTANCE;
+        else
+            sweep->distance[i] = (uint16_t)(d > 8000.0 ? 8000.0 : d);
+    }
+}
+
+/* Bytes of a sweep in 2-byte polar pages */
+static size_t Bench_polar_bytes(uint16_t count)
+{
+    size_t per_page = (BENCH_FRAME_MAX - BENCH_POLAR_HEAD) / 2;
+    size_t pages = (count + per_page - 1) / per_page;
+    return pages * BENCH_POLAR_HEAD + (size_t)count * 2;
+}
+
+static uint16_t Bench_get_u16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+/* Receiver side of sweep_change.h; returns the MORE flag, -1 on a malformed frame */
+static int Bench_apply(const uint8_t* frame, size_t len, uint16_t* model)
+{
+    uint8_t flags = frame[2];
+    uint16_t count = Bench_get_u16(&frame[6]);
+    uint16_t first = Bench_get_u16(&frame[8]);
+    uint16_t num = Bench_get_u16(&frame[10]);
+    const uint8_t* p = &frame[SWEEP_CHANGE_HEAD_LEN];
+
+    if ((len < SWEEP_CHANGE_HEAD_LEN) || (count > RADAR_SWEEP_POINT_MAX))
+        return -1;
+    if (flags & SWEEP_CHANGE_FLAG_KEYFRAME)
+    {
+        if ((len != SWEEP_CHANGE_HEAD_LEN + 2u * num) || (first + num > count))
+            return -1;
+        for (uint16_t i = 0; i < num; i++, p += 2)
+            model[first + i] = Bench_get_u16(p);
+    }
+    else
+    {
+        if (len != SWEEP_CHANGE_HEAD_LEN + 4u * num)
+            return -1;
+        for (uint16_t i = 0; i < num; i++, p += 4)
+        {
+            uint16_t bin = Bench_get_u16(p);
+            if (bin >= count)
+                return -1;
+            model[bin] = Bench_get_u16(p + 2);
+        }
+    }
+    return (flags & SWEEP_CHANGE_FLAG_MORE) != 0;
+}
+
+static int Bench_model_matches(const Radar_sweep_t* sweep, const uint16_t* model)
+{
+    for (uint16_t i = 0; i < sweep->count; i++)
+    {
+        uint16_t d = sweep->distance[i];
+
+        if ((d == RADAR_SWEEP_INVALID_DISTANCE) || (model[i] == RADAR_SWEEP_INVALID_DISTANCE))
+        {
+            if (d != model[i])
+                return 0;
+        }
+        else if (abs((int)d - (int)model[i]) > BENCH_TOLERANCE_MM)
+            return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long sweeps = 5000;
+    static Radar_sweep_t sweep;
+    static Sweep_change_t change;
+    static uint16_t model[RADAR_SWEEP_POINT_MAX];
+    uint8_t frame[BENCH_FRAME_MAX];
+
+    if (argc > 1)
+    {
+        char* end;
+
+        errno = 0;
+        sweeps = strtoul(argv[1], &end, 10);
+        if ((argc > 2) || (errno != 0) || (end == argv[1]) || (*end != '\0') || (sweeps == 0))
+        {
+            fprintf(stderr, "usage: bench_change [sweeps]\n");
+            return 2;
+        }
+    }
+
+    printf("tolerance_mm %d keyframe_interval %d sweeps %lu\n", BENCH_TOLERANCE_MM, BENCH_KEYFRAME_INTERVAL, sweeps);
+    printf("%-22s %8s %8s %7s %7s\n", "scene", "polar B", "delta B", "ratio", "frames");
+    for (size_t s = 0; s < sizeof(g_scenes) / sizeof(g_scenes[0]); s++)
+    {
+        const Bench_scene_t* scene = &g_scenes[s];
+        size_t polar_bytes = 0;
+        size_t delta_bytes = 0;
+        size_t frames = 0;
+
+        g_rand_state = 0x12345678;
+        Sweep_change_init(&change, BENCH_TOLERANCE_MM, BENCH_KEYFRAME_INTERVAL);
+        for (uint32_t n = 1; n <= sweeps; n++)
+        {
+            int more;
+
+            Bench_make_sweep(scene, n, &sweep);
+            polar_bytes += Bench_polar_bytes(sweep.count);
+            do
+            {
+                size_t len = Sweep_change_encode(&change, &sweep, frame, sizeof(frame));
+
+                more = len ? Bench_apply(frame, len, model) : -1;
+                if (more < 0)
+                {
+                    fprintf(stderr, "%s: sweep %u gives a malformed frame\n", scene->name, (unsigned)n);
+                    return 1;
+                }
+                delta_bytes += len;
+                frames++;
+            } while (more);
+            if (!Bench_model_matches(&sweep, model))
+            {
+                fprintf(stderr, "%s: receiver model off by more than the tolerance after sweep %u\n",
+                        scene->name, (unsigned)n);
+                return 1;
+            }
+        }
+
+        printf("%-22s %8.1f %8.1f %6.2fx %7.2f\n", scene->name,
+               (double)polar_bytes / sweeps, (double)delta_bytes / sweeps,
+               (double)polar_bytes / (double)delta_bytes, (double)frames / sweeps);
+    }
+    return 0;
+}
@@ -0,0 +1,301 @@
+/*
+ * Client library throughput benchmark against local device simulators.
+ *   serial : a thread plays the radar on a pty, answering 0x0A reads back to back with polar pages
+ *            (three 0x0A answers per 361-point sweep); the client parses them in place from its
+ *            receive ring and rebuilds the sweeps. With a noise period n, every n-th frame is
+ *            preceded by junk bytes and every (n+1)-th has a broken checksum.
+ *   udp    : a thread sends v3 scan messages with the same pages over loopback; the client
+ *            receives them with recvmmsg, batch 1 then batch 32.
+ * Reports sweeps/s, MB/s and the client's CPU time per sweep (its thread only).
+ *
+ * usage: bench_client [seconds per mode] [noise period]
+ */
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "radar_client/client.hpp"
+#include "radar_client/sweep.hpp"
+
+#define BENCH_POINTS        361     /* RADAR_SWEEP_POINT_MAX: 0..360° at 1° */
+#define BENCH_PAGE_POINTS   121     /* 9 + 2 * 121 bytes fit a 0x0A answer */
+#define BENCH_PAGE_COUNT    ((BENCH_POINTS + BENCH_PAGE_POINTS - 1) / BENCH_PAGE_POINTS)
+#define BENCH_UDP_PORT      3433
+
+static std::atomic<bool> g_run;
+
+static double Bench_clock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// CPU time of the calling thread, the client never runs anywhere else
+static double Bench_thread_cpu()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+// Pages carry the low 16 bits of the sequence only
+static uint16_t Bench_distance(uint16_t sequence, unsigned bin)
+{
+    return (uint16_t)(1000 + (((unsigned)sequence * 7 + bin * 13) % 3000));
+}
+
+// Polar page of the sweep, high byte first (sweep_output.h); returns its length
+static size_t Bench_page(uint8_t* buf, uint32_t sequence, unsigned page)
+{
+    unsigned first = page * BENCH_PAGE_POINTS;
+    unsigned num = (first + BENCH_PAGE_POINTS > BENCH_POINTS) ? BENCH_POINTS - first : BENCH_PAGE_POINTS;
+
+    radar::put_u16(&buf[0], (uint16_t)sequence);
+    buf[2] = (uint8_t)page;
+    buf[3] = BENCH_PAGE_COUNT;
+    buf[4] = radar::sweep::kPolar;
+    radar::put_u16(&buf[5], (uint16_t)first);
+    buf[7] = 1;
+    buf[8] = (uint8_t)num;
+    for (unsigned i = 0; i < num; i++)
+        radar::put_u16(&buf[9 + 2 * i], Bench_distance((uint16_t)sequence, first + i));
+    return 9 + 2 * num;
+}
+
+static bool Bench_write_all(int fd, const uint8_t* buf, size_t len)
+{
+    while (len)
+    {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// The radar side of the pty: read answers of Modbus_back_xxx, status normal
+static void Bench_serial_device(int master, unsigned noise)
+{
+    static const uint8_t junk[] = { 0x55, 0x00, 0x13, 0x55, 0x0B, 0x00 };
+    uint8_t frame[radar::modbus::kFrameMax];
+    unsigned long frames = 0;
+
+    for (uint32_t sequence = 0; g_run; sequence++)
+    {
+        for (unsigned page = 0; page < BENCH_PAGE_COUNT; page++, frames++)
+        {
+            size_t len = Bench_page(&frame[8], sequence, page);
+
+            frame[0] = radar::modbus::kSlaveHead;
+            frame[1] = radar::modbus::kSensorType;
+            radar::put_u16(&frame[2], 0x0001);
+            frame[4] = radar::modbus::kOptRead;
+            frame[5] = radar::modbus::kNormal;
+            frame[6] = radar::modbus::kSweepData;
+            frame[7] = (uint8_t)len;
+            radar::put_u16(&frame[8 + len], radar::modbus::checksum(frame, 8 + len));
+            if (noise && (frames % noise == 0))
+                Bench_write_all(master, junk, sizeof(junk));
+            if (noise && (frames % (noise + 1) == 0))
+                frame[8 + len + 1] ^= 0x5A;
+            if (!Bench_write_all(master, frame, 10 + len))
+                return;
+        }
+    }
+}
+
+static void Bench_report(const char* mode, double wall, double cpu, unsigned long sweeps, unsigned long bytes)
+{
+    printf("%-10s %9.0f sweeps/s %8.2f MB/s %7.2f us CPU/sweep %5.1f%% CPU\n", mode, (double)sweeps / wall,
+           (double)bytes / wall / 1e6, sweeps ? cpu / (double)sweeps * 1e6 : 0.0, cpu / wall * 100.0);
+}
+
+static int Bench_serial(double seconds, unsigned noise)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    unsigned long frames = 0, sweeps = 0, bytes = 0, bad = 0;
+
+    if ((master < 0) || (grantpt(master) < 0) || (unlockpt(master) < 0))
+    {
+        perror("posix_openpt");
+        return 1;
+    }
+
+    radar::SerialLink link(ptsname(master), 921600, 256 * 1024);
+    radar::SweepAssembler assembler;
+    radar::EventLoop loop;
+
+    link.attach(loop, [&](const radar::ModbusFrameView& frame) {
+        frames++;
+        bytes += frame.size();
+        if (!frame.is_read() || (frame.fun_code() != radar::modbus::kSweepData))
+            return;
+        if (assembler.add(radar::sweep::kPolar, frame.payload(), frame.payload_size()))
+        {
+            const Radar_sweep_t& sweep = assembler.sweep();
+            sweeps++;
+            if (sweep.distance[sweep.count - 1] != Bench_distance((uint16_t)sweep.sequence, sweep.count - 1))
+                bad++;
+        }
+    });
+
+    g_run = true;
+    std::thread device(Bench_serial_device, master, noise);
+    double cpu = Bench_thread_cpu();
+    double start = Bench_clock();
+    while (Bench_clock() - start < seconds)
+        loop.run_once(100);
+    double wall = Bench_clock() - start;
+    cpu = Bench_thread_cpu() - cpu;
+    g_run = false;
+    while (loop.run_once(10) > 0)
+        ;   // unblock the device's last write
+    close(master);
+    device.join();
+
+    Bench_report("serial", wall, cpu, sweeps, bytes);
+    printf("           %lu frames, %.1f frames/read, %lu resync bytes, %lu bad checksums, "
+           "%lu incomplete sweeps, %lu wrong\n",
+           frames, link.reads() ? (double)frames / (double)link.reads() : 0.0, link.parser().resyncs(),
+           link.parser().bad_checksums(), assembler.incomplete(), bad);
+    return 0;
+}
+
+// Scan messages as the streamer sends them (udp_stream_put_head), one page each
+static void Bench_udp_device()
+{
+    uint8_t datagram[radar::stream::kDatagramMax] = {};
+    struct sockaddr_in dest = {};
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(BENCH_UDP_PORT);
+    dest.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    radar::put_u16(&datagram[0], radar::stream::kMagic);
+    datagram[2] = radar::stream::kVersion;
+    datagram[3] = radar::sweep::kPolar;
+    for (uint32_t sequence = 0, datagram_seq = 0; g_run; sequence++)
+    {
+        for (unsigned page = 0; page < BENCH_PAGE_COUNT; page++, datagram_seq++)
+        {
+            size_t len = radar::stream::kHeadLen;
+
+            radar::put_u16(&datagram[6], (uint16_t)(sequence >> 16));
+            radar::put_u16(&datagram[8], (uint16_t)sequence);
+            datagram[18] = (uint8_t)page;
+            radar::put_u16(&datagram[24], (uint16_t)(datagram_seq >> 16));
+            radar::put_u16(&datagram[26], (uint16_t)datagram_seq);
+            len += Bench_page(&datagram[len], sequence, page);
+            sendto(sock, datagram, len, 0, reinterpret_cast<struct sockaddr*>(&dest), sizeof(dest));
+        }
+    }
+    close(sock);
+}
+
+static int Bench_udp(double seconds, unsigned batch)
+{
+    unsigned long sweeps = 0, bytes = 0;
+    radar::UdpStream stream(BENCH_UDP_PORT, nullptr, nullptr, batch);
+    radar::SweepAssembler assembler;
+    radar::EventLoop loop;
+    char mode[16];
+
+    stream.attach(loop, [&](const radar::ScanMessageView& message) {
+        bytes += message.size();
+        if (assembler.add(message.format(), message.payload(), message.payload_size()))
+            sweeps++;
+    });
+
+    g_run = true;
+    std::thread device(Bench_udp_device);
+    double cpu = Bench_thread_cpu();
+    double start = Bench_clock();
+    while (Bench_clock() - start < seconds)
+        loop.run_once(100);
+    double wall = Bench_clock() - start;
+    cpu = Bench_thread_cpu() - cpu;
+    g_run = false;
+    device.join();
+
+    snprintf(mode, sizeof(mode), "udp x%u", batch);
+    Bench_report(mode, wall, cpu, sweeps, bytes);
+    printf("           %.1f datagrams/recvmmsg, %lu invalid\n",
+           stream.batches() ? (double)stream.datagrams() / (double)stream.batches() : 0.0, stream.invalid());
+    return 0;
+}
+
+static int Bench_usage(const char* name, int status)
+{
+    fprintf(stderr,
+            "usage: %s [seconds per mode] [noise period]\n"
+            "  seconds per mode  run time of each mode, > 0 (2)\n"
+            "  noise period      junk before every n-th serial frame, 0 for none (0)\n",
+            name);
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = 2.0;
+    unsigned noise = 0;
+    char* end;
+
+    if ((argc > 1) && ((strcmp(argv[1], "-h") == 0) || (strcmp(argv[1], "--help") == 0)))
+        return Bench_usage(argv[0], 0);
+    if (argc > 3)
+        return Bench_usage(argv[0], 2);
+    if (argc > 1)
+    {
+        errno = 0;
+        seconds = strtod(argv[1], &end);
+        if ((errno != 0) || (end == argv[1]) || (*end != '\0') || !std::isfinite(seconds) || (seconds <= 0.0))
+        {
+            fprintf(stderr, "bench_client: bad run time \"%s\"\n", argv[1]);
+            return Bench_usage(argv[0], 2);
+        }
+    }
+    if (argc > 2)
+    {
+        unsigned long value;
+
+        errno = 0;
+        value = strtoul(argv[2], &end, 10);
+        if ((errno != 0) || (end == argv[2]) || (*end != '\0') || (argv[2][0] == '-') || (value > UINT_MAX))
+        {
+            fprintf(stderr, "bench_client: bad noise period \"%s\"\n", argv[2]);
+            return Bench_usage(argv[0], 2);
+        }
+        noise = (unsigned)value;
+    }
+
+    try
+    {
+        if (Bench_serial(seconds, noise) != 0)
+            return 1;
+        Bench_udp(seconds, 1);
+        Bench_udp(seconds, 32);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "bench_client: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
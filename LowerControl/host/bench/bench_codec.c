@@ -0,0 +1,194 @@
+/*
+ * Compact sweep codec benchmark: compression ratio against the 2-byte polar page
+ * and encode/decode throughput, on synthetic indoor scenes.
+ * Every frame is decoded and compared, so a wrong codec fails the run.
+ *
+ * usage: bench_codec [iterations]
+ */
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sweep_codec.h"
+
+#define BENCH_FRAME_MAX     255     /* Modbus data field */
+#define BENCH_POLAR_HEAD    9       /* RADAR_OUTPUT_PAGE_HEAD_LEN */
+
+typedef struct
+{
+    const char* name;
+    uint8_t step;
+    uint16_t count;
+    double noise_mm;        /* measurement noise */
+    double invalid_ratio;   /* chance of a bin starting a dropout */
+} Bench_scene_t;
+
+static const Bench_scene_t g_scenes[] = {
+    { "room 1deg",        1, 181, 3.0,  0.00 },
+    { "room 1deg dropout",1, 181, 3.0,  0.03 },
+    { "room 2deg",        2,  91, 3.0,  0.00 },
+    { "room 1deg noisy",  1, 181, 20.0, 0.01 },
+    { "full 360 0.5m",    1, 361, 3.0,  0.02 },
+};
+
+static uint32_t g_rand_state = 0x12345678;
+
+static double Bench_rand(void)
+{
+    g_rand_state ^= g_rand_state << 13;
+    g_rand_state ^= g_rand_state >> 17;
+    g_rand_state ^= g_rand_state << 5;
+    return (double)g_rand_state / 4294967296.0;
+}
+
+static double Bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* A 4 m x 3 m room seen from its middle, with a box in front of the sensor */
+static void Bench_make_sweep(const Bench_scene_t* scene, uint32_t sequence, Radar_sweep_t* sweep)
+{
+    uint16_t dropout = 0;
+
+    memset(sweep, 0, sizeof(*sweep));
+    sweep->sequence = sequence;
+    sweep->step = scene->step;
+    sweep->count = scene->count;
+    for (uint16_t i = 0; i < scene->count; i++)
+    {
+        double a = (double)(i * scene->step) * M_PI / 180.0;
+        double c = fabs(cos(a));
+        double s = fabs(sin(a));
+        double d = 1e9;
+
+        if (c > 1e-6)
+            d = 2000.0 / c;
+        if ((s > 1e-6) && (1500.0 / s < d))
+            d = 1500.0 / s;
+        if ((i * scene->step >= 80) && (i * scene->step <= 100))
+            d = 600.0;
+        d += (Bench_rand() * 2.0 - 1.0) * scene->noise_mm;
+
+        if (!dropout && (Bench_rand() < scene->invalid_ratio))
+            dropout = 1 + (uint16_t)(Bench_rand() * 6);
+        if (dropout)
+        {
+            dropout--;
+            sweep->distance[i] = RADAR_SWEEP_INVALID_DISTANCE;
+        }
+        else
+            sweep->distance[i] = (uint16_t)(d > 8000.0 ? 8000.0 : d);
+    }
+}
+
+/* Modbus frames needed for a sweep in 2-byte polar pages */
+static size_t Bench_polar_bytes(uint16_t count)
+{
+    size_t per_page = (BENCH_FRAME_MAX - BENCH_POLAR_HEAD) / 2;
+    size_t pages = (count + per_page - 1) / per_page;
+    return pages * BENCH_POLAR_HEAD + (size_t)count * 2;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 20000;
+    static Radar_sweep_t sweeps[16];
+    static Radar_sweep_t decoded;
+    static uint8_t frames[8][BENCH_FRAME_MAX];
+    static size_t frame_len[8];
+
+    if (argc > 1)
+    {
+        unsigned long value;
+        char* end;
+
+        errno = 0;
+        value = strtoul(argv[1], &end, 10);
+        if ((argc > 2) || (errno != 0) || (end == argv[1]) || (*end != '\0') || (argv[1][0] == '-') ||
+            (value == 0) || (value > INT_MAX))
+        {
+            fprintf(stderr, "usage: bench_codec [iterations]\n");
+            return 2;
+        }
+        iterations = (int)value;
+    }
+
+    printf("%-18s %6s %8s %8s %7s %10s %10s\n",
+           "scene", "points", "polar B", "compact", "ratio", "enc ns/pt", "dec ns/pt");
+    for (size_t s = 0; s < sizeof(g_scenes) / sizeof(g_scenes[0]); s++)
+    {
+        const Bench_scene_t* scene = &g_scenes[s];
+        size_t compact_bytes = 0;
+        double t0, enc_time, dec_time;
+        volatile size_t sink = 0;
+
+        for (uint32_t i = 0; i < 16; i++)
+            Bench_make_sweep(scene, i, &sweeps[i]);
+
+        /* Correctness and size over every test sweep */
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            uint16_t bin = 0;
+            memset(&decoded, 0xFF, sizeof(decoded));
+            do
+            {
+                size_t len = Sweep_codec_encode(&sweeps[i], &bin, frames[0], BENCH_FRAME_MAX);
+                if ((len == 0) || (Sweep_codec_decode(frames[0], len, &decoded) != SWEEP_CODEC_EOK))
+                {
+                    fprintf(stderr, "%s: sweep %u does not round-trip\n", scene->name, (unsigned)i);
+                    return 1;
+                }
+                compact_bytes += len;
+            } while (bin < sweeps[i].count);
+            if (memcmp(decoded.distance, sweeps[i].distance, sweeps[i].count * sizeof(uint16_t)) != 0)
+            {
+                fprintf(stderr, "%s: sweep %u decodes to different distances\n", scene->name, (unsigned)i);
+                return 1;
+            }
+        }
+
+        t0 = Bench_now();
+        for (int n = 0; n < iterations; n++)
+        {
+            uint16_t bin = 0;
+            size_t f = 0;
+            do
+            {
+                frame_len[f] = Sweep_codec_encode(&sweeps[n & 15], &bin, frames[f], BENCH_FRAME_MAX);
+                sink += frame_len[f++];
+            } while (bin < sweeps[n & 15].count);
+        }
+        enc_time = Bench_now() - t0;
+
+        {
+            uint16_t bin = 0;
+            size_t f = 0;
+            do
+            {
+                frame_len[f] = Sweep_codec_encode(&sweeps[0], &bin, frames[f], BENCH_FRAME_MAX);
+                f++;
+            } while (bin < sweeps[0].count);
+            t0 = Bench_now();
+            for (int n = 0; n < iterations; n++)
+                for (size_t i = 0; i < f; i++)
+                    sink += Sweep_codec_decode(frames[i], frame_len[i], &decoded);
+            dec_time = Bench_now() - t0;
+        }
+        (void)sink;
+
+        printf("%-18s %6u %8zu %8.1f %6.2fx %10.1f %10.1f\n",
+               scene->name, (unsigned)scene->count, Bench_polar_bytes(scene->count),
+               (double)compact_bytes / 16.0,
+               (double)Bench_polar_bytes(scene->count) * 16.0 / (double)compact_bytes,
+               enc_time * 1e9 / ((double)iterations * scene->count),
+               dec_time * 1e9 / ((double)iterations * scene->count));
+    }
+    return 0;
+}
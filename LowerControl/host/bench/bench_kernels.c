@@ -0,0 +1,84 @@
+/*
+ * Kernel microbenchmarks on Linux: the suite of components/Radar_Bench built on the sim shims,
+ * printing the same "bench_<kernel>_cycles_per_<unit> value" lines as a board booted with
+ * CONFIG_RADAR_BENCH_AT_BOOT, so a run can be diffed against a stored one for regressions.
+ * Cycles are those of sim/include/esp_cpu.h (the x86 time stamp counter); bench_counter_mhz gives
+ * its rate to turn them into time.
+ *
+ * usage: bench_kernels [-r rounds] [-k kernel name part]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "radar_bench.h"
+
+static double Bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Counter ticks per µs over 100 ms */
+static double Bench_counter_mhz(void)
+{
+    double t0 = Bench_now();
+    esp_cpu_cycle_count_t c0 = esp_cpu_get_cycle_count();
+
+    usleep(100000);
+    return (double)(uint32_t)(esp_cpu_get_cycle_count() - c0) / ((Bench_now() - t0) * 1e6);
+}
+
+int main(int argc, char** argv)
+{
+    int rounds = CONFIG_RADAR_BENCH_ROUNDS;
+    const char* filter = NULL;
+    unsigned long value;
+    char* end;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:k:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            errno = 0;
+            value = strtoul(optarg, &end, 10);
+            if ((errno != 0) || (end == optarg) || (*end != '\0') || (optarg[0] == '-') ||
+                (value < 1) || (value > 31))
+            {
+                fprintf(stderr, "bench_kernels: 1 to 31 rounds\n");
+                return 2;
+            }
+            rounds = (int)value;
+            break;
+        case 'k': filter = optarg; break;
+        default:
+            fprintf(stderr, "usage: bench_kernels [-r rounds] [-k kernel name part]\n");
+            return (opt == 'h') ? 0 : 2;
+        }
+    }
+    if (optind < argc)
+    {
+        fprintf(stderr, "usage: bench_kernels [-r rounds] [-k kernel name part]\n");
+        return 2;
+    }
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    printf("bench_rounds %d\n", rounds);
+    printf("bench_counter_mhz %.1f\n", Bench_counter_mhz());
+    if (Radar_bench_run((uint8_t)rounds, filter, Radar_bench_print) == 0)
+    {
+        fprintf(stderr, "bench_kernels: no kernel run\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,336 @@
+/*
+ * Hot-path logging benchmark: Modbus requests handled per second when every request logs its lines
+ * straight to the console UART, when they go through the deferred queue of main/diag_task/radar_log.c,
+ * and when they are compiled out. radar_log.c is the firmware source, on the radar_sim shims: its queue
+ * is sim_freertos, its task a thread, and its lines reach the console model through esp_log_set_vprintf.
+ * The console is modelled as the ESP-IDF one: a 128-byte TX FIFO drained at baud / 10 bytes/s,
+ * the writer busy-waits while the FIFO is full.
+ * Each request logs what the UART, Modbus and dispatch paths logged at INFO before they were
+ * given compile-time levels: the UART event, the received frame, "[receive data]" and the request.
+ *
+ *   immediate : the lines formatted and written on the spot, as before
+ *   deferred  : requests as fast as they come, the lines the queue cannot take are dropped
+ *   sustained : the highest request rate at which the formatting task keeps up, no line dropped
+ *   elided    : release levels, no logging code left
+ * Drops are those radar_log.c reports ("RadarLog: n lines dropped"), hot-path us/req the CPU time of
+ * the requesting thread only. Queue and task costs are those of the shims, not of the board.
+ *
+ * usage: bench_log [seconds per run] [baud]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "radar_log.h"
+
+#define BENCH_FIFO_LEN          128     /* UART TX FIFO of the ESP32-S3 */
+#define BENCH_LINE_MAX          160
+#define BENCH_LINES_PER_REQUEST 4
+#define BENCH_SEARCH_STEPS      8       /* Bisections of the sustained rate */
+#define BENCH_DRAIN_TIMEOUT     10.0    /* s to wait for the formatting task after a run */
+
+/* Console */
+static double g_byte_time;                  /* s per byte */
+static double g_drained_at;                 /* when the FIFO will be empty */
+static unsigned long g_console_bytes;
+static unsigned long g_console_lines;       /* lines written, drop reports excluded */
+static unsigned long g_console_dropped;     /* sum of the drop reports of radar_log.c */
+
+typedef struct {
+    double rate;            /* requests/s */
+    double us_per_request;  /* wall time per request */
+    double cpu_us;          /* CPU time of the requesting thread per request */
+    double busy;            /* that CPU time over the wall time */
+    double console_rate;    /* console B/s */
+    unsigned long lines;    /* lines logged */
+    unsigned long dropped;  /* lines dropped by the queue */
+    unsigned long backlog;  /* lines still queued when the requests stopped */
+} Bench_result_t;
+
+static double Bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static double Bench_thread_cpu(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Blocking console write: wait until the bytes fit in the FIFO, then queue them behind the others */
+static void Bench_console_write(size_t len)
+{
+    while (len)
+    {
+        double now = Bench_now();
+        double pending = (g_drained_at > now) ? (g_drained_at - now) / g_byte_time : 0.0;
+        size_t room = (pending < BENCH_FIFO_LEN) ? BENCH_FIFO_LEN - (size_t)pending : 0;
+
+        if (room == 0)
+            continue;   /* busy-wait, as uart_tx_chars does for the console */
+        if (room > len)
+            room = len;
+        g_drained_at = ((g_drained_at > now) ? g_drained_at : now) + (double)room * g_byte_time;
+        g_console_bytes += room;
+        len -= room;
+    }
+}
+
+/*
+ * esp_log_set_vprintf hook: every line of ESP_LOGx and of the radar_log.c task ends here.
+ * Only one thread writes at a time in each mode, the requests or the formatting task
+ */
+static int Bench_console_vprintf(const char* format, va_list ap)
+{
+    char line[BENCH_LINE_MAX];
+    unsigned long dropped;
+    int len;
+
+    len = vsnprintf(line, sizeof(line), format, ap);
+    if (len <= 0)
+        return len;
+    Bench_console_write((size_t)len < sizeof(line) ? (size_t)len : sizeof(line) - 1);
+    if (sscanf(line, "W (%*u) RadarLog: %lu lines dropped", &dropped) == 1)
+        __atomic_fetch_add(&g_console_dropped, dropped, __ATOMIC_RELAXED);
+    else
+        __atomic_fetch_add(&g_console_lines, 1, __ATOMIC_RELEASE);
+    return len;
+}
+
+/* A read request as Modbus_judgment_recv_data sees it, additive checksum */
+static unsigned Bench_request(const uint8_t* frame, size_t len)
+{
+    uint16_t sum = 0;
+    for (size_t i = 0; i + 2 < len; i++)
+        sum += frame[i];
+    return sum == (uint16_t)((frame[len - 2] << 8) | frame[len - 1]);
+}
+
+/* before: ESP_LOGI and printf formatted and written on the spot */
+static void Bench_log_immediate(const uint8_t* frame, size_t len)
+{
+    ESP_LOGI("RadarUART", "uart[%d] event:", 1);
+    ESP_LOGI("RadarUART", "[Recv str]: %.9s, [Len]: %d", (const char*)frame, (int)len);
+    ESP_LOGI("mod_bus", "[receive data]");
+    ESP_LOGI("RadarManager", "READ Sweep output format.");
+}
+
+/* debug levels compiled in: the same lines through Radar_log_defer */
+#undef RADAR_LOG_LEVEL
+#define RADAR_LOG_LEVEL RADAR_LOG_DEBUG
+static void Bench_log_deferred(const uint8_t* frame, size_t len)
+{
+    (void)frame;
+    RADAR_LOGD("RadarUART", "uart[%d] event:", 1);
+    RADAR_LOGD("RadarUART", "[Recv]: %d bytes", len);
+    RADAR_LOGD("mod_bus", "[receive data]");
+    RADAR_LOGD("RadarManager", "READ Sweep output format.");
+}
+
+/* the end of a run, it also makes the task report the lines dropped before it */
+static void Bench_log_marker(void)
+{
+    RADAR_LOGW("bench_log", "end of run");
+}
+
+/* release levels: the same calls, constant-false */
+#undef RADAR_LOG_LEVEL
+#define RADAR_LOG_LEVEL RADAR_LOG_WARN
+static void Bench_log_elided(const uint8_t* frame, size_t len)
+{
+    (void)frame;
+    RADAR_LOGD("RadarUART", "uart[%d] event:", 1);
+    RADAR_LOGD("RadarUART", "[Recv]: %d bytes", len);
+    RADAR_LOGD("mod_bus", "[receive data]");
+    RADAR_LOGD("RadarManager", "READ Sweep output format.");
+}
+
+/*
+ * Requests for a while, paced at rate requests/s or back to back when rate is 0, then wait for
+ * the formatting task to write or drop every line queued
+ */
+static int Bench_run(void (*log)(const uint8_t*, size_t), bool deferred, double rate, double seconds,
+                     Bench_result_t* result)
+{
+    uint8_t frame[9] = { 0x51, 0x0B, 0x00, 0x01, 0x00, 0x09, 0x01, 0x00, 0x00 };
+    unsigned long requests = 0, valid = 0;
+    unsigned long lines0, dropped0;
+    double start, wall, cpu, deadline;
+    uint16_t sum = 0;
+
+    for (int i = 0; i < 7; i++)
+        sum += frame[i];
+    frame[7] = (uint8_t)(sum >> 8);
+    frame[8] = (uint8_t)sum;
+
+    g_drained_at = 0;
+    g_console_bytes = 0;
+    lines0 = __atomic_load_n(&g_console_lines, __ATOMIC_ACQUIRE);
+    dropped0 = __atomic_load_n(&g_console_dropped, __ATOMIC_ACQUIRE);
+
+    cpu = Bench_thread_cpu();
+    start = Bench_now();
+    while ((wall = Bench_now() - start) < seconds)
+    {
+        if (rate > 0.0)
+        {
+            double wait = (double)requests / rate - wall;
+
+            if (wait > 0.0)
+            {
+                struct timespec ts = { (time_t)wait, (long)((wait - floor(wait)) * 1e9) };
+                nanosleep(&ts, NULL);
+                continue;
+            }
+        }
+        log(frame, sizeof(frame));
+        valid += Bench_request(frame, sizeof(frame));
+        requests++;
+    }
+    cpu = Bench_thread_cpu() - cpu;
+
+    memset(result, 0, sizeof(*result));
+    result->rate = (double)requests / wall;
+    result->us_per_request = requests ? wall / (double)requests * 1e6 : 0.0;
+    result->cpu_us = requests ? cpu / (double)requests * 1e6 : 0.0;
+    result->busy = cpu / wall * 100.0;
+    result->console_rate = (double)g_console_bytes / wall;
+    if (log != Bench_log_elided)
+        result->lines = requests * BENCH_LINES_PER_REQUEST;
+    if (deferred)
+    {
+        result->backlog = result->lines - (__atomic_load_n(&g_console_lines, __ATOMIC_ACQUIRE) - lines0) -
+                          (__atomic_load_n(&g_console_dropped, __ATOMIC_ACQUIRE) - dropped0);
+        /* the marker must find room: wait until the task, which writes without pause while it has lines, stops */
+        deadline = Bench_now() + BENCH_DRAIN_TIMEOUT;
+        for (unsigned long done = 0, last = 1; done != last; )
+        {
+            double quiet = 0.01 + 2.0 * BENCH_LINE_MAX * g_byte_time;
+
+            last = done;
+            nanosleep(&(struct timespec){ (time_t)quiet, (long)((quiet - floor(quiet)) * 1e9) }, NULL);
+            done = __atomic_load_n(&g_console_lines, __ATOMIC_ACQUIRE) + __atomic_load_n(&g_console_dropped, __ATOMIC_ACQUIRE);
+            if (Bench_now() > deadline)
+                break;
+        }
+        Bench_log_marker();
+        while ((__atomic_load_n(&g_console_lines, __ATOMIC_ACQUIRE) - lines0) +
+               (__atomic_load_n(&g_console_dropped, __ATOMIC_ACQUIRE) - dropped0) < result->lines + 1)
+        {
+            if (Bench_now() > deadline)
+            {
+                fprintf(stderr, "bench_log: the formatting task did not drain its queue\n");
+                return -1;
+            }
+            nanosleep(&(struct timespec){ 0, 1000000 }, NULL);
+        }
+        result->dropped = __atomic_load_n(&g_console_dropped, __ATOMIC_ACQUIRE) - dropped0;
+    }
+    if (valid != requests)
+    {
+        fprintf(stderr, "bench_log: %lu invalid requests\n", requests - valid);
+        return -1;
+    }
+    return 0;
+}
+
+static void Bench_print(const char* name, const Bench_result_t* result)
+{
+    printf("%-10s %12.0f req/s %10.3f us/req %8.3f us/req hot path %6.1f%% busy %7.0f console B/s"
+           " %9lu lines %9lu dropped\n",
+           name, result->rate, result->us_per_request, result->cpu_us, result->busy, result->console_rate,
+           result->lines, result->dropped);
+}
+
+static int Bench_usage(const char* name, int status)
+{
+    fprintf(stderr,
+            "usage: %s [seconds per run] [baud]\n"
+            "  seconds per run  run time of each mode and of each sustained rate tried, > 0 (1)\n"
+            "  baud             console line speed (115200)\n",
+            name);
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = 1.0;
+    unsigned long baud = 115200;
+    Bench_result_t result, best;
+    double low, high;
+    char* end;
+
+    if ((argc > 1) && ((strcmp(argv[1], "-h") == 0) || (strcmp(argv[1], "--help") == 0)))
+        return Bench_usage(argv[0], 0);
+    if (argc > 3)
+        return Bench_usage(argv[0], 2);
+    if (argc > 1)
+    {
+        errno = 0;
+        seconds = strtod(argv[1], &end);
+        if ((errno != 0) || (end == argv[1]) || (*end != '\0') || !isfinite(seconds) || (seconds <= 0.0))
+            return Bench_usage(argv[0], 2);
+    }
+    if (argc > 2)
+    {
+        errno = 0;
+        baud = strtoul(argv[2], &end, 10);
+        if ((errno != 0) || (end == argv[2]) || (*end != '\0') || (argv[2][0] == '-') || (baud < 300))
+            return Bench_usage(argv[0], 2);
+    }
+
+    g_byte_time = 10.0 / (double)baud;  /* 8N1 */
+    esp_log_set_vprintf(Bench_console_vprintf);
+    esp_log_level_set("*", ESP_LOG_DEBUG);
+    if (Radar_log_init() != ESP_OK)
+    {
+        fprintf(stderr, "bench_log: Radar_log_init failed\n");
+        return 1;
+    }
+    printf("console %lu baud, %.0f B/s, queue %d lines\n", baud, 1.0 / g_byte_time, CONFIG_RADAR_LOG_QUEUE_LEN);
+
+    if (Bench_run(Bench_log_immediate, false, 0.0, seconds, &result) != 0)
+        return 1;
+    Bench_print("immediate", &result);
+    high = result.rate * 4.0;   /* the queue cannot sustain much more than the console takes */
+
+    if (Bench_run(Bench_log_deferred, true, 0.0, seconds, &result) != 0)
+        return 1;
+    Bench_print("deferred", &result);
+
+    /* sustained: nothing dropped and the queue not growing, at most one request behind */
+    low = 0.0;
+    memset(&best, 0, sizeof(best));
+    for (int step = 0; step < BENCH_SEARCH_STEPS; step++)
+    {
+        double rate = (low + high) / 2.0;
+
+        if (Bench_run(Bench_log_deferred, true, rate, seconds, &result) != 0)
+            return 1;
+        if ((result.dropped == 0) && (result.backlog <= BENCH_LINES_PER_REQUEST))
+        {
+            low = rate;
+            best = result;
+        }
+        else
+            high = rate;
+    }
+    Bench_print("sustained", &best);
+
+    if (Bench_run(Bench_log_elided, false, 0.0, seconds, &result) != 0)
+        return 1;
+    Bench_print("elided", &result);
+    return 0;
+}
@@ -0,0 +1,558 @@
+/*
+ * Modbus load generator: a mix of requests to a radar on a tty or pty, with latency histograms,
+ * BUSY and error rates and throughput, printed as "key value" lines for regression tracking.
+ *   open loop   (-r HZ) : requests leave on a fixed schedule whatever the answers do; latency is
+ *                         taken from the scheduled time, so a stalled device is not hidden by
+ *                         the generator waiting for it
+ *   closed loop (-w N)  : N requests in flight, the next one leaves when one is answered or lost
+ * Answers are matched to requests by kind and function code, oldest first. Error frames carry no
+ * function code: BUSY comes from the receive path at once (Modbus_submit) and goes to the newest
+ * request, every other error comes from the execution task in order and goes to the oldest.
+ *
+ *   radar_sim -m                                    prints the host pty
+ *   bench_modbus -d /dev/pts/N -r 200 -t 10         open loop, the default mix
+ *   bench_modbus -d /dev/ttyUSB0 -w 4 -x appoint    closed loop, APPOINTDATA only, 4 in flight
+ */
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "radar_client/client.hpp"
+
+#define BENCH_HIST_LINEAR       16      // 0..15 us one bucket each
+#define BENCH_HIST_SUB          8       // then 8 buckets per power of two
+#define BENCH_HIST_NUM          (BENCH_HIST_LINEAR + (32 - 4) * BENCH_HIST_SUB)
+#define BENCH_WEIGHT_MAX        1000    // per request of the mix, one vector entry each
+
+namespace {
+
+struct Op {
+    const char* name;
+    const char* help;
+    uint8_t fun_code;
+    bool write;
+    uint8_t data[2];
+    uint8_t len;            // read: bytes asked for, write: data bytes
+    bool answer_read;       // answered with a read message (APPOINTDATA write)
+};
+
+// APPOINTDATA: servo number in the high 7 bits, then a 9 bit angle (Processing_Funcode_5_write_data)
+const Op g_ops[] = {
+    { "workmode", "READ WORKMODE", radar::modbus::kWorkMode, false, { 0, 0 }, 1, true },
+    { "idset", "READ IDSET", radar::modbus::kIdSet, false, { 0, 0 }, 2, true },
+    { "counters", "READ COUNTERS, the health block", radar::modbus::kCounters, false, { 0, 0 }, 0, true },
+    { "appoint", "WRITE APPOINTDATA servo 0 at 90 degrees, answered with the distance",
+      radar::modbus::kAppointData, true, { 0x00, 90 }, 2, true },
+    { "setmode", "WRITE WORKMODE normal (the firmware does not answer it yet)",
+      radar::modbus::kWorkMode, true, { 0x00, 0 }, 1, false },
+    { "run", "WRITE SYS run", radar::modbus::kSys, true, { 0x00, 0 }, 1, false },
+    { "suspend", "WRITE SYS suspend", radar::modbus::kSys, true, { 0x03, 0 }, 1, false },
+};
+const size_t g_op_num = sizeof(g_ops) / sizeof(g_ops[0]);
+
+double Bench_clock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Log-linear latency histogram in us: exact below 16, then 1/8 of a power of two wide
+class Histogram {
+public:
+    void add(uint64_t us)
+    {
+        count_[index(us)]++;
+        num_++;
+        sum_ += (double)us;
+        if (us > max_)
+            max_ = us;
+    }
+
+    unsigned long num() const { return num_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return num_ ? sum_ / (double)num_ : 0.0; }
+    // Upper bound of the bucket holding the q quantile, never above the largest value seen
+    uint64_t quantile(double q) const
+    {
+        unsigned long rank = (unsigned long)ceil(q * (double)num_);
+        unsigned long seen = 0;
+
+        if (num_ == 0)
+            return 0;
+        for (size_t i = 0; i < BENCH_HIST_NUM; i++)
+        {
+            seen += count_[i];
+            if (seen >= rank)
+                return std::min(upper(i), max_);
+        }
+        return max_;
+    }
+    void print(const char* key) const
+    {
+        for (size_t i = 0; i < BENCH_HIST_NUM; i++)
+            if (count_[i])
+                printf("%s %llu %lu\n", key, (unsigned long long)upper(i), count_[i]);
+    }
+
+private:
+    static size_t index(uint64_t us)
+    {
+        if (us < BENCH_HIST_LINEAR)
+            return (size_t)us;
+        if (us >> 32)
+            return BENCH_HIST_NUM - 1;
+        int exp = 63 - __builtin_clzll(us);
+        return BENCH_HIST_LINEAR + (size_t)(exp - 4) * BENCH_HIST_SUB + ((us >> (exp - 3)) & (BENCH_HIST_SUB - 1));
+    }
+    static uint64_t upper(size_t i)
+    {
+        if (i < BENCH_HIST_LINEAR)
+            return i;
+        int exp = (int)((i - BENCH_HIST_LINEAR) / BENCH_HIST_SUB) + 4;
+        uint64_t sub = (i - BENCH_HIST_LINEAR) % BENCH_HIST_SUB;
+        return ((BENCH_HIST_SUB + sub + 1) << (exp - 3)) - 1;
+    }
+
+    unsigned long count_[BENCH_HIST_NUM] = {};
+    unsigned long num_ = 0;
+    double sum_ = 0.0;
+    uint64_t max_ = 0;
+};
+
+struct Counts {
+    unsigned long sent = 0;
+    unsigned long ok = 0;           // Answered with status normal
+    unsigned long busy = 0;         // MODBUS_STATUSCODE_ERR_BUSY
+    unsigned long errors = 0;       // Any other error frame, or a read answer with a bad status
+    unsigned long lost = 0;         // No answer within the timeout
+    Histogram latency;              // Of every answer, errors included
+};
+
+struct Pending {
+    size_t op;
+    double scheduled;               // When it should have left (open loop) or left (closed loop)
+};
+
+struct Bench {
+    radar::SerialLink* link = nullptr;
+    std::vector<size_t> mix;        // Op indexes, one per weight unit
+    std::mt19937 random;
+    std::deque<Pending> pending;
+    double timeout = 2.0;
+    Counts total;
+    Counts interval;
+    Counts per_op[g_op_num];
+    unsigned long error_code[256] = {};
+    unsigned long unexpected = 0;   // Answers matching nothing in flight, late ones included
+    unsigned long send_failed = 0;
+};
+
+void Bench_usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s -d PATH [options]\n"
+            "  -d PATH       tty or pty of the radar host UART\n"
+            "  -b BAUD       line speed (115200)\n"
+            "  -a ADDR       device address (1)\n"
+            "  -x MIX        request mix, name[:weight 0..1000],... (workmode:4,idset:2,appoint:2,run:1,suspend:1)\n"
+            "  -r HZ         open loop at this request rate, 0 for closed loop\n"
+            "  -w N          closed loop with N requests in flight (1, the default mode)\n"
+            "  -T MS         answer timeout, APPOINTDATA takes the servo settle time (2000)\n"
+            "  -t SEC        run time (10)\n"
+            "  -i SEC        progress line interval, 0 for none (0)\n"
+            "  -H            print the latency histogram, \"hist_us <bucket upper bound> <count>\" lines\n"
+            "  -s SEED       mix order seed (1)\n"
+            "requests:\n",
+            name);
+    for (size_t i = 0; i < g_op_num; i++)
+        fprintf(stderr, "  %-13s %s\n", g_ops[i].name, g_ops[i].help);
+}
+
+// Unsigned option in the given base (0: C prefixes), within [min, max]
+bool Bench_parse_unsigned(const char* arg, int base, unsigned long min, unsigned long max, unsigned long* out)
+{
+    char* end;
+    unsigned long value;
+
+    errno = 0;
+    value = strtoul(arg, &end, base);
+    if ((errno != 0) || (end == arg) || (*end != '\0') || (arg[0] == '-') || (value < min) || (value > max))
+        return false;
+    *out = value;
+    return true;
+}
+
+// Real option, finite and within [min, max]
+bool Bench_parse_real(const char* arg, double min, double max, double* out)
+{
+    char* end;
+    double value;
+
+    errno = 0;
+    value = strtod(arg, &end);
+    if ((errno != 0) || (end == arg) || (*end != '\0') || !std::isfinite(value) || (value < min) || (value > max))
+        return false;
+    *out = value;
+    return true;
+}
+
+bool Bench_parse_mix(const char* text, std::vector<size_t>* mix)
+{
+    std::string spec(text);
+    size_t start = 0;
+
+    mix->clear();
+    while (start <= spec.size())
+    {
+        size_t end = spec.find(',', start);
+        std::string item = spec.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+        size_t colon = item.find(':');
+        std::string name = item.substr(0, colon);
+        unsigned long weight = 1;
+        size_t op = 0;
+
+        while ((op < g_op_num) && (name != g_ops[op].name))
+            op++;
+        if ((op == g_op_num) ||
+            ((colon != std::string::npos) &&
+             !Bench_parse_unsigned(item.c_str() + colon + 1, 10, 0, BENCH_WEIGHT_MAX, &weight)))
+            return false;
+        mix->insert(mix->end(), (size_t)weight, op);
+        if (end == std::string::npos)
+            break;
+        start = end + 1;
+    }
+    return !mix->empty();
+}
+
+void Bench_send(Bench& bench, double scheduled)
+{
+    size_t op = bench.mix[bench.random() % bench.mix.size()];
+    const Op& o = g_ops[op];
+    bool sent = o.write ? bench.link->send_write(o.fun_code, o.data, o.len) : bench.link->send_read(o.fun_code, o.len);
+
+    if (!sent)
+    {
+        bench.send_failed++;
+        return;
+    }
+    bench.pending.push_back(Pending{ op, scheduled });
+    bench.total.sent++;
+    bench.interval.sent++;
+    bench.per_op[op].sent++;
+}
+
+enum class Outcome { kOk, kBusy, kError, kLost };
+
+void Bench_count(Bench& bench, const Pending& pending, Outcome outcome, double now)
+{
+    Counts* counts[] = { &bench.total, &bench.interval, &bench.per_op[pending.op] };
+    uint64_t us = (uint64_t)llround((now - pending.scheduled) * 1e6);
+
+    for (Counts* c : counts)
+    {
+        switch (outcome)
+        {
+        case Outcome::kOk: c->ok++; break;
+        case Outcome::kBusy: c->busy++; break;
+        case Outcome::kError: c->errors++; break;
+        case Outcome::kLost: c->lost++; break;
+        }
+        if (outcome != Outcome::kLost)
+            c->latency.add(us);
+    }
+}
+
+void Bench_on_frame(Bench& bench, const radar::ModbusFrameView& frame)
+{
+    double now = Bench_clock();
+    std::deque<Pending>::iterator it;
+
+    if (frame.is_error())
+    {
+        if (bench.pending.empty())
+        {
+            bench.unexpected++;
+            return;
+        }
+        bench.error_code[frame.status()]++;
+        if (frame.status() == radar::modbus::kErrBusy)
+        {
+            Bench_count(bench, bench.pending.back(), Outcome::kBusy, now);
+            bench.pending.pop_back();
+        }
+        else
+        {
+            Bench_count(bench, bench.pending.front(), Outcome::kError, now);
+            bench.pending.pop_front();
+        }
+        return;
+    }
+    for (it = bench.pending.begin(); it != bench.pending.end(); ++it)
+    {
+        const Op& o = g_ops[it->op];
+        if ((o.fun_code == frame.fun_code()) && (o.answer_read == frame.is_read()))
+            break;
+    }
+    if (it == bench.pending.end())
+    {
+        bench.unexpected++;     // sector alarm events land here too
+        return;
+    }
+    if (frame.status() != radar::modbus::kNormal)
+        bench.error_code[frame.status()]++;
+    Bench_count(bench, *it, (frame.status() == radar::modbus::kNormal) ? Outcome::kOk : Outcome::kError, now);
+    bench.pending.erase(it);
+}
+
+void Bench_expire(Bench& bench, double now)
+{
+    while (!bench.pending.empty() && (now - bench.pending.front().scheduled > bench.timeout))
+    {
+        Bench_count(bench, bench.pending.front(), Outcome::kLost, now);
+        bench.pending.pop_front();
+    }
+}
+
+double Bench_rate(unsigned long part, unsigned long whole)
+{
+    return whole ? (double)part / (double)whole : 0.0;
+}
+
+void Bench_progress(Bench& bench, double t, double seconds)
+{
+    const Counts& c = bench.interval;
+    printf("t_s %.1f sent %lu ok %lu busy %lu errors %lu lost %lu answers_per_s %.1f p50_us %llu p99_us %llu\n", t,
+           c.sent, c.ok, c.busy, c.errors, c.lost, (double)(c.ok + c.busy + c.errors) / seconds,
+           (unsigned long long)c.latency.quantile(0.50), (unsigned long long)c.latency.quantile(0.99));
+    fflush(stdout);
+    bench.interval = Counts();
+}
+
+void Bench_report(const Bench& bench, double seconds, double rate, unsigned window, bool histogram)
+{
+    const Counts& c = bench.total;
+    unsigned long answered = c.ok + c.busy + c.errors;
+    static const struct {
+        const char* key;
+        double q;
+    } quantiles[] = { { "p50", 0.50 }, { "p90", 0.90 }, { "p99", 0.99 }, { "p999", 0.999 } };
+
+    printf("mode %s\n", (rate > 0.0) ? "open" : "closed");
+    if (rate > 0.0)
+        printf("rate_hz %.1f\n", rate);
+    else
+        printf("window %u\n", window);
+    printf("run_s %.3f\n", seconds);
+    printf("sent %lu\n", c.sent);
+    printf("answered %lu\n", answered);
+    printf("ok %lu\n", c.ok);
+    printf("busy %lu\n", c.busy);
+    printf("errors %lu\n", c.errors);
+    printf("lost %lu\n", c.lost);
+    printf("unexpected %lu\n", bench.unexpected);
+    printf("send_failed %lu\n", bench.send_failed);
+    printf("busy_rate %.4f\n", Bench_rate(c.busy, c.sent));
+    printf("error_rate %.4f\n", Bench_rate(c.errors, c.sent));
+    printf("loss_rate %.4f\n", Bench_rate(c.lost, c.sent));
+    printf("requests_per_s %.1f\n", (double)c.sent / seconds);
+    printf("answers_per_s %.1f\n", (double)answered / seconds);
+    printf("ok_per_s %.1f\n", (double)c.ok / seconds);
+    printf("latency_mean_us %.1f\n", c.latency.mean());
+    for (const auto& q : quantiles)
+        printf("latency_%s_us %llu\n", q.key, (unsigned long long)c.latency.quantile(q.q));
+    printf("latency_max_us %llu\n", (unsigned long long)c.latency.max());
+    for (size_t i = 0; i < 256; i++)
+        if (bench.error_code[i])
+            printf("error_code_%02zx %lu\n", i, bench.error_code[i]);
+    for (size_t i = 0; i < g_op_num; i++)
+    {
+        const Counts& o = bench.per_op[i];
+        if (o.sent == 0)
+            continue;
+        printf("%s_sent %lu\n", g_ops[i].name, o.sent);
+        printf("%s_ok %lu\n", g_ops[i].name, o.ok);
+        printf("%s_busy %lu\n", g_ops[i].name, o.busy);
+        printf("%s_errors %lu\n", g_ops[i].name, o.errors);
+        printf("%s_lost %lu\n", g_ops[i].name, o.lost);
+        printf("%s_p50_us %llu\n", g_ops[i].name, (unsigned long long)o.latency.quantile(0.50));
+        printf("%s_p99_us %llu\n", g_ops[i].name, (unsigned long long)o.latency.quantile(0.99));
+    }
+    if (histogram)
+        c.latency.print("hist_us");
+}
+
+int Bench_run(Bench& bench, double seconds, double rate, unsigned window, double interval_s)
+{
+    radar::EventLoop loop;
+    uint64_t ticks = 0;
+    int timer = -1;
+
+    bench.link->attach(loop, [&bench](const radar::ModbusFrameView& frame) { Bench_on_frame(bench, frame); });
+
+    double start = Bench_clock();
+    double next_progress = start + interval_s;
+    double last_progress = start;
+    if (rate > 0.0)
+    {
+        // the schedule is start + k / rate; the timer only says when to look at it
+        struct itimerspec spec = {};
+        long period_ns = std::max(1L, (long)(1e9 / rate));
+
+        timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timer < 0)
+        {
+            perror("timerfd_create");
+            return 1;
+        }
+        spec.it_interval.tv_sec = period_ns / 1000000000L;
+        spec.it_interval.tv_nsec = period_ns % 1000000000L;
+        spec.it_value = spec.it_interval;
+        timerfd_settime(timer, 0, &spec, nullptr);
+        loop.add(timer, EPOLLIN, [&](uint32_t) {
+            uint64_t expirations;
+            if (read(timer, &expirations, sizeof(expirations)) != sizeof(expirations))
+                return;
+            for (uint64_t i = 0; i < expirations; i++, ticks++)
+                Bench_send(bench, start + (double)(ticks + 1) / rate);
+        });
+    }
+    else
+    {
+        for (unsigned i = 0; i < window; i++)
+            Bench_send(bench, Bench_clock());
+    }
+
+    double now = start;
+    while (now - start < seconds)
+    {
+        loop.run_once(1);
+        now = Bench_clock();
+        Bench_expire(bench, now);
+        if (rate <= 0.0)
+        {
+            while (bench.pending.size() < window)
+                Bench_send(bench, Bench_clock());
+        }
+        if ((interval_s > 0.0) && (now >= next_progress))
+        {
+            Bench_progress(bench, now - start, now - last_progress);
+            last_progress = now;
+            next_progress += interval_s;
+        }
+    }
+    if (timer >= 0)
+    {
+        loop.remove(timer);
+        close(timer);
+    }
+    // what is still in flight gets its timeout to answer, it is counted, not sent again
+    while (!bench.pending.empty())
+    {
+        loop.run_once(1);
+        Bench_expire(bench, Bench_clock());
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Bench bench;
+    const char* path = nullptr;
+    const char* mix = "workmode:4,idset:2,appoint:2,run:1,suspend:1";
+    unsigned baud = 115200;
+    uint16_t address = 0x0001;
+    double rate = 0.0;
+    unsigned window = 1;
+    double seconds = 10.0;
+    double interval_s = 0.0;
+    bool histogram = false;
+    int opt;
+
+    bench.random.seed(1);
+    while ((opt = getopt(argc, argv, "d:b:a:x:r:w:T:t:i:Hs:h")) != -1)
+    {
+        unsigned long value = 0;
+        double real = 0.0;
+        bool ok = true;
+
+        switch (opt)
+        {
+        case 'd': path = optarg; break;
+        case 'b':
+            ok = Bench_parse_unsigned(optarg, 10, 1, UINT_MAX, &value);
+            baud = (unsigned)value;
+            break;
+        case 'a':
+            ok = Bench_parse_unsigned(optarg, 0, 0, 0xFFFF, &value);
+            address = (uint16_t)value;
+            break;
+        case 'x': mix = optarg; break;
+        case 'r': ok = Bench_parse_real(optarg, 0.0, HUGE_VAL, &rate); break;
+        case 'w':
+            ok = Bench_parse_unsigned(optarg, 10, 1, UINT_MAX, &value);
+            window = (unsigned)value;
+            break;
+        case 'T':
+            ok = Bench_parse_real(optarg, 0.0, HUGE_VAL, &real) && (real > 0.0);
+            bench.timeout = real / 1000.0;
+            break;
+        case 't': ok = Bench_parse_real(optarg, 0.0, HUGE_VAL, &seconds) && (seconds > 0.0); break;
+        case 'i': ok = Bench_parse_real(optarg, 0.0, HUGE_VAL, &interval_s); break;
+        case 'H': histogram = true; break;
+        case 's':
+            ok = Bench_parse_unsigned(optarg, 0, 0, UINT32_MAX, &value);
+            bench.random.seed((uint32_t)value);
+            break;
+        default:
+            Bench_usage(argv[0]);
+            return (opt == 'h') ? 0 : 2;
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "%s: bad value for -%c: %s\n", argv[0], opt, optarg);
+            Bench_usage(argv[0]);
+            return 2;
+        }
+    }
+    if ((path == nullptr) || (optind < argc) || !Bench_parse_mix(mix, &bench.mix))
+    {
+        Bench_usage(argv[0]);
+        return 2;
+    }
+
+    try
+    {
+        radar::SerialLink link(path, baud);
+
+        link.set_address(address);
+        bench.link = &link;
+        if (Bench_run(bench, seconds, rate, window, interval_s) != 0)
+            return 1;
+        Bench_report(bench, seconds, rate, window, histogram);
+        printf("resync_bytes %lu\n", link.parser().resyncs());
+        printf("bad_checksums %lu\n", link.parser().bad_checksums());
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "bench_modbus: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
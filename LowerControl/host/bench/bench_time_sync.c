@@ -0,0 +1,182 @@
+/*
+ * Time sync benchmark: main/wifi_task/time_sync.c on the radar_sim shims against tools/radar_time_server,
+ * both on loopback, with the esp_timer of the shims running off the host clock by a set drift.
+ * Every 100 ms the radar clock is converted with time_sync_to_shared and compared with CLOCK_REALTIME,
+ * which is the server clock. Reported each interval: the quality time_sync_to_shared gives, the mean and
+ * largest error, and the conversions whose error is not below the 2^quality bound they claim; the run
+ * fails when one of the second half of the run is.
+ * Loopback has a round trip of some µs and no WiFi queueing: the errors are those of the clock filter and
+ * drift estimation on the host, not of a board on a radio link.
+ *
+ * usage: bench_time_sync [seconds] [drift ppm]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "time_sync.h"
+#include "sim.h"
+
+#define BENCH_SAMPLE_MS     100
+#define BENCH_REPORT_S      5
+#define BENCH_DRIFT_MAX_PPM 500.0   /* TIME_DRIFT_MAX_PPB */
+
+extern char** environ;
+
+typedef struct {
+    unsigned long num;
+    unsigned long out_of_bound;     /* |error| >= 2^quality */
+    double sum_us;                  /* of |error| */
+    double max_us;
+    uint8_t quality;                /* of the last conversion */
+} Bench_stats_t;
+
+static int64_t Bench_realtime_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* One conversion, against the host clock read on both sides of the radar clock */
+static void Bench_sample(Bench_stats_t* stats)
+{
+    int64_t before = Bench_realtime_us();
+    int64_t local = esp_timer_get_time();
+    int64_t after = Bench_realtime_us();
+    uint8_t quality;
+    int64_t shared = time_sync_to_shared(local, &quality);
+    double error;
+
+    stats->quality = quality;
+    if (quality == RADAR_TIME_UNSYNCHRONIZED)
+        return;
+    error = fabs((double)(shared - (before + after) / 2));
+    stats->num++;
+    stats->sum_us += error;
+    if (error > stats->max_us)
+        stats->max_us = error;
+    if (error >= ldexp(1.0, quality))
+        stats->out_of_bound++;
+}
+
+static void Bench_print(double t, const Bench_stats_t* stats)
+{
+    if (stats->num == 0)
+    {
+        printf("%7.1f %8s\n", t, "unsync");
+        fflush(stdout);
+        return;
+    }
+    printf("%7.1f %8u %10.0f %9.1f %9.1f %8lu\n", t, (unsigned)stats->quality, ldexp(1.0, stats->quality),
+           stats->sum_us / (double)stats->num, stats->max_us, stats->out_of_bound);
+    fflush(stdout);     /* the run ends with _exit */
+}
+
+static int Bench_usage(const char* name, int status)
+{
+    fprintf(stderr,
+            "usage: %s [seconds] [drift ppm]\n"
+            "  seconds    run time, >= %d (60)\n"
+            "  drift ppm  esp_timer rate error against the server clock, |drift| <= %.0f (30)\n",
+            name, BENCH_REPORT_S, BENCH_DRIFT_MAX_PPM);
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = 60.0;
+    double drift = 30.0;
+    char port[8];
+    char* server_argv[] = { RADAR_TIME_SERVER_PATH, port, NULL };
+    posix_spawn_file_actions_t actions;
+    pid_t server;
+    Bench_stats_t interval, total;
+    int64_t start, next;
+    char* end;
+
+    if ((argc > 1) && ((strcmp(argv[1], "-h") == 0) || (strcmp(argv[1], "--help") == 0)))
+        return Bench_usage(argv[0], 0);
+    if (argc > 3)
+        return Bench_usage(argv[0], 2);
+    if (argc > 1)
+    {
+        errno = 0;
+        seconds = strtod(argv[1], &end);
+        if ((errno != 0) || (end == argv[1]) || (*end != '\0') || !isfinite(seconds) || (seconds < BENCH_REPORT_S))
+            return Bench_usage(argv[0], 2);
+    }
+    if (argc > 2)
+    {
+        errno = 0;
+        drift = strtod(argv[2], &end);
+        if ((errno != 0) || (end == argv[2]) || (*end != '\0') || !isfinite(drift) ||
+            (fabs(drift) > BENCH_DRIFT_MAX_PPM))
+            return Bench_usage(argv[0], 2);
+    }
+
+    snprintf(port, sizeof(port), "%d", CONFIG_RADAR_TIME_PORT);
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    errno = posix_spawn(&server, server_argv[0], &actions, NULL, server_argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (errno != 0)
+    {
+        fprintf(stderr, "bench_time_sync: %s: %s\n", server_argv[0], strerror(errno));
+        return 1;
+    }
+    usleep(100000);     /* the server bound before the first request */
+
+    Sim_clock_set_drift(drift);
+    esp_log_level_set("*", ESP_LOG_WARN);
+    time_sync_start();
+    printf("time server %s:%d, radar clock %+.1f ppm, poll %d ms\n",
+           CONFIG_EXAMPLE_IPV4_ADDR, CONFIG_RADAR_TIME_PORT, drift, CONFIG_RADAR_TIME_POLL_MS);
+    printf("%7s %8s %10s %9s %9s %8s\n", "t s", "quality", "bound us", "mean us", "max us", "outside");
+
+    memset(&total, 0, sizeof(total));
+    memset(&interval, 0, sizeof(interval));
+    start = esp_timer_get_time();
+    next = start + BENCH_REPORT_S * 1000000LL;
+    while (esp_timer_get_time() - start < (int64_t)(seconds * 1e6))
+    {
+        vTaskDelay(pdMS_TO_TICKS(BENCH_SAMPLE_MS));
+        Bench_sample(&interval);
+        if (esp_timer_get_time() >= next)
+        {
+            Bench_print((double)(next - start) / 1e6, &interval);
+            /* the second half of the run, the drift measured by then */
+            if (next - start > (int64_t)(seconds * 0.5e6))
+            {
+                total.num += interval.num;
+                total.out_of_bound += interval.out_of_bound;
+                total.sum_us += interval.sum_us;
+                if (interval.max_us > total.max_us)
+                    total.max_us = interval.max_us;
+                total.quality = interval.quality;
+            }
+            memset(&interval, 0, sizeof(interval));
+            next += BENCH_REPORT_S * 1000000LL;
+        }
+    }
+    printf("second half of the run:\n");
+    Bench_print(seconds, &total);
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    _exit(total.out_of_bound ? 1 : 0);  /* the time sync task never returns */
+}
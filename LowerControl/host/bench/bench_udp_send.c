@@ -0,0 +1,264 @@
+/*
+ * Scan streamer benchmark: main/wifi_task/UDP_clinet.c on the radar_sim shims, streaming every
+ * UDP output format to a local sink on CONFIG_EXAMPLE_PORT.
+ *   bench_udp_send        : the streamer as radar_firmware builds it, CONFIG_RADAR_STREAM_ZERO_COPY
+ *                           (the Kconfig default) on the netconn and pbufs of sim/sim_lwip.c: polar LE
+ *                           points referenced in the sweep, the other formats encoded into pbufs
+ *   bench_udp_send_socket : UDP_clinet.c built without it, pages encoded into a buffer and sent with sendto
+ * The bench plays the steering task: it publishes a sweep, and the next one once the sink has the
+ * first slice of it. Reported per format: sweeps and datagrams per second at the sink, CPU time per
+ * sweep of the stream task and of the WiFi driver task of sim_lwip.c, datagrams the streamer dropped
+ * and datagrams the sink missed. CPU times are those of the host shims, not of the board.
+ *
+ * usage: bench_udp_send [seconds per format]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "WIFI.h"
+#include "UDP_clinet.h"
+#include "sweep_output.h"
+#include "sweep_publish.h"
+
+#define BENCH_SCOPE         180     /* CONFIG_STEERING_ANGLE_SCOPE, 1° steps */
+#define BENCH_WAIT_MS       100     /* longest wait for the first slice of a sweep */
+#define BENCH_DRAIN_US      200000  /* for the sink after each format */
+#define BENCH_TASK_MAX      32      /* uxTaskGetSystemState room */
+
+static const struct {
+    uint8_t format;
+    const char* name;
+} g_formats[] = {
+    { RADAR_SWEEP_FORMAT_POLAR,    "polar" },
+    { RADAR_SWEEP_FORMAT_POLAR_LE, "polar_le" },
+    { RADAR_SWEEP_FORMAT_COMPACT,  "compact" },
+    { RADAR_SWEEP_FORMAT_DELTA,    "delta" },
+};
+
+typedef struct {
+    uint64_t stream_us;     /* CPU time of the stream task */
+    uint64_t wifi_us;       /* CPU time of the WiFi driver task */
+} Bench_cpu_t;
+
+static pthread_mutex_t g_sink_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_sink_cond = PTHREAD_COND_INITIALIZER;
+static uint32_t g_sink_sequence = 0;        /* sweep sequence of the last datagram received */
+static unsigned long g_sink_datagrams = 0;
+static unsigned long g_sink_bytes = 0;
+
+static uint32_t g_rand_state = 0x12345678;
+
+static double Bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint32_t Bench_rand(void)
+{
+    g_rand_state ^= g_rand_state << 13;
+    g_rand_state ^= g_rand_state >> 17;
+    g_rand_state ^= g_rand_state << 5;
+    return g_rand_state;
+}
+
+static void* Bench_sink(void* arg)
+{
+    int sock = *(int*)arg;
+    static uint8_t buf[2048];
+
+    while (1)
+    {
+        ssize_t len = recv(sock, buf, sizeof(buf), 0);
+
+        if ((len < RADAR_STREAM_HEAD_LEN) || (((buf[0] << 8) | buf[1]) != RADAR_STREAM_MAGIC))
+            continue;
+        pthread_mutex_lock(&g_sink_lock);
+        g_sink_datagrams++;
+        g_sink_bytes += (unsigned long)len;
+        g_sink_sequence = ((uint32_t)buf[6] << 24) | ((uint32_t)buf[7] << 16) | ((uint32_t)buf[8] << 8) | buf[9];
+        pthread_cond_broadcast(&g_sink_cond);
+        pthread_mutex_unlock(&g_sink_lock);
+    }
+    return NULL;
+}
+
+/* Wait for the first slice of a sweep at the sink, false after BENCH_WAIT_MS */
+static bool Bench_sink_wait(uint32_t sequence)
+{
+    struct timespec deadline;
+    bool seen;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += BENCH_WAIT_MS * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+    pthread_mutex_lock(&g_sink_lock);
+    while (((int32_t)(g_sink_sequence - sequence) < 0) &&
+           (pthread_cond_timedwait(&g_sink_cond, &g_sink_lock, &deadline) == 0))
+        ;
+    seen = ((int32_t)(g_sink_sequence - sequence) >= 0);
+    pthread_mutex_unlock(&g_sink_lock);
+    return seen;
+}
+
+static void Bench_sink_counts(unsigned long* datagrams, unsigned long* bytes)
+{
+    pthread_mutex_lock(&g_sink_lock);
+    *datagrams = g_sink_datagrams;
+    *bytes = g_sink_bytes;
+    pthread_mutex_unlock(&g_sink_lock);
+}
+
+static void Bench_cpu(Bench_cpu_t* cpu)
+{
+    static TaskStatus_t status[BENCH_TASK_MAX];
+    UBaseType_t num = uxTaskGetSystemState(status, BENCH_TASK_MAX, NULL);
+
+    memset(cpu, 0, sizeof(*cpu));
+    for (UBaseType_t i = 0; i < num; i++)
+    {
+        if (strcmp(status[i].pcTaskName, "udp_client_task") == 0)
+            cpu->stream_us = status[i].ulRunTimeCounter;
+        else if (strcmp(status[i].pcTaskName, "wifi") == 0)
+            cpu->wifi_us = status[i].ulRunTimeCounter;
+    }
+}
+
+/* One 1° sweep of a room with ±10 mm of noise and a few dropouts, as the steering task fills it */
+static uint32_t Bench_publish(void)
+{
+    const Radar_sweep_t* sweep;
+    uint32_t sequence;
+
+    while (Radar_sweep_begin(BENCH_SCOPE, 1, true, 0) != ESP_OK)
+        usleep(1000);   /* every buffer held by the streamer */
+    for (uint16_t angle = 0; angle <= BENCH_SCOPE; angle++)
+    {
+        uint16_t distance = (uint16_t)(1500 + (angle * 7) % 400 + Bench_rand() % 21 - 10);
+
+        if (angle % 37 == 5)
+            distance = RADAR_SWEEP_INVALID_DISTANCE;
+        Radar_sweep_add_point(angle, distance);
+    }
+    Radar_sweep_publish();
+    sweep = Radar_sweep_acquire_latest();
+    sequence = sweep->sequence;
+    Radar_sweep_release(sweep);
+    return sequence;
+}
+
+static int Bench_usage(const char* name, int status)
+{
+    fprintf(stderr,
+            "usage: %s [seconds per format]\n"
+            "  seconds per format  run time of each UDP output format, > 0 (1)\n",
+            name);
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = 1.0;
+    struct sockaddr_in addr;
+    int sink_sock;
+    int rcvbuf = 4 << 20;
+    pthread_t sink_thread;
+    long lost_base = 0;     /* slices sent and not received, after the drain of the previous format */
+
+    if ((argc > 1) && ((strcmp(argv[1], "-h") == 0) || (strcmp(argv[1], "--help") == 0)))
+        return Bench_usage(argv[0], 0);
+    if (argc > 2)
+        return Bench_usage(argv[0], 2);
+    if (argc > 1)
+    {
+        char* end;
+
+        errno = 0;
+        seconds = strtod(argv[1], &end);
+        if ((errno != 0) || (end == argv[1]) || (*end != '\0') || !isfinite(seconds) || (seconds <= 0.0))
+            return Bench_usage(argv[0], 2);
+    }
+
+    sink_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(CONFIG_EXAMPLE_IPV4_ADDR);
+    addr.sin_port = htons(CONFIG_EXAMPLE_PORT);
+    setsockopt(sink_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (bind(sink_sock, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        fprintf(stderr, "bench_udp_send: sink on %s:%d: %s\n", CONFIG_EXAMPLE_IPV4_ADDR, CONFIG_EXAMPLE_PORT,
+                strerror(errno));
+        return 1;
+    }
+    pthread_create(&sink_thread, NULL, Bench_sink, &sink_sock);
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    if ((Radar_sweep_init() != ESP_OK) || (Radar_output_init() != ESP_OK) || (udp_stream_init() != ESP_OK))
+    {
+        fprintf(stderr, "bench_udp_send: firmware init failed\n");
+        return 1;
+    }
+    xTaskCreatePinnedToCore(udp_client_task, "udp_client_task", 4096, NULL, 1, NULL, 0);
+
+    printf("streamer %s, datagram %d bytes, %d points per sweep\n",
+           CONFIG_RADAR_STREAM_ZERO_COPY ? "zero-copy netconn" : "socket", CONFIG_RADAR_STREAM_DATAGRAM_LEN,
+           BENCH_SCOPE + 1);
+    printf("%-9s %9s %11s %8s %14s %12s %8s %6s %6s\n", "format", "sweep/s", "datagram/s", "MB/s",
+           "stream us/swp", "wifi us/swp", "dropped", "lost", "late");
+    for (size_t f = 0; f < sizeof(g_formats) / sizeof(g_formats[0]); f++)
+    {
+        udp_stream_stats_t stats0, stats1;
+        unsigned long datagrams0, bytes0, datagrams1, bytes1;
+        long lost;
+        unsigned long sweeps = 0;
+        unsigned long late = 0;
+        Bench_cpu_t cpu0, cpu1;
+        double start, wall;
+
+        Radar_output_set_format(RADAR_OUTPUT_CHANNEL_UDP, g_formats[f].format);
+        Bench_sink_wait(Bench_publish());   /* the first sweep of a format is not counted */
+        udp_stream_get_stats(&stats0);
+        Bench_sink_counts(&datagrams0, &bytes0);
+        Bench_cpu(&cpu0);
+        start = Bench_now();
+        do
+        {
+            if (!Bench_sink_wait(Bench_publish()))
+                late++;
+            sweeps++;
+            wall = Bench_now() - start;
+        } while (wall < seconds);
+        usleep(BENCH_DRAIN_US);
+        Bench_cpu(&cpu1);
+        udp_stream_get_stats(&stats1);
+        Bench_sink_counts(&datagrams1, &bytes1);
+        lost = (long)stats1.sent - (long)datagrams1 - lost_base;   /* drained: exact, unlike the counts at start */
+        lost_base += lost;
+
+        printf("%-9s %9.0f %11.0f %8.2f %14.2f %12.2f %8lu %6ld %6lu\n", g_formats[f].name,
+               (double)sweeps / wall, (double)(datagrams1 - datagrams0) / wall,
+               (double)(bytes1 - bytes0) / wall / 1e6,
+               (double)(cpu1.stream_us - cpu0.stream_us) / (double)sweeps,
+               (double)(cpu1.wifi_us - cpu0.wifi_us) / (double)sweeps,
+               (unsigned long)(stats1.dropped - stats0.dropped), lost, late);
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+// Linux client of the ESP32S3 radar: Modbus over a tty, the UDP scan stream and the TCP scan server.
+// Every transport is non-blocking and driven by one epoll loop; received frames are handed to the
+// callbacks as views over the receive buffers (views.hpp), nothing is allocated per frame.
+// Constructors throw std::system_error when the device or socket cannot be opened.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "radar_client/protocol.hpp"
+#include "radar_client/receive_ring.hpp"
+#include "radar_client/views.hpp"
+
+struct mmsghdr;
+struct iovec;
+
+namespace radar {
+
+class EventLoop {
+public:
+    using Handler = std::function<void(uint32_t events)>;
+
+    EventLoop();
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    void add(int fd, uint32_t events, Handler handler);   // events: EPOLLIN...
+    void remove(int fd);
+    int run_once(int timeout_ms);   // dispatch what is ready, number of fds handled
+    void run();                     // until stop()
+    void stop() { running_ = false; }
+
+private:
+    struct Entry {
+        int fd;
+        Handler handler;
+    };
+
+    int epoll_fd_ = -1;
+    bool running_ = false;
+    std::vector<std::unique_ptr<Entry>> entries_;
+};
+
+using FrameHandler = std::function<void(const ModbusFrameView&)>;
+using MessageHandler = std::function<void(const ScanMessageView&)>;
+
+// Modbus over a serial port (or pty), in raw 8N1
+class SerialLink {
+public:
+    SerialLink(const std::string& path, unsigned baud, size_t ring_size = 64 * 1024);
+    ~SerialLink();
+    SerialLink(const SerialLink&) = delete;
+    SerialLink& operator=(const SerialLink&) = delete;
+
+    void attach(EventLoop& loop, FrameHandler handler);
+    int fd() const { return fd_; }
+    // Read everything available and hand out the complete frames; false once the device is gone
+    bool on_readable();
+
+    void set_address(uint16_t address) { address_ = address; }
+    bool send_read(uint8_t fun_code, uint8_t len);
+    bool send_write(uint8_t fun_code, const uint8_t* data, uint8_t len);
+
+    const ModbusParser& parser() const { return parser_; }
+    unsigned long reads() const { return reads_; }     // read(2) calls that returned data
+
+private:
+    bool send(const uint8_t* frame, size_t len);
+
+    int fd_ = -1;
+    uint16_t address_ = 0x0001;
+    ReceiveRing ring_;
+    ModbusParser parser_;
+    FrameHandler handler_;
+    unsigned long reads_ = 0;
+};
+
+// Receiver of the UDP scan stream, unicast or multicast; datagrams are taken in batches
+class UdpStream {
+public:
+    explicit UdpStream(uint16_t port = stream::kDefaultPort, const char* group = nullptr,
+                       const char* interface = nullptr, unsigned batch = 32);
+    ~UdpStream();
+    UdpStream(const UdpStream&) = delete;
+    UdpStream& operator=(const UdpStream&) = delete;
+
+    void attach(EventLoop& loop, MessageHandler handler);
+    int fd() const { return fd_; }
+    void on_readable();
+
+    // Ask the radar that sent the last datagram for lost ones again (datagram_seq, see UDP_clinet.h)
+    bool send_nack(const uint32_t* seq, size_t count, uint16_t control_port = stream::kDefaultControlPort);
+
+    unsigned long datagrams() const { return datagrams_; }
+    unsigned long batches() const { return batches_; }     // recvmmsg(2) calls that returned data
+    unsigned long invalid() const { return invalid_; }
+
+private:
+    int fd_ = -1;
+    unsigned batch_;
+    std::vector<uint8_t> slab_;             // batch datagrams of stream::kDatagramMax
+    std::vector<struct mmsghdr> headers_;
+    std::vector<struct iovec> iov_;
+    std::vector<uint8_t> sources_;          // sockaddr_in of each datagram
+    std::vector<uint8_t> last_source_;
+    MessageHandler handler_;
+    unsigned long datagrams_ = 0;
+    unsigned long batches_ = 0;
+    unsigned long invalid_ = 0;
+};
+
+// Client of the TCP scan server in plain framing: len(2) + body, see scan_server.h
+class TcpStream {
+public:
+    TcpStream(const std::string& host, uint16_t port = stream::kDefaultServerPort, size_t ring_size = 64 * 1024);
+    ~TcpStream();
+    TcpStream(const TcpStream&) = delete;
+    TcpStream& operator=(const TcpStream&) = delete;
+
+    void attach(EventLoop& loop, MessageHandler on_message, FrameHandler on_frame);
+    int fd() const { return fd_; }
+    bool on_readable();     // false once the server closed the connection
+
+    void set_address(uint16_t address) { address_ = address; }
+    bool send_read(uint8_t fun_code, uint8_t len);
+    bool send_write(uint8_t fun_code, const uint8_t* data, uint8_t len);
+
+    unsigned long messages() const { return messages_; }
+    unsigned long invalid() const { return invalid_; }
+
+private:
+    bool send(const uint8_t* frame, size_t len);
+
+    int fd_ = -1;
+    uint16_t address_ = 0x0001;
+    ReceiveRing ring_;
+    ModbusParser parser_;
+    MessageHandler on_message_;
+    FrameHandler on_frame_;
+    unsigned long messages_ = 0;
+    unsigned long invalid_ = 0;
+};
+
+} // namespace radar
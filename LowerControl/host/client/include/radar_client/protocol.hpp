@@ -0,0 +1,134 @@
+// Wire constants of the ESP32S3 radar, mirrored from the firmware headers named next to each group.
+// Everything on the wire is high byte first, except the points of a polar LE page.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace radar {
+
+// main/communication_protocol/mod_bus.h
+namespace modbus {
+
+constexpr uint8_t kMasterHead = 0x51;   // Host request frame header
+constexpr uint8_t kSlaveHead = 0x55;    // Slave response frame header
+constexpr uint8_t kSensorType = 0x0B;   // Type code
+constexpr uint8_t kOptRead = 0x00;
+constexpr uint8_t kOptWrite = 0x01;
+constexpr uint8_t kOptError = 0xFF;
+constexpr size_t kFrameMax = UINT8_MAX + 10;   // Read answer with 255 bytes of data
+
+enum FunCode : uint8_t {
+    kSys = 0x00,
+    kScanRate = 0x01,
+    kBaudRate = 0x02,
+    kIdSet = 0x03,
+    kAppointData = 0x05,
+    kWorkMode = 0x06,
+    kMeasureMode = 0x07,
+    kCaliMode = 0x08,
+    kOutputFormat = 0x09,
+    kSweepData = 0x0A,
+    kOccupancy = 0x0B,
+    kSectorQuery = 0x0C,
+    kSectorAlarm = 0x0D,
+    kStreamStats = 0x0E,
+    kLatency = 0x0F,
+    kCounters = 0x10,
+    kTaskStats = 0x11,
+    kTrace = 0x12,
+    kCapture = 0x13,
+};
+
+enum Status : uint8_t {
+    kNormal = 0x00,
+    kNoSensor = 0x01,
+    kErrAddress = 0x02,
+    kErrOpr = 0x03,
+    kErrFuncode = 0x04,
+    kErrLen = 0x05,
+    kErrCrc = 0x06,
+    kErrFrame = 0x07,
+    kErrBusy = 0x08,
+    kErrDevice = 0x09,
+    kErrData = 0x0A,
+};
+
+// Additive checksum of every byte covered, as Modbus_crc_check_sum
+inline uint16_t checksum(const uint8_t* p, size_t len)
+{
+    uint16_t sum = 0;
+    for (size_t i = 0; i < len; i++)
+        sum = static_cast<uint16_t>(sum + p[i]);
+    return sum;
+}
+
+// Request frames, written into buf (at least 9 + len bytes); return the frame length
+size_t build_read(uint8_t* buf, uint16_t address, uint8_t fun_code, uint8_t len);
+size_t build_write(uint8_t* buf, uint16_t address, uint8_t fun_code, const uint8_t* data, uint8_t len);
+
+} // namespace modbus
+
+// main/wifi_task/UDP_clinet.h
+namespace stream {
+
+constexpr uint16_t kMagic = 0x5253;     // "RS"
+constexpr uint8_t kVersion = 0x03;
+constexpr size_t kHeadLen = 29;
+constexpr size_t kParityHeadLen = 3;
+constexpr uint8_t kFlagParity = 0x01;
+constexpr uint8_t kFlagRetransmit = 0x02;
+constexpr uint16_t kNackMagic = 0x524E; // "RN"
+constexpr size_t kDatagramMax = 1472;   // CONFIG_RADAR_STREAM_DATAGRAM_LEN upper bound
+constexpr uint8_t kTimeUnsynchronized = 0;
+
+constexpr uint16_t kDefaultPort = 3333;         // CONFIG_EXAMPLE_PORT
+constexpr uint16_t kDefaultControlPort = 3334;  // CONFIG_RADAR_CONTROL_PORT
+constexpr uint16_t kDefaultServerPort = 3335;   // CONFIG_RADAR_SERVER_PORT
+
+} // namespace stream
+
+// components/Radar_Sweep/include/radar_sweep.h, main/sweep_task/sweep_output.h
+namespace sweep {
+
+enum Format : uint8_t {
+    kPolar = 0x00,
+    kCartesianXY = 0x01,
+    kCartesianXYZ = 0x02,
+    kDelta = 0x03,
+    kCompact = 0x04,
+    kPolarLE = 0x05,
+    kLaserScan = 0x06,
+};
+
+constexpr size_t kPageHeadLen = 9;          // RADAR_OUTPUT_PAGE_HEAD_LEN
+constexpr size_t kLaserScanHeadLen = 28;    // RADAR_OUTPUT_LASERSCAN_HEAD_LEN, after the page header
+constexpr size_t kDeltaHeadLen = 12;        // SWEEP_CHANGE_HEAD_LEN
+constexpr uint8_t kDeltaKeyframe = 0x01;
+constexpr uint8_t kDeltaMore = 0x02;
+constexpr size_t kPointMax = 361;           // RADAR_SWEEP_POINT_MAX
+
+} // namespace sweep
+
+inline uint16_t get_u16(const uint8_t* p)
+{
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline uint32_t get_u32(const uint8_t* p)
+{
+    return (static_cast<uint32_t>(get_u16(p)) << 16) | get_u16(p + 2);
+}
+
+inline uint64_t get_u64(const uint8_t* p)
+{
+    return (static_cast<uint64_t>(get_u32(p)) << 32) | get_u32(p + 4);
+}
+
+inline void put_u16(uint8_t* p, uint16_t value)
+{
+    p[0] = static_cast<uint8_t>(value >> 8);
+    p[1] = static_cast<uint8_t>(value & 0xFF);
+}
+
+} // namespace radar
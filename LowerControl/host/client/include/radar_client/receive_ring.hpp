@@ -0,0 +1,42 @@
+// Byte ring mapped twice back to back in virtual memory: the bytes after the end of the buffer are
+// its beginning again, so any span of up to capacity() bytes is contiguous wherever it starts.
+// Frames that wrap are decoded in place like any other, and reads never have to be split.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace radar {
+
+class ReceiveRing {
+public:
+    // capacity is rounded up to a multiple of the page size; throws std::system_error
+    explicit ReceiveRing(size_t capacity);
+    ~ReceiveRing();
+    ReceiveRing(const ReceiveRing&) = delete;
+    ReceiveRing& operator=(const ReceiveRing&) = delete;
+
+    size_t capacity() const { return capacity_; }
+    size_t size() const { return static_cast<size_t>(tail_ - head_); }
+    size_t space() const { return capacity_ - size(); }
+
+    // Unread bytes, contiguous
+    const uint8_t* data() const { return base_ + (head_ & mask_); }
+    void consume(size_t len) { head_ += len; }
+
+    // Free space, contiguous, to read() into; commit what was written
+    uint8_t* write_ptr() { return base_ + (tail_ & mask_); }
+    void commit(size_t len) { tail_ += len; }
+
+    // read(2) from fd into the free space: bytes read, 0 at end of file, -1 with errno set
+    long fill(int fd);
+
+private:
+    uint8_t* base_ = nullptr;
+    size_t capacity_ = 0;
+    size_t mask_ = 0;
+    uint64_t head_ = 0;
+    uint64_t tail_ = 0;
+};
+
+} // namespace radar
@@ -0,0 +1,44 @@
+// Whole sweeps rebuilt from pages, for the consumers that want the full scan rather than page views.
+// This is the one place the client copies points: into a sweep owned by the assembler.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "radar_sweep.h"
+}
+
+namespace radar {
+
+class SweepAssembler {
+public:
+    SweepAssembler();
+
+    // Add the payload of one scan message (format from its header) or 0x0A answer, in any sweep format
+    // but the cartesian and LaserScan ones. Returns true when it completed a sweep, which stays readable
+    // until the next add()
+    bool add(uint8_t format, const uint8_t* payload, size_t size);
+
+    const Radar_sweep_t& sweep() const { return sweep_; }
+    unsigned long incomplete() const { return incomplete_; }   // Sweeps abandoned with pages missing
+    unsigned long errors() const { return errors_; }           // Frames that failed to decode
+
+private:
+    bool add_page(const uint8_t* payload, size_t size);
+    bool add_compact(const uint8_t* payload, size_t size);
+    bool add_delta(const uint8_t* payload, size_t size);
+    void start(uint16_t sequence);
+
+    Radar_sweep_t sweep_;
+    bool started_ = false;
+    uint16_t sequence_ = 0;         // Low 16 bits, as in every page format
+    uint16_t bins_ = 0;             // Bins received of the sweep being built
+    uint8_t pages_ = 0;             // Pages received of the sweep being built
+    bool complete_ = false;         // The sweep being built was handed out
+    bool delta_valid_ = false;      // A keyframe was received
+    unsigned long incomplete_ = 0;
+    unsigned long errors_ = 0;
+};
+
+} // namespace radar
@@ -0,0 +1,204 @@
+// Non-owning views over frames in a receive buffer. Nothing here allocates or copies:
+// a view is valid as long as the bytes it points at, i.e. until its callback returns.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "radar_client/protocol.hpp"
+
+namespace radar {
+
+// One answer frame of the Modbus protocol: read answer, write acknowledge or error
+class ModbusFrameView {
+public:
+    ModbusFrameView() = default;
+    ModbusFrameView(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    bool is_error() const
+    {
+        return (data_[2] == modbus::kOptError) && (data_[3] == modbus::kOptError) && (data_[4] == modbus::kOptError);
+    }
+    bool is_write_ack() const { return !is_error() && (data_[4] == modbus::kOptWrite); }
+    bool is_read() const { return !is_error() && (data_[4] == modbus::kOptRead); }
+    uint16_t address() const { return is_error() ? 0 : get_u16(&data_[2]); }
+    // Status of a read answer, error code of an error frame, kNormal for a write acknowledge
+    uint8_t status() const { return (is_error() || is_read()) ? data_[5] : static_cast<uint8_t>(modbus::kNormal); }
+    uint8_t fun_code() const { return is_read() ? data_[6] : (is_write_ack() ? data_[5] : 0); }
+    const uint8_t* payload() const { return is_read() ? &data_[8] : nullptr; }
+    size_t payload_size() const { return is_read() ? data_[7] : 0; }
+    // Data of a 1 or 2 byte read answer (Modbus_back_read_message)
+    uint16_t value() const
+    {
+        return payload_size() == 1 ? payload()[0] : (payload_size() >= 2 ? get_u16(payload()) : 0);
+    }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Finds answer frames in a byte stream, resynchronizing on the header after noise or a bad checksum
+class ModbusParser {
+public:
+    enum class Result { kFrame, kNeedMore };
+
+    // Looks at [data, data + size). On kFrame, frame is set and *consumed covers everything up to
+    // its end; on kNeedMore, *consumed covers the bytes that can never start a frame
+    Result parse(const uint8_t* data, size_t size, ModbusFrameView* frame, size_t* consumed);
+
+    unsigned long resyncs() const { return resyncs_; }     // Bytes skipped
+    unsigned long bad_checksums() const { return bad_checksums_; }
+
+private:
+    unsigned long resyncs_ = 0;
+    unsigned long bad_checksums_ = 0;
+};
+
+// Scan message of the UDP stream and of the scan server (see UDP_clinet.h)
+class ScanMessageView {
+public:
+    ScanMessageView() = default;
+
+    // Checks magic, version and length; returns false for anything else
+    bool parse(const uint8_t* data, size_t size)
+    {
+        if ((size < stream::kHeadLen) || (get_u16(data) != stream::kMagic) || (data[2] != stream::kVersion))
+            return false;
+        data_ = data;
+        size_ = size;
+        return true;
+    }
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    uint8_t format() const { return data_[3]; }
+    uint16_t device_id() const { return get_u16(&data_[4]); }
+    uint32_t sweep_sequence() const { return get_u32(&data_[6]); }
+    // First sample of the sweep: µs since the Unix epoch, or since boot when time_quality is 0
+    int64_t timestamp_us() const { return static_cast<int64_t>(get_u64(&data_[10])); }
+    uint8_t slice() const { return data_[18]; }
+    uint32_t duration_us() const { return get_u32(&data_[19]); }
+    uint8_t time_quality() const { return data_[23]; }
+    uint32_t datagram_seq() const { return get_u32(&data_[24]); }
+    uint8_t flags() const { return data_[28]; }
+    bool is_parity() const { return flags() & stream::kFlagParity; }
+    bool is_retransmit() const { return flags() & stream::kFlagRetransmit; }
+    const uint8_t* payload() const { return data_ + stream::kHeadLen; }
+    size_t payload_size() const { return size_ - stream::kHeadLen; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+struct PointXY {
+    int16_t x;
+    int16_t y;
+};
+
+struct PointXYZ {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+};
+
+// sensor_msgs/LaserScan fields of a LaserScan page, in the order of the message
+struct LaserScanInfo {
+    float angle_min;        // rad, 0 in the middle of the pan scope
+    float angle_max;
+    float angle_increment;
+    float time_increment;   // s, negative when bin 0 was measured last
+    float scan_time;        // s, 0 until the radar measured one sweep period
+    float range_min;        // m
+    float range_max;
+};
+static_assert(sizeof(LaserScanInfo) == sweep::kLaserScanHeadLen, "LaserScanInfo must match the wire");
+
+// One page of a fixed-size format (polar, polar LE, cartesian, LaserScan), from a scan message or a 0x0A answer
+class PageView {
+public:
+    PageView() = default;
+
+    // Checks the header against the size; returns false for delta and compact frames
+    bool parse(const uint8_t* data, size_t size)
+    {
+        size_t head_len = sweep::kPageHeadLen;
+        size_t point_size;
+
+        if (size < sweep::kPageHeadLen)
+            return false;
+        switch (data[4])
+        {
+        case sweep::kPolar:
+        case sweep::kPolarLE:
+            point_size = 2;
+            break;
+        case sweep::kCartesianXY:
+            point_size = 4;
+            break;
+        case sweep::kCartesianXYZ:
+            point_size = 6;
+            break;
+        case sweep::kLaserScan:
+            head_len += sweep::kLaserScanHeadLen;
+            point_size = 4;
+            break;
+        default:
+            return false;
+        }
+        if (size < head_len + data[8] * point_size)
+            return false;
+        data_ = data;
+        head_len_ = head_len;
+        return true;
+    }
+
+    uint16_t sequence() const { return get_u16(&data_[0]); }  // Low 16 bits of the sweep sequence
+    uint8_t page() const { return data_[2]; }
+    uint8_t page_count() const { return data_[3]; }
+    uint8_t format() const { return data_[4]; }
+    uint16_t first_angle() const { return get_u16(&data_[5]); }
+    uint8_t step() const { return data_[7]; }
+    size_t size() const { return data_[8]; }
+    bool last() const { return page() + 1 >= page_count(); }
+
+    // Polar formats: distance (mm) of point i, 0 when not measured
+    uint16_t distance(size_t i) const
+    {
+        const uint8_t* p = points() + 2 * i;
+        return format() == sweep::kPolarLE ? static_cast<uint16_t>(p[0] | (p[1] << 8)) : get_u16(p);
+    }
+    PointXY xy(size_t i) const
+    {
+        const uint8_t* p = points() + 4 * i;
+        return { static_cast<int16_t>(get_u16(p)), static_cast<int16_t>(get_u16(p + 2)) };
+    }
+    PointXYZ xyz(size_t i) const
+    {
+        const uint8_t* p = points() + 6 * i;
+        return { static_cast<int16_t>(get_u16(p)), static_cast<int16_t>(get_u16(p + 2)),
+                 static_cast<int16_t>(get_u16(p + 4)) };
+    }
+    // LaserScan format, little-endian float32 as on any Linux host: the fields and the ranges (m) of the page
+    // go into a LaserScan message with one memcpy each, ranges at index (first_angle - angle of bin 0) / step
+    LaserScanInfo laserscan() const
+    {
+        LaserScanInfo info;
+        memcpy(&info, data_ + sweep::kPageHeadLen, sizeof(info));
+        return info;
+    }
+    const uint8_t* ranges() const { return points(); }
+    size_t ranges_size() const { return 4 * size(); }
+    const uint8_t* points() const { return data_ + head_len_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t head_len_ = sweep::kPageHeadLen;
+};
+
+} // namespace radar
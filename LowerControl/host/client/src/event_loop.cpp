@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "radar_client/client.hpp"
+
+namespace radar {
+
+EventLoop::EventLoop()
+{
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0)
+        throw std::system_error(errno, std::generic_category(), "epoll_create1");
+}
+
+EventLoop::~EventLoop()
+{
+    close(epoll_fd_);
+}
+
+void EventLoop::add(int fd, uint32_t events, Handler handler)
+{
+    std::unique_ptr<Entry> entry(new Entry{ fd, std::move(handler) });
+    struct epoll_event event = {};
+
+    event.events = events;
+    event.data.ptr = entry.get();
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0)
+        throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+    entries_.push_back(std::move(entry));
+}
+
+void EventLoop::remove(int fd)
+{
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                  [fd](const std::unique_ptr<Entry>& entry) { return entry->fd == fd; }),
+                   entries_.end());
+}
+
+int EventLoop::run_once(int timeout_ms)
+{
+    struct epoll_event events[16];
+    int num = epoll_wait(epoll_fd_, events, 16, timeout_ms);
+
+    if (num < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+        throw std::system_error(errno, std::generic_category(), "epoll_wait");
+    }
+    for (int i = 0; i < num; i++)
+    {
+        // a handler may remove its own fd: look the entry up again before each call
+        Entry* entry = static_cast<Entry*>(events[i].data.ptr);
+        if (std::any_of(entries_.begin(), entries_.end(),
+                        [entry](const std::unique_ptr<Entry>& e) { return e.get() == entry; }))
+            entry->handler(events[i].events);
+    }
+    return num;
+}
+
+void EventLoop::run()
+{
+    running_ = true;
+    while (running_)
+        run_once(-1);
+}
+
+} // namespace radar
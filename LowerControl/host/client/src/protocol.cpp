@@ -0,0 +1,101 @@
+#include <cstring>
+
+#include "radar_client/protocol.hpp"
+#include "radar_client/views.hpp"
+
+namespace radar {
+namespace modbus {
+
+size_t build_read(uint8_t* buf, uint16_t address, uint8_t fun_code, uint8_t len)
+{
+    buf[0] = kMasterHead;
+    buf[1] = kSensorType;
+    put_u16(&buf[2], address);
+    buf[4] = kOptRead;
+    buf[5] = fun_code;
+    buf[6] = len;   // bytes asked for
+    put_u16(&buf[7], checksum(buf, 7));
+    return 9;
+}
+
+size_t build_write(uint8_t* buf, uint16_t address, uint8_t fun_code, const uint8_t* data, uint8_t len)
+{
+    buf[0] = kMasterHead;
+    buf[1] = kSensorType;
+    put_u16(&buf[2], address);
+    buf[4] = kOptWrite;
+    buf[5] = fun_code;
+    buf[6] = len;
+    if (len)
+        memcpy(&buf[7], data, len);
+    put_u16(&buf[7 + len], checksum(buf, 7 + len));
+    return 9 + len;
+}
+
+} // namespace modbus
+
+// Answer frames (Modbus_transmit_ErrCode, Modbus_back_xxx, Modbus_push_event):
+//   error  : head type FF FF FF code sum(2)                        sum of 6 bytes
+//   write  : head type addr(2) 01 fun sum(2)                       sum of 6 bytes
+//   read   : head type addr(2) 00 status fun len data... sum(2)    sum of len + 8 bytes,
+//            but only of the first 7 for the 1 and 2 byte answers of Modbus_back_read_message
+ModbusParser::Result ModbusParser::parse(const uint8_t* data, size_t size, ModbusFrameView* frame, size_t* consumed)
+{
+    size_t start = 0;
+
+    while (start + 1 < size)
+    {
+        const uint8_t* p = data + start;
+        size_t left = size - start;
+        size_t len;
+        bool valid;
+
+        if ((p[0] != modbus::kSlaveHead) || (p[1] != modbus::kSensorType))
+        {
+            const void* next = memchr(p + 1, modbus::kSlaveHead, left - 1);
+            size_t skip = next ? static_cast<size_t>(static_cast<const uint8_t*>(next) - p) : left;
+            resyncs_ += skip;
+            start += skip;
+            continue;
+        }
+        if (left < 8)
+            break;
+        if ((p[2] == modbus::kOptError) && (p[3] == modbus::kOptError) && (p[4] == modbus::kOptError))
+        {
+            len = 8;
+            valid = get_u16(&p[6]) == modbus::checksum(p, 6);
+        }
+        else if (p[4] == modbus::kOptWrite)
+        {
+            len = 8;
+            valid = get_u16(&p[6]) == modbus::checksum(p, 6);
+        }
+        else if (p[4] == modbus::kOptRead)
+        {
+            len = 10 + p[7];
+            if (left < len)
+                break;
+            uint16_t sum = get_u16(&p[len - 2]);
+            valid = (sum == modbus::checksum(p, len - 2)) || ((p[7] <= 2) && (sum == modbus::checksum(p, 7)));
+        }
+        else
+        {
+            valid = false;
+            len = 0;
+        }
+        if (!valid)
+        {
+            bad_checksums_++;
+            resyncs_++;
+            start++;    // look for the next header inside what was taken for a frame
+            continue;
+        }
+        *frame = ModbusFrameView(p, len);
+        *consumed = start + len;
+        return Result::kFrame;
+    }
+    *consumed = start;
+    return Result::kNeedMore;
+}
+
+} // namespace radar
@@ -0,0 +1,71 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <cerrno>
+#include <system_error>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "radar_client/receive_ring.hpp"
+
+namespace radar {
+
+ReceiveRing::ReceiveRing(size_t capacity)
+{
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    int fd;
+    void* area;
+
+    capacity_ = page;
+    while (capacity_ < capacity)
+        capacity_ <<= 1;    // a power of two, positions wrap with a mask
+    mask_ = capacity_ - 1;
+
+    fd = memfd_create("radar_ring", MFD_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "memfd_create");
+    if (ftruncate(fd, static_cast<off_t>(capacity_)) < 0)
+    {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "ftruncate");
+    }
+    // reserve twice the size, then map the same pages over both halves
+    area = mmap(nullptr, 2 * capacity_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((area == MAP_FAILED) ||
+        (mmap(area, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) ||
+        (mmap(static_cast<uint8_t*>(area) + capacity_, capacity_, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED))
+    {
+        int err = errno;
+        if (area != MAP_FAILED)
+            munmap(area, 2 * capacity_);
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "mmap");
+    }
+    close(fd);  // the mappings keep the pages
+    base_ = static_cast<uint8_t*>(area);
+}
+
+ReceiveRing::~ReceiveRing()
+{
+    munmap(base_, 2 * capacity_);
+}
+
+long ReceiveRing::fill(int fd)
+{
+    ssize_t len;
+
+    if (space() == 0)
+    {
+        errno = ENOBUFS;
+        return -1;
+    }
+    len = read(fd, write_ptr(), space());
+    if (len > 0)
+        commit(static_cast<size_t>(len));
+    return len;
+}
+
+} // namespace radar
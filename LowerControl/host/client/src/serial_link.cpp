@@ -0,0 +1,124 @@
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "radar_client/client.hpp"
+
+namespace radar {
+
+static speed_t serial_speed(unsigned baud)
+{
+    switch (baud)
+    {
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return B0;
+    }
+}
+
+SerialLink::SerialLink(const std::string& path, unsigned baud, size_t ring_size) : ring_(ring_size)
+{
+    struct termios tio;
+    speed_t speed = serial_speed(baud);
+
+    if (speed == B0)
+        throw std::system_error(EINVAL, std::generic_category(), "unsupported baud rate");
+    fd_ = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0)
+        throw std::system_error(errno, std::generic_category(), path);
+    if (tcgetattr(fd_, &tio) < 0)
+    {
+        int err = errno;
+        close(fd_);
+        throw std::system_error(err, std::generic_category(), "tcgetattr");
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd_, TCSANOW, &tio) < 0)
+    {
+        int err = errno;
+        close(fd_);
+        throw std::system_error(err, std::generic_category(), "tcsetattr");
+    }
+    tcflush(fd_, TCIOFLUSH);
+}
+
+SerialLink::~SerialLink()
+{
+    close(fd_);
+}
+
+void SerialLink::attach(EventLoop& loop, FrameHandler handler)
+{
+    handler_ = std::move(handler);
+    loop.add(fd_, EPOLLIN, [this](uint32_t) { on_readable(); });
+}
+
+bool SerialLink::on_readable()
+{
+    while (1)
+    {
+        long len = ring_.fill(fd_);
+
+        if (len == 0)
+            return false;
+        if (len < 0)
+            return (errno == EAGAIN) || (errno == EINTR);
+        reads_++;
+
+        // frames are handed out in place, the ring keeps them contiguous across its end
+        while (1)
+        {
+            ModbusFrameView frame;
+            size_t consumed;
+            ModbusParser::Result result = parser_.parse(ring_.data(), ring_.size(), &frame, &consumed);
+
+            if (result == ModbusParser::Result::kFrame)
+            {
+                if (handler_)
+                    handler_(frame);
+                ring_.consume(consumed);
+                continue;
+            }
+            ring_.consume(consumed);
+            break;
+        }
+    }
+}
+
+bool SerialLink::send(const uint8_t* frame, size_t len)
+{
+    // requests are short: a full TX buffer means the device is gone
+    return write(fd_, frame, len) == static_cast<ssize_t>(len);
+}
+
+bool SerialLink::send_read(uint8_t fun_code, uint8_t len)
+{
+    uint8_t frame[9];
+    return send(frame, modbus::build_read(frame, address_, fun_code, len));
+}
+
+bool SerialLink::send_write(uint8_t fun_code, const uint8_t* data, uint8_t len)
+{
+    uint8_t frame[modbus::kFrameMax];
+    return send(frame, modbus::build_write(frame, address_, fun_code, data, len));
+}
+
+} // namespace radar
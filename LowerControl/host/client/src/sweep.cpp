@@ -0,0 +1,163 @@
+#include <cstring>
+
+#include "radar_client/protocol.hpp"
+#include "radar_client/sweep.hpp"
+#include "radar_client/views.hpp"
+
+extern "C" {
+#include "sweep_codec.h"
+}
+
+namespace radar {
+
+SweepAssembler::SweepAssembler()
+{
+    memset(&sweep_, 0, sizeof(sweep_));
+}
+
+void SweepAssembler::start(uint16_t sequence)
+{
+    if (started_ && !complete_)
+        incomplete_++;
+    started_ = true;
+    complete_ = false;
+    sequence_ = sequence;
+    bins_ = 0;
+    pages_ = 0;
+}
+
+bool SweepAssembler::add(uint8_t format, const uint8_t* payload, size_t size)
+{
+    switch (format)
+    {
+    case sweep::kPolar:
+    case sweep::kPolarLE:
+        return add_page(payload, size);
+    case sweep::kCompact:
+        return add_compact(payload, size);
+    case sweep::kDelta:
+        return add_delta(payload, size);
+    default:
+        errors_++;  // cartesian and LaserScan pages are for their own consumers
+        return false;
+    }
+}
+
+bool SweepAssembler::add_page(const uint8_t* payload, size_t size)
+{
+    PageView page;
+    uint16_t first;
+
+    if (!page.parse(payload, size) || ((page.format() != sweep::kPolar) && (page.format() != sweep::kPolarLE)))
+    {
+        errors_++;
+        return false;
+    }
+    if (!started_ || (page.sequence() != sequence_) || (page.page() == 0))
+    {
+        start(page.sequence());
+        sweep_.sequence = page.sequence();
+        sweep_.start_angle = page.first_angle();
+        sweep_.step = page.step();
+        sweep_.count = 0;
+    }
+    if (page.step() == 0)
+    {
+        errors_++;
+        return false;
+    }
+    first = static_cast<uint16_t>((page.first_angle() - sweep_.start_angle) / page.step());
+    if (first + page.size() > sweep::kPointMax)
+    {
+        errors_++;
+        return false;
+    }
+    for (size_t i = 0; i < page.size(); i++)
+        sweep_.distance[first + i] = page.distance(i);
+    bins_ = static_cast<uint16_t>(bins_ + page.size());
+    pages_++;
+    if (!page.last())
+        return false;
+    // without page 0 the start angle is not known, the bins would be misplaced
+    sweep_.count = static_cast<uint16_t>(first + page.size());
+    complete_ = (pages_ == page.page_count()) && (bins_ == sweep_.count);
+    return complete_;
+}
+
+// sequence(2) start_angle(2) step(1) count(2) first_bin(2) num(2) tokens... fletcher16(2), see sweep_codec.h
+bool SweepAssembler::add_compact(const uint8_t* payload, size_t size)
+{
+    uint16_t sequence;
+    uint16_t first;
+    uint16_t num;
+
+    if (size < SWEEP_CODEC_HEAD_LEN + SWEEP_CODEC_TAIL_LEN)
+    {
+        errors_++;
+        return false;
+    }
+    sequence = get_u16(&payload[0]);
+    first = get_u16(&payload[7]);
+    num = get_u16(&payload[9]);
+    if (!started_ || (sequence != sequence_) || (first == 0))
+        start(sequence);
+    if (Sweep_codec_decode(payload, size, &sweep_) != SWEEP_CODEC_EOK)
+    {
+        errors_++;
+        return false;
+    }
+    bins_ = static_cast<uint16_t>(bins_ + num);
+    complete_ = (first + num == sweep_.count) && (bins_ == sweep_.count);
+    return complete_;
+}
+
+// sequence(2) flags(1) start_angle(2) step(1) count(2) first_bin(2) num(2) then distances or bin + distance pairs,
+// see sweep_change.h: the model is kept between sweeps, every frame updates it
+bool SweepAssembler::add_delta(const uint8_t* payload, size_t size)
+{
+    uint8_t flags = payload[2];
+    uint16_t count = get_u16(&payload[6]);
+    uint16_t first = get_u16(&payload[8]);
+    uint16_t num = get_u16(&payload[10]);
+    const uint8_t* p = payload + sweep::kDeltaHeadLen;
+
+    if ((size < sweep::kDeltaHeadLen) ||
+        (size < sweep::kDeltaHeadLen + num * ((flags & sweep::kDeltaKeyframe) ? 2u : 4u)) ||
+        (count > sweep::kPointMax))
+    {
+        errors_++;
+        return false;
+    }
+    if (flags & sweep::kDeltaKeyframe)
+    {
+        if (first + num > count)
+        {
+            errors_++;
+            return false;
+        }
+        if (first == 0)
+        {
+            delta_valid_ = true;
+            sweep_.start_angle = get_u16(&payload[3]);
+            sweep_.step = payload[5];
+            sweep_.count = count;
+        }
+        for (uint16_t i = 0; i < num; i++, p += 2)
+            sweep_.distance[first + i] = get_u16(p);
+    }
+    else
+    {
+        if (!delta_valid_)
+            return false;   // waiting for a keyframe
+        for (uint16_t i = 0; i < num; i++, p += 4)
+        {
+            uint16_t bin = get_u16(p);
+            if (bin < sweep_.count)
+                sweep_.distance[bin] = get_u16(p + 2);
+        }
+    }
+    sweep_.sequence = get_u16(&payload[0]);
+    return delta_valid_ && !(flags & sweep::kDeltaMore);
+}
+
+} // namespace radar
@@ -0,0 +1,129 @@
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "radar_client/client.hpp"
+
+namespace radar {
+
+TcpStream::TcpStream(const std::string& host, uint16_t port, size_t ring_size) : ring_(ring_size)
+{
+    struct addrinfo hints = {};
+    struct addrinfo* result = nullptr;
+    std::string service = std::to_string(port);
+    int opt = 1;
+    int err;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    err = getaddrinfo(host.c_str(), service.c_str(), &hints, &result);
+    if (err != 0)
+        throw std::system_error(EHOSTUNREACH, std::generic_category(), gai_strerror(err));
+    err = ECONNREFUSED;
+    for (struct addrinfo* ai = result; ai != nullptr; ai = ai->ai_next)
+    {
+        fd_ = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd_ < 0)
+        {
+            err = errno;
+            continue;
+        }
+        if (connect(fd_, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        err = errno;
+        close(fd_);
+        fd_ = -1;
+    }
+    freeaddrinfo(result);
+    if (fd_ < 0)
+        throw std::system_error(err, std::generic_category(), "connect " + host);
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));   // requests are single small frames
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);          // connected blocking, then read in the loop
+}
+
+TcpStream::~TcpStream()
+{
+    close(fd_);
+}
+
+void TcpStream::attach(EventLoop& loop, MessageHandler on_message, FrameHandler on_frame)
+{
+    on_message_ = std::move(on_message);
+    on_frame_ = std::move(on_frame);
+    loop.add(fd_, EPOLLIN | EPOLLRDHUP, [this](uint32_t) { on_readable(); });
+}
+
+bool TcpStream::on_readable()
+{
+    while (1)
+    {
+        long len = ring_.fill(fd_);
+
+        if (len == 0)
+            return false;
+        if (len < 0)
+            return (errno == EAGAIN) || (errno == EINTR);
+
+        // len(2) + body, handed out in place
+        while (ring_.size() >= 2)
+        {
+            const uint8_t* p = ring_.data();
+            size_t body_len = get_u16(p);
+            ScanMessageView message;
+            ModbusFrameView frame;
+            size_t consumed;
+
+            if (ring_.size() < 2 + body_len)
+                break;
+            messages_++;
+            if (message.parse(p + 2, body_len))
+            {
+                if (on_message_)
+                    on_message_(message);
+            }
+            else if ((parser_.parse(p + 2, body_len, &frame, &consumed) == ModbusParser::Result::kFrame) &&
+                     (consumed == body_len))
+            {
+                if (on_frame_)
+                    on_frame_(frame);
+            }
+            else
+            {
+                invalid_++;
+            }
+            ring_.consume(2 + body_len);
+        }
+    }
+}
+
+bool TcpStream::send(const uint8_t* frame, size_t len)
+{
+    uint8_t prefix[2];
+    struct iovec iov[2] = { { prefix, sizeof(prefix) }, { const_cast<uint8_t*>(frame), len } };
+
+    put_u16(prefix, static_cast<uint16_t>(len));
+    return writev(fd_, iov, 2) == static_cast<ssize_t>(2 + len);
+}
+
+bool TcpStream::send_read(uint8_t fun_code, uint8_t len)
+{
+    uint8_t frame[9];
+    return send(frame, modbus::build_read(frame, address_, fun_code, len));
+}
+
+bool TcpStream::send_write(uint8_t fun_code, const uint8_t* data, uint8_t len)
+{
+    uint8_t frame[modbus::kFrameMax];
+    return send(frame, modbus::build_write(frame, address_, fun_code, data, len));
+}
+
+} // namespace radar
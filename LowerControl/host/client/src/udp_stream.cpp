@@ -0,0 +1,132 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "radar_client/client.hpp"
+
+namespace radar {
+
+UdpStream::UdpStream(uint16_t port, const char* group, const char* interface, unsigned batch)
+    : batch_(batch ? batch : 1),
+      slab_(static_cast<size_t>(batch_) * stream::kDatagramMax),
+      headers_(batch_),
+      iov_(batch_),
+      sources_(static_cast<size_t>(batch_) * sizeof(struct sockaddr_in)),
+      last_source_(sizeof(struct sockaddr_in))
+{
+    struct sockaddr_in addr = {};
+    int opt = 1;
+    int rcvbuf = 1 << 20;   // room for bursts while the loop is busy elsewhere
+
+    fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0)
+        throw std::system_error(errno, std::generic_category(), "socket");
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+    setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        int err = errno;
+        close(fd_);
+        throw std::system_error(err, std::generic_category(), "bind");
+    }
+    if (group != nullptr)
+    {
+        struct ip_mreq mreq = {};
+        mreq.imr_multiaddr.s_addr = inet_addr(group);
+        mreq.imr_interface.s_addr = interface ? inet_addr(interface) : htonl(INADDR_ANY);
+        if (setsockopt(fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+        {
+            int err = errno;
+            close(fd_);
+            throw std::system_error(err, std::generic_category(), "IP_ADD_MEMBERSHIP");
+        }
+    }
+
+    // fixed slots, set up once: recvmmsg only fills them in
+    for (unsigned i = 0; i < batch_; i++)
+    {
+        iov_[i].iov_base = &slab_[i * stream::kDatagramMax];
+        iov_[i].iov_len = stream::kDatagramMax;
+        memset(&headers_[i], 0, sizeof(headers_[i]));
+        headers_[i].msg_hdr.msg_iov = &iov_[i];
+        headers_[i].msg_hdr.msg_iovlen = 1;
+        headers_[i].msg_hdr.msg_name = &sources_[i * sizeof(struct sockaddr_in)];
+    }
+}
+
+UdpStream::~UdpStream()
+{
+    close(fd_);
+}
+
+void UdpStream::attach(EventLoop& loop, MessageHandler handler)
+{
+    handler_ = std::move(handler);
+    loop.add(fd_, EPOLLIN, [this](uint32_t) { on_readable(); });
+}
+
+void UdpStream::on_readable()
+{
+    while (1)
+    {
+        int num;
+
+        for (unsigned i = 0; i < batch_; i++)
+            headers_[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        num = recvmmsg(fd_, headers_.data(), batch_, MSG_DONTWAIT, nullptr);
+        if (num <= 0)
+            return;
+        batches_++;
+        for (int i = 0; i < num; i++)
+        {
+            ScanMessageView message;
+
+            datagrams_++;
+            if (!message.parse(static_cast<const uint8_t*>(iov_[i].iov_base), headers_[i].msg_len))
+            {
+                invalid_++;
+                continue;
+            }
+            if (handler_)
+                handler_(message);
+        }
+        memcpy(last_source_.data(), &sources_[(num - 1) * sizeof(struct sockaddr_in)], sizeof(struct sockaddr_in));
+        if (static_cast<unsigned>(num) < batch_)
+            return;     // drained
+    }
+}
+
+bool UdpStream::send_nack(const uint32_t* seq, size_t count, uint16_t control_port)
+{
+    uint8_t buf[4 + 4 * UINT8_MAX];
+    struct sockaddr_in dest;
+
+    memcpy(&dest, last_source_.data(), sizeof(dest));
+    if ((count == 0) || (count > UINT8_MAX) || (dest.sin_family != AF_INET))
+        return false;
+    put_u16(&buf[0], stream::kNackMagic);
+    buf[2] = stream::kVersion;
+    buf[3] = static_cast<uint8_t>(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        put_u16(&buf[4 + 4 * i], static_cast<uint16_t>(seq[i] >> 16));
+        put_u16(&buf[6 + 4 * i], static_cast<uint16_t>(seq[i] & 0xFFFF));
+    }
+    dest.sin_port = htons(control_port);
+    return sendto(fd_, buf, 4 + 4 * count, 0, reinterpret_cast<struct sockaddr*>(&dest), sizeof(dest)) > 0;
+}
+
+} // namespace radar
@@ -0,0 +1,271 @@
+/*
+ * atk_emulator: a standalone ATK-MS53L0M on a pty, for the sensor driver and for radar_sim -s.
+ * Every read and write function code of atk_ms53l0m.h is served, Normal work mode prints the
+ * readings at the back rate, and faults (drops, OPT_ERROR answers, flipped bits) and latency
+ * can be set to drive the driver through its timeout, checksum and operation error paths.
+ * With no latency and a short ranging period it is a load source: the answers per second it
+ * reports are the sample rate the driver sustains.
+ *
+ *   atk_emulator                             prints the pty to hand to the driver
+ *   radar_sim -s /dev/pts/N                  the firmware on the emulator
+ *   atk_emulator -P walk.txt -d 0.02 -e 0.01 scripted distances, 2% lost, 1% error frames
+ *   atk_emulator -L 0 -p 0.1 -i 1            load source, one stats line per second
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "esp_timer.h"
+#include "sim.h"
+#include "atk_ms53l0m.h"
+
+static volatile sig_atomic_t g_stop = 0;
+static Sim_profile_t g_profile;
+
+static void Emulator_usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -l PATH       serve an existing tty instead of a new pty\n"
+            "  -a ADDR       device address, 0x0001..0xFFFE (1)\n"
+            "  -B BAUD       line speed at power on, one of the module rates 2400..921600 (115200)\n"
+            "  -W MODE       work mode at power on: normal, modbus (modbus)\n"
+            "  -M MODE       measurement mode 0..3: general, high precision, long, high speed (0)\n"
+            "  -R CODE       back rate code 0..9, 0.1 Hz .. 100 Hz (6, 10 Hz)\n"
+            "  -b HZ         Normal mode output rate, overrides the back rate\n"
+            "  -p MS         ranging period, overrides the measurement mode\n"
+            "  -L US         answer latency (500)\n"
+            "  -J US         uniform latency jitter (0)\n"
+            "  -D MM         constant distance, 0..65535 (500)\n"
+            "  -P FILE       distance profile: \"time_ms distance_mm\" lines, optional \"loop\"\n"
+            "  -n MM         ranging noise in general mode (5)\n"
+            "  -d RATE       answers dropped, 0..1 (0)\n"
+            "  -e RATE       answers replaced by OPT_ERROR frames, 0..1 (0)\n"
+            "  -c RATE       answers with one bit flipped, 0..1 (0)\n"
+            "  -A            faults on every answer, not only measurements\n"
+            "  -E            no error frames at power on\n"
+            "  -s SEED       noise and fault seed (1)\n"
+            "  -i SEC        stats line interval, 0 for the totals only (0)\n"
+            "  -t SEC        run time, 0 until interrupted (0)\n",
+            name);
+}
+
+/* Unsigned option in the given base (0: C prefixes), within [min, max] */
+static bool Emulator_parse_unsigned(const char* arg, int base, unsigned long min, unsigned long max,
+                                    unsigned long* out)
+{
+    unsigned long value;
+    char* end;
+
+    errno = 0;
+    value = strtoul(arg, &end, base);
+    if ((errno != 0) || (end == arg) || (*end != '\0') || (arg[0] == '-') || (value < min) || (value > max))
+        return false;
+    *out = value;
+    return true;
+}
+
+/* Real option, finite and within [min, max] */
+static bool Emulator_parse_real(const char* arg, double min, double max, double* out)
+{
+    double value;
+    char* end;
+
+    errno = 0;
+    value = strtod(arg, &end);
+    if ((errno != 0) || (end == arg) || (*end != '\0') || !isfinite(value) || (value < min) || (value > max))
+        return false;
+    *out = value;
+    return true;
+}
+
+static void Emulator_on_signal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+/* New pty, the returned master is the module's end and the far end stays open in raw mode */
+static int Emulator_open_pty(char* path, size_t path_len)
+{
+    struct termios tio;
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    int slave;
+
+    if (master < 0)
+        return -1;
+    if ((grantpt(master) != 0) || (unlockpt(master) != 0) || (ptsname_r(master, path, path_len) != 0) ||
+        ((slave = open(path, O_RDWR | O_NOCTTY)) < 0))
+    {
+        close(master);
+        return -1;
+    }
+    if (tcgetattr(slave, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+    }
+    return master;
+}
+
+static void Emulator_print_stats(double t_s, const Sim_sensor_stats_t* stats, const Sim_sensor_stats_t* last,
+                                 double interval_s)
+{
+    printf("t_s %.1f requests %u answers %u measurements %u streamed %u errors %u dropped %u corrupted %u "
+           "bad_bytes %u answers_per_s %.1f\n",
+           t_s, stats->requests, stats->answers, stats->measurements, stats->streamed, stats->errors,
+           stats->dropped, stats->corrupted, stats->bad_frames,
+           (interval_s > 0.0) ? (stats->answers - last->answers) / interval_s : 0.0);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    Sim_sensor_config_t config;
+    Sim_sensor_stats_t stats;
+    Sim_sensor_stats_t last;
+    const char* line_path = NULL;
+    char path[64];
+    double distance = 500.0;
+    double interval_s = 0.0;
+    double run_s = 0.0;
+    int64_t start;
+    int64_t next;
+    unsigned long value;
+    int fd;
+    int opt;
+
+    Sim_sensor_default_config(&config);
+    while ((opt = getopt(argc, argv, "l:a:B:W:M:R:b:p:L:J:D:P:n:d:e:c:AEs:i:t:h")) != -1)
+    {
+        bool ok = true;
+
+        switch (opt)
+        {
+            case 'l': line_path = optarg; break;
+            case 'a':
+                ok = Emulator_parse_unsigned(optarg, 0, 0x0001, 0xFFFE, &value);
+                config.addr = (uint16_t)value;
+                break;
+            case 'B':
+                ok = Emulator_parse_unsigned(optarg, 10, 1, INT_MAX, &value);
+                config.baud_rate = (int)value;
+                break;
+            case 'W':
+                if (strcmp(optarg, "normal") == 0)
+                    config.workmode = ATK_MS53L0M_WORKMODE_NORMAL;
+                else if (strcmp(optarg, "modbus") == 0)
+                    config.workmode = ATK_MS53L0M_WORKMODE_MODBUS;
+                else
+                {
+                    Emulator_usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'M':
+                ok = Emulator_parse_unsigned(optarg, 10, 0, ATK_MS53L0M_MEAUMODE_HISPEED, &value);
+                config.meaumode = (uint8_t)value;
+                break;
+            case 'R':
+                ok = Emulator_parse_unsigned(optarg, 10, 0, ATK_MS53L0M_BACKRATE_100HZ, &value);
+                config.backrate = (uint8_t)value;
+                break;
+            case 'b': ok = Emulator_parse_real(optarg, 0.0, HUGE_VAL, &config.stream_hz); break;
+            case 'p': ok = Emulator_parse_real(optarg, 0.0, HUGE_VAL, &config.period_ms); break;
+            case 'L': ok = Emulator_parse_real(optarg, 0.0, HUGE_VAL, &config.latency_us); break;
+            case 'J': ok = Emulator_parse_real(optarg, 0.0, HUGE_VAL, &config.jitter_us); break;
+            case 'D': ok = Emulator_parse_real(optarg, 0.0, 65535.0, &distance); break;
+            case 'P':
+                if (Sim_profile_load(optarg, &g_profile) != 0)
+                {
+                    fprintf(stderr, "%s: not a distance profile\n", optarg);
+                    return 1;
+                }
+                config.profile = &g_profile;
+                break;
+            case 'n': ok = Emulator_parse_real(optarg, 0.0, HUGE_VAL, &config.noise_mm); break;
+            case 'd': ok = Emulator_parse_real(optarg, 0.0, 1.0, &config.drop_rate); break;
+            case 'e': ok = Emulator_parse_real(optarg, 0.0, 1.0, &config.error_rate); break;
+            case 'c': ok = Emulator_parse_real(optarg, 0.0, 1.0, &config.corrupt_rate); break;
+            case 'A': config.fault_all = true; break;
+            case 'E': config.error_frames = false; break;
+            case 's':
+                ok = Emulator_parse_unsigned(optarg, 0, 0, UINT32_MAX, &value);
+                config.seed = (uint32_t)value;
+                break;
+            case 'i': ok = Emulator_parse_real(optarg, 0.0, HUGE_VAL, &interval_s); break;
+            case 't': ok = Emulator_parse_real(optarg, 0.0, HUGE_VAL, &run_s); break;
+            default:
+                Emulator_usage(argv[0]);
+                return (opt == 'h') ? 0 : 2;
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "%s: bad value for -%c: %s\n", argv[0], opt, optarg);
+            Emulator_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind < argc)
+    {
+        Emulator_usage(argv[0]);
+        return 2;
+    }
+    if (config.profile == NULL)
+    {
+        /* A constant distance is a one point profile */
+        g_profile.t_ms[0] = 0.0;
+        g_profile.mm[0] = distance;
+        g_profile.num = 1;
+        config.profile = &g_profile;
+    }
+
+    if (line_path != NULL)
+    {
+        fd = Sim_uart_open_tty(line_path, config.baud_rate);
+        snprintf(path, sizeof(path), "%s", line_path);
+    }
+    else
+        fd = Emulator_open_pty(path, sizeof(path));
+    if (fd < 0)
+    {
+        fprintf(stderr, "line: %s\n", strerror(errno));
+        return 1;
+    }
+    if (Sim_sensor_start(&config, fd) != 0)
+    {
+        Emulator_usage(argv[0]);
+        return 2;
+    }
+    fprintf(stderr, "ATK-MS53L0M 0x%04X on %s\n", config.addr, path);
+
+    signal(SIGINT, Emulator_on_signal);
+    signal(SIGTERM, Emulator_on_signal);
+    memset(&last, 0, sizeof(last));
+    start = esp_timer_get_time();
+    next = start + (int64_t)(interval_s * 1e6);
+    while (!g_stop && ((run_s <= 0.0) || (esp_timer_get_time() - start < (int64_t)(run_s * 1e6))))
+    {
+        usleep(10000);
+        if ((interval_s > 0.0) && (esp_timer_get_time() >= next))
+        {
+            Sim_sensor_get_stats(&stats);
+            Emulator_print_stats((double)(esp_timer_get_time() - start) / 1e6, &stats, &last, interval_s);
+            last = stats;
+            next += (int64_t)(interval_s * 1e6);
+        }
+    }
+    Sim_sensor_get_stats(&stats);
+    memset(&last, 0, sizeof(last));
+    run_s = (double)(esp_timer_get_time() - start) / 1e6;
+    Emulator_print_stats(run_s, &stats, &last, run_s);
+    _exit(0);   /* The module threads never return */
+}
@@ -0,0 +1,6 @@
+#ifndef _SIM_DRIVER_I2C_H_
+#define _SIM_DRIVER_I2C_H_
+
+/* Included by main.c, nothing of it is used */
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef _SIM_ESP_CPU_H_
+#define _SIM_ESP_CPU_H_
+
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+/*
+ * Cycle counter, inline like the IDF one. On x86 the time stamp counter: it runs at a fixed rate
+ * near the nominal clock, not at the core clock under turbo or power saving, so compare host
+ * numbers with host numbers. Nanoseconds elsewhere.
+ */
+static inline esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (esp_cpu_cycle_count_t)__rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (esp_cpu_cycle_count_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+#endif
+}
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _SIM_ESP_EVENT_H_
+#define _SIM_ESP_EVENT_H_
+
+#include "esp_err.h"
+
+typedef const char* esp_event_base_t;
+
+#endif
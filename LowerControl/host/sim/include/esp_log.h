@@ -0,0 +1,40 @@
+#ifndef _SIM_ESP_LOG_H_
+#define _SIM_ESP_LOG_H_
+
+#include <stdarg.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+typedef enum {
+    ESP_LOG_NONE = 0,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+typedef int (*vprintf_like_t)(const char* format, va_list ap);
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func); /* returns the previous one */
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+uint32_t esp_log_timestamp(void);
+esp_log_level_t esp_log_level_get(const char* tag);
+void esp_log_level_set(const char* tag, esp_log_level_t level);
+
+/* Written to stderr unless redirected with esp_log_set_vprintf, stdout is left to the simulator report */
+#define ESP_LOG_LEVEL_LOCAL(level, letter, tag, format, ...)                                        \
+    do {                                                                                            \
+        if (CONFIG_LOG_DEFAULT_LEVEL >= (level))                                                    \
+            esp_log_write((level), (tag), letter " (%lu) %s: " format "\n",                          \
+                          (unsigned long)esp_log_timestamp(), (tag), ##__VA_ARGS__);                \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...)  ESP_LOG_LEVEL_LOCAL(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)  ESP_LOG_LEVEL_LOCAL(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)  ESP_LOG_LEVEL_LOCAL(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)  ESP_LOG_LEVEL_LOCAL(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)  ESP_LOG_LEVEL_LOCAL(ESP_LOG_VERBOSE, "V", tag, format, ##__VA_ARGS__)
+#define ESP_EARLY_LOGI(tag, format, ...) ESP_LOGI(tag, format, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _SIM_ESP_NETIF_H_
+#define _SIM_ESP_NETIF_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/* One station interface on the loopback address */
+typedef struct Sim_netif esp_netif_t;
+
+typedef struct {
+    uint32_t addr;                      /* Network byte order */
+} esp_ip4_addr_t;
+
+typedef struct {
+    esp_ip4_addr_t ip;
+    esp_ip4_addr_t netmask;
+    esp_ip4_addr_t gw;
+} esp_netif_ip_info_t;
+
+esp_netif_t* esp_netif_get_handle_from_ifkey(const char* if_key);
+esp_err_t esp_netif_get_ip_info(esp_netif_t* netif, esp_netif_ip_info_t* ip_info);
+int esp_netif_get_netif_impl_index(esp_netif_t* netif);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _SIM_ESP_RANDOM_H_
+#define _SIM_ESP_RANDOM_H_
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
+
+#endif
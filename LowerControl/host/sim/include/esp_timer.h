@@ -0,0 +1,8 @@
+#ifndef _SIM_ESP_TIMER_H_
+#define _SIM_ESP_TIMER_H_
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void); /* µs since the simulator started, CLOCK_MONOTONIC unless Sim_clock_set_drift */
+
+#endif
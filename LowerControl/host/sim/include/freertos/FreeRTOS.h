@@ -0,0 +1,179 @@
+#ifndef _SIM_FREERTOS_H_
+#define _SIM_FREERTOS_H_
+
+/*
+ * FreeRTOS API of ESP-IDF on POSIX threads, for the host build of the firmware.
+ * Every task is a thread and all of them run at once: priorities are kept for the telemetry
+ * but do not order anything, a critical section is one process-wide recursive lock.
+ * The whole kernel API is declared here, task.h, queue.h, semphr.h and event_groups.h only include it.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t EventBits_t;
+typedef uint32_t StackType_t;
+
+typedef struct Sim_task* TaskHandle_t;
+typedef struct Sim_queue* QueueHandle_t;
+typedef struct Sim_queue* SemaphoreHandle_t;
+typedef struct Sim_event_group* EventGroupHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define configTICK_RATE_HZ          CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES        25
+#define configMAX_TASK_NAME_LEN     16
+#define configNUM_CORES             2
+#define portNUM_PROCESSORS          configNUM_CORES
+
+#define portMAX_DELAY               ((TickType_t)0xFFFFFFFFUL)
+#define portTICK_PERIOD_MS          ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)           ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define pdTICKS_TO_MS(ticks)        ((TickType_t)(((uint64_t)(ticks) * 1000) / configTICK_RATE_HZ))
+
+#define pdFALSE                     ((BaseType_t)0)
+#define pdTRUE                      ((BaseType_t)1)
+#define pdFAIL                      pdFALSE
+#define pdPASS                      pdTRUE
+#define errQUEUE_FULL               ((BaseType_t)0)
+#define errQUEUE_EMPTY              ((BaseType_t)0)
+
+#define tskIDLE_PRIORITY            ((UBaseType_t)0)
+#define tskNO_AFFINITY              ((BaseType_t)0x7FFFFFFF)
+
+#ifndef BIT0
+#define BIT31   0x80000000
+#define BIT7    0x00000080
+#define BIT6    0x00000040
+#define BIT5    0x00000020
+#define BIT4    0x00000010
+#define BIT3    0x00000008
+#define BIT2    0x00000004
+#define BIT1    0x00000002
+#define BIT0    0x00000001
+#endif
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define EXT_RAM_BSS_ATTR
+
+/* Critical sections: the spinlock is not used, one recursive lock serialises them all */
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0, 0 }
+
+void Sim_enter_critical(void);
+void Sim_exit_critical(void);
+
+#define portENTER_CRITICAL(mux)         do { (void)(mux); Sim_enter_critical(); } while (0)
+#define portEXIT_CRITICAL(mux)          do { (void)(mux); Sim_exit_critical(); } while (0)
+#define portENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
+#define taskENTER_CRITICAL(mux)         portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux)          portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR(woken)       do { (void)(woken); } while (0)
+
+BaseType_t xPortGetCoreID(void);
+
+/* Tasks */
+typedef enum {
+    eNoAction = 0,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+typedef enum {
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid,
+} eTaskState;
+
+typedef struct {
+    TaskHandle_t xHandle;
+    const char* pcTaskName;
+    UBaseType_t xTaskNumber;
+    eTaskState eCurrentState;
+    UBaseType_t uxCurrentPriority;
+    UBaseType_t uxBasePriority;
+    uint32_t ulRunTimeCounter;          /* Thread CPU time (µs) */
+    StackType_t* pxStackBase;
+    uint32_t usStackHighWaterMark;
+    BaseType_t xCoreID;
+} TaskStatus_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* param,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+#define xTaskCreate(function, name, stack_depth, param, priority, handle) \
+    xTaskCreatePinnedToCore((function), (name), (stack_depth), (param), (priority), (handle), tskNO_AFFINITY)
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskDelayUntil(TickType_t* previous_wake, TickType_t increment);
+#define vTaskDelayUntil(previous_wake, increment) ((void)xTaskDelayUntil((previous_wake), (increment)))
+void vTaskSuspend(TaskHandle_t task);
+void vTaskResume(TaskHandle_t task);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+UBaseType_t uxTaskGetNumberOfTasks(void);
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* status, UBaseType_t capacity, uint32_t* total_run_time);
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core);
+#define xTaskGetIdleTaskHandleForCPU(core) xTaskGetIdleTaskHandleForCore(core)
+BaseType_t xTaskGetCoreID(TaskHandle_t task);
+#define xTaskGetAffinity(task) xTaskGetCoreID(task)
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+#define xTaskNotifyFromISR(task, value, action, woken) xTaskNotify((task), (value), (action))
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks);
+#define xTaskNotifyGive(task) xTaskNotify((task), 0, eIncrement)
+#define vTaskNotifyGiveFromISR(task, woken) ((void)xTaskNotifyGive(task))
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+
+/* Queues and semaphores, a semaphore is a queue of empty items */
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks);
+#define xQueueSendToBack(queue, item, ticks) xQueueSend((queue), (item), (ticks))
+#define xQueueSendFromISR(queue, item, woken) xQueueSend((queue), (item), 0)
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticks);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks);
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+#define xSemaphoreCreateBinary()            xSemaphoreCreateCounting(1, 0)
+#define xSemaphoreCreateMutex()             xSemaphoreCreateCounting(1, 1)
+#define vSemaphoreDelete(semaphore)         vQueueDelete(semaphore)
+#define xSemaphoreTake(semaphore, ticks)    xQueueReceive((semaphore), NULL, (ticks))
+#define xSemaphoreGive(semaphore)           xQueueSend((semaphore), NULL, 0)
+#define xSemaphoreGiveFromISR(semaphore, woken) xQueueSend((semaphore), NULL, 0)
+#define uxSemaphoreGetCount(semaphore)      uxQueueMessagesWaiting(semaphore)
+
+/* Event groups */
+EventGroupHandle_t xEventGroupCreate(void);
+void vEventGroupDelete(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+
+#endif
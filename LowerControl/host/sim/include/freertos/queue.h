@@ -0,0 +1,6 @@
+#ifndef _SIM_QUEUE_H_
+#define _SIM_QUEUE_H_
+
+#include "freertos/FreeRTOS.h"   /* the whole kernel API is declared there */
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _SIM_TASK_H_
+#define _SIM_TASK_H_
+
+#include "freertos/FreeRTOS.h"   /* the whole kernel API is declared there */
+
+#endif
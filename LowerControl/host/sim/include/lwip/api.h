@@ -0,0 +1,36 @@
+#ifndef _SIM_LWIP_API_H_
+#define _SIM_LWIP_API_H_
+
+#include <stdint.h>
+#include "lwip/err.h"
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+/* lwIP netconn API, UDP only, see sim_lwip.c */
+enum netconn_type {
+    NETCONN_UDP         = 0x20,
+    NETCONN_UDP_IPV6    = 0x28,
+};
+
+struct netconn {
+    enum netconn_type type;
+    union {
+        struct udp_pcb* udp;
+    } pcb;
+};
+
+struct netbuf {
+    struct pbuf* p;
+    struct pbuf* ptr;
+};
+
+struct netconn* netconn_new(enum netconn_type type);
+err_t netconn_delete(struct netconn* conn);
+err_t netconn_connect(struct netconn* conn, const ip_addr_t* addr, uint16_t port);
+err_t netconn_send(struct netconn* conn, struct netbuf* buf); /* ERR_MEM when the driver TX queue is full */
+
+struct netbuf* netbuf_new(void);
+void netbuf_delete(struct netbuf* buf); /* frees the pbuf chain it holds */
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _SIM_LWIP_ERR_H_
+#define _SIM_LWIP_ERR_H_
+
+#include <stdint.h>
+#include "lwip/sockets.h"
+
+/* lwIP error codes, returned by the netconn API of sim_lwip.c */
+typedef int8_t err_t;
+
+#define ERR_OK          0
+#define ERR_MEM         -1      /* Out of memory, the driver TX queue is full */
+#define ERR_BUF         -2
+#define ERR_TIMEOUT     -3
+#define ERR_RTE         -4
+#define ERR_INPROGRESS  -5
+#define ERR_VAL         -6      /* Illegal value */
+#define ERR_WOULDBLOCK  -7
+#define ERR_USE         -8
+#define ERR_ALREADY     -9
+#define ERR_ISCONN      -10
+#define ERR_CONN        -11     /* Not connected */
+#define ERR_IF          -12     /* Low-level netif error */
+#define ERR_ABRT        -13
+#define ERR_RST         -14
+#define ERR_CLSD        -15
+#define ERR_ARG         -16
+
+#endif
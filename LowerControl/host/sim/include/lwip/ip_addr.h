@@ -0,0 +1,23 @@
+#ifndef _SIM_LWIP_IP_ADDR_H_
+#define _SIM_LWIP_IP_ADDR_H_
+
+#include <stdint.h>
+#include "lwip/sockets.h"
+
+/* lwIP dual-stack address */
+#define IPADDR_TYPE_V4  0U
+#define IPADDR_TYPE_V6  6U
+
+typedef struct {
+    union {
+        struct in_addr ip4;
+        struct in6_addr ip6;
+    } u_addr;
+    uint8_t type;                       /* IPADDR_TYPE_xx */
+} ip_addr_t;
+
+#define IP_IS_V6(ipaddr)    ((ipaddr)->type == IPADDR_TYPE_V6)
+
+int ipaddr_aton(const char* cp, ip_addr_t* addr); /* 1 on success */
+
+#endif
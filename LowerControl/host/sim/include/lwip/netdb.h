@@ -0,0 +1,6 @@
+#ifndef _SIM_LWIP_NETDB_H_
+#define _SIM_LWIP_NETDB_H_
+
+#include <netdb.h>
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _SIM_LWIP_PBUF_H_
+#define _SIM_LWIP_PBUF_H_
+
+#include <stdint.h>
+#include "lwip/err.h"
+
+/* lwIP packet buffers: the allocation, chaining and reference counting of pbuf.c, see sim_lwip.c */
+#define LWIP_SUPPORT_CUSTOM_PBUF    1
+
+typedef enum {
+    PBUF_TRANSPORT,
+    PBUF_IP,
+    PBUF_LINK,
+    PBUF_RAW_TX,
+    PBUF_RAW,
+} pbuf_layer;
+
+typedef enum {
+    PBUF_RAM,                           /* Payload allocated with the pbuf */
+    PBUF_ROM,
+    PBUF_REF,                           /* Payload owned by someone else */
+    PBUF_POOL,
+} pbuf_type;
+
+struct pbuf {
+    struct pbuf* next;
+    void* payload;
+    uint16_t tot_len;                   /* This pbuf and the rest of the chain */
+    uint16_t len;
+    uint8_t type;                       /* pbuf_type */
+    uint8_t flags;                      /* PBUF_FLAG_xx */
+    uint16_t ref;
+};
+
+#define PBUF_FLAG_IS_CUSTOM         0x02U
+
+typedef void (*pbuf_free_custom_fn)(struct pbuf* p);
+
+/* pbuf whose memory and payload belong to the application, given back through custom_free_function */
+struct pbuf_custom {
+    struct pbuf pbuf;                   /* Must stay the first member */
+    pbuf_free_custom_fn custom_free_function;
+};
+
+struct pbuf* pbuf_alloc(pbuf_layer layer, uint16_t length, pbuf_type type);
+struct pbuf* pbuf_alloced_custom(pbuf_layer layer, uint16_t length, pbuf_type type, struct pbuf_custom* p,
+                                 void* payload_mem, uint16_t payload_mem_len);
+void pbuf_realloc(struct pbuf* p, uint16_t size);
+void pbuf_ref(struct pbuf* p);
+uint8_t pbuf_free(struct pbuf* p); /* number of pbufs freed */
+void pbuf_cat(struct pbuf* head, struct pbuf* tail); /* the chain takes over the reference of tail */
+
+#endif
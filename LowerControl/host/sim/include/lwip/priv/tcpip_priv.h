@@ -0,0 +1,15 @@
+#ifndef _SIM_LWIP_TCPIP_PRIV_H_
+#define _SIM_LWIP_TCPIP_PRIV_H_
+
+#include "lwip/err.h"
+
+/* Run a function in the thread that owns the pcbs */
+struct tcpip_api_call_data {
+    err_t err;
+};
+
+typedef err_t (*tcpip_api_call_fn)(struct tcpip_api_call_data* call);
+
+err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data* call);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef _SIM_LWIP_SOCKETS_H_
+#define _SIM_LWIP_SOCKETS_H_
+
+/* lwIP BSD socket API: the host socket API, loopback plays the WiFi network */
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _SIM_LWIP_SYS_H_
+#define _SIM_LWIP_SYS_H_
+
+#include "lwip/sockets.h"
+
+#endif
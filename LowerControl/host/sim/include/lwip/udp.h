@@ -0,0 +1,18 @@
+#ifndef _SIM_LWIP_UDP_H_
+#define _SIM_LWIP_UDP_H_
+
+#include <stdint.h>
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+
+#define LWIP_MULTICAST_TX_OPTIONS   1
+
+/* UDP protocol control block: a host socket connected to the destination */
+struct udp_pcb {
+    int sock;
+    uint8_t mcast_ttl;
+};
+
+void udp_set_multicast_ttl(struct udp_pcb* pcb, uint8_t ttl); /* tcpip thread only */
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _SIM_MBEDTLS_SHA1_H_
+#define _SIM_MBEDTLS_SHA1_H_
+
+#include <stddef.h>
+
+/* Only the one-shot digest the WebSocket handshake needs */
+int mbedtls_sha1(const unsigned char* input, size_t ilen, unsigned char output[20]);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef _SIM_NVS_FLASH_H_
+#define _SIM_NVS_FLASH_H_
+
+#include "esp_err.h"
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif
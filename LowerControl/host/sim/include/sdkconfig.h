@@ -0,0 +1,95 @@
+#ifndef _SIM_SDKCONFIG_H_
+#define _SIM_SDKCONFIG_H_
+
+/*
+ * Configuration of the host build: the Kconfig defaults of main, Steering and WIFI,
+ * except where noted. The log level can be set with -DCONFIG_LOG_DEFAULT_LEVEL=n, edit this file for the others.
+ */
+
+#define CONFIG_IDF_TARGET_LINUX                 1
+#define CONFIG_FREERTOS_HZ                      100
+#ifndef CONFIG_LOG_DEFAULT_LEVEL
+#define CONFIG_LOG_DEFAULT_LEVEL                3
+#endif
+
+/* Radar UART Configuration: every port is a pty, see sim_uart.c */
+#define CONFIG_RADAR_USING_UART0                1
+#define CONFIG_RADAR_UART0_PORT_NUM             0
+#define CONFIG_RADAR_UART0_BAUD_RATE            115200
+#define CONFIG_RADAR_UART0_RXD                  45
+#define CONFIG_RADAR_UART0_TXD                  46
+#define CONFIG_RADAR_UART0_TASK_STACK_SIZE      2048
+#define CONFIG_RADAR_USING_UART1                1
+#define CONFIG_RADAR_UART1_PORT_NUM             1
+#define CONFIG_RADAR_UART1_BAUD_RATE            115200
+#define CONFIG_RADAR_UART1_RXD                  41
+#define CONFIG_RADAR_UART1_TXD                  42
+#define CONFIG_RADAR_UART1_TASK_STACK_SIZE      2048
+#define CONFIG_RADAR_USING_UART2                1
+#define CONFIG_RADAR_UART2_PORT_NUM             2
+#define CONFIG_RADAR_UART2_BAUD_RATE            115200
+#define CONFIG_RADAR_UART2_RXD                  15
+#define CONFIG_RADAR_UART2_TXD                  16
+#define CONFIG_RADAR_UART2_TASK_STACK_SIZE      2048
+
+/* Sweep change detection */
+#define CONFIG_RADAR_CHANGE_TOLERANCE_MM        20
+#define CONFIG_RADAR_CHANGE_KEYFRAME_INTERVAL   50
+
+/* LaserScan output */
+#define CONFIG_RADAR_LASERSCAN_RANGE_MIN_MM     30
+#define CONFIG_RADAR_LASERSCAN_RANGE_MAX_MM     2000
+
+/* Network scan streaming and control */
+#define CONFIG_RADAR_CONTROL_PORT               3334
+#define CONFIG_RADAR_SERVER_PORT                3335
+#define CONFIG_RADAR_SERVER_CLIENT_MAX          4
+#define CONFIG_RADAR_MULTICAST_TTL              1
+#define CONFIG_RADAR_DISCOVERY_PORT             3336
+#define CONFIG_RADAR_DISCOVERY_GROUP            "239.255.82.82"
+#define CONFIG_RADAR_DISCOVERY_INTERVAL_MS      5000
+#define CONFIG_RADAR_TIME_SERVER                ""
+#define CONFIG_RADAR_TIME_PORT                  3337
+#define CONFIG_RADAR_TIME_POLL_MS               1000
+#define CONFIG_RADAR_STREAM_DATAGRAM_LEN        1400
+#define CONFIG_RADAR_STREAM_SLICE_INTERVAL_MS   2
+#ifndef CONFIG_RADAR_STREAM_ZERO_COPY
+#define CONFIG_RADAR_STREAM_ZERO_COPY           1       /* on the netconn and pbufs of sim_lwip.c */
+#endif
+#define CONFIG_RADAR_STREAM_FEC_GROUP           0
+
+/* Diagnostics */
+#define CONFIG_RADAR_LATENCY_HISTOGRAMS         1
+#define CONFIG_RADAR_TASK_STATS                 1
+#define CONFIG_RADAR_TASK_STATS_PERIOD_MS       1000
+#define CONFIG_RADAR_TRACE                      1
+#define CONFIG_RADAR_TRACE_RING_ORDER           8
+#define CONFIG_RADAR_UART_CAPTURE               1
+#define CONFIG_RADAR_UART_CAPTURE_RING_ORDER    9
+#define CONFIG_RADAR_LOG_QUEUE_LEN              32
+#define CONFIG_RADAR_LOG_LEVEL_UART             2
+#define CONFIG_RADAR_LOG_LEVEL_MODBUS           2
+#define CONFIG_RADAR_LOG_LEVEL_DISPATCH         2
+#define CONFIG_RADAR_LOG_LEVEL_MEASURE          2
+
+/* Steering engine Control */
+#define CONFIG_STEERING_NUM                     2
+#define CONFIG_STEERING_0_GPIO_NUM              5
+#define CONFIG_STEERING_1_GPIO_NUM              6
+#define CONFIG_STEERING_BASE_FREQUENCY          50
+#define CONFIG_STEERING_DUTY_RESOLUTION         13
+#define CONFIG_STEERING_ANGLE_SCOPE             180
+#define CONFIG_STEERING_DEFAULT_ANGLE           0
+#define CONFIG_STEERING_MAX_HIGH_TIME           2500
+#define CONFIG_STEERING_MIN_HIGH_TIME           500
+
+/* Kernel benchmarks: the entry points are built, host/bench/bench_kernels runs the suite */
+#define CONFIG_RADAR_BENCH                      1
+#define CONFIG_RADAR_BENCH_ROUNDS               7
+
+/* UDP Clinet Configuration: the stream goes to this host */
+#define CONFIG_EXAMPLE_IPV4                     1
+#define CONFIG_EXAMPLE_IPV4_ADDR                "127.0.0.1"     /* default 192.168.0.165 */
+#define CONFIG_EXAMPLE_PORT                     3333
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef _SIM_H_
+#define _SIM_H_
+
+/*
+ * Host build of the radar firmware: the models and wiring behind the ESP-IDF shims.
+ * The firmware runs unchanged on top of them, sim_main.c puts them together.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/uart.h"
+
+#define SIM_SERVO_NUM           8       /* LEDC_CHANNEL_MAX */
+#define SIM_SCENE_CIRCLE_MAX    8
+#define SIM_SENSOR_OUT_OF_RANGE 8190    /* Reading of the VL53L0X when nothing is in range (mm) */
+
+/* Clock: esp_timer against CLOCK_MONOTONIC */
+void Sim_clock_set_drift(double ppm);
+
+/* NVS */
+void Sim_nvs_set_file(const char* path);
+
+/* UART: each port is a file descriptor, a pty unless one is attached before uart_driver_install */
+int Sim_uart_attach(uart_port_t uart_num, int fd);
+int Sim_uart_open_pty(uart_port_t uart_num, char* path, size_t path_len);
+int Sim_uart_open_tty(const char* path, int baud_rate);
+const char* Sim_uart_path(uart_port_t uart_num);
+
+/* Servo: hobby servo behind each LEDC channel */
+typedef struct {
+    double slew_dps;            /* Angular speed while moving (°/s) */
+    double dead_ms;             /* Delay from a new duty to the start of the motion (ms) */
+    double settle_ms;           /* Time constant of the ringing around the target (ms) */
+    double overshoot;           /* Ringing amplitude, fraction of the move */
+    uint32_t min_high_us;       /* Pulse of 0° */
+    uint32_t max_high_us;       /* Pulse of the full scope */
+    double scope_deg;           /* Mechanical range */
+} Sim_servo_config_t;
+
+typedef struct {
+    uint32_t commands;          /* Duty updates */
+    double target_deg;          /* Commanded angle */
+    double angle_deg;           /* Mechanical angle now */
+} Sim_servo_state_t;
+
+void Sim_servo_default_config(Sim_servo_config_t* config);
+void Sim_servo_configure(const Sim_servo_config_t* config);
+double Sim_servo_angle(int channel, int64_t time_us);
+void Sim_servo_get_state(int channel, Sim_servo_state_t* state);
+
+/* Scene: a rectangular room seen from the pan axis, 0° along +x and 90° along +y, plus round obstacles */
+typedef struct {
+    double x;
+    double y;
+    double r;
+} Sim_circle_t;
+
+typedef struct {
+    double width;               /* Room along x (mm) */
+    double depth;               /* Room along y (mm) */
+    double x;                   /* Radar position in the room (mm) */
+    double y;
+    Sim_circle_t circle[SIM_SCENE_CIRCLE_MAX];
+    int circle_num;
+} Sim_scene_t;
+
+double Sim_scene_range(const Sim_scene_t* scene, double angle_deg);
+
+/* Scripted distance over time: piecewise linear between the points, optionally repeated */
+#define SIM_PROFILE_POINT_MAX   1024
+
+typedef struct {
+    double t_ms[SIM_PROFILE_POINT_MAX];     /* Ascending, from the start of the sensor */
+    double mm[SIM_PROFILE_POINT_MAX];
+    int num;
+    bool loop;                              /* Start over after the last point */
+} Sim_profile_t;
+
+int Sim_profile_load(const char* path, Sim_profile_t* profile);
+double Sim_profile_value(const Sim_profile_t* profile, double t_ms);
+
+/* ATK-MS53L0M sensor: the Modbus function codes of atk_ms53l0m.h and Normal mode output */
+enum
+{
+    SIM_SENSOR_ERR_FUNCODE      = 0x01, /* Unknown function code or operation */
+    SIM_SENSOR_ERR_DATA         = 0x02, /* Value out of range */
+    SIM_SENSOR_ERR_CHECKSUM     = 0x03, /* Request checksum mismatch */
+    SIM_SENSOR_ERR_LENGTH       = 0x04, /* Bad data length */
+    SIM_SENSOR_ERR_INJECTED     = 0x0F, /* Fault injected by error_rate */
+};
+
+typedef struct {
+    Sim_scene_t scene;          /* Ranged at the pan servo angle when there is no profile */
+    const Sim_profile_t* profile;
+    int pan_channel;            /* Servo the sensor is mounted on */
+    /* Settings at power on, changed at run time by the host */
+    uint16_t addr;              /* Device address */
+    int baud_rate;
+    uint8_t workmode;           /* ATK_MS53L0M_WORKMODE_xxx */
+    uint8_t meaumode;           /* ATK_MS53L0M_MEAUMODE_xxx */
+    uint8_t backrate;           /* ATK_MS53L0M_BACKRATE_xxx, Normal mode output rate */
+    bool error_frames;          /* Answer bad requests with OPT_ERROR frames */
+    /* Timing */
+    double period_ms;           /* Ranging period, 0 for the timing budget of the measurement mode */
+    double stream_hz;           /* Normal mode output rate, 0 for the back rate */
+    double latency_us;          /* Request decode to answer start */
+    double jitter_us;           /* Uniform extra latency */
+    /* Readings */
+    double noise_mm;            /* Standard deviation of the reading in general mode */
+    uint16_t range_max_mm;      /* Farther than this reads SIM_SENSOR_OUT_OF_RANGE */
+    /* Faults, on measurements only unless fault_all */
+    double drop_rate;           /* Requests left unanswered */
+    double error_rate;          /* Answered with an OPT_ERROR frame */
+    double corrupt_rate;        /* Answers with one bit flipped */
+    bool fault_all;
+    uint32_t seed;              /* Noise and faults */
+} Sim_sensor_config_t;
+
+typedef struct {
+    uint32_t requests;          /* Frames decoded */
+    uint32_t bad_frames;        /* Bytes discarded resynchronising */
+    uint32_t answers;           /* Frames sent */
+    uint32_t measurements;      /* MEAUDATA requests served, before faults */
+    uint32_t streamed;          /* Normal mode lines */
+    uint32_t errors;            /* OPT_ERROR frames */
+    uint32_t dropped;
+    uint32_t corrupted;
+    double angle_error_sum;     /* |mechanical - commanded| at the ranging of each measurement (°) */
+    double angle_error_max;
+} Sim_sensor_stats_t;
+
+void Sim_sensor_default_config(Sim_sensor_config_t* config);
+int Sim_sensor_start(const Sim_sensor_config_t* config, int fd);
+void Sim_sensor_get_stats(Sim_sensor_stats_t* stats);
+
+#endif
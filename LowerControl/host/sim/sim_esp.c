@@ -0,0 +1,185 @@
+/*
+ * ESP-IDF system services on the host: esp_timer, logging, error names, random numbers and heap figures
+ * esp_timer runs off CLOCK_MONOTONIC, optionally off by a constant rate like the board crystal
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#define SIM_HEAP_SIZE       (320 * 1024)    /* Reported free heap, the host heap is not accounted */
+#define SIM_LOG_TAG_MAX     16              /* Tags with their own level */
+
+static int64_t g_boot_ns;
+static double g_clock_drift = 0.0;              /* esp_timer rate error, Sim_clock_set_drift */
+static pthread_mutex_t g_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static esp_log_level_t g_log_default = (esp_log_level_t)CONFIG_LOG_DEFAULT_LEVEL;
+static struct {
+    const char* tag;
+    esp_log_level_t level;
+} g_log_tag[SIM_LOG_TAG_MAX];
+static int g_log_tag_num = 0;
+static vprintf_like_t g_log_vprintf;          /* NULL for stderr, stdout is left to the simulator report */
+
+static int64_t Sim_monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+__attribute__((constructor)) static void Sim_boot(void)
+{
+    g_boot_ns = Sim_monotonic_ns();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    int64_t ns = Sim_monotonic_ns() - g_boot_ns;
+
+    return (ns + (int64_t)((double)ns * g_clock_drift)) / 1000;
+}
+
+/**
+ * @brief       Make esp_timer run fast or slow against the host clock, from boot on
+ * @param       ppm : rate error, positive runs fast; set before the firmware starts
+ */
+void Sim_clock_set_drift(double ppm)
+{
+    g_clock_drift = ppm * 1e-6;
+}
+
+static int Sim_log_vprintf(const char* format, va_list ap)
+{
+    return vfprintf(stderr, format, ap);
+}
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
+{
+    vprintf_like_t previous = __atomic_exchange_n(&g_log_vprintf, func, __ATOMIC_ACQ_REL);
+
+    return previous ? previous : Sim_log_vprintf;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...)
+{
+    vprintf_like_t func = __atomic_load_n(&g_log_vprintf, __ATOMIC_ACQUIRE);
+    va_list ap;
+
+    if (level > esp_log_level_get(tag))
+        return;
+    va_start(ap, format);
+    (func ? func : Sim_log_vprintf)(format, ap);
+    va_end(ap);
+}
+
+esp_log_level_t esp_log_level_get(const char* tag)
+{
+    esp_log_level_t level = g_log_default;
+
+    pthread_mutex_lock(&g_log_lock);
+    for (int i = 0; i < g_log_tag_num; i++)
+    {
+        if (strcmp(g_log_tag[i].tag, tag) == 0)
+        {
+            level = g_log_tag[i].level;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_log_lock);
+    return level;
+}
+
+void esp_log_level_set(const char* tag, esp_log_level_t level)
+{
+    int i;
+
+    pthread_mutex_lock(&g_log_lock);
+    if (strcmp(tag, "*") == 0)
+    {
+        g_log_default = level;
+        g_log_tag_num = 0;
+        pthread_mutex_unlock(&g_log_lock);
+        return;
+    }
+    for (i = 0; i < g_log_tag_num; i++)
+    {
+        if (strcmp(g_log_tag[i].tag, tag) == 0)
+            break;
+    }
+    if (i < SIM_LOG_TAG_MAX)
+    {
+        g_log_tag[i].tag = tag;
+        g_log_tag[i].level = level;
+        if (i == g_log_tag_num)
+            g_log_tag_num++;
+    }
+    pthread_mutex_unlock(&g_log_lock);
+}
+
+const char* esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+        case ESP_OK:                        return "ESP_OK";
+        case ESP_FAIL:                      return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:                return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:           return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:         return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:          return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:             return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:         return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:               return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_NVS_NOT_FOUND:         return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_NO_FREE_PAGES:     return "ESP_ERR_NVS_NO_FREE_PAGES";
+        case ESP_ERR_NVS_NEW_VERSION_FOUND: return "ESP_ERR_NVS_NEW_VERSION_FOUND";
+        default:                            return "UNKNOWN ERROR";
+    }
+}
+
+uint32_t esp_random(void)
+{
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    static uint64_t state = 0;
+    uint64_t x;
+
+    pthread_mutex_lock(&lock);
+    if (state == 0)
+        state = (uint64_t)Sim_monotonic_ns() | 1;
+    /* xorshift64* */
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    x = state * 0x2545F4914F6CDD1DULL;
+    pthread_mutex_unlock(&lock);
+    return (uint32_t)(x >> 32);
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return ESP_RST_POWERON;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return SIM_HEAP_SIZE;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return SIM_HEAP_SIZE;
+}
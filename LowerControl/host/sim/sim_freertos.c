@@ -0,0 +1,738 @@
+/*
+ * FreeRTOS kernel API on POSIX threads, see include/freertos/FreeRTOS.h
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#define SIM_TICK_US         (1000000 / configTICK_RATE_HZ)
+
+struct Sim_task {
+    pthread_t thread;
+    char name[configMAX_TASK_NAME_LEN];
+    TaskFunction_t function;
+    void* param;
+    UBaseType_t priority;
+    BaseType_t core;                    /* tskNO_AFFINITY or the pinned core */
+    uint32_t stack_depth;               /* bytes, as given to xTaskCreate */
+    UBaseType_t number;
+    bool idle;                          /* Idle pseudo-task of a core, no thread */
+    uint32_t idle_run_time;             /* µs, idle tasks only */
+    pthread_mutex_t lock;               /* Suspension and notification state */
+    pthread_cond_t cond;
+    bool suspended;
+    bool notify_pending;
+    uint32_t notify_value;
+    struct Sim_task* next;
+};
+
+struct Sim_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;                /* Broadcast on every change */
+    UBaseType_t length;
+    UBaseType_t item_size;              /* 0 for a semaphore */
+    UBaseType_t count;
+    UBaseType_t head;                   /* Slot of the oldest item */
+    uint8_t* storage;
+};
+
+struct Sim_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+static __thread struct Sim_task* t_current = NULL;  /* NULL in the simulator's own threads */
+
+static pthread_mutex_t g_task_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct Sim_task* g_task_list = NULL;
+static UBaseType_t g_task_num = 0;
+static UBaseType_t g_task_number = 0;
+static struct Sim_task g_idle_task[configNUM_CORES];
+
+static pthread_mutex_t g_critical_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+/**
+ * @brief       Condition variable on CLOCK_MONOTONIC, the clock of the deadlines
+ */
+static void Sim_cond_init(pthread_cond_t* cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/**
+ * @brief       Deadline of a wait of ticks from now
+ * @param       ticks    : wait time, portMAX_DELAY for none
+ * @param       deadline : CLOCK_MONOTONIC deadline
+ *
+ * @retval      false : wait forever
+ */
+static bool Sim_deadline(TickType_t ticks, struct timespec* deadline)
+{
+    uint64_t ns;
+
+    if (ticks == portMAX_DELAY)
+        return false;
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    ns = (uint64_t)deadline->tv_nsec + (uint64_t)ticks * SIM_TICK_US * 1000;
+    deadline->tv_sec += (time_t)(ns / 1000000000);
+    deadline->tv_nsec = (long)(ns % 1000000000);
+    return true;
+}
+
+/**
+ * @brief       Wait on a condition until it is signalled or the deadline passes
+ * @retval      false : deadline passed
+ */
+static bool Sim_cond_wait(pthread_cond_t* cond, pthread_mutex_t* lock, bool timed, const struct timespec* deadline)
+{
+    if (!timed)
+        return pthread_cond_wait(cond, lock) == 0;
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+void Sim_enter_critical(void)
+{
+    pthread_mutex_lock(&g_critical_lock);
+}
+
+void Sim_exit_critical(void)
+{
+    pthread_mutex_unlock(&g_critical_lock);
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    if ((t_current == NULL) || (t_current->core < 0) || (t_current->core >= configNUM_CORES))
+        return 0;
+    return t_current->core;
+}
+
+/* ---------------------------------------------------------------- tasks */
+
+static void* Sim_task_main(void* arg)
+{
+    struct Sim_task* task = arg;
+
+    t_current = task;
+    pthread_setname_np(pthread_self(), task->name);
+    task->function(task->param);
+    vTaskDelete(NULL);  /* a FreeRTOS task must not return, be lenient */
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* param,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core)
+{
+    struct Sim_task* task = calloc(1, sizeof(*task));
+    pthread_attr_t attr;
+
+    if (task == NULL)
+        return pdFAIL;
+    strncpy(task->name, name ? name : "", sizeof(task->name) - 1);
+    task->function    = function;
+    task->param       = param;
+    task->priority    = priority;
+    task->core        = core;
+    task->stack_depth = stack_depth;
+    pthread_mutex_init(&task->lock, NULL);
+    Sim_cond_init(&task->cond);
+
+    pthread_mutex_lock(&g_task_lock);
+    task->number = ++g_task_number;
+    task->next = g_task_list;
+    g_task_list = task;
+    g_task_num++;
+    if (handle)
+        *handle = task;     /* before the task runs, as the creator may use it at once */
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&task->thread, &attr, Sim_task_main, task) != 0)
+    {
+        g_task_list = task->next;
+        g_task_num--;
+        pthread_mutex_unlock(&g_task_lock);
+        pthread_attr_destroy(&attr);
+        free(task);
+        if (handle)
+            *handle = NULL;
+        return pdFAIL;
+    }
+    pthread_mutex_unlock(&g_task_lock);
+    pthread_attr_destroy(&attr);
+    return pdPASS;
+}
+
+/**
+ * @brief       Delete a task; the handle stays valid memory so that late notifications are harmless
+ */
+void vTaskDelete(TaskHandle_t task)
+{
+    struct Sim_task** link;
+
+    if (task == NULL)
+        task = t_current;
+    if (task == NULL)
+        pthread_exit(NULL);   /* app_main of the simulator */
+
+    pthread_mutex_lock(&g_task_lock);
+    for (link = &g_task_list; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == task)
+        {
+            *link = task->next;
+            g_task_num--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_task_lock);
+
+    if (task == t_current)
+        pthread_exit(NULL);
+    pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec  = (time_t)((uint64_t)ticks * SIM_TICK_US / 1000000),
+        .tv_nsec = (long)(((uint64_t)ticks * SIM_TICK_US % 1000000) * 1000),
+    };
+
+    if (ticks == 0)
+    {
+        sched_yield();
+        return;
+    }
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+BaseType_t xTaskDelayUntil(TickType_t* previous_wake, TickType_t increment)
+{
+    TickType_t target = *previous_wake + increment;
+    TickType_t now = xTaskGetTickCount();
+
+    *previous_wake = target;
+    if ((int32_t)(target - now) <= 0)
+        return pdFALSE;
+    vTaskDelay(target - now);
+    return pdTRUE;
+}
+
+/**
+ * @brief       Suspend a task. Only a task suspending itself stops at once;
+ *              another task would have to be stopped in the middle of anything and is not supported
+ */
+void vTaskSuspend(TaskHandle_t task)
+{
+    if ((task == NULL) || (task == t_current))
+    {
+        task = t_current;
+        if (task == NULL)
+            return;
+        pthread_mutex_lock(&task->lock);
+        task->suspended = true;
+        while (task->suspended)
+            pthread_cond_wait(&task->cond, &task->lock);
+        pthread_mutex_unlock(&task->lock);
+    }
+}
+
+void vTaskResume(TaskHandle_t task)
+{
+    if (task == NULL)
+        return;
+    pthread_mutex_lock(&task->lock);
+    task->suspended = false;    /* no effect on a task that is not suspended, as in FreeRTOS */
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / SIM_TICK_US);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return t_current;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    if (task == NULL)
+        task = t_current;
+    return task ? task->priority : tskIDLE_PRIORITY;
+}
+
+/**
+ * @brief       Stack headroom is not measured on the host, the whole stack is reported free
+ */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    if (task == NULL)
+        task = t_current;
+    return task ? task->stack_depth : 0;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    return g_task_num + configNUM_CORES;
+}
+
+/**
+ * @brief       CPU time of a task thread
+ * @retval      µs
+ */
+static uint64_t Sim_task_cpu_time(const struct Sim_task* task)
+{
+    clockid_t clock;
+    struct timespec ts;
+
+    if ((pthread_getcpuclockid(task->thread, &clock) != 0) || (clock_gettime(clock, &ts) != 0))
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void Sim_task_status(TaskStatus_t* status, struct Sim_task* task, uint32_t run_time)
+{
+    status->xHandle               = task;
+    status->pcTaskName            = task->name;
+    status->xTaskNumber           = task->number;
+    status->eCurrentState         = task->suspended ? eSuspended : eReady;
+    status->uxCurrentPriority     = task->priority;
+    status->uxBasePriority        = task->priority;
+    status->ulRunTimeCounter      = run_time;
+    status->pxStackBase           = NULL;
+    status->usStackHighWaterMark  = task->stack_depth;
+    status->xCoreID               = task->core;
+}
+
+/**
+ * @brief       State of every task, run time counters in µs of thread CPU time.
+ *              The idle task of a core is credited with the time the tasks pinned to that core,
+ *              and half of the unpinned ones, did not use
+ */
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* status, UBaseType_t capacity, uint32_t* total_run_time)
+{
+    uint64_t busy[configNUM_CORES] = {0};
+    uint64_t now = (uint64_t)esp_timer_get_time();
+    UBaseType_t num = 0;
+
+    pthread_mutex_lock(&g_task_lock);
+    if (g_task_num + configNUM_CORES > capacity)
+    {
+        pthread_mutex_unlock(&g_task_lock);
+        return 0;
+    }
+    for (struct Sim_task* task = g_task_list; task != NULL; task = task->next)
+    {
+        uint64_t cpu = Sim_task_cpu_time(task);
+
+        if ((task->core >= 0) && (task->core < configNUM_CORES))
+            busy[task->core] += cpu;
+        else
+        {
+            for (int core = 0; core < configNUM_CORES; core++)
+                busy[core] += cpu / configNUM_CORES;
+        }
+        Sim_task_status(&status[num++], task, (uint32_t)cpu);
+    }
+    for (int core = 0; core < configNUM_CORES; core++)
+    {
+        struct Sim_task* idle = xTaskGetIdleTaskHandleForCore(core);
+        uint32_t run_time = (now > busy[core]) ? (uint32_t)(now - busy[core]) : 0;
+
+        if ((int32_t)(run_time - idle->idle_run_time) > 0)
+            idle->idle_run_time = run_time;     /* a counter never goes back */
+        Sim_task_status(&status[num++], idle, idle->idle_run_time);
+    }
+    pthread_mutex_unlock(&g_task_lock);
+    if (total_run_time)
+        *total_run_time = (uint32_t)now;
+    return num;
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core)
+{
+    struct Sim_task* idle;
+
+    if ((core < 0) || (core >= configNUM_CORES))
+        return NULL;
+    idle = &g_idle_task[core];
+    if (!idle->idle)
+    {
+        snprintf(idle->name, sizeof(idle->name), "IDLE%d", (int)core);
+        idle->idle     = true;
+        idle->core     = core;
+        idle->priority = tskIDLE_PRIORITY;
+        idle->number   = 1000 + (UBaseType_t)core;
+    }
+    return idle;
+}
+
+BaseType_t xTaskGetCoreID(TaskHandle_t task)
+{
+    if (task == NULL)
+        task = t_current;
+    return task ? task->core : tskNO_AFFINITY;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    BaseType_t ret = pdPASS;
+
+    if (task == NULL)
+        return pdFAIL;
+    pthread_mutex_lock(&task->lock);
+    switch (action)
+    {
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (task->notify_pending)
+                ret = pdFAIL;
+            else
+                task->notify_value = value;
+            break;
+        default:
+            break;
+    }
+    task->notify_pending = true;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks)
+{
+    struct Sim_task* task = t_current;
+    struct timespec deadline;
+    bool timed;
+    BaseType_t ret = pdFALSE;
+
+    if (task == NULL)
+        return pdFALSE;
+    pthread_mutex_lock(&task->lock);
+    if (!task->notify_pending)
+    {
+        task->notify_value &= ~clear_on_entry;
+        if (ticks != 0)
+        {
+            timed = Sim_deadline(ticks, &deadline);
+            while (!task->notify_pending && Sim_cond_wait(&task->cond, &task->lock, timed, &deadline))
+                ;
+        }
+    }
+    if (value)
+        *value = task->notify_value;
+    if (task->notify_pending)
+    {
+        task->notify_value &= ~clear_on_exit;
+        task->notify_pending = false;
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct Sim_task* task = t_current;
+    struct timespec deadline;
+    bool timed;
+    uint32_t value;
+
+    if (task == NULL)
+        return 0;
+    pthread_mutex_lock(&task->lock);
+    if ((task->notify_value == 0) && (ticks != 0))
+    {
+        timed = Sim_deadline(ticks, &deadline);
+        while ((task->notify_value == 0) && Sim_cond_wait(&task->cond, &task->lock, timed, &deadline))
+            ;
+    }
+    value = task->notify_value;
+    if (value)
+        task->notify_value = clear_on_exit ? 0 : value - 1;
+    task->notify_pending = false;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+/* ---------------------------------------------------------------- queues and semaphores */
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct Sim_queue* queue;
+
+    if (length == 0)
+        return NULL;
+    queue = calloc(1, sizeof(*queue));
+    if (queue == NULL)
+        return NULL;
+    if (item_size)
+    {
+        queue->storage = malloc((size_t)length * item_size);
+        if (queue->storage == NULL)
+        {
+            free(queue);
+            return NULL;
+        }
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->lock, NULL);
+    Sim_cond_init(&queue->cond);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (queue == NULL)
+        return;
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->cond);
+    free(queue->storage);
+    free(queue);
+}
+
+/**
+ * @brief       Wait until the queue has room (put) or an item (take)
+ * @retval      false : timed out, the lock is held either way
+ */
+static bool Sim_queue_wait(struct Sim_queue* queue, bool put, TickType_t ticks)
+{
+    struct timespec deadline;
+    bool timed;
+
+    if ((put ? queue->count < queue->length : queue->count > 0))
+        return true;
+    if (ticks == 0)
+        return false;
+    timed = Sim_deadline(ticks, &deadline);
+    while (put ? queue->count >= queue->length : queue->count == 0)
+    {
+        if (!Sim_cond_wait(&queue->cond, &queue->lock, timed, &deadline))
+            return put ? queue->count < queue->length : queue->count > 0;
+    }
+    return true;
+}
+
+static BaseType_t Sim_queue_put(QueueHandle_t queue, const void* item, TickType_t ticks, bool front)
+{
+    UBaseType_t slot;
+
+    if (queue == NULL)
+        return errQUEUE_FULL;
+    pthread_mutex_lock(&queue->lock);
+    if (!Sim_queue_wait(queue, true, ticks))
+    {
+        pthread_mutex_unlock(&queue->lock);
+        return errQUEUE_FULL;
+    }
+    if (front)
+    {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+    }
+    else
+        slot = (queue->head + queue->count) % queue->length;
+    if (queue->item_size)
+        memcpy(&queue->storage[(size_t)slot * queue->item_size], item, queue->item_size);
+    queue->count++;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks)
+{
+    return Sim_queue_put(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticks)
+{
+    return Sim_queue_put(queue, item, ticks, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item)
+{
+    if (queue == NULL)
+        return pdFAIL;
+    pthread_mutex_lock(&queue->lock);
+    queue->count = 0;   /* a queue of one item, as in FreeRTOS */
+    queue->head = 0;
+    pthread_mutex_unlock(&queue->lock);
+    return Sim_queue_put(queue, item, 0, false);
+}
+
+static BaseType_t Sim_queue_take(QueueHandle_t queue, void* item, TickType_t ticks, bool peek)
+{
+    if (queue == NULL)
+        return pdFALSE;
+    pthread_mutex_lock(&queue->lock);
+    if (!Sim_queue_wait(queue, false, ticks))
+    {
+        pthread_mutex_unlock(&queue->lock);
+        return pdFALSE;
+    }
+    if (queue->item_size && item)
+        memcpy(item, &queue->storage[(size_t)queue->head * queue->item_size], queue->item_size);
+    if (!peek)
+    {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks)
+{
+    return Sim_queue_take(queue, item, ticks, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks)
+{
+    return Sim_queue_take(queue, item, ticks, true);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    if (queue == NULL)
+        return pdFAIL;
+    pthread_mutex_lock(&queue->lock);
+    queue->count = 0;
+    queue->head = 0;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    UBaseType_t count;
+
+    pthread_mutex_lock(&queue->lock);
+    count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    return queue->length - uxQueueMessagesWaiting(queue);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    struct Sim_queue* queue = xQueueCreate(max, 0);
+
+    if (queue)
+        queue->count = (initial > max) ? max : initial;
+    return queue;
+}
+
+/* ---------------------------------------------------------------- event groups */
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct Sim_event_group* group = calloc(1, sizeof(*group));
+
+    if (group == NULL)
+        return NULL;
+    pthread_mutex_init(&group->lock, NULL);
+    Sim_cond_init(&group->cond);
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    if (group == NULL)
+        return;
+    pthread_mutex_destroy(&group->lock);
+    pthread_cond_destroy(&group->cond);
+    free(group);
+}
+
+static inline bool Sim_event_group_met(EventBits_t bits, EventBits_t wanted, BaseType_t wait_for_all)
+{
+    return wait_for_all ? ((bits & wanted) == wanted) : ((bits & wanted) != 0);
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks)
+{
+    struct timespec deadline;
+    bool timed;
+    EventBits_t value;
+
+    pthread_mutex_lock(&group->lock);
+    if (!Sim_event_group_met(group->bits, bits, wait_for_all) && (ticks != 0))
+    {
+        timed = Sim_deadline(ticks, &deadline);
+        while (!Sim_event_group_met(group->bits, bits, wait_for_all) &&
+               Sim_cond_wait(&group->cond, &group->lock, timed, &deadline))
+            ;
+    }
+    value = group->bits;
+    if (clear_on_exit && Sim_event_group_met(value, bits, wait_for_all))
+        group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t value;
+
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    value = group->bits;
+    pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t value;
+
+    pthread_mutex_lock(&group->lock);
+    value = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    EventBits_t value;
+
+    pthread_mutex_lock(&group->lock);
+    value = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
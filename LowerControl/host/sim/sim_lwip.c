@@ -0,0 +1,330 @@
+/*
+ * lwIP on the host build, the part the zero-copy streamer uses (CONFIG_RADAR_STREAM_ZERO_COPY):
+ * pbufs with their reference counts, custom PBUF_REF pbufs, and UDP netconns on host sockets.
+ * As on the board, netconn_send returns once the datagram is queued for the WiFi driver, which
+ * holds a reference to the pbuf chain until the datagram is on the air: here a driver task sends
+ * the queued chains with sendmsg, then frees them, so custom pbufs are given back from another
+ * task and later than the send. A full driver queue is ERR_MEM.
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "lwip/api.h"
+#include "lwip/priv/tcpip_priv.h"
+
+#define SIM_WIFI_TX_QUEUE_LEN   32      /* CONFIG_ESP_WIFI_DYNAMIC_TX_BUFFER_NUM default */
+#define SIM_WIFI_TX_IOV_MAX     16      /* pbufs in the chain of one datagram */
+#define SIM_WIFI_TASK_STACK     4096
+#define SIM_WIFI_TASK_PRIORITY  23      /* ESP-IDF WiFi task */
+
+typedef struct {
+    struct udp_pcb* pcb;
+    struct pbuf* p;                     /* NULL: close the pcb, after the datagrams queued before */
+} Sim_wifi_tx_t;
+
+static const char *TAG = "SimLwIP";
+
+static portMUX_TYPE g_pbuf_lock = portMUX_INITIALIZER_UNLOCKED;    /* SYS_ARCH_PROTECT of the reference counts */
+static pthread_once_t g_wifi_once = PTHREAD_ONCE_INIT;
+static QueueHandle_t g_wifi_tx_queue = NULL;
+
+/* ---------------------------------------------------------------- pbufs */
+
+struct pbuf* pbuf_alloc(pbuf_layer layer, uint16_t length, pbuf_type type)
+{
+    struct pbuf* p;
+
+    (void)layer;    /* the host stack adds its own headers */
+    if (type != PBUF_RAM)
+        return NULL;
+    p = malloc(sizeof(*p) + length);
+    if (p == NULL)
+        return NULL;
+    memset(p, 0, sizeof(*p));
+    p->payload = p + 1;
+    p->tot_len = length;
+    p->len = length;
+    p->type = PBUF_RAM;
+    p->ref = 1;
+    return p;
+}
+
+struct pbuf* pbuf_alloced_custom(pbuf_layer layer, uint16_t length, pbuf_type type, struct pbuf_custom* p,
+                                 void* payload_mem, uint16_t payload_mem_len)
+{
+    (void)layer;
+    if (length > payload_mem_len)
+        return NULL;
+    p->pbuf.next = NULL;
+    p->pbuf.payload = payload_mem;
+    p->pbuf.tot_len = length;
+    p->pbuf.len = length;
+    p->pbuf.type = (uint8_t)type;
+    p->pbuf.flags = PBUF_FLAG_IS_CUSTOM;
+    p->pbuf.ref = 1;
+    return &p->pbuf;
+}
+
+/**
+ * @brief       Shrink a pbuf chain to size, the pbufs past it are freed
+ */
+void pbuf_realloc(struct pbuf* p, uint16_t size)
+{
+    uint16_t shrink;
+    uint16_t rem = size;
+    struct pbuf* q = p;
+
+    if (size >= p->tot_len)
+        return;     /* lwIP cannot grow a pbuf either */
+    shrink = p->tot_len - size;
+    while (rem > q->len)
+    {
+        rem -= q->len;
+        q->tot_len -= shrink;
+        q = q->next;
+    }
+    q->len = rem;
+    q->tot_len = rem;
+    if (q->next != NULL)
+        pbuf_free(q->next);
+    q->next = NULL;
+}
+
+void pbuf_ref(struct pbuf* p)
+{
+    taskENTER_CRITICAL(&g_pbuf_lock);
+    p->ref++;
+    taskEXIT_CRITICAL(&g_pbuf_lock);
+}
+
+/**
+ * @brief       Drop a reference to a chain: every pbuf whose count reaches 0 is freed, up to the
+ *              first one still referenced. Custom pbufs go back through their free function
+ */
+uint8_t pbuf_free(struct pbuf* p)
+{
+    uint8_t freed = 0;
+
+    while (p != NULL)
+    {
+        struct pbuf* next;
+        uint16_t ref;
+
+        taskENTER_CRITICAL(&g_pbuf_lock);
+        ref = --p->ref;
+        taskEXIT_CRITICAL(&g_pbuf_lock);
+        if (ref != 0)
+            break;
+        next = p->next;
+        if (p->flags & PBUF_FLAG_IS_CUSTOM)
+            ((struct pbuf_custom*)p)->custom_free_function(p);
+        else
+            free(p);
+        freed++;
+        p = next;
+    }
+    return freed;
+}
+
+void pbuf_cat(struct pbuf* head, struct pbuf* tail)
+{
+    struct pbuf* p;
+
+    for (p = head; p->next != NULL; p = p->next)
+        p->tot_len += tail->tot_len;
+    p->tot_len += tail->tot_len;
+    p->next = tail;
+}
+
+int ipaddr_aton(const char* cp, ip_addr_t* addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    if (inet_pton(AF_INET, cp, &addr->u_addr.ip4) == 1)
+    {
+        addr->type = IPADDR_TYPE_V4;
+        return 1;
+    }
+    if (inet_pton(AF_INET6, cp, &addr->u_addr.ip6) == 1)
+    {
+        addr->type = IPADDR_TYPE_V6;
+        return 1;
+    }
+    return 0;
+}
+
+/* ---------------------------------------------------------------- WiFi driver */
+
+/**
+ * @brief       Driver TX task: sends the queued datagrams in order, then drops its reference
+ */
+static void Sim_wifi_tx_task(void* pvParameters)
+{
+    Sim_wifi_tx_t tx;
+    struct iovec iov[SIM_WIFI_TX_IOV_MAX];
+
+    (void)pvParameters;
+    while (1)
+    {
+        struct msghdr msg;
+        size_t num = 0;
+
+        xQueueReceive(g_wifi_tx_queue, &tx, portMAX_DELAY);
+        if (tx.p == NULL)
+        {
+            close(tx.pcb->sock);
+            free(tx.pcb);
+            continue;
+        }
+        for (struct pbuf* q = tx.p; (q != NULL) && (num < SIM_WIFI_TX_IOV_MAX); q = q->next)
+        {
+            iov[num].iov_base = q->payload;
+            iov[num++].iov_len = q->len;
+        }
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = num;
+        if (sendmsg(tx.pcb->sock, &msg, 0) < 0)
+            ESP_LOGD(TAG, "datagram lost: errno %d", errno);
+        pbuf_free(tx.p);
+    }
+}
+
+static void Sim_wifi_start(void)
+{
+    g_wifi_tx_queue = xQueueCreate(SIM_WIFI_TX_QUEUE_LEN, sizeof(Sim_wifi_tx_t));
+    if ((g_wifi_tx_queue != NULL) &&
+        (xTaskCreatePinnedToCore(Sim_wifi_tx_task, "wifi", SIM_WIFI_TASK_STACK, NULL,
+                                 SIM_WIFI_TASK_PRIORITY, NULL, 0) != pdPASS))
+    {
+        vQueueDelete(g_wifi_tx_queue);
+        g_wifi_tx_queue = NULL;
+    }
+}
+
+/* ---------------------------------------------------------------- netconn */
+
+struct netconn* netconn_new(enum netconn_type type)
+{
+    struct netconn* conn;
+    struct udp_pcb* pcb;
+
+    pthread_once(&g_wifi_once, Sim_wifi_start);
+    if (g_wifi_tx_queue == NULL)
+        return NULL;
+    conn = calloc(1, sizeof(*conn));
+    pcb = calloc(1, sizeof(*pcb));
+    if ((conn == NULL) || (pcb == NULL))
+        goto fail;
+    pcb->sock = socket((type == NETCONN_UDP_IPV6) ? AF_INET6 : AF_INET, SOCK_DGRAM, 0);
+    if (pcb->sock < 0)
+        goto fail;
+    pcb->mcast_ttl = 1;
+    conn->type = type;
+    conn->pcb.udp = pcb;
+    return conn;
+
+fail:
+    free(pcb);
+    free(conn);
+    return NULL;
+}
+
+/**
+ * @brief       Delete a connection, its pcb is closed once the datagrams queued before are sent
+ */
+err_t netconn_delete(struct netconn* conn)
+{
+    Sim_wifi_tx_t tx = { conn->pcb.udp, NULL };
+
+    xQueueSend(g_wifi_tx_queue, &tx, portMAX_DELAY);
+    free(conn);
+    return ERR_OK;
+}
+
+err_t netconn_connect(struct netconn* conn, const ip_addr_t* addr, uint16_t port)
+{
+    struct sockaddr_storage dest;
+    socklen_t len;
+
+    memset(&dest, 0, sizeof(dest));
+    if (IP_IS_V6(addr))
+    {
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*)&dest;
+
+        in6->sin6_family = AF_INET6;
+        in6->sin6_addr = addr->u_addr.ip6;
+        in6->sin6_port = htons(port);
+        len = sizeof(*in6);
+    }
+    else
+    {
+        struct sockaddr_in* in = (struct sockaddr_in*)&dest;
+
+        in->sin_family = AF_INET;
+        in->sin_addr = addr->u_addr.ip4;
+        in->sin_port = htons(port);
+        len = sizeof(*in);
+    }
+    if (connect(conn->pcb.udp->sock, (struct sockaddr*)&dest, len) < 0)
+        return ERR_VAL;
+    return ERR_OK;
+}
+
+/**
+ * @brief       Queue the pbuf chain of a netbuf for the driver, which takes its own reference
+ * @retval      ERR_OK  : queued, the caller still frees the netbuf
+ * @retval      ERR_MEM : driver queue full, the datagram is not sent
+ * @retval      ERR_VAL : chain too long
+ */
+err_t netconn_send(struct netconn* conn, struct netbuf* buf)
+{
+    Sim_wifi_tx_t tx = { conn->pcb.udp, buf->p };
+    size_t num = 0;
+
+    for (struct pbuf* q = buf->p; q != NULL; q = q->next)
+        num++;
+    if ((num == 0) || (num > SIM_WIFI_TX_IOV_MAX))
+        return ERR_VAL;
+    pbuf_ref(tx.p);
+    if (xQueueSend(g_wifi_tx_queue, &tx, 0) != pdTRUE)
+    {
+        pbuf_free(tx.p);
+        return ERR_MEM;
+    }
+    return ERR_OK;
+}
+
+struct netbuf* netbuf_new(void)
+{
+    return calloc(1, sizeof(struct netbuf));
+}
+
+void netbuf_delete(struct netbuf* buf)
+{
+    if (buf == NULL)
+        return;
+    if (buf->p != NULL)
+        pbuf_free(buf->p);
+    free(buf);
+}
+
+void udp_set_multicast_ttl(struct udp_pcb* pcb, uint8_t ttl)
+{
+    pcb->mcast_ttl = ttl;
+    setsockopt(pcb->sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+}
+
+/**
+ * @brief       Run a function against the pcbs: host sockets need no tcpip thread, it runs here
+ */
+err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data* call)
+{
+    call->err = fn(call);
+    return call->err;
+}
@@ -0,0 +1,527 @@
+/*
+ * radar_sim: the ESP32S3 radar firmware on Linux.
+ * The firmware runs unchanged on the FreeRTOS and ESP-IDF shims of this directory; the pan servo
+ * and the ATK-MS53L0M are models, the WiFi network is the loopback interface and every UART is
+ * a pty. Unless told otherwise a probe on the host UART starts the scan and times Modbus queries,
+ * and a report of the sweep rate, query latency and sensor frame loss is printed at the end.
+ *
+ *   radar_sim -t 10                          ten seconds with the default scene, then the report
+ *   radar_sim -m -t 0                        wait for a host program on the printed pty
+ *   radar_sim -o 1800,1000,150 -n 10 -d 0.01 an obstacle, noisier ranging, 1% of the answers lost
+ *   radar_sim -C run.rcap                    raw UART capture of the run, see tools/radar_capture.c
+ *   radar_sim -m -R run.rcap -F              the capture fed again to the handlers, as fast as they go
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "radar_counters.h"
+#include "radar_uart_capture.h"
+#include "sim.h"
+
+#define SIM_HOST_UART           CONFIG_RADAR_UART1_PORT_NUM     /* MODBUS_UART */
+#define SIM_SENSOR_UART         CONFIG_RADAR_UART2_PORT_NUM     /* ATK_MS53L0M_UART */
+#define SIM_PROBE_BOOT_MS       500         /* Firmware start before the first request */
+#define SIM_PROBE_TIMEOUT_MS    100         /* MODBUS_WAITTIME */
+#define SIM_PROBE_SAMPLE_MAX    65536       /* Latencies kept for the percentiles */
+#define SIM_CAPTURE_FILE_MAGIC  "RCAP"      /* tools/radar_capture.c */
+
+void app_main(void);
+
+static volatile sig_atomic_t g_stop = 0;
+
+static struct {
+    uint16_t addr;
+    double rate_hz;
+    int fd;
+    uint32_t sent;
+    uint32_t answered;
+    uint32_t lost;
+    uint32_t busy;
+    uint32_t errors;
+    uint32_t* latency_us;
+    uint32_t latency_num;
+} g_probe = { .addr = 0x0001, .rate_hz = 20.0, .fd = -1 };
+
+static void Sim_usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -t SEC        run time, 0 until interrupted (10)\n"
+            "  -m            manual: no probe, the host UART is left to another program\n"
+            "  -q HZ         probe query rate on the host UART (20)\n"
+            "  -r W,D,X,Y    room size and radar position in it, mm (3000,2000,1500,200)\n"
+            "  -o X,Y,R      round obstacle, mm, repeatable\n"
+            "  -n MM         ranging noise, standard deviation (5)\n"
+            "  -p MS         ranging period, 0 for the measurement mode timing (0)\n"
+            "  -L US         sensor answer latency (500)\n"
+            "  -d RATE       measurement answers dropped, 0..1 (0)\n"
+            "  -e RATE       measurement answers replaced by error frames, 0..1 (0)\n"
+            "  -c RATE       measurement answers corrupted, 0..1 (0)\n"
+            "  -w DPS        servo slew rate (600)\n"
+            "  -S MS         servo settle time constant (15)\n"
+            "  -O FRAC       servo overshoot, fraction of the move, 0..1 (0.1)\n"
+            "  -s PATH       sensor on a serial device instead of the model\n"
+            "  -N FILE       NVS backing file\n"
+            "  -C FILE       capture the UART data events from boot, saved to FILE at the end\n"
+            "  -R FILE       replay a capture once the firmware is up\n"
+            "  -F            replay as fast as the handlers take the events, not at the recorded pace\n"
+            "  -v LEVEL      log level, 0 none .. 5 verbose (3)\n",
+            name);
+}
+
+static void Sim_on_signal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+static void Sim_app_main_task(void* arg)
+{
+    (void)arg;
+    app_main();
+    vTaskDelete(NULL);
+}
+
+static size_t Sim_probe_frame(uint8_t* buf, uint8_t opt, uint8_t fun, uint8_t len, const uint8_t* data)
+{
+    size_t n = 0;
+    uint16_t sum = 0;
+
+    buf[n++] = 0x51;
+    buf[n++] = 0x0B;
+    buf[n++] = (uint8_t)(g_probe.addr >> 8);
+    buf[n++] = (uint8_t)(g_probe.addr & 0xFF);
+    buf[n++] = opt;
+    buf[n++] = fun;
+    buf[n++] = len;
+    if (data != NULL)
+    {
+        memcpy(buf + n, data, len);
+        n += len;
+    }
+    for (size_t i = 0; i < n; i++)
+        sum += buf[i];
+    buf[n++] = (uint8_t)(sum >> 8);
+    buf[n++] = (uint8_t)(sum & 0xFF);
+    return n;
+}
+
+/**
+ * @brief       Send one request and wait for its answer
+ * @retval      1 : answered, 0 : lost, -1 : error answer
+ */
+static int Sim_probe_request(const uint8_t* req, size_t req_len, uint32_t* latency_us)
+{
+    struct pollfd pfd = { .fd = g_probe.fd, .events = POLLIN };
+    uint8_t buf[300];
+    size_t len = 0;
+    int64_t start = esp_timer_get_time();
+    int64_t left_ms;
+    ssize_t n;
+
+    tcflush(g_probe.fd, TCIFLUSH);
+    if (write(g_probe.fd, req, req_len) != (ssize_t)req_len)
+        return 0;
+    for (;;)
+    {
+        left_ms = SIM_PROBE_TIMEOUT_MS - (esp_timer_get_time() - start) / 1000;
+        if ((left_ms <= 0) || (poll(&pfd, 1, (int)left_ms) <= 0))
+            return 0;
+        n = read(g_probe.fd, buf + len, sizeof(buf) - len);
+        if (n <= 0)
+            return 0;
+        len += (size_t)n;
+        /* Every answer starts with 55 0B and is at least 8 bytes, error answers carry FF FF FF */
+        if ((len >= 8) && (buf[0] == 0x55) && (buf[1] == 0x0B))
+        {
+            *latency_us = (uint32_t)(esp_timer_get_time() - start);
+            return ((buf[2] == 0xFF) && (buf[3] == 0xFF) && (buf[4] == 0xFF)) ? -1 : 1;
+        }
+    }
+}
+
+static void* Sim_probe_task(void* arg)
+{
+    const uint8_t run = 0x00;   /* MODBUS_SYS_RUN */
+    uint8_t req[16];
+    size_t req_len;
+    uint32_t latency;
+    int ret;
+    struct timespec next;
+    int64_t period_ns = (int64_t)(1e9 / g_probe.rate_hz);
+
+    (void)arg;
+    usleep(SIM_PROBE_BOOT_MS * 1000);
+    /* Start the scan: SYS write, RUN */
+    req_len = Sim_probe_frame(req, 0x01, 0x00, 1, &run);
+    if (Sim_probe_request(req, req_len, &latency) != 1)
+        ESP_LOGW("SimProbe", "no answer to SYS RUN");
+
+    /* Then time device address reads, answered by the execution task */
+    req_len = Sim_probe_frame(req, 0x00, 0x03, 2, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!g_stop)
+    {
+        g_probe.sent++;
+        ret = Sim_probe_request(req, req_len, &latency);
+        if (ret == 0)
+            g_probe.lost++;
+        else
+        {
+            if (ret < 0)
+                g_probe.errors++;
+            else
+                g_probe.answered++;
+            if (g_probe.latency_num < SIM_PROBE_SAMPLE_MAX)
+                g_probe.latency_us[g_probe.latency_num++] = latency;
+        }
+        next.tv_nsec += period_ns;
+        while (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    return NULL;
+}
+
+static int Sim_compare_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint32_t Sim_percentile(const uint32_t* sorted, uint32_t num, double p)
+{
+    if (num == 0)
+        return 0;
+    return sorted[(uint32_t)(p * (num - 1) + 0.5)];
+}
+
+/* Capture file: magic(4) record_len(1) num(4) then num records oldest first, as on the wire */
+static int Sim_capture_save(const char* file)
+{
+    uint8_t info[RADAR_CAPTURE_INFO_LEN];
+    uint8_t page[RADAR_CAPTURE_PAGE_LEN];
+    uint8_t head[9];
+    uint32_t written;
+    uint32_t num;
+    FILE* f;
+
+    Radar_uart_capture_command(RADAR_CAPTURE_CMD_STOP);
+    if (Radar_uart_capture_encode_info(info, sizeof(info)) == 0)
+        return -1;
+    written = ((uint32_t)info[5] << 24) | ((uint32_t)info[6] << 16) | ((uint32_t)info[7] << 8) | info[8];
+    num = (written < RADAR_CAPTURE_RING_LEN) ? written : RADAR_CAPTURE_RING_LEN;
+    if ((f = fopen(file, "wb")) == NULL)
+        return -1;
+    memcpy(head, SIM_CAPTURE_FILE_MAGIC, 4);
+    head[4] = RADAR_CAPTURE_RECORD_LEN;
+    head[5] = (uint8_t)(num >> 24);
+    head[6] = (uint8_t)(num >> 16);
+    head[7] = (uint8_t)(num >> 8);
+    head[8] = (uint8_t)num;
+    fwrite(head, 1, sizeof(head), f);
+    for (uint32_t n = written - num; n != written;)
+    {
+        uint32_t take;
+
+        Radar_uart_capture_encode_page((uint16_t)(n % RADAR_CAPTURE_RING_LEN), page, sizeof(page));
+        take = (page[2] < written - n) ? page[2] : written - n;
+        fwrite(&page[3], RADAR_CAPTURE_RECORD_LEN, take, f);
+        n += take;
+    }
+    return fclose(f);
+}
+
+static int Sim_capture_load(const char* file)
+{
+    uint8_t record[RADAR_CAPTURE_RECORD_LEN];
+    uint8_t head[9];
+    uint32_t num;
+    int ret = -1;
+    FILE* f = fopen(file, "rb");
+
+    if (f == NULL)
+        return -1;
+    if ((fread(head, 1, sizeof(head), f) == sizeof(head)) && (memcmp(head, SIM_CAPTURE_FILE_MAGIC, 4) == 0) &&
+        (head[4] == RADAR_CAPTURE_RECORD_LEN))
+    {
+        num = ((uint32_t)head[5] << 24) | ((uint32_t)head[6] << 16) | ((uint32_t)head[7] << 8) | head[8];
+        ret = 0;
+        while ((ret == 0) && num--)
+        {
+            if ((fread(record, 1, sizeof(record), f) != sizeof(record)) || !Radar_uart_capture_load(record, sizeof(record)))
+                ret = -1;
+        }
+    }
+    fclose(f);
+    return ret;
+}
+
+static void Sim_report(double seconds, bool probe, bool replay)
+{
+    Sim_sensor_stats_t sensor;
+    Sim_servo_state_t servo;
+    uint32_t sweeps = Radar_counter_get(RADAR_COUNTER_SWEEP_COMPLETE);
+    uint32_t reads = Radar_counter_get(RADAR_COUNTER_SENSOR_READ);
+    uint32_t sensor_lost = Radar_counter_get(RADAR_COUNTER_SENSOR_TIMEOUT) +
+                           Radar_counter_get(RADAR_COUNTER_SENSOR_FRAME) +
+                           Radar_counter_get(RADAR_COUNTER_SENSOR_CRC) +
+                           Radar_counter_get(RADAR_COUNTER_SENSOR_OPT);
+
+    Sim_sensor_get_stats(&sensor);
+    Sim_servo_get_state(0, &servo);
+    printf("run_s %.1f\n", seconds);
+    printf("sweeps %u\n", sweeps);
+    printf("sweep_hz %.3f\n", sweeps / seconds);
+    printf("points_per_s %.1f\n", reads / seconds);
+    printf("servo_commands %u\n", servo.commands);
+    printf("sensor_reads %u\n", reads);
+    printf("sensor_lost %u\n", sensor_lost);
+    printf("sensor_loss %.4f\n", (reads > 0) ? (double)sensor_lost / reads : 0.0);
+    printf("sensor_late %u\n", Radar_counter_get(RADAR_COUNTER_SENSOR_LATE));
+    printf("model_requests %u\n", sensor.requests);
+    printf("model_answers %u\n", sensor.answers);
+    printf("model_dropped %u\n", sensor.dropped);
+    printf("model_errors %u\n", sensor.errors);
+    printf("model_corrupted %u\n", sensor.corrupted);
+    printf("angle_error_mean_deg %.3f\n", (sensor.measurements > 0) ? sensor.angle_error_sum / sensor.measurements : 0.0);
+    printf("angle_error_max_deg %.3f\n", sensor.angle_error_max);
+    if (replay)
+    {
+        Radar_capture_replay_stats_t stats;
+
+        Radar_uart_replay_get_stats(&stats);
+        printf("replay_events %u\n", stats.events);
+        printf("replay_bytes %u\n", stats.bytes);
+        printf("replay_skipped %u\n", stats.skipped);
+        printf("replay_handler_us %u\n", stats.handler_us);
+        printf("replay_ns_per_byte %.1f\n", (stats.bytes > 0) ? stats.handler_us * 1000.0 / stats.bytes : 0.0);
+    }
+    if (!probe)
+        return;
+    qsort(g_probe.latency_us, g_probe.latency_num, sizeof(uint32_t), Sim_compare_u32);
+    printf("query_sent %u\n", g_probe.sent);
+    printf("query_answered %u\n", g_probe.answered);
+    printf("query_error %u\n", g_probe.errors);
+    printf("query_lost %u\n", g_probe.lost);
+    printf("query_p50_us %u\n", Sim_percentile(g_probe.latency_us, g_probe.latency_num, 0.50));
+    printf("query_p90_us %u\n", Sim_percentile(g_probe.latency_us, g_probe.latency_num, 0.90));
+    printf("query_p99_us %u\n", Sim_percentile(g_probe.latency_us, g_probe.latency_num, 0.99));
+    printf("query_max_us %u\n", (g_probe.latency_num > 0) ? g_probe.latency_us[g_probe.latency_num - 1] : 0);
+}
+
+static bool Sim_parse_doubles(const char* arg, double* out, int num)
+{
+    char* end;
+
+    for (int i = 0; i < num; i++)
+    {
+        errno = 0;
+        out[i] = strtod(arg, &end);
+        if ((errno != 0) || (end == arg) || !isfinite(out[i]))
+            return false;
+        arg = end;
+        if (i + 1 < num)
+        {
+            if (*arg != ',')
+                return false;
+            arg++;
+        }
+    }
+    return *arg == '\0';
+}
+
+/* One real option value, within [min, max] */
+static bool Sim_parse_real(const char* arg, double min, double max, double* out)
+{
+    double value;
+
+    if (!Sim_parse_doubles(arg, &value, 1) || (value < min) || (value > max))
+        return false;
+    *out = value;
+    return true;
+}
+
+/* Log level option, ESP_LOG_NONE .. ESP_LOG_VERBOSE */
+static bool Sim_parse_level(const char* arg, esp_log_level_t* out)
+{
+    unsigned long value;
+    char* end;
+
+    errno = 0;
+    value = strtoul(arg, &end, 10);
+    if ((errno != 0) || (end == arg) || (*end != '\0') || (arg[0] == '-') || (value > ESP_LOG_VERBOSE))
+        return false;
+    *out = (esp_log_level_t)value;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    Sim_sensor_config_t sensor;
+    Sim_servo_config_t servo;
+    const char* sensor_path = NULL;
+    const char* capture_file = NULL;
+    const char* replay_file = NULL;
+    bool replay_fast = false;
+    char path[64];
+    double run_s = 10.0;
+    bool probe = true;
+    double v[4];
+    esp_log_level_t level;
+    pthread_t probe_thread;
+    int64_t start;
+    int fd;
+    int opt;
+
+    Sim_sensor_default_config(&sensor);
+    Sim_servo_default_config(&servo);
+    while ((opt = getopt(argc, argv, "t:mq:r:o:n:p:L:d:e:c:w:S:O:s:N:C:R:Fv:h")) != -1)
+    {
+        bool ok = true;
+
+        switch (opt)
+        {
+            case 't': ok = Sim_parse_real(optarg, 0.0, HUGE_VAL, &run_s); break;
+            case 'm': probe = false; break;
+            case 'q': ok = Sim_parse_real(optarg, 0.0, HUGE_VAL, &g_probe.rate_hz) && (g_probe.rate_hz > 0.0); break;
+            case 'r':
+                ok = Sim_parse_doubles(optarg, v, 4) && (v[0] > 0.0) && (v[1] > 0.0);
+                sensor.scene.width = v[0];
+                sensor.scene.depth = v[1];
+                sensor.scene.x = v[2];
+                sensor.scene.y = v[3];
+                break;
+            case 'o':
+                ok = Sim_parse_doubles(optarg, v, 3) && (v[2] >= 0.0) &&
+                     (sensor.scene.circle_num < SIM_SCENE_CIRCLE_MAX);
+                if (ok)
+                    sensor.scene.circle[sensor.scene.circle_num++] = (Sim_circle_t){ v[0], v[1], v[2] };
+                break;
+            case 'n': ok = Sim_parse_real(optarg, 0.0, HUGE_VAL, &sensor.noise_mm); break;
+            case 'p': ok = Sim_parse_real(optarg, 0.0, HUGE_VAL, &sensor.period_ms); break;
+            case 'L': ok = Sim_parse_real(optarg, 0.0, HUGE_VAL, &sensor.latency_us); break;
+            case 'd': ok = Sim_parse_real(optarg, 0.0, 1.0, &sensor.drop_rate); break;
+            case 'e': ok = Sim_parse_real(optarg, 0.0, 1.0, &sensor.error_rate); break;
+            case 'c': ok = Sim_parse_real(optarg, 0.0, 1.0, &sensor.corrupt_rate); break;
+            case 'w': ok = Sim_parse_real(optarg, 0.0, HUGE_VAL, &servo.slew_dps) && (servo.slew_dps > 0.0); break;
+            case 'S': ok = Sim_parse_real(optarg, 0.0, HUGE_VAL, &servo.settle_ms); break;
+            case 'O': ok = Sim_parse_real(optarg, 0.0, 1.0, &servo.overshoot); break;
+            case 's': sensor_path = optarg; break;
+            case 'N': Sim_nvs_set_file(optarg); break;
+            case 'C': capture_file = optarg; break;
+            case 'R': replay_file = optarg; break;
+            case 'F': replay_fast = true; break;
+            case 'v':
+                ok = Sim_parse_level(optarg, &level);
+                if (ok)
+                    esp_log_level_set("*", level);
+                break;
+            default:
+                Sim_usage(argv[0]);
+                return (opt == 'h') ? 0 : 2;
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "%s: bad value for -%c: %s\n", argv[0], opt, optarg);
+            Sim_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind < argc)
+    {
+        Sim_usage(argv[0]);
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN);   /* A peer closing a stream socket must not end the firmware */
+    signal(SIGINT, Sim_on_signal);
+    signal(SIGTERM, Sim_on_signal);
+    Sim_servo_configure(&servo);
+
+    /* Sensor line: a device, or a pty with the model on its far end */
+    if (sensor_path != NULL)
+    {
+        fd = Sim_uart_open_tty(sensor_path, sensor.baud_rate);
+        if ((fd < 0) || (Sim_uart_attach(SIM_SENSOR_UART, fd) != 0))
+        {
+            fprintf(stderr, "%s: %s\n", sensor_path, strerror(errno));
+            return 1;
+        }
+    }
+    else if ((Sim_uart_open_pty(SIM_SENSOR_UART, path, sizeof(path)) != 0) ||
+             ((fd = Sim_uart_open_tty(path, sensor.baud_rate)) < 0) || (Sim_sensor_start(&sensor, fd) != 0))
+    {
+        fprintf(stderr, "sensor line: %s\n", strerror(errno));
+        return 1;
+    }
+
+    /* Host line */
+    if (Sim_uart_open_pty(SIM_HOST_UART, path, sizeof(path)) != 0)
+    {
+        fprintf(stderr, "host line: %s\n", strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "host UART%d: %s\n", SIM_HOST_UART, path);
+
+    /* A replay needs the records in the ring, the capture stopped; a capture starts before the first byte */
+    if ((replay_file != NULL) && (Sim_capture_load(replay_file) != 0))
+    {
+        fprintf(stderr, "%s: not a radar UART capture\n", replay_file);
+        return 1;
+    }
+    if (capture_file != NULL)
+        Radar_uart_capture_command(RADAR_CAPTURE_CMD_START);
+
+    start = esp_timer_get_time();
+    xTaskCreatePinnedToCore(Sim_app_main_task, "main", 3584, NULL, 1, NULL, 0);
+
+    if (probe)
+    {
+        g_probe.latency_us = malloc(SIM_PROBE_SAMPLE_MAX * sizeof(uint32_t));
+        g_probe.fd = Sim_uart_open_tty(path, CONFIG_RADAR_UART1_BAUD_RATE);
+        if ((g_probe.latency_us == NULL) || (g_probe.fd < 0) ||
+            (pthread_create(&probe_thread, NULL, Sim_probe_task, NULL) != 0))
+        {
+            fprintf(stderr, "probe: %s\n", strerror(errno));
+            return 1;
+        }
+    }
+
+    if (replay_file != NULL)
+    {
+        usleep(SIM_PROBE_BOOT_MS * 1000);
+        if (!Radar_uart_capture_command(replay_fast ? RADAR_CAPTURE_CMD_REPLAY_FAST : RADAR_CAPTURE_CMD_REPLAY))
+            fprintf(stderr, "%s: replay not started\n", replay_file);
+    }
+
+    while (!g_stop && ((run_s <= 0.0) || (esp_timer_get_time() - start < (int64_t)(run_s * 1e6))))
+        usleep(10000);
+    g_stop = 1;
+    if (probe)
+        pthread_join(probe_thread, NULL);
+    if ((capture_file != NULL) && (Sim_capture_save(capture_file) != 0))
+        fprintf(stderr, "%s: %s\n", capture_file, strerror(errno));
+    Sim_report((double)(esp_timer_get_time() - start) / 1e6, probe, replay_file != NULL);
+    fflush(stdout);
+    _exit(0);   /* The firmware tasks never return */
+}
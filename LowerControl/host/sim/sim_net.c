@@ -0,0 +1,171 @@
+/*
+ * Network side of the host build: the WiFi station is up at once on the loopback interface,
+ * so the stream, control, server, discovery and time sockets of the firmware work unchanged.
+ * SHA-1 and base64 stand in for mbedTLS in the WebSocket handshake.
+ */
+#include <string.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "mbedtls/base64.h"
+#include "mbedtls/sha1.h"
+#include "WIFI.h"
+
+static const char *TAG = "SimWIFI";
+
+struct Sim_netif {
+    const char* if_key;
+};
+
+static struct Sim_netif g_netif_sta = { "WIFI_STA_DEF" };
+
+esp_err_t wifi_init_sta(void)
+{
+    ESP_LOGI(TAG, "station on loopback");
+    return ESP_OK;
+}
+
+esp_err_t wifi_wait_connected(TickType_t xTicksToWait)
+{
+    (void)xTicksToWait;
+    return ESP_OK;
+}
+
+esp_netif_t* esp_netif_get_handle_from_ifkey(const char* if_key)
+{
+    if ((if_key == NULL) || (strcmp(if_key, g_netif_sta.if_key) != 0))
+        return NULL;
+    return &g_netif_sta;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t* netif, esp_netif_ip_info_t* ip_info)
+{
+    if ((netif == NULL) || (ip_info == NULL))
+        return ESP_ERR_INVALID_ARG;
+    ip_info->ip.addr = htonl(INADDR_LOOPBACK);
+    ip_info->netmask.addr = htonl(0xFF000000);
+    ip_info->gw.addr = htonl(INADDR_LOOPBACK);
+    return ESP_OK;
+}
+
+int esp_netif_get_netif_impl_index(esp_netif_t* netif)
+{
+    (void)netif;
+    return (int)if_nametoindex("lo");
+}
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6])
+{
+    static const uint8_t sim_mac[6] = { 0x02, 0x00, 0x00, 0x52, 0x44, 0x52 };
+
+    if (ifx != WIFI_IF_STA)
+        return ESP_ERR_INVALID_ARG;
+    memcpy(mac, sim_mac, sizeof(sim_mac));
+    return ESP_OK;
+}
+
+static inline uint32_t Sim_rol(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static void Sim_sha1_block(uint32_t h[5], const unsigned char* block)
+{
+    uint32_t w[80];
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    uint32_t f, k, t;
+
+    for (int i = 0; i < 16; i++)
+        w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16) |
+               ((uint32_t)block[4 * i + 2] << 8) | block[4 * i + 3];
+    for (int i = 16; i < 80; i++)
+        w[i] = Sim_rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    for (int i = 0; i < 80; i++)
+    {
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        t = Sim_rol(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = Sim_rol(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+int mbedtls_sha1(const unsigned char* input, size_t ilen, unsigned char output[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    unsigned char tail[128] = { 0 };
+    uint64_t bits = (uint64_t)ilen * 8;
+    size_t full = ilen & ~(size_t)63;
+    size_t rest = ilen - full;
+    size_t tail_len = (rest < 56) ? 64 : 128;
+
+    for (size_t i = 0; i < full; i += 64)
+        Sim_sha1_block(h, input + i);
+    memcpy(tail, input + full, rest);
+    tail[rest] = 0x80;
+    for (int i = 0; i < 8; i++)
+        tail[tail_len - 1 - i] = (unsigned char)(bits >> (8 * i));
+    for (size_t i = 0; i < tail_len; i += 64)
+        Sim_sha1_block(h, tail + i);
+    for (int i = 0; i < 20; i++)
+        output[i] = (unsigned char)(h[i / 4] >> (24 - 8 * (i % 4)));
+    return 0;
+}
+
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t need = 4 * ((slen + 2) / 3) + 1;
+    size_t o = 0;
+    uint32_t v;
+
+    if ((dst == NULL) || (dlen < need))
+    {
+        *olen = need;
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+    for (size_t i = 0; i < slen; i += 3)
+    {
+        v = (uint32_t)src[i] << 16;
+        if (i + 1 < slen)
+            v |= (uint32_t)src[i + 1] << 8;
+        if (i + 2 < slen)
+            v |= src[i + 2];
+        dst[o++] = table[(v >> 18) & 0x3F];
+        dst[o++] = table[(v >> 12) & 0x3F];
+        dst[o++] = (i + 1 < slen) ? table[(v >> 6) & 0x3F] : '=';
+        dst[o++] = (i + 2 < slen) ? table[v & 0x3F] : '=';
+    }
+    dst[o] = '\0';
+    *olen = o;
+    return 0;
+}
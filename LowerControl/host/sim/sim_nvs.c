@@ -0,0 +1,254 @@
+/*
+ * NVS on the host: integer entries in RAM, optionally loaded from and committed to a text file,
+ * one "namespace key type value" line per entry
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nvs_flash.h"
+#include "sim.h"
+
+#define SIM_NVS_ENTRY_MAX       64
+#define SIM_NVS_NAMESPACE_MAX   8
+#define SIM_NVS_KEY_LEN         16      /* NVS_KEY_NAME_MAX_SIZE */
+
+typedef enum {
+    SIM_NVS_U8 = 1,
+    SIM_NVS_U16,
+    SIM_NVS_U32,
+} Sim_nvs_type_t;
+
+typedef struct {
+    char ns[SIM_NVS_KEY_LEN];
+    char key[SIM_NVS_KEY_LEN];
+    Sim_nvs_type_t type;
+    uint32_t value;
+} Sim_nvs_entry_t;
+
+static pthread_mutex_t g_nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static Sim_nvs_entry_t g_nvs_entry[SIM_NVS_ENTRY_MAX];
+static int g_nvs_entry_num = 0;
+static char g_nvs_namespace[SIM_NVS_NAMESPACE_MAX][SIM_NVS_KEY_LEN];  /* handle - 1 */
+static int g_nvs_namespace_num = 0;
+static const char* g_nvs_file = NULL;
+static bool g_nvs_ready = false;
+
+/**
+ * @brief       Back NVS with a file, before nvs_flash_init; without one the entries only live in RAM
+ * @param       path : file, created on the first commit
+ */
+void Sim_nvs_set_file(const char* path)
+{
+    g_nvs_file = path;
+}
+
+static void Sim_nvs_load(void)
+{
+    FILE* file;
+    Sim_nvs_entry_t entry;
+    unsigned type;
+    unsigned long value;
+
+    g_nvs_entry_num = 0;
+    if ((g_nvs_file == NULL) || ((file = fopen(g_nvs_file, "r")) == NULL))
+        return;
+    while ((g_nvs_entry_num < SIM_NVS_ENTRY_MAX) &&
+           (fscanf(file, "%15s %15s %u %lu", entry.ns, entry.key, &type, &value) == 4))
+    {
+        entry.type = (Sim_nvs_type_t)type;
+        entry.value = (uint32_t)value;
+        g_nvs_entry[g_nvs_entry_num++] = entry;
+    }
+    fclose(file);
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    pthread_mutex_lock(&g_nvs_lock);
+    if (!g_nvs_ready)
+        Sim_nvs_load();
+    g_nvs_ready = true;
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    pthread_mutex_lock(&g_nvs_lock);
+    g_nvs_entry_num = 0;
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle)
+{
+    int i;
+
+    (void)open_mode;
+    if ((name == NULL) || (strlen(name) >= SIM_NVS_KEY_LEN))
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&g_nvs_lock);
+    if (!g_nvs_ready)
+    {
+        pthread_mutex_unlock(&g_nvs_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (i = 0; i < g_nvs_namespace_num; i++)
+    {
+        if (strcmp(g_nvs_namespace[i], name) == 0)
+            break;
+    }
+    if (i == g_nvs_namespace_num)
+    {
+        if (i == SIM_NVS_NAMESPACE_MAX)
+        {
+            pthread_mutex_unlock(&g_nvs_lock);
+            return ESP_ERR_NO_MEM;
+        }
+        strcpy(g_nvs_namespace[i], name);
+        g_nvs_namespace_num++;
+    }
+    pthread_mutex_unlock(&g_nvs_lock);
+    *out_handle = (nvs_handle_t)(i + 1);
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+/**
+ * @brief       Entry of a key, called with the lock held
+ * @retval      NULL : no such entry
+ */
+static Sim_nvs_entry_t* Sim_nvs_find(nvs_handle_t handle, const char* key)
+{
+    if ((handle == 0) || (handle > (nvs_handle_t)g_nvs_namespace_num))
+        return NULL;
+    for (int i = 0; i < g_nvs_entry_num; i++)
+    {
+        if ((strcmp(g_nvs_entry[i].ns, g_nvs_namespace[handle - 1]) == 0) && (strcmp(g_nvs_entry[i].key, key) == 0))
+            return &g_nvs_entry[i];
+    }
+    return NULL;
+}
+
+static esp_err_t Sim_nvs_get(nvs_handle_t handle, const char* key, Sim_nvs_type_t type, uint32_t* value)
+{
+    Sim_nvs_entry_t* entry;
+    esp_err_t err = ESP_OK;
+
+    pthread_mutex_lock(&g_nvs_lock);
+    entry = Sim_nvs_find(handle, key);
+    if ((entry == NULL) || (entry->type != type))
+        err = ESP_ERR_NVS_NOT_FOUND;
+    else
+        *value = entry->value;
+    pthread_mutex_unlock(&g_nvs_lock);
+    return err;
+}
+
+static esp_err_t Sim_nvs_set(nvs_handle_t handle, const char* key, Sim_nvs_type_t type, uint32_t value)
+{
+    Sim_nvs_entry_t* entry;
+
+    if ((key == NULL) || (strlen(key) >= SIM_NVS_KEY_LEN))
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&g_nvs_lock);
+    entry = Sim_nvs_find(handle, key);
+    if (entry == NULL)
+    {
+        if ((handle == 0) || (handle > (nvs_handle_t)g_nvs_namespace_num) || (g_nvs_entry_num == SIM_NVS_ENTRY_MAX))
+        {
+            pthread_mutex_unlock(&g_nvs_lock);
+            return ESP_ERR_NVS_NO_FREE_PAGES;
+        }
+        entry = &g_nvs_entry[g_nvs_entry_num++];
+        strcpy(entry->ns, g_nvs_namespace[handle - 1]);
+        strcpy(entry->key, key);
+    }
+    entry->type = type;
+    entry->value = value;
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value)
+{
+    uint32_t value;
+    esp_err_t err = Sim_nvs_get(handle, key, SIM_NVS_U8, &value);
+
+    if (err == ESP_OK)
+        *out_value = (uint8_t)value;
+    return err;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value)
+{
+    return Sim_nvs_set(handle, key, SIM_NVS_U8, value);
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char* key, uint16_t* out_value)
+{
+    uint32_t value;
+    esp_err_t err = Sim_nvs_get(handle, key, SIM_NVS_U16, &value);
+
+    if (err == ESP_OK)
+        *out_value = (uint16_t)value;
+    return err;
+}
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char* key, uint16_t value)
+{
+    return Sim_nvs_set(handle, key, SIM_NVS_U16, value);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value)
+{
+    return Sim_nvs_get(handle, key, SIM_NVS_U32, out_value);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value)
+{
+    return Sim_nvs_set(handle, key, SIM_NVS_U32, value);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key)
+{
+    Sim_nvs_entry_t* entry;
+
+    pthread_mutex_lock(&g_nvs_lock);
+    entry = Sim_nvs_find(handle, key);
+    if (entry == NULL)
+    {
+        pthread_mutex_unlock(&g_nvs_lock);
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *entry = g_nvs_entry[--g_nvs_entry_num];
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    FILE* file;
+
+    (void)handle;
+    if (g_nvs_file == NULL)
+        return ESP_OK;
+    pthread_mutex_lock(&g_nvs_lock);
+    file = fopen(g_nvs_file, "w");
+    if (file == NULL)
+    {
+        pthread_mutex_unlock(&g_nvs_lock);
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < g_nvs_entry_num; i++)
+        fprintf(file, "%s %s %u %lu\n", g_nvs_entry[i].ns, g_nvs_entry[i].key, (unsigned)g_nvs_entry[i].type,
+                (unsigned long)g_nvs_entry[i].value);
+    fclose(file);
+    pthread_mutex_unlock(&g_nvs_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,742 @@
+/*
+ * ATK-MS53L0M laser range sensor on its end of a serial line.
+ * The module ranges continuously: a MEAUDATA read answers the last completed ranging, taken either
+ * from a scripted profile or over the scene in the direction the pan servo really pointed at the
+ * middle of that ranging. Answers leave after the request and answer wire times plus the decode
+ * latency. In Normal work mode the module also prints every ranging at the back rate.
+ * Drops, OPT_ERROR answers and flipped bits can be injected to exercise the driver.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sim.h"
+#include "atk_ms53l0m.h"
+
+#define SIM_SENSOR_REQUEST_LEN      9       /* Read request, a write adds its data */
+#define SIM_SENSOR_WRITE_DATA_MAX   2
+#define SIM_SENSOR_BOOT_MS          100     /* Deaf after a SYS reset */
+#define SIM_SENSOR_VERSION          0x0101
+
+static const char *TAG = "SimSensor";
+
+/* Back rates and baud rates by setting code */
+static const double g_backrate_hz[] = { 0.1, 0.2, 0.5, 1, 2, 5, 10, 20, 50, 100 };
+static const int g_baudrate[] = { 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600 };
+
+/* Timing budget (ms) and noise factor of the measurement modes */
+static const struct {
+    double period_ms;
+    double noise;
+} g_meaumode[] = {
+    [ATK_MS53L0M_MEAUMODE_GENERAL] = { 33.0, 1.0 },
+    [ATK_MS53L0M_MEAUMODE_HIPRECI] = { 200.0, 0.4 },
+    [ATK_MS53L0M_MEAUMODE_LONG]    = { 33.0, 1.5 },
+    [ATK_MS53L0M_MEAUMODE_HISPEED] = { 20.0, 2.0 },
+};
+
+static pthread_mutex_t g_sensor_lock = PTHREAD_MUTEX_INITIALIZER;   /* Settings, readings and stats */
+static pthread_mutex_t g_sensor_write_lock = PTHREAD_MUTEX_INITIALIZER;
+static Sim_sensor_config_t g_sensor_config;
+static Sim_sensor_stats_t g_sensor_stats;
+static int g_sensor_fd = -1;
+static int64_t g_sensor_start_us;
+static int64_t g_sensor_deaf_until_us;
+static int64_t g_sensor_range_index = -1;   /* Ranging of the cached reading */
+static uint16_t g_sensor_range_mm;
+static uint64_t g_sensor_random;
+
+/* Live settings */
+static struct {
+    uint16_t addr;
+    uint8_t baudrate;
+    uint8_t workmode;
+    uint8_t meaumode;
+    uint8_t backrate;
+    uint8_t errorfram;
+    uint8_t calimode;
+} g_sensor_reg;
+
+/**
+ * @brief       Module defaults: address 1, 115200 baud, general ranging mode, Modbus work mode
+ *              (the firmware leaves the module in Modbus mode and it keeps the setting)
+ * @param       config : filled, the scene is an empty 3 m x 2 m room
+ */
+void Sim_sensor_default_config(Sim_sensor_config_t* config)
+{
+    memset(config, 0, sizeof(*config));
+    config->scene.width = 3000.0;
+    config->scene.depth = 2000.0;
+    config->scene.x = 1500.0;
+    config->scene.y = 200.0;
+    config->addr = 0x0001;
+    config->baud_rate = 115200;
+    config->workmode = ATK_MS53L0M_WORKMODE_MODBUS;
+    config->meaumode = ATK_MS53L0M_MEAUMODE_GENERAL;
+    config->backrate = ATK_MS53L0M_BACKRATE_10HZ;
+    config->error_frames = true;
+    config->latency_us = 500.0;
+    config->noise_mm = 5.0;
+    config->range_max_mm = 2000;
+    config->seed = 1;
+}
+
+/**
+ * @brief       Distance from the radar to the first wall or obstacle
+ * @param       scene     : room and obstacles
+ * @param       angle_deg : direction, 0° along +x
+ *
+ * @retval      distance (mm), INFINITY when the ray leaves the room
+ */
+double Sim_scene_range(const Sim_scene_t* scene, double angle_deg)
+{
+    double dx = cos(angle_deg * M_PI / 180.0);
+    double dy = sin(angle_deg * M_PI / 180.0);
+    double best = INFINITY;
+    double t;
+
+    if (dx > 1e-9)
+        best = fmin(best, (scene->width - scene->x) / dx);
+    else if (dx < -1e-9)
+        best = fmin(best, -scene->x / dx);
+    if (dy > 1e-9)
+        best = fmin(best, (scene->depth - scene->y) / dy);
+    else if (dy < -1e-9)
+        best = fmin(best, -scene->y / dy);
+
+    for (int i = 0; i < scene->circle_num; i++)
+    {
+        const Sim_circle_t* c = &scene->circle[i];
+        double ox = c->x - scene->x;
+        double oy = c->y - scene->y;
+        double b = ox * dx + oy * dy;
+        double d2 = ox * ox + oy * oy - c->r * c->r;
+        double disc = b * b - d2;
+
+        if ((d2 <= 0.0) || (b <= 0.0) || (disc < 0.0))
+            continue;   /* Inside it, behind or missed */
+        t = b - sqrt(disc);
+        if (t < best)
+            best = t;
+    }
+    return best;
+}
+
+/**
+ * @brief       Load a distance profile: one "time_ms distance_mm" line per point, ascending times,
+ *              '#' starts a comment and a "loop" line repeats the profile from its last time on
+ * @param       path    : file
+ * @param       profile : filled
+ *
+ * @retval      0 : success
+ * @retval      -1 : unreadable file, bad line or no point
+ */
+int Sim_profile_load(const char* path, Sim_profile_t* profile)
+{
+    FILE* file = fopen(path, "r");
+    char line[128];
+    char word[8];
+    double t;
+    double mm;
+    int ret = 0;
+
+    if (file == NULL)
+        return -1;
+    profile->num = 0;
+    profile->loop = false;
+    while ((ret == 0) && (fgets(line, sizeof(line), file) != NULL))
+    {
+        char* hash = strchr(line, '#');
+
+        if (hash != NULL)
+            *hash = '\0';
+        if (sscanf(line, "%lf %lf", &t, &mm) == 2)
+        {
+            if ((profile->num == SIM_PROFILE_POINT_MAX) ||
+                ((profile->num > 0) && (t < profile->t_ms[profile->num - 1])))
+                ret = -1;
+            else
+            {
+                profile->t_ms[profile->num] = t;
+                profile->mm[profile->num] = mm;
+                profile->num++;
+            }
+        }
+        else if (sscanf(line, "%7s", word) == 1)
+        {
+            if (strcmp(word, "loop") == 0)
+                profile->loop = true;
+            else
+                ret = -1;
+        }
+    }
+    fclose(file);
+    return ((ret == 0) && (profile->num > 0)) ? 0 : -1;
+}
+
+/**
+ * @brief       Distance of a profile at a time
+ * @param       profile : profile, at least one point
+ * @param       t_ms    : time from the start of the sensor
+ *
+ * @retval      distance (mm)
+ */
+double Sim_profile_value(const Sim_profile_t* profile, double t_ms)
+{
+    double end = profile->t_ms[profile->num - 1];
+    int i;
+
+    if (profile->loop && (end > 0.0) && (t_ms > end))
+        t_ms = fmod(t_ms, end);
+    if (t_ms <= profile->t_ms[0])
+        return profile->mm[0];
+    if (t_ms >= end)
+        return profile->mm[profile->num - 1];
+    for (i = 1; profile->t_ms[i] < t_ms; i++)
+        ;
+    if (profile->t_ms[i] == profile->t_ms[i - 1])
+        return profile->mm[i];
+    return profile->mm[i - 1] + (profile->mm[i] - profile->mm[i - 1]) *
+                                (t_ms - profile->t_ms[i - 1]) / (profile->t_ms[i] - profile->t_ms[i - 1]);
+}
+
+/* Uniform in [0, 1), called with the lock held */
+static double Sim_sensor_uniform(void)
+{
+    g_sensor_random ^= g_sensor_random >> 12;
+    g_sensor_random ^= g_sensor_random << 25;
+    g_sensor_random ^= g_sensor_random >> 27;
+    return (double)((g_sensor_random * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0;
+}
+
+static double Sim_sensor_gauss(void)
+{
+    double u = Sim_sensor_uniform();
+    double v = Sim_sensor_uniform();
+
+    return sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * v);
+}
+
+static double Sim_sensor_period_ms(void)
+{
+    if (g_sensor_config.period_ms > 0.0)
+        return g_sensor_config.period_ms;
+    return g_meaumode[g_sensor_reg.meaumode].period_ms;
+}
+
+static int64_t Sim_sensor_wire_us(size_t len)
+{
+    return (int64_t)len * 10 * 1000000 / g_baudrate[g_sensor_reg.baudrate];
+}
+
+/* Reading of the last completed ranging, called with the lock held */
+static uint16_t Sim_sensor_measure(int64_t now_us)
+{
+    int64_t period_us = (int64_t)(Sim_sensor_period_ms() * 1000.0);
+    int64_t index;
+    int64_t middle_us;
+    Sim_servo_state_t servo;
+    double angle;
+    double range;
+    double error;
+
+    if (period_us < 1)
+        period_us = 1;
+    index = now_us / period_us;
+    middle_us = index * period_us - period_us / 2;
+    if (index == g_sensor_range_index)
+        return g_sensor_range_mm;
+    g_sensor_range_index = index;
+
+    if (g_sensor_config.profile != NULL)
+        range = Sim_profile_value(g_sensor_config.profile, (double)(middle_us - g_sensor_start_us) / 1000.0);
+    else
+    {
+        angle = Sim_servo_angle(g_sensor_config.pan_channel, middle_us);
+        Sim_servo_get_state(g_sensor_config.pan_channel, &servo);
+        error = fabs(angle - servo.target_deg);
+        g_sensor_stats.angle_error_sum += error;
+        if (error > g_sensor_stats.angle_error_max)
+            g_sensor_stats.angle_error_max = error;
+        range = Sim_scene_range(&g_sensor_config.scene, angle);
+    }
+    range += g_sensor_config.noise_mm * g_meaumode[g_sensor_reg.meaumode].noise * Sim_sensor_gauss();
+    if (range > g_sensor_config.range_max_mm)
+        g_sensor_range_mm = SIM_SENSOR_OUT_OF_RANGE;
+    else
+        g_sensor_range_mm = (uint16_t)((range < 0.0) ? 0.0 : lround(range));
+    return g_sensor_range_mm;
+}
+
+static uint16_t Sim_sensor_sum(const uint8_t* buf, size_t len)
+{
+    uint16_t sum = 0;
+
+    for (size_t i = 0; i < len; i++)
+        sum += buf[i];
+    return sum;
+}
+
+static size_t Sim_sensor_put_sum(uint8_t* buf, size_t len)
+{
+    uint16_t sum = Sim_sensor_sum(buf, len);
+
+    buf[len] = (uint8_t)(sum >> 8);
+    buf[len + 1] = (uint8_t)(sum & 0xFF);
+    return len + 2;
+}
+
+/* OPT_ERROR answer, 0 length when error frames are off */
+static size_t Sim_sensor_error(uint8_t* answer, uint8_t code)
+{
+    if (g_sensor_reg.errorfram != ATK_MS53L0M_ERRORFRAM_ON)
+        return 0;
+    answer[0] = ATK_MS53L0M_SLAVE_FRAME_HEAD;
+    answer[1] = ATK_MS53L0M_SENSOR_TYPE;
+    answer[2] = ATK_MS53L0M_OPT_ERROR;
+    answer[3] = ATK_MS53L0M_OPT_ERROR;
+    answer[4] = ATK_MS53L0M_OPT_ERROR;
+    answer[5] = code;
+    return Sim_sensor_put_sum(answer, 6);
+}
+
+/* Power on settings, called with the lock held */
+static void Sim_sensor_reset_settings(void)
+{
+    g_sensor_reg.addr = g_sensor_config.addr;
+    g_sensor_reg.workmode = g_sensor_config.workmode;
+    g_sensor_reg.meaumode = g_sensor_config.meaumode;
+    g_sensor_reg.backrate = g_sensor_config.backrate;
+    g_sensor_reg.errorfram = g_sensor_config.error_frames ? ATK_MS53L0M_ERRORFRAM_ON : ATK_MS53L0M_ERRORFRAM_OFF;
+    g_sensor_reg.calimode = 0;
+    g_sensor_reg.baudrate = ATK_MS53L0M_BAUDRATE_115200;
+    for (uint8_t i = 0; i < sizeof(g_baudrate) / sizeof(g_baudrate[0]); i++)
+    {
+        if (g_baudrate[i] == g_sensor_config.baud_rate)
+            g_sensor_reg.baudrate = i;
+    }
+    g_sensor_range_index = -1;
+}
+
+/**
+ * @brief       Apply a write request, called with the lock held
+ * @param       fun  : function code
+ * @param       data : data bytes
+ * @param       len  : data length
+ *
+ * @retval      0 : done, else the error code to answer
+ */
+static uint8_t Sim_sensor_write(uint8_t fun, const uint8_t* data, uint8_t len)
+{
+    uint16_t value = (len == 2) ? (uint16_t)(((uint16_t)data[0] << 8) | data[1]) : data[0];
+
+    switch (fun)
+    {
+        case ATK_MS53L0M_FUNCODE_SYS:
+            if (value == ATK_MS53L0M_SYS_PARAM_RESET)
+                Sim_sensor_reset_settings();
+            else if (value == ATK_MS53L0M_SYS_RESET)
+                g_sensor_deaf_until_us = esp_timer_get_time() + SIM_SENSOR_BOOT_MS * 1000;
+            else
+                return SIM_SENSOR_ERR_DATA;
+            return 0;
+        case ATK_MS53L0M_FUNCODE_BACKRATE:
+            if (value > ATK_MS53L0M_BACKRATE_100HZ)
+                return SIM_SENSOR_ERR_DATA;
+            g_sensor_reg.backrate = (uint8_t)value;
+            return 0;
+        case ATK_MS53L0M_FUNCODE_BAUDRATE:
+            if (value > ATK_MS53L0M_BAUDRATE_921600)
+                return SIM_SENSOR_ERR_DATA;
+            return 0;   /* Switched once the acknowledge is out */
+        case ATK_MS53L0M_FUNCODE_IDSET:
+            if ((value == 0x0000) || (value == 0xFFFF))
+                return SIM_SENSOR_ERR_DATA;
+            g_sensor_reg.addr = value;
+            return 0;
+        case ATK_MS53L0M_FUNCODE_MEAUMODE:
+            if (value > ATK_MS53L0M_MEAUMODE_HISPEED)
+                return SIM_SENSOR_ERR_DATA;
+            g_sensor_reg.meaumode = (uint8_t)value;
+            g_sensor_range_index = -1;
+            return 0;
+        case ATK_MS53L0M_FUNCODE_CALIMODE:
+            g_sensor_reg.calimode = (uint8_t)value;
+            return 0;
+        case ATK_MS53L0M_FUNCODE_WORKMODE:
+            if (value > ATK_MS53L0M_WORKMODE_IIC)
+                return SIM_SENSOR_ERR_DATA;
+            g_sensor_reg.workmode = (uint8_t)value;
+            return 0;
+        case ATK_MS53L0M_FUNCODE_ERRORFRAM:
+            if (value > ATK_MS53L0M_ERRORFRAM_ON)
+                return SIM_SENSOR_ERR_DATA;
+            g_sensor_reg.errorfram = (uint8_t)value;
+            return 0;
+        default:
+            return SIM_SENSOR_ERR_FUNCODE;
+    }
+}
+
+/**
+ * @brief       Value of a read request, called with the lock held
+ * @param       fun   : function code
+ * @param       value : read value
+ *
+ * @retval      0 : done, else the error code to answer
+ */
+static uint8_t Sim_sensor_read(uint8_t fun, uint16_t* value)
+{
+    switch (fun)
+    {
+        case ATK_MS53L0M_FUNCODE_BACKRATE:      *value = g_sensor_reg.backrate; return 0;
+        case ATK_MS53L0M_FUNCODE_BAUDRATE:      *value = g_sensor_reg.baudrate; return 0;
+        case ATK_MS53L0M_FUNCODE_IDSET:         *value = g_sensor_reg.addr; return 0;
+        case ATK_MS53L0M_FUNCODE_MEAUMODE:      *value = g_sensor_reg.meaumode; return 0;
+        case ATK_MS53L0M_FUNCODE_CALIMODE:      *value = g_sensor_reg.calimode; return 0;
+        case ATK_MS53L0M_FUNCODE_WORKMODE:      *value = g_sensor_reg.workmode; return 0;
+        case ATK_MS53L0M_FUNCODE_ERRORFRAM:     *value = g_sensor_reg.errorfram; return 0;
+        case ATK_MS53L0M_FUNCODE_VERSION:       *value = SIM_SENSOR_VERSION; return 0;
+        case ATK_MS53L0M_FUNCODE_MEAUDATA:
+            *value = Sim_sensor_measure(esp_timer_get_time());
+            g_sensor_stats.measurements++;
+            return 0;
+        case ATK_MS53L0M_FUNCODE_OUTPUTSTATUS:  /* 0: valid, 1: out of range */
+            *value = (Sim_sensor_measure(esp_timer_get_time()) == SIM_SENSOR_OUT_OF_RANGE) ? 1 : 0;
+            return 0;
+        default:
+            return SIM_SENSOR_ERR_FUNCODE;
+    }
+}
+
+/**
+ * @brief       Build the answer to one request, called with the lock held
+ * @param       req    : request, checksum verified
+ * @param       answer : answer frame
+ *
+ * @retval      answer length, 0 for no answer
+ */
+static size_t Sim_sensor_answer(const uint8_t* req, uint8_t* answer)
+{
+    uint16_t addr = ((uint16_t)req[2] << 8) | req[3];
+    uint8_t opt = req[4];
+    uint8_t fun = req[5];
+    uint8_t len = req[6];
+    uint16_t value = 0;
+    uint8_t err;
+
+    if ((addr != g_sensor_reg.addr) && (addr != 0xFFFF))
+        return 0;   /* Another module on the bus */
+    if ((len < 1) || (len > SIM_SENSOR_WRITE_DATA_MAX))
+        return Sim_sensor_error(answer, SIM_SENSOR_ERR_LENGTH);
+    if (opt == ATK_MS53L0M_OPT_WRITE)
+        err = Sim_sensor_write(fun, &req[7], len);
+    else if (opt == ATK_MS53L0M_OPT_READ)
+        err = Sim_sensor_read(fun, &value);
+    else
+        err = SIM_SENSOR_ERR_FUNCODE;
+    if (err != 0)
+        return Sim_sensor_error(answer, err);
+
+    answer[0] = ATK_MS53L0M_SLAVE_FRAME_HEAD;
+    answer[1] = ATK_MS53L0M_SENSOR_TYPE;
+    answer[2] = (uint8_t)(g_sensor_reg.addr >> 8);
+    answer[3] = (uint8_t)(g_sensor_reg.addr & 0xFF);
+    answer[4] = opt;
+    answer[5] = fun;
+    if (opt == ATK_MS53L0M_OPT_WRITE)
+        return Sim_sensor_put_sum(answer, 6);
+    answer[6] = 0x00;
+    answer[7] = len;
+    if (len == 1)
+        answer[8] = (uint8_t)value;
+    else
+    {
+        answer[8] = (uint8_t)(value >> 8);
+        answer[9] = (uint8_t)(value & 0xFF);
+    }
+    return Sim_sensor_put_sum(answer, 8 + len);
+}
+
+/**
+ * @brief       Injected faults on an outgoing frame, called with the lock held
+ * @param       data : frame, an answer may be replaced by an error frame
+ * @param       len  : frame length, updated
+ * @param       text : Normal mode line, never turned into an error frame
+ *
+ * @retval      false : drop the frame
+ */
+static bool Sim_sensor_fault(uint8_t* data, size_t* len, bool text)
+{
+    if (Sim_sensor_uniform() < g_sensor_config.drop_rate)
+    {
+        g_sensor_stats.dropped++;
+        return false;
+    }
+    if (!text && (Sim_sensor_uniform() < g_sensor_config.error_rate))
+        *len = Sim_sensor_error(data, SIM_SENSOR_ERR_INJECTED);
+    if ((*len > 0) && (Sim_sensor_uniform() < g_sensor_config.corrupt_rate))
+    {
+        data[(size_t)(Sim_sensor_uniform() * *len)] ^= (uint8_t)(1u << (int)(Sim_sensor_uniform() * 8));
+        g_sensor_stats.corrupted++;
+    }
+    return true;
+}
+
+static void Sim_sensor_sleep_until(int64_t time_us)
+{
+    int64_t wait_us = time_us - esp_timer_get_time();
+    struct timespec ts;
+
+    if (wait_us <= 0)
+        return;
+    ts.tv_sec = (time_t)(wait_us / 1000000);
+    ts.tv_nsec = (long)(wait_us % 1000000) * 1000;
+    while ((nanosleep(&ts, &ts) != 0) && (errno == EINTR))
+        ;
+}
+
+static void Sim_sensor_send(const void* data, size_t len)
+{
+    pthread_mutex_lock(&g_sensor_write_lock);
+    if (write(g_sensor_fd, data, len) != (ssize_t)len)
+        ESP_LOGW(TAG, "answer lost");
+    pthread_mutex_unlock(&g_sensor_write_lock);
+}
+
+static void Sim_sensor_set_line_speed(int baud_rate)
+{
+    struct termios tio;
+    speed_t speed;
+
+    if (!isatty(g_sensor_fd) || (tcgetattr(g_sensor_fd, &tio) != 0))
+        return;
+    switch (baud_rate)
+    {
+        case 2400:      speed = B2400; break;
+        case 4800:      speed = B4800; break;
+        case 9600:      speed = B9600; break;
+        case 19200:     speed = B19200; break;
+        case 38400:     speed = B38400; break;
+        case 57600:     speed = B57600; break;
+        case 230400:    speed = B230400; break;
+        case 460800:    speed = B460800; break;
+        case 921600:    speed = B921600; break;
+        default:        speed = B115200; break;
+    }
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tcsetattr(g_sensor_fd, TCSADRAIN, &tio);
+}
+
+/* Length of the request starting buf, 0 while incomplete */
+static size_t Sim_sensor_request_len(const uint8_t* buf, size_t len)
+{
+    size_t frame_len;
+
+    if (len < 7)
+        return 0;
+    frame_len = (buf[4] == ATK_MS53L0M_OPT_WRITE) ? (size_t)SIM_SENSOR_REQUEST_LEN + buf[6] : (size_t)SIM_SENSOR_REQUEST_LEN;
+    return (len < frame_len) ? 0 : frame_len;
+}
+
+/* Resynchronise on a frame head, counting the bytes skipped; called with the lock held */
+static size_t Sim_sensor_resync(uint8_t* buf, size_t len)
+{
+    size_t skip = 1;
+
+    while ((skip < len) && (buf[skip] != ATK_MS53L0M_MASTER_FRAME_HEAD))
+        skip++;
+    g_sensor_stats.bad_frames += (uint32_t)skip;
+    memmove(buf, buf + skip, len - skip);
+    return len - skip;
+}
+
+static void* Sim_sensor_task(void* arg)
+{
+    uint8_t buf[64];
+    uint8_t answer[16];
+    size_t len = 0;
+    size_t frame_len;
+    size_t answer_len;
+    int64_t request_us;
+    int64_t answer_us;
+    uint16_t sum;
+    uint8_t baudrate;
+    ssize_t n;
+    bool send;
+
+    (void)arg;
+    for (;;)
+    {
+        n = read(g_sensor_fd, buf + len, sizeof(buf) - len);
+        if (n <= 0)
+        {
+            if ((n < 0) && (errno == EINTR))
+                continue;
+            ESP_LOGE(TAG, "line closed");
+            return NULL;
+        }
+        request_us = esp_timer_get_time();
+        len += (size_t)n;
+
+        pthread_mutex_lock(&g_sensor_lock);
+        if (request_us < g_sensor_deaf_until_us)
+            len = 0;    /* Rebooting */
+        pthread_mutex_unlock(&g_sensor_lock);
+        while (len > 0)
+        {
+            pthread_mutex_lock(&g_sensor_lock);
+            if ((buf[0] != ATK_MS53L0M_MASTER_FRAME_HEAD) || ((len >= 2) && (buf[1] != ATK_MS53L0M_SENSOR_TYPE)) ||
+                ((len >= 7) && (buf[4] == ATK_MS53L0M_OPT_WRITE) && (buf[6] > SIM_SENSOR_WRITE_DATA_MAX)))
+            {
+                len = Sim_sensor_resync(buf, len);
+                pthread_mutex_unlock(&g_sensor_lock);
+                continue;
+            }
+            frame_len = Sim_sensor_request_len(buf, len);
+            if (frame_len == 0)
+            {
+                pthread_mutex_unlock(&g_sensor_lock);
+                break;
+            }
+
+            send = true;
+            baudrate = g_sensor_reg.baudrate;
+            sum = ((uint16_t)buf[frame_len - 2] << 8) | buf[frame_len - 1];
+            if (sum != Sim_sensor_sum(buf, frame_len - 2))
+            {
+                g_sensor_stats.bad_frames++;
+                answer_len = Sim_sensor_error(answer, SIM_SENSOR_ERR_CHECKSUM);
+            }
+            else
+            {
+                g_sensor_stats.requests++;
+                answer_len = Sim_sensor_answer(buf, answer);
+                if ((answer_len > 0) && (g_sensor_config.fault_all || (buf[5] == ATK_MS53L0M_FUNCODE_MEAUDATA)))
+                    send = Sim_sensor_fault(answer, &answer_len, false);
+                if ((answer_len > 0) && (answer[4] == ATK_MS53L0M_OPT_WRITE) && (buf[5] == ATK_MS53L0M_FUNCODE_BAUDRATE))
+                    baudrate = buf[7];
+            }
+            send = send && (answer_len > 0);
+            if (send)
+            {
+                g_sensor_stats.answers++;
+                if (answer[4] == ATK_MS53L0M_OPT_ERROR)
+                    g_sensor_stats.errors++;
+            }
+            answer_us = request_us + Sim_sensor_wire_us(frame_len) + (int64_t)g_sensor_config.latency_us +
+                        (int64_t)(g_sensor_config.jitter_us * Sim_sensor_uniform()) + Sim_sensor_wire_us(answer_len);
+            pthread_mutex_unlock(&g_sensor_lock);
+
+            memmove(buf, buf + frame_len, len - frame_len);
+            len -= frame_len;
+            if (!send)
+                continue;
+            /* The request had to cross the line before the module saw it, and so does the answer */
+            Sim_sensor_sleep_until(answer_us);
+            Sim_sensor_send(answer, answer_len);
+            if (baudrate != g_sensor_reg.baudrate)
+            {
+                pthread_mutex_lock(&g_sensor_lock);
+                g_sensor_reg.baudrate = baudrate;
+                pthread_mutex_unlock(&g_sensor_lock);
+                Sim_sensor_set_line_speed(g_baudrate[baudrate]);
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Normal work mode: every ranging printed at the back rate */
+static void* Sim_sensor_stream_task(void* arg)
+{
+    char line[24];
+    size_t len;
+    double hz;
+    int64_t next_us = esp_timer_get_time();
+    int64_t now_us;
+    bool send;
+
+    (void)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&g_sensor_lock);
+        hz = (g_sensor_config.stream_hz > 0.0) ? g_sensor_config.stream_hz : g_backrate_hz[g_sensor_reg.backrate];
+        now_us = esp_timer_get_time();
+        send = (g_sensor_reg.workmode == ATK_MS53L0M_WORKMODE_NORMAL) && (now_us >= g_sensor_deaf_until_us);
+        if (send)
+        {
+            len = (size_t)snprintf(line, sizeof(line), "d: %u mm\r\n", Sim_sensor_measure(now_us));
+            send = Sim_sensor_fault((uint8_t*)line, &len, true);
+            if (send)
+                g_sensor_stats.streamed++;
+        }
+        pthread_mutex_unlock(&g_sensor_lock);
+        if (send)
+            Sim_sensor_send(line, len);
+
+        next_us += (int64_t)(1e6 / hz);
+        if (next_us < now_us)
+            next_us = now_us;   /* Mode switches and slow writes do not pile up */
+        Sim_sensor_sleep_until(next_us);
+    }
+    return NULL;
+}
+
+/**
+ * @brief       Start the module on its end of the line
+ * @param       config : model, a profile must outlive the module
+ * @param       fd     : line, owned by the model from now on
+ *
+ * @retval      0 : success
+ * @retval      -1 : bad setting or no thread
+ */
+int Sim_sensor_start(const Sim_sensor_config_t* config, int fd)
+{
+    pthread_t thread;
+    bool baud_ok = false;
+
+    for (uint8_t i = 0; i < sizeof(g_baudrate) / sizeof(g_baudrate[0]); i++)
+        baud_ok |= (g_baudrate[i] == config->baud_rate);
+    if ((config->meaumode > ATK_MS53L0M_MEAUMODE_HISPEED) || (config->backrate > ATK_MS53L0M_BACKRATE_100HZ) ||
+        (config->workmode > ATK_MS53L0M_WORKMODE_IIC) || ((config->profile != NULL) && (config->profile->num == 0)) ||
+        !baud_ok)
+        return -1;
+    pthread_mutex_lock(&g_sensor_lock);
+    g_sensor_config = *config;
+    g_sensor_random = ((uint64_t)config->seed << 1) | 1;
+    memset(&g_sensor_stats, 0, sizeof(g_sensor_stats));
+    Sim_sensor_reset_settings();
+    g_sensor_fd = fd;
+    g_sensor_start_us = esp_timer_get_time();
+    g_sensor_deaf_until_us = 0;
+    pthread_mutex_unlock(&g_sensor_lock);
+    Sim_sensor_set_line_speed(g_baudrate[g_sensor_reg.baudrate]);
+    if (pthread_create(&thread, NULL, Sim_sensor_task, NULL) != 0)
+        return -1;
+    pthread_detach(thread);
+    if (pthread_create(&thread, NULL, Sim_sensor_stream_task, NULL) != 0)
+        return -1;
+    pthread_detach(thread);
+    return 0;
+}
+
+/**
+ * @brief       Counters of the module since it started
+ * @param       stats : filled
+ */
+void Sim_sensor_get_stats(Sim_sensor_stats_t* stats)
+{
+    pthread_mutex_lock(&g_sensor_lock);
+    *stats = g_sensor_stats;
+    pthread_mutex_unlock(&g_sensor_lock);
+}
@@ -0,0 +1,192 @@
+/*
+ * LEDC PWM driving hobby servos. A new pulse width turns into a target angle; the horn starts
+ * moving after a dead time, slews at a constant speed and rings around the target before it
+ * settles. The sensor model asks where the horn really was when it ranged.
+ */
+#include <math.h>
+#include <pthread.h>
+
+#include "driver/ledc.h"
+#include "esp_timer.h"
+#include "sim.h"
+
+typedef struct {
+    bool configured;
+    uint32_t duty;              /* Set, not yet updated */
+    uint32_t commands;
+    double start_deg;           /* Angle when the last command came */
+    double target_deg;
+    int64_t command_us;
+} Sim_servo_t;
+
+static pthread_mutex_t g_servo_lock = PTHREAD_MUTEX_INITIALIZER;
+static Sim_servo_t g_servo[SIM_SERVO_NUM];
+static Sim_servo_config_t g_servo_config;
+static uint32_t g_servo_freq_hz = 50;
+static uint32_t g_servo_resolution = 13;
+
+/**
+ * @brief       Figures of an SG90 class servo on the firmware's default pulse range
+ * @param       config : filled
+ */
+void Sim_servo_default_config(Sim_servo_config_t* config)
+{
+    config->slew_dps = 600.0;       /* 0.1 s / 60° */
+    config->dead_ms = 10.0;         /* Half a PWM period on average */
+    config->settle_ms = 15.0;
+    config->overshoot = 0.1;
+    config->min_high_us = CONFIG_STEERING_MIN_HIGH_TIME;
+    config->max_high_us = CONFIG_STEERING_MAX_HIGH_TIME;
+    config->scope_deg = CONFIG_STEERING_ANGLE_SCOPE;
+}
+
+__attribute__((constructor)) static void Sim_servo_boot(void)
+{
+    Sim_servo_default_config(&g_servo_config);
+}
+
+/**
+ * @brief       Replace the servo model, before the firmware starts
+ * @param       config : model
+ */
+void Sim_servo_configure(const Sim_servo_config_t* config)
+{
+    pthread_mutex_lock(&g_servo_lock);
+    g_servo_config = *config;
+    pthread_mutex_unlock(&g_servo_lock);
+}
+
+static double Sim_servo_duty_angle(uint32_t duty)
+{
+    double pulse_us = (double)duty * 1e6 / ((double)g_servo_freq_hz * (double)(1UL << g_servo_resolution));
+    double angle = (pulse_us - g_servo_config.min_high_us) * g_servo_config.scope_deg /
+                   (double)(g_servo_config.max_high_us - g_servo_config.min_high_us);
+
+    if (angle < 0.0)
+        return 0.0;
+    if (angle > g_servo_config.scope_deg)
+        return g_servo_config.scope_deg;
+    return angle;
+}
+
+/* Horn angle at a time, called with the lock held */
+static double Sim_servo_position(const Sim_servo_t* servo, int64_t time_us)
+{
+    double move = servo->target_deg - servo->start_deg;
+    double t_ms = (double)(time_us - servo->command_us) / 1000.0 - g_servo_config.dead_ms;
+    double travel_ms = fabs(move) * 1000.0 / g_servo_config.slew_dps;
+    double ring_ms;
+
+    if ((t_ms <= 0.0) || (move == 0.0))
+        return servo->start_deg;
+    if (t_ms < travel_ms)
+        return servo->start_deg + copysign(g_servo_config.slew_dps * t_ms / 1000.0, move);
+    if (g_servo_config.settle_ms <= 0.0)
+        return servo->target_deg;
+    /* Past the target by about overshoot * move one time constant after arrival, then decaying */
+    ring_ms = t_ms - travel_ms;
+    return servo->target_deg + g_servo_config.overshoot * move * exp(1.0 - ring_ms / g_servo_config.settle_ms) *
+                               sin(M_PI_2 * ring_ms / g_servo_config.settle_ms);
+}
+
+/**
+ * @brief       Mechanical angle of a servo
+ * @param       channel : LEDC channel
+ * @param       time_us : esp_timer time
+ *
+ * @retval      angle (°)
+ */
+double Sim_servo_angle(int channel, int64_t time_us)
+{
+    double angle = 0.0;
+
+    if ((channel < 0) || (channel >= SIM_SERVO_NUM))
+        return 0.0;
+    pthread_mutex_lock(&g_servo_lock);
+    if (g_servo[channel].configured)
+        angle = Sim_servo_position(&g_servo[channel], time_us);
+    pthread_mutex_unlock(&g_servo_lock);
+    return angle;
+}
+
+/**
+ * @brief       Commands and angles of a servo
+ * @param       channel : LEDC channel
+ * @param       state   : filled, zero for an unknown channel
+ */
+void Sim_servo_get_state(int channel, Sim_servo_state_t* state)
+{
+    int64_t now = esp_timer_get_time();
+
+    state->commands = 0;
+    state->target_deg = 0.0;
+    state->angle_deg = 0.0;
+    if ((channel < 0) || (channel >= SIM_SERVO_NUM))
+        return;
+    pthread_mutex_lock(&g_servo_lock);
+    if (g_servo[channel].configured)
+    {
+        state->commands = g_servo[channel].commands;
+        state->target_deg = g_servo[channel].target_deg;
+        state->angle_deg = Sim_servo_position(&g_servo[channel], now);
+    }
+    pthread_mutex_unlock(&g_servo_lock);
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t* timer_conf)
+{
+    if ((timer_conf == NULL) || (timer_conf->freq_hz == 0) ||
+        (timer_conf->duty_resolution == 0) || (timer_conf->duty_resolution > 20))
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&g_servo_lock);
+    g_servo_freq_hz = timer_conf->freq_hz;
+    g_servo_resolution = timer_conf->duty_resolution;
+    pthread_mutex_unlock(&g_servo_lock);
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t* ledc_conf)
+{
+    Sim_servo_t* servo;
+
+    if ((ledc_conf == NULL) || (ledc_conf->channel < 0) || (ledc_conf->channel >= SIM_SERVO_NUM))
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&g_servo_lock);
+    servo = &g_servo[ledc_conf->channel];
+    servo->configured = true;
+    servo->duty = ledc_conf->duty;
+    servo->target_deg = Sim_servo_duty_angle(ledc_conf->duty);
+    servo->start_deg = servo->target_deg;   /* The horn is wherever the first pulse puts it */
+    servo->command_us = esp_timer_get_time();
+    pthread_mutex_unlock(&g_servo_lock);
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty)
+{
+    if ((speed_mode != LEDC_LOW_SPEED_MODE) || (channel < 0) || (channel >= SIM_SERVO_NUM) ||
+        !g_servo[channel].configured)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&g_servo_lock);
+    g_servo[channel].duty = duty;
+    pthread_mutex_unlock(&g_servo_lock);
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    Sim_servo_t* servo;
+    int64_t now = esp_timer_get_time();
+
+    if ((speed_mode != LEDC_LOW_SPEED_MODE) || (channel < 0) || (channel >= SIM_SERVO_NUM) ||
+        !g_servo[channel].configured)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&g_servo_lock);
+    servo = &g_servo[channel];
+    servo->start_deg = Sim_servo_position(servo, now);
+    servo->target_deg = Sim_servo_duty_angle(servo->duty);
+    servo->command_us = now;
+    servo->commands++;
+    pthread_mutex_unlock(&g_servo_lock);
+    return ESP_OK;
+}
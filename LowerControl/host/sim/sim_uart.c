@@ -0,0 +1,411 @@
+/*
+ * UART driver on file descriptors: a pty per port by default, or a tty attached by sim_main.c.
+ * A reader thread plays the RX interrupt: it gathers bytes until the line stays idle for the
+ * RX timeout (10 symbols), stores them in the ring buffer and posts a UART_DATA event, so a
+ * frame written in one go arrives as one event like on the chip.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "sim.h"
+
+#define SIM_UART_FIFO_LEN       120     /* RX FIFO full threshold of the IDF driver */
+#define SIM_UART_TOUT_SYMBOLS   10      /* RX timeout, in symbols of 10 bits */
+
+static const char *TAG = "SimUART";
+
+typedef struct {
+    int fd;                     /* Firmware end, -1 when nothing is attached */
+    int peer_fd;                /* Far end of a pty, held open so the master never reads EIO */
+    char path[64];              /* Far end path, for the other program */
+    bool installed;
+    int baud_rate;
+    uint8_t* ring;              /* RX ring buffer */
+    size_t ring_size;
+    size_t ring_head;           /* Oldest byte */
+    size_t ring_count;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        /* Signalled when bytes are stored */
+    QueueHandle_t queue;        /* Event queue handed to the application */
+    pthread_t reader;
+} Sim_uart_t;
+
+static Sim_uart_t g_uart[UART_NUM_MAX] = {
+    { .fd = -1, .peer_fd = -1, .baud_rate = 115200, .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER },
+    { .fd = -1, .peer_fd = -1, .baud_rate = 115200, .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER },
+    { .fd = -1, .peer_fd = -1, .baud_rate = 115200, .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER },
+};
+
+static inline bool Sim_uart_valid(uart_port_t uart_num)
+{
+    return (uart_num >= 0) && (uart_num < UART_NUM_MAX);
+}
+
+static speed_t Sim_uart_speed(int baud_rate)
+{
+    switch (baud_rate)
+    {
+        case 2400:      return B2400;
+        case 4800:      return B4800;
+        case 9600:      return B9600;
+        case 19200:     return B19200;
+        case 38400:     return B38400;
+        case 57600:     return B57600;
+        case 230400:    return B230400;
+        case 460800:    return B460800;
+        case 921600:    return B921600;
+        default:        return B115200;
+    }
+}
+
+static void Sim_uart_raw(int fd, int baud_rate)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) != 0)
+        return;
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, Sim_uart_speed(baud_rate));
+    cfsetospeed(&tio, Sim_uart_speed(baud_rate));
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+/**
+ * @brief       Attach a file descriptor to a port, before uart_driver_install
+ * @param       uart_num : port
+ * @param       fd       : descriptor, the driver owns it from now on
+ *
+ * @retval      0 : success
+ * @retval      -1 : bad port or driver already installed
+ */
+int Sim_uart_attach(uart_port_t uart_num, int fd)
+{
+    if (!Sim_uart_valid(uart_num) || g_uart[uart_num].installed)
+        return -1;
+    g_uart[uart_num].fd = fd;
+    return 0;
+}
+
+/**
+ * @brief       Open a pty for a port and attach its master end
+ * @param       uart_num : port
+ * @param       path     : receives the path of the far end, may be NULL
+ * @param       path_len : size of path
+ *
+ * @retval      0 : success
+ * @retval      -1 : error, errno set
+ */
+int Sim_uart_open_pty(uart_port_t uart_num, char* path, size_t path_len)
+{
+    Sim_uart_t* uart;
+    int master;
+    int slave;
+
+    if (!Sim_uart_valid(uart_num))
+        return -1;
+    uart = &g_uart[uart_num];
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0)
+        return -1;
+    if ((grantpt(master) != 0) || (unlockpt(master) != 0) ||
+        (ptsname_r(master, uart->path, sizeof(uart->path)) != 0))
+    {
+        close(master);
+        return -1;
+    }
+    slave = open(uart->path, O_RDWR | O_NOCTTY);
+    if (slave < 0)
+    {
+        close(master);
+        return -1;
+    }
+    Sim_uart_raw(slave, uart->baud_rate);
+    Sim_uart_raw(master, uart->baud_rate);
+    if (Sim_uart_attach(uart_num, master) != 0)
+    {
+        close(slave);
+        close(master);
+        return -1;
+    }
+    uart->peer_fd = slave;
+    if (path != NULL)
+        snprintf(path, path_len, "%s", uart->path);
+    return 0;
+}
+
+/**
+ * @brief       Open a serial device (tty or pty far end) in raw mode
+ * @param       path      : device
+ * @param       baud_rate : line speed, ignored by ptys
+ *
+ * @retval      descriptor, -1 on error
+ */
+int Sim_uart_open_tty(const char* path, int baud_rate)
+{
+    int fd = open(path, O_RDWR | O_NOCTTY);
+
+    if (fd >= 0)
+        Sim_uart_raw(fd, baud_rate);
+    return fd;
+}
+
+/**
+ * @brief       Path of the far end of a port's pty
+ * @retval      NULL : the port is not a pty
+ */
+const char* Sim_uart_path(uart_port_t uart_num)
+{
+    if (!Sim_uart_valid(uart_num) || (g_uart[uart_num].path[0] == '\0'))
+        return NULL;
+    return g_uart[uart_num].path;
+}
+
+static void Sim_uart_post(Sim_uart_t* uart, uart_event_type_t type, size_t size)
+{
+    uart_event_t event = {
+        .type = type,
+        .size = size,
+        .timeout_flag = false,
+    };
+
+    /* A full queue loses the event like the driver does, the bytes stay in the ring */
+    if (uart->queue != NULL)
+        xQueueSend(uart->queue, &event, 0);
+}
+
+static void* Sim_uart_reader(void* arg)
+{
+    Sim_uart_t* uart = arg;
+    uint8_t chunk[SIM_UART_FIFO_LEN];
+    struct pollfd pfd = { .fd = uart->fd, .events = POLLIN };
+    struct timespec idle;
+    size_t len;
+    ssize_t n;
+
+    for (;;)
+    {
+        if (poll(&pfd, 1, -1) < 0)
+            continue;
+        n = read(uart->fd, chunk, sizeof(chunk));
+        if (n <= 0)
+        {
+            if ((n < 0) && (errno == EAGAIN))
+                continue;
+            usleep(10000);  /* EOF or no far end yet */
+            continue;
+        }
+        len = (size_t)n;
+        /* Gather until the line is idle for the RX timeout or the FIFO threshold is reached */
+        idle.tv_sec = 0;
+        idle.tv_nsec = (long)SIM_UART_TOUT_SYMBOLS * 10 * 1000000000L / uart->baud_rate;
+        while ((len < sizeof(chunk)) && (ppoll(&pfd, 1, &idle, NULL) > 0))
+        {
+            n = read(uart->fd, chunk + len, sizeof(chunk) - len);
+            if (n <= 0)
+                break;
+            len += (size_t)n;
+        }
+
+        pthread_mutex_lock(&uart->lock);
+        if (uart->ring_count + len > uart->ring_size)
+        {
+            pthread_mutex_unlock(&uart->lock);
+            Sim_uart_post(uart, UART_BUFFER_FULL, 0);
+            continue;
+        }
+        for (size_t i = 0; i < len; i++)
+            uart->ring[(uart->ring_head + uart->ring_count + i) % uart->ring_size] = chunk[i];
+        uart->ring_count += len;
+        pthread_cond_broadcast(&uart->cond);
+        pthread_mutex_unlock(&uart->lock);
+        Sim_uart_post(uart, UART_DATA, len);
+    }
+    return NULL;
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t* uart_config)
+{
+    if (!Sim_uart_valid(uart_num) || (uart_config == NULL) || (uart_config->baud_rate <= 0))
+        return ESP_ERR_INVALID_ARG;
+    g_uart[uart_num].baud_rate = uart_config->baud_rate;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num)
+{
+    (void)tx_io_num;
+    (void)rx_io_num;
+    (void)rts_io_num;
+    (void)cts_io_num;
+    return Sim_uart_valid(uart_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size,
+                              QueueHandle_t* uart_queue, int intr_alloc_flags)
+{
+    Sim_uart_t* uart;
+
+    (void)tx_buffer_size;
+    (void)intr_alloc_flags;
+    if (!Sim_uart_valid(uart_num) || (rx_buffer_size <= SIM_UART_FIFO_LEN))
+        return ESP_ERR_INVALID_ARG;
+    uart = &g_uart[uart_num];
+    if (uart->installed)
+        return ESP_FAIL;
+    if ((uart->fd < 0) && (Sim_uart_open_pty(uart_num, NULL, 0) != 0))
+    {
+        ESP_LOGE(TAG, "UART%d: no pty (%s)", uart_num, strerror(errno));
+        return ESP_FAIL;
+    }
+    fcntl(uart->fd, F_SETFL, fcntl(uart->fd, F_GETFL) | O_NONBLOCK);
+
+    uart->ring = malloc((size_t)rx_buffer_size);
+    if (uart->ring == NULL)
+        return ESP_ERR_NO_MEM;
+    uart->ring_size = (size_t)rx_buffer_size;
+    uart->ring_head = 0;
+    uart->ring_count = 0;
+    uart->queue = NULL;
+    if ((uart_queue != NULL) && (queue_size > 0))
+    {
+        uart->queue = xQueueCreate((UBaseType_t)queue_size, sizeof(uart_event_t));
+        if (uart->queue == NULL)
+        {
+            free(uart->ring);
+            return ESP_ERR_NO_MEM;
+        }
+        *uart_queue = uart->queue;
+    }
+    if (pthread_create(&uart->reader, NULL, Sim_uart_reader, uart) != 0)
+    {
+        if (uart->queue != NULL)
+            vQueueDelete(uart->queue);
+        free(uart->ring);
+        return ESP_FAIL;
+    }
+    uart->installed = true;
+    if (uart->path[0] != '\0')
+        ESP_LOGI(TAG, "UART%d on %s", uart_num, uart->path);
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num)
+{
+    Sim_uart_t* uart;
+
+    if (!Sim_uart_valid(uart_num) || !g_uart[uart_num].installed)
+        return ESP_ERR_INVALID_ARG;
+    uart = &g_uart[uart_num];
+    pthread_cancel(uart->reader);
+    pthread_join(uart->reader, NULL);
+    uart->installed = false;
+    if (uart->queue != NULL)
+        vQueueDelete(uart->queue);
+    uart->queue = NULL;
+    free(uart->ring);
+    uart->ring = NULL;
+    return ESP_OK;
+}
+
+bool uart_is_driver_installed(uart_port_t uart_num)
+{
+    return Sim_uart_valid(uart_num) && g_uart[uart_num].installed;
+}
+
+esp_err_t uart_pattern_queue_reset(uart_port_t uart_num, int queue_length)
+{
+    (void)queue_length;
+    return uart_is_driver_installed(uart_num) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num)
+{
+    Sim_uart_t* uart;
+
+    if (!uart_is_driver_installed(uart_num))
+        return ESP_ERR_INVALID_STATE;
+    uart = &g_uart[uart_num];
+    pthread_mutex_lock(&uart->lock);
+    uart->ring_head = 0;
+    uart->ring_count = 0;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_get_baudrate(uart_port_t uart_num, uint32_t* baudrate)
+{
+    if (!Sim_uart_valid(uart_num) || (baudrate == NULL))
+        return ESP_ERR_INVALID_ARG;
+    *baudrate = (uint32_t)g_uart[uart_num].baud_rate;
+    return ESP_OK;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void* src, size_t size)
+{
+    const uint8_t* data = src;
+    size_t done = 0;
+    ssize_t n;
+
+    if (!uart_is_driver_installed(uart_num) || (src == NULL))
+        return -1;
+    /* The line never pushes back: what the far end does not take in time is lost */
+    while (done < size)
+    {
+        n = write(g_uart[uart_num].fd, data + done, size - done);
+        if (n <= 0)
+        {
+            if ((n < 0) && (errno == EINTR))
+                continue;
+            break;
+        }
+        done += (size_t)n;
+    }
+    return (int)size;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void* buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    Sim_uart_t* uart;
+    uint8_t* data = buf;
+    struct timespec deadline;
+    uint64_t ns;
+    size_t len;
+
+    if (!uart_is_driver_installed(uart_num) || (buf == NULL))
+        return -1;
+    uart = &g_uart[uart_num];
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    ns = (uint64_t)ticks_to_wait * (1000000000ULL / configTICK_RATE_HZ) + (uint64_t)deadline.tv_nsec;
+    deadline.tv_sec += (time_t)(ns / 1000000000ULL);
+    deadline.tv_nsec = (long)(ns % 1000000000ULL);
+
+    pthread_mutex_lock(&uart->lock);
+    while (uart->ring_count < length)
+    {
+        if (ticks_to_wait == portMAX_DELAY)
+            pthread_cond_wait(&uart->cond, &uart->lock);
+        else if ((ticks_to_wait == 0) || (pthread_cond_timedwait(&uart->cond, &uart->lock, &deadline) != 0))
+            break;
+    }
+    len = (uart->ring_count < length) ? uart->ring_count : length;
+    for (size_t i = 0; i < len; i++)
+        data[i] = uart->ring[(uart->ring_head + i) % uart->ring_size];
+    uart->ring_head = (uart->ring_head + len) % uart->ring_size;
+    uart->ring_count -= len;
+    pthread_mutex_unlock(&uart->lock);
+    return (int)len;
+}
@@ -0,0 +1,470 @@
+/*
+ * Raw UART capture of the radar (main/uart_task/radar_uart_capture.h): control, dump, load and print.
+ * Everything goes over the UDP control port with function code 0x13, so the tool never shows up in
+ * the capture of the host UART it may be looking at.
+ *   dump  : stops the capture, reads the ring, starts it again (unless -k) and saves it
+ *   load  : stops and clears the capture and writes the records of a file into the ring, to replay
+ *           a capture taken on another radar or in radar_sim
+ *   print : one line per data event, with the time since the previous event of the same port
+ * A replay hands the events to the port handlers again, -x replay at the recorded pace, -x fast
+ * as quick as the handlers take them; -x info then reports how long the handlers needed.
+ *
+ * usage: radar_capture -a radar address [-c control port] [-d device address]
+ *                      [-x start|stop|clear|replay|fast|info] [-u capture file] [-w capture file] [-k] [-q]
+ *        radar_capture -f capture file [-q]
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define CAPTURE_CONTROL_PORT    3334    /* CONFIG_RADAR_CONTROL_PORT */
+#define CAPTURE_FUNCODE         0x13    /* MODBUS_FUNCODE_CAPTURE */
+#define CAPTURE_CMD_STOP        0x00    /* RADAR_CAPTURE_CMD_xxx */
+#define CAPTURE_CMD_START       0x01
+#define CAPTURE_CMD_CLEAR       0x02
+#define CAPTURE_CMD_REPLAY      0x03
+#define CAPTURE_CMD_REPLAY_FAST 0x04
+#define CAPTURE_RECORD_LEN      32      /* RADAR_CAPTURE_RECORD_LEN */
+#define CAPTURE_DATA_LEN        25
+#define CAPTURE_FLAG_CONTINUED  0x01
+#define CAPTURE_RING_MAX        4096    /* 1 << 12, largest CONFIG_RADAR_UART_CAPTURE_RING_ORDER */
+#define CAPTURE_PORT_MAX        8
+#define CAPTURE_TIMEOUT_MS      300
+#define CAPTURE_TRIES           5
+#define CAPTURE_FILE_MAGIC      "RCAP"
+
+/* Modbus framing, see main/communication_protocol/mod_bus.h */
+#define MODBUS_MASTER_HEAD      0x51
+#define MODBUS_SLAVE_HEAD       0x55
+#define MODBUS_SENSOR_TYPE      0x0B
+#define MODBUS_OPT_READ         0x00
+#define MODBUS_OPT_WRITE        0x01
+#define MODBUS_OPT_ERROR        0xFF
+
+/* Records oldest first, as on the wire */
+typedef struct {
+    uint32_t num;
+    uint8_t records[CAPTURE_RING_MAX * CAPTURE_RECORD_LEN];
+} Capture_t;
+
+static Capture_t g_capture;
+
+static void Capture_usage(void)
+{
+    fprintf(stderr, "usage: radar_capture -a radar address [-c control port] [-d device address]\n"
+                    "                     [-x start|stop|clear|replay|fast|info] [-u capture file] [-w capture file] [-k] [-q]\n"
+                    "       radar_capture -f capture file [-q]\n"
+                    "  control port 1..65535, device address 0..0xFFFF\n");
+    exit(2);
+}
+
+/* Unsigned option in the given base (0: C prefixes), the usage unless min <= value <= max */
+static unsigned long Capture_parse_unsigned(const char* arg, int base, unsigned long min, unsigned long max)
+{
+    unsigned long value;
+    char* end;
+
+    errno = 0;
+    value = strtoul(arg, &end, base);
+    if ((errno != 0) || (end == arg) || (*end != '\0') || (arg[0] == '-') || (value < min) || (value > max))
+        Capture_usage();
+    return value;
+}
+
+static uint16_t Capture_get_u16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t Capture_get_u32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void Capture_put_u16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static void Capture_put_u32(uint8_t* p, uint32_t value)
+{
+    Capture_put_u16(p, (uint16_t)(value >> 16));
+    Capture_put_u16(p + 2, (uint16_t)value);
+}
+
+static uint16_t Capture_checksum(const uint8_t* buf, size_t len)
+{
+    uint16_t sum = 0;
+    while (len--)
+        sum += *buf++;
+    return sum;
+}
+
+/*
+ * One request, answered within CAPTURE_TIMEOUT_MS or sent again: commands and page reads can be
+ * repeated, a record load whose answer got lost is appended twice and caught by Capture_upload.
+ * Returns the data length of a read answer, 0 for a write acknowledge, -1 on error.
+ */
+static int Capture_request(int sock, uint16_t address, uint8_t opt, const uint8_t* data, uint8_t len, uint8_t* answer)
+{
+    uint8_t frame[9 + 255];
+    size_t frame_len = 7;
+
+    frame[0] = MODBUS_MASTER_HEAD;
+    frame[1] = MODBUS_SENSOR_TYPE;
+    Capture_put_u16(&frame[2], address);
+    frame[4] = opt;
+    frame[5] = CAPTURE_FUNCODE;
+    frame[6] = len;
+    if (opt == MODBUS_OPT_WRITE)
+    {
+        memcpy(&frame[7], data, len);
+        frame_len += len;
+    }
+    Capture_put_u16(&frame[frame_len], Capture_checksum(frame, frame_len));
+    frame_len += 2;
+
+    for (int tries = 0; tries < CAPTURE_TRIES; tries++)
+    {
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+        uint8_t buf[512];
+        ssize_t n;
+
+        if (send(sock, frame, frame_len, 0) != (ssize_t)frame_len)
+        {
+            perror("send");
+            return -1;
+        }
+        while (poll(&pfd, 1, CAPTURE_TIMEOUT_MS) > 0)
+        {
+            n = recv(sock, buf, sizeof(buf), 0);
+            if ((n < 8) || (buf[0] != MODBUS_SLAVE_HEAD) || (buf[1] != MODBUS_SENSOR_TYPE))
+                continue;   /* not a Modbus answer */
+            if (buf[2] == MODBUS_OPT_ERROR)
+            {
+                fprintf(stderr, "radar_capture: error status 0x%02X (capture compiled out, running or replaying?)\n",
+                        buf[5]);
+                return -1;
+            }
+            if ((buf[4] == MODBUS_OPT_WRITE) && (buf[5] == CAPTURE_FUNCODE))
+                return 0;
+            if ((n >= 10) && (buf[4] == MODBUS_OPT_READ) && (buf[6] == CAPTURE_FUNCODE) && (n >= 10 + buf[7]) &&
+                (Capture_get_u16(&buf[8 + buf[7]]) == Capture_checksum(buf, 8 + buf[7])))
+            {
+                memcpy(answer, &buf[8], buf[7]);
+                return buf[7];
+            }
+        }
+    }
+    fprintf(stderr, "radar_capture: no answer\n");
+    return -1;
+}
+
+static int Capture_command(int sock, uint16_t address, uint8_t cmd)
+{
+    uint8_t answer[255];
+    return Capture_request(sock, address, MODBUS_OPT_WRITE, &cmd, 1, answer);
+}
+
+/* Information answer, see radar_uart_capture.h; fills ring_len and head */
+static int Capture_info(int sock, uint16_t address, bool print, uint16_t* ring_len, uint32_t* head)
+{
+    uint8_t answer[255];
+    int len = Capture_request(sock, address, MODBUS_OPT_READ, NULL, 0, answer);
+
+    if ((len < 25) || (answer[4] != CAPTURE_RECORD_LEN))
+    {
+        fprintf(stderr, "radar_capture: unexpected capture information\n");
+        return -1;
+    }
+    *ring_len = Capture_get_u16(&answer[2]);
+    *head = Capture_get_u32(&answer[5]);
+    if (print)
+    {
+        uint32_t bytes = Capture_get_u32(&answer[13]);
+        uint32_t handler_us = Capture_get_u32(&answer[17]);
+
+        printf("capturing %u\n", answer[0]);
+        printf("replaying %u\n", answer[1]);
+        printf("ring_records %u\n", *ring_len);
+        printf("records_written %u\n", *head);
+        printf("replay_events %u\n", Capture_get_u32(&answer[9]));
+        printf("replay_bytes %u\n", bytes);
+        printf("replay_handler_us %u\n", handler_us);
+        printf("replay_skipped %u\n", Capture_get_u32(&answer[21]));
+        printf("replay_ns_per_byte %.1f\n", bytes ? (double)handler_us * 1000.0 / bytes : 0.0);
+    }
+    return 0;
+}
+
+/* Stop the capture and read the records still in the ring, oldest first */
+static int Capture_fetch(int sock, uint16_t address, bool keep_stopped)
+{
+    uint8_t answer[255];
+    uint16_t ring_len;
+    uint32_t head;
+    uint32_t num;
+    int len;
+
+    if ((Capture_command(sock, address, CAPTURE_CMD_STOP) < 0) || (Capture_info(sock, address, false, &ring_len, &head) < 0))
+        return -1;
+    if ((ring_len == 0) || (ring_len > CAPTURE_RING_MAX))
+    {
+        fprintf(stderr, "radar_capture: ring of %u records\n", ring_len);
+        return -1;
+    }
+    num = (head < ring_len) ? head : ring_len;
+    g_capture.num = 0;
+    for (uint32_t n = head - num; n != head;)
+    {
+        uint16_t slot = (uint16_t)(n % ring_len);
+        uint8_t first[2] = { (uint8_t)(slot >> 8), (uint8_t)slot };
+        uint32_t take;
+
+        len = Capture_request(sock, address, MODBUS_OPT_WRITE, first, sizeof(first), answer);
+        if ((len < 3) || (Capture_get_u16(&answer[0]) != slot) || (answer[2] == 0) ||
+            (len < 3 + answer[2] * CAPTURE_RECORD_LEN))
+            return -1;
+        take = answer[2];
+        if (take > head - n)
+            take = head - n;
+        memcpy(&g_capture.records[g_capture.num * CAPTURE_RECORD_LEN], &answer[3], (size_t)take * CAPTURE_RECORD_LEN);
+        g_capture.num += take;
+        n += take;
+    }
+    if (!keep_stopped)
+        Capture_command(sock, address, CAPTURE_CMD_START);
+    return 0;
+}
+
+/* Stop and clear the capture, append every record of g_capture, then check none went in twice */
+static int Capture_upload(int sock, uint16_t address)
+{
+    uint8_t answer[255];
+    uint16_t ring_len;
+    uint32_t head;
+
+    if ((Capture_command(sock, address, CAPTURE_CMD_STOP) < 0) || (Capture_command(sock, address, CAPTURE_CMD_CLEAR) < 0) ||
+        (Capture_info(sock, address, false, &ring_len, &head) < 0))
+        return -1;
+    if (g_capture.num > ring_len)
+        fprintf(stderr, "radar_capture: %u records for a ring of %u, the oldest are lost\n", g_capture.num, ring_len);
+    for (uint32_t i = 0; i < g_capture.num; i++)
+    {
+        if (Capture_request(sock, address, MODBUS_OPT_WRITE, &g_capture.records[i * CAPTURE_RECORD_LEN],
+                            CAPTURE_RECORD_LEN, answer) < 0)
+            return -1;
+    }
+    if (Capture_info(sock, address, false, &ring_len, &head) < 0)
+        return -1;
+    if (head != g_capture.num)
+    {
+        fprintf(stderr, "radar_capture: %u records written for %u, load again\n", head, g_capture.num);
+        return -1;
+    }
+    return 0;
+}
+
+// File: magic(4) record_len(1) num(4) then num records oldest first, as on the wire
+static int Capture_save(const char* path)
+{
+    FILE* f = fopen(path, "wb");
+    uint8_t head[9];
+
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    memcpy(head, CAPTURE_FILE_MAGIC, 4);
+    head[4] = CAPTURE_RECORD_LEN;
+    Capture_put_u32(&head[5], g_capture.num);
+    fwrite(head, 1, sizeof(head), f);
+    fwrite(g_capture.records, CAPTURE_RECORD_LEN, g_capture.num, f);
+    return fclose(f);
+}
+
+static int Capture_load(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    uint8_t head[9];
+    int ret = -1;
+
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    if ((fread(head, 1, sizeof(head), f) == sizeof(head)) && (memcmp(head, CAPTURE_FILE_MAGIC, 4) == 0) &&
+        (head[4] == CAPTURE_RECORD_LEN))
+    {
+        g_capture.num = Capture_get_u32(&head[5]);
+        if ((g_capture.num <= CAPTURE_RING_MAX) &&
+            (fread(g_capture.records, CAPTURE_RECORD_LEN, g_capture.num, f) == g_capture.num))
+            ret = 0;
+    }
+    if (ret < 0)
+        fprintf(stderr, "%s: not a radar UART capture\n", path);
+    fclose(f);
+    return ret;
+}
+
+// One line per data event, the records of an event joined again
+static void Capture_print(bool quiet)
+{
+    uint32_t last[CAPTURE_PORT_MAX];
+    bool seen[CAPTURE_PORT_MAX] = { false };
+    unsigned long events[CAPTURE_PORT_MAX] = { 0 };
+    unsigned long bytes[CAPTURE_PORT_MAX] = { 0 };
+    uint32_t first_us = 0;
+    uint32_t i = 0;
+
+    /* the oldest event may have lost its first records to the ring */
+    while ((i < g_capture.num) && (g_capture.records[i * CAPTURE_RECORD_LEN + 5] & CAPTURE_FLAG_CONTINUED))
+        i++;
+    if (i < g_capture.num)
+        first_us = Capture_get_u32(&g_capture.records[i * CAPTURE_RECORD_LEN]);
+    while (i < g_capture.num)
+    {
+        const uint8_t* record = &g_capture.records[i * CAPTURE_RECORD_LEN];
+        uint32_t time_us = Capture_get_u32(record);
+        uint8_t port = (record[4] < CAPTURE_PORT_MAX) ? record[4] : 0;
+        int32_t since = seen[port] ? (int32_t)(time_us - last[port]) : 0;
+        size_t len = 0;
+
+        if (!quiet)
+            printf("%12.3f ms %9.3f ms  port %u ", (double)(int32_t)(time_us - first_us) / 1000.0, since / 1000.0,
+                   record[4]);
+        do
+        {
+            record = &g_capture.records[i * CAPTURE_RECORD_LEN];
+            for (uint8_t b = 0; !quiet && (b < record[6]) && (b < CAPTURE_DATA_LEN); b++)
+                printf(" %02X", record[7 + b]);
+            len += record[6];
+            i++;
+        } while ((i < g_capture.num) && (g_capture.records[i * CAPTURE_RECORD_LEN + 5] & CAPTURE_FLAG_CONTINUED));
+        if (!quiet)
+            printf("  (%zu)\n", len);
+        events[port]++;
+        bytes[port] += len;
+        last[port] = time_us;
+        seen[port] = true;
+    }
+    printf("\n%u records\n", g_capture.num);
+    for (unsigned port = 0; port < CAPTURE_PORT_MAX; port++)
+    {
+        if (events[port])
+            printf("  port %u: %lu events, %lu bytes\n", port, events[port], bytes[port]);
+    }
+}
+
+static int Capture_parse_action(const char* text)
+{
+    static const struct {
+        const char* name;
+        int cmd;
+    } actions[] = {
+        { "stop", CAPTURE_CMD_STOP },     { "start", CAPTURE_CMD_START },      { "clear", CAPTURE_CMD_CLEAR },
+        { "replay", CAPTURE_CMD_REPLAY }, { "fast", CAPTURE_CMD_REPLAY_FAST }, { "info", -1 },
+    };
+
+    for (size_t i = 0; i < sizeof(actions) / sizeof(actions[0]); i++)
+    {
+        if (strcmp(text, actions[i].name) == 0)
+            return actions[i].cmd;
+    }
+    Capture_usage();
+    return -1;
+}
+
+int main(int argc, char** argv)
+{
+    const char* radar = NULL;
+    const char* save = NULL;
+    const char* upload = NULL;
+    const char* load = NULL;
+    uint16_t port = CAPTURE_CONTROL_PORT;
+    uint16_t address = 0x0001;
+    bool action = false;
+    int cmd = -1;
+    bool keep_stopped = false;
+    bool quiet = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:c:d:x:u:w:kf:q")) != -1)
+    {
+        switch (opt)
+        {
+        case 'a': radar = optarg; break;
+        case 'c': port = (uint16_t)Capture_parse_unsigned(optarg, 10, 1, 65535); break;
+        case 'd': address = (uint16_t)Capture_parse_unsigned(optarg, 0, 0, 0xFFFF); break;
+        case 'x':
+            action = true;
+            cmd = Capture_parse_action(optarg);
+            break;
+        case 'u': upload = optarg; break;
+        case 'w': save = optarg; break;
+        case 'k': keep_stopped = true; break;
+        case 'f': load = optarg; break;
+        case 'q': quiet = true; break;
+        default: Capture_usage();
+        }
+    }
+    if (((radar == NULL) == (load == NULL)) || (radar && !action && !save && !upload) || (optind < argc))
+        Capture_usage();
+
+    if (load)
+    {
+        if (Capture_load(load) < 0)
+            return 1;
+        Capture_print(quiet);
+        return 0;
+    }
+
+    struct sockaddr_in dest = { .sin_family = AF_INET, .sin_port = htons(port) };
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    uint16_t ring_len;
+    uint32_t head;
+
+    if (inet_pton(AF_INET, radar, &dest.sin_addr) != 1)
+    {
+        fprintf(stderr, "radar_capture: bad address %s\n", radar);
+        return 1;
+    }
+    if ((sock < 0) || (connect(sock, (struct sockaddr*)&dest, sizeof(dest)) < 0))
+    {
+        perror("connect");
+        return 1;
+    }
+    if (save)
+    {
+        if ((Capture_fetch(sock, address, keep_stopped) < 0) || (Capture_save(save) < 0))
+            return 1;
+        if (!quiet)
+            Capture_print(true);
+    }
+    if (upload)
+    {
+        if ((Capture_load(upload) < 0) || (Capture_upload(sock, address) < 0))
+            return 1;
+    }
+    if (action)
+    {
+        if ((cmd >= 0) ? (Capture_command(sock, address, (uint8_t)cmd) < 0)
+                       : (Capture_info(sock, address, true, &ring_len, &head) < 0))
+            return 1;
+    }
+    close(sock);
+    return 0;
+}
@@ -0,0 +1,314 @@
+/*
+ * Stand-in listener for multi-radar sites.
+ * Probes the discovery group, lists every radar that answers or announces itself, and
+ * optionally joins the scan stream (multicast group or unicast port) and counts the sweeps
+ * of each radar, so one capture shows what every host of the site would receive.
+ * Announce layout: see main/wifi_task/discovery.h, datagram header: main/wifi_task/UDP_clinet.h.
+ *
+ * usage: radar_listen [-g discovery group] [-p discovery port] [-m stream group] [-s stream port]
+ *                     [-t seconds] [-i interface address]
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LISTEN_DISCOVERY_GROUP  "239.255.82.82" /* CONFIG_RADAR_DISCOVERY_GROUP */
+#define LISTEN_DISCOVERY_PORT   3336            /* CONFIG_RADAR_DISCOVERY_PORT */
+#define LISTEN_DISCOVERY_MAGIC  0x5244          /* RADAR_DISCOVERY_MAGIC */
+#define LISTEN_TYPE_PROBE       0x01
+#define LISTEN_TYPE_ANNOUNCE    0x02
+#define LISTEN_ANNOUNCE_LEN     42              /* RADAR_DISCOVERY_ANNOUNCE_LEN */
+#define LISTEN_STREAM_MAGIC     0x5253          /* RADAR_STREAM_MAGIC */
+#define LISTEN_STREAM_HEAD      29              /* RADAR_STREAM_HEAD_LEN */
+#define LISTEN_STREAM_RESENT    0x03            /* RADAR_STREAM_FLAG_PARITY | RADAR_STREAM_FLAG_RETRANSMIT */
+#define LISTEN_RADAR_MAX        64
+
+typedef struct {
+    bool announced;
+    uint16_t address;
+    uint8_t mac[6];
+    uint32_t ipv4;
+    uint16_t capabilities;
+    uint16_t control_port;
+    uint16_t server_port;
+    uint16_t stream_port;
+    uint32_t stream_addr;
+    uint8_t format;
+    uint16_t interval_ms;
+    uint16_t start_angle;
+    uint8_t step;
+    uint16_t count;
+    int16_t tilt_angle;
+    uint32_t sequence;
+    /* stream statistics, by device address */
+    unsigned long datagrams;
+    unsigned long sweeps;
+    unsigned long missed;
+    uint32_t last_sequence;
+} Listen_radar_t;
+
+static Listen_radar_t g_radar[LISTEN_RADAR_MAX];
+static int g_radar_num = 0;
+
+static uint16_t Listen_get_u16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t Listen_get_u32(const uint8_t* p)
+{
+    return ((uint32_t)Listen_get_u16(p) << 16) | Listen_get_u16(p + 2);
+}
+
+static double Listen_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static Listen_radar_t* Listen_find(uint16_t address)
+{
+    for (int i = 0; i < g_radar_num; i++)
+    {
+        if (g_radar[i].address == address)
+            return &g_radar[i];
+    }
+    if (g_radar_num >= LISTEN_RADAR_MAX)
+        return NULL;
+    memset(&g_radar[g_radar_num], 0, sizeof(g_radar[0]));
+    g_radar[g_radar_num].address = address;
+    return &g_radar[g_radar_num++];
+}
+
+static int Listen_open(uint16_t port, const char* group, const char* interface)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_ANY) };
+    int opt = 1;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (sock < 0)
+        return -1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)); /* several listeners on one host */
+    setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &opt, sizeof(opt));
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        close(sock);
+        return -1;
+    }
+    if (group != NULL)
+    {
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr.s_addr = inet_addr(group);
+        mreq.imr_interface.s_addr = interface ? inet_addr(interface) : htonl(INADDR_ANY);
+        if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+            perror("IP_ADD_MEMBERSHIP");
+    }
+    return sock;
+}
+
+static void Listen_probe(int sock, const char* group, uint16_t port)
+{
+    uint8_t probe[4] = { LISTEN_DISCOVERY_MAGIC >> 8, LISTEN_DISCOVERY_MAGIC & 0xFF, 0x01, LISTEN_TYPE_PROBE };
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+
+    addr.sin_addr.s_addr = inet_addr(group);
+    sendto(sock, probe, sizeof(probe), 0, (struct sockaddr*)&addr, sizeof(addr));
+    addr.sin_addr.s_addr = htonl(INADDR_BROADCAST);   /* radars that could not join the group */
+    sendto(sock, probe, sizeof(probe), 0, (struct sockaddr*)&addr, sizeof(addr));
+}
+
+static void Listen_announce(const uint8_t* p, ssize_t len)
+{
+    Listen_radar_t* radar;
+    struct in_addr ip;
+    struct in_addr stream;
+    char ip_text[INET_ADDRSTRLEN];
+    bool changed;
+
+    if ((len < LISTEN_ANNOUNCE_LEN) || (Listen_get_u16(p) != LISTEN_DISCOVERY_MAGIC) || (p[3] != LISTEN_TYPE_ANNOUNCE))
+        return;
+    radar = Listen_find(Listen_get_u16(&p[4]));
+    if (radar == NULL)
+        return;
+
+    changed = !radar->announced || (radar->ipv4 != Listen_get_u32(&p[12])) ||
+              (radar->format != p[28]) || (radar->step != p[33]) || (radar->count != Listen_get_u16(&p[34]));
+    radar->announced = true;
+    memcpy(radar->mac, &p[6], 6);
+    radar->ipv4 = Listen_get_u32(&p[12]);
+    radar->capabilities = Listen_get_u16(&p[16]);
+    radar->control_port = Listen_get_u16(&p[18]);
+    radar->server_port = Listen_get_u16(&p[20]);
+    radar->stream_port = Listen_get_u16(&p[22]);
+    radar->stream_addr = Listen_get_u32(&p[24]);
+    radar->format = p[28];
+    radar->interval_ms = Listen_get_u16(&p[29]);
+    radar->start_angle = Listen_get_u16(&p[31]);
+    radar->step = p[33];
+    radar->count = Listen_get_u16(&p[34]);
+    radar->tilt_angle = (int16_t)Listen_get_u16(&p[36]);
+    radar->sequence = Listen_get_u32(&p[38]);
+    if (!changed)
+        return;
+
+    ip.s_addr = htonl(radar->ipv4);
+    stream.s_addr = htonl(radar->stream_addr);
+    inet_ntop(AF_INET, &ip, ip_text, sizeof(ip_text));
+    printf("radar 0x%04X  %02x:%02x:%02x:%02x:%02x:%02x  %-15s control:%u server:%u stream:%s:%u caps:0x%04X\n"
+           "             format 0x%02X every %u ms, %u bins from %u° by %u°, tilt %d°, sweep %u\n",
+           radar->address, radar->mac[0], radar->mac[1], radar->mac[2], radar->mac[3], radar->mac[4], radar->mac[5],
+           ip_text, radar->control_port, radar->server_port, inet_ntoa(stream), radar->stream_port,
+           radar->capabilities, radar->format, radar->interval_ms, radar->count, radar->start_angle, radar->step,
+           radar->tilt_angle, radar->sequence);
+    fflush(stdout);
+}
+
+static void Listen_stream(const uint8_t* p, ssize_t len)
+{
+    Listen_radar_t* radar;
+    uint32_t sequence;
+
+    if ((len < LISTEN_STREAM_HEAD) || (Listen_get_u16(p) != LISTEN_STREAM_MAGIC) || (p[28] & LISTEN_STREAM_RESENT))
+        return;     /* parity and retransmissions repeat slices already counted */
+    radar = Listen_find(Listen_get_u16(&p[4]));
+    if (radar == NULL)
+        return;
+    sequence = Listen_get_u32(&p[6]);
+    radar->datagrams++;
+    if (!radar->sweeps || (sequence != radar->last_sequence))
+    {
+        if (radar->sweeps && (sequence > radar->last_sequence + 1))
+            radar->missed += sequence - radar->last_sequence - 1;
+        radar->sweeps++;
+        radar->last_sequence = sequence;
+    }
+}
+
+static void Listen_usage(void)
+{
+    fprintf(stderr, "usage: radar_listen [-g discovery group] [-p discovery port] [-m stream group] [-s stream port]\n"
+                    "                    [-t seconds] [-i interface address]\n"
+                    "  ports 1..65535, seconds >= 0 (0: until interrupted)\n");
+    exit(2);
+}
+
+/* UDP port option, the usage on anything but 1..65535 */
+static uint16_t Listen_parse_port(const char* arg)
+{
+    unsigned long value;
+    char* end;
+
+    errno = 0;
+    value = strtoul(arg, &end, 10);
+    if ((errno != 0) || (end == arg) || (*end != '\0') || (arg[0] == '-') || (value == 0) || (value > 65535))
+        Listen_usage();
+    return (uint16_t)value;
+}
+
+static double Listen_parse_seconds(const char* arg)
+{
+    double value;
+    char* end;
+
+    errno = 0;
+    value = strtod(arg, &end);
+    if ((errno != 0) || (end == arg) || (*end != '\0') || !isfinite(value) || (value < 0.0))
+        Listen_usage();
+    return value;
+}
+
+int main(int argc, char** argv)
+{
+    const char* discovery_group = LISTEN_DISCOVERY_GROUP;
+    const char* stream_group = NULL;
+    const char* interface = NULL;
+    uint16_t discovery_port = LISTEN_DISCOVERY_PORT;
+    uint16_t stream_port = 0;
+    double seconds = 0;
+    struct pollfd fds[2];
+    int nfds = 1;
+    int opt;
+    double start;
+    double report;
+
+    while ((opt = getopt(argc, argv, "g:p:m:s:t:i:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'g': discovery_group = optarg; break;
+        case 'p': discovery_port = Listen_parse_port(optarg); break;
+        case 'm': stream_group = optarg; break;
+        case 's': stream_port = Listen_parse_port(optarg); break;
+        case 't': seconds = Listen_parse_seconds(optarg); break;
+        case 'i': interface = optarg; break;
+        default: Listen_usage();
+        }
+    }
+    if (optind < argc)
+        Listen_usage();
+    if (stream_group && !stream_port)
+        stream_port = 3333;     /* CONFIG_EXAMPLE_PORT */
+
+    fds[0].fd = Listen_open(discovery_port, discovery_group, interface);
+    fds[0].events = POLLIN;
+    if (fds[0].fd < 0)
+        return 1;
+    if (stream_port)
+    {
+        fds[1].fd = Listen_open(stream_port, stream_group, interface);
+        fds[1].events = POLLIN;
+        if (fds[1].fd < 0)
+            return 1;
+        nfds = 2;
+    }
+
+    Listen_probe(fds[0].fd, discovery_group, discovery_port);
+    start = Listen_clock();
+    report = start + 1.0;
+    while ((seconds <= 0) || (Listen_clock() - start < seconds))
+    {
+        uint8_t buf[2048];
+
+        if (poll(fds, nfds, 200) > 0)
+        {
+            for (int i = 0; i < nfds; i++)
+            {
+                ssize_t len;
+                if (!(fds[i].revents & POLLIN))
+                    continue;
+                len = recv(fds[i].fd, buf, sizeof(buf), 0);
+                if (i == 0)
+                    Listen_announce(buf, len);
+                else
+                    Listen_stream(buf, len);
+            }
+        }
+        if (stream_port && (Listen_clock() >= report))
+        {
+            report += 1.0;
+            for (int i = 0; i < g_radar_num; i++)
+            {
+                if (g_radar[i].datagrams)
+                    printf("radar 0x%04X  datagrams:%lu sweeps:%lu missed:%lu last:%u\n", g_radar[i].address,
+                           g_radar[i].datagrams, g_radar[i].sweeps, g_radar[i].missed, g_radar[i].last_sequence);
+            }
+            fflush(stdout);
+        }
+    }
+    printf("%d radar(s)\n", g_radar_num);
+    return 0;
+}
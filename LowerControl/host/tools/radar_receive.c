@@ -0,0 +1,440 @@
+/*
+ * Stand-in receiver for the loss-tolerant scan stream (main/wifi_task/UDP_clinet.h).
+ * Follows datagram_seq, NACKs the gaps to the control port of the radar, rebuilds single losses
+ * from the parity datagrams, and reports what was lost and how it came back.
+ * Datagrams can be dropped on purpose before they are looked at, at random or in bursts,
+ * so the recovery can be tested on a clean network.
+ *
+ * usage: radar_receive [-s stream port] [-m stream group] [-i interface address] [-c control port]
+ *                      [-l loss %] [-b burst] [-n nack delay ms] [-r nack retry ms] [-t seconds] [-q]
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RECEIVE_STREAM_PORT     3333    /* CONFIG_EXAMPLE_PORT */
+#define RECEIVE_CONTROL_PORT    3334    /* CONFIG_RADAR_CONTROL_PORT */
+#define RECEIVE_STREAM_MAGIC    0x5253  /* RADAR_STREAM_MAGIC */
+#define RECEIVE_STREAM_VERSION  0x03    /* RADAR_STREAM_VERSION */
+#define RECEIVE_STREAM_HEAD     29      /* RADAR_STREAM_HEAD_LEN */
+#define RECEIVE_PARITY_HEAD     3       /* RADAR_STREAM_PARITY_HEAD_LEN */
+#define RECEIVE_FLAG_PARITY     0x01
+#define RECEIVE_FLAG_RETRANSMIT 0x02
+#define RECEIVE_NACK_MAGIC      0x524E  /* RADAR_STREAM_NACK_MAGIC */
+#define RECEIVE_NACK_MAX        64      /* datagram_seq per NACK */
+#define RECEIVE_NACK_TRIES      3       /* NACKs per lost slice before it is given up */
+#define RECEIVE_RING            1024    /* Slices kept for parity and duplicate detection */
+#define RECEIVE_PAYLOAD_MAX     1472
+
+typedef enum {
+    RECEIVE_EMPTY = 0,
+    RECEIVE_RECEIVED,
+    RECEIVE_MISSING,
+    RECEIVE_LOST,
+} Receive_state_t;
+
+typedef struct {
+    uint32_t seq;
+    Receive_state_t state;
+    uint8_t tries;          /* NACKs sent */
+    double due;             /* Time of the next NACK */
+    uint8_t slice;
+    uint16_t len;
+    uint8_t payload[RECEIVE_PAYLOAD_MAX];
+} Receive_slot_t;
+
+typedef struct {
+    unsigned long received;     /* Slices received the first time */
+    unsigned long injected;     /* Datagrams dropped on purpose */
+    unsigned long gaps;         /* Slices found missing */
+    unsigned long fec;          /* Rebuilt from parity */
+    unsigned long nack;         /* Received again after a NACK */
+    unsigned long late;         /* Arrived after being found missing, out of order */
+    unsigned long lost;         /* Given up */
+    unsigned long duplicate;
+    unsigned long parity;
+    unsigned long nack_sent;    /* NACK datagrams */
+} Receive_stats_t;
+
+static Receive_slot_t g_ring[RECEIVE_RING];
+static Receive_stats_t g_stats;
+static bool g_started = false;
+static uint32_t g_next_seq = 0;         /* Seq after the highest one seen */
+static unsigned long g_missing = 0;     /* Slots in RECEIVE_MISSING */
+static struct sockaddr_in g_radar;      /* Where NACKs go */
+static bool g_radar_known = false;
+
+static uint16_t Receive_get_u16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t Receive_get_u32(const uint8_t* p)
+{
+    return ((uint32_t)Receive_get_u16(p) << 16) | Receive_get_u16(p + 2);
+}
+
+static double Receive_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static Receive_slot_t* Receive_slot(uint32_t seq)
+{
+    Receive_slot_t* slot = &g_ring[seq % RECEIVE_RING];
+    return (slot->state != RECEIVE_EMPTY) && (slot->seq == seq) ? slot : NULL;
+}
+
+/* reuse the slot of seq, a slice still missing there is given up */
+static Receive_slot_t* Receive_claim(uint32_t seq)
+{
+    Receive_slot_t* slot = &g_ring[seq % RECEIVE_RING];
+
+    if (slot->state == RECEIVE_MISSING)
+    {
+        g_stats.lost++;
+        g_missing--;
+    }
+    memset(slot, 0, offsetof(Receive_slot_t, payload));
+    slot->seq = seq;
+    return slot;
+}
+
+/* every seq below end has been sent: the ones not seen yet are missing */
+static void Receive_advance(uint32_t end, double now, double nack_delay)
+{
+    if (!g_started)
+    {
+        g_started = true;
+        g_next_seq = end;
+        return;
+    }
+    if ((int32_t)(end - g_next_seq) > RECEIVE_RING)
+    {
+        /* radar restarted or long outage: resynchronize */
+        g_stats.gaps += end - g_next_seq;
+        g_stats.lost += end - g_next_seq;
+        for (int i = 0; i < RECEIVE_RING; i++)
+            g_ring[i].state = RECEIVE_EMPTY;
+        g_missing = 0;
+        g_next_seq = end;
+        return;
+    }
+    while ((int32_t)(end - g_next_seq) > 0)
+    {
+        Receive_slot_t* slot = Receive_claim(g_next_seq++);
+        slot->state = RECEIVE_MISSING;
+        slot->due = now + nack_delay;  /* room for reordering and for the parity of the group */
+        g_stats.gaps++;
+        g_missing++;
+    }
+}
+
+static void Receive_store(Receive_slot_t* slot, uint8_t slice, const uint8_t* payload, size_t len)
+{
+    slot->state = RECEIVE_RECEIVED;
+    slot->slice = slice;
+    slot->len = (uint16_t)len;
+    memcpy(slot->payload, payload, len);
+}
+
+static void Receive_data(const uint8_t* p, size_t len, double now, double nack_delay)
+{
+    uint32_t seq = Receive_get_u32(&p[24]);
+    const uint8_t* payload = &p[RECEIVE_STREAM_HEAD];
+    size_t payload_len = len - RECEIVE_STREAM_HEAD;
+    Receive_slot_t* slot;
+
+    if (g_started && ((int32_t)(seq - g_next_seq) < 0))
+    {
+        slot = Receive_slot(seq);
+        if ((slot == NULL) || (slot->state != RECEIVE_MISSING))
+        {
+            g_stats.duplicate++;   /* already there, rebuilt, given up or too old */
+            return;
+        }
+        if (p[28] & RECEIVE_FLAG_RETRANSMIT)
+            g_stats.nack++;
+        else
+            g_stats.late++;
+        g_missing--;
+        Receive_store(slot, p[18], payload, payload_len);
+        return;
+    }
+    Receive_advance(seq, now, nack_delay);
+    slot = Receive_claim(seq);
+    Receive_store(slot, p[18], payload, payload_len);
+    g_next_seq = seq + 1;
+    g_stats.received++;
+}
+
+/* one missing slice of the group is the XOR of the parity and every other slice */
+static void Receive_parity(const uint8_t* p, size_t len, double now, double nack_delay)
+{
+    uint32_t base = Receive_get_u32(&p[24]);
+    uint8_t num = p[RECEIVE_STREAM_HEAD];
+    uint16_t rebuilt_len = Receive_get_u16(&p[RECEIVE_STREAM_HEAD + 1]);
+    const uint8_t* xor = &p[RECEIVE_STREAM_HEAD + RECEIVE_PARITY_HEAD];
+    size_t xor_len = len - RECEIVE_STREAM_HEAD - RECEIVE_PARITY_HEAD;
+    uint8_t rebuilt[1 + RECEIVE_PAYLOAD_MAX];
+    Receive_slot_t* missing = NULL;
+
+    g_stats.parity++;
+    if ((num == 0) || (xor_len == 0) || (xor_len > sizeof(rebuilt)))
+        return;
+    Receive_advance(base + num, now, nack_delay);   /* the last slices of the group may be the lost ones */
+
+    memcpy(rebuilt, xor, xor_len);
+    for (uint8_t i = 0; i < num; i++)
+    {
+        Receive_slot_t* slot = Receive_slot(base + i);
+
+        if (slot == NULL)
+            return;     /* fell out of the ring */
+        if (slot->state == RECEIVE_MISSING)
+        {
+            if (missing != NULL)
+                return; /* two losses in the group, left to the NACKs */
+            missing = slot;
+            continue;
+        }
+        if (slot->state != RECEIVE_RECEIVED)
+            return;
+        if ((size_t)slot->len + 1 > xor_len)
+            return;
+        rebuilt[0] ^= slot->slice;
+        for (uint16_t j = 0; j < slot->len; j++)
+            rebuilt[1 + j] ^= slot->payload[j];
+        rebuilt_len ^= slot->len;
+    }
+    if ((missing == NULL) || ((size_t)rebuilt_len + 1 > xor_len))
+        return;
+    Receive_store(missing, rebuilt[0], &rebuilt[1], rebuilt_len);
+    g_missing--;
+    g_stats.fec++;
+}
+
+static void Receive_send_nacks(int sock, double now, double nack_retry)
+{
+    uint8_t nack[4 + 4 * RECEIVE_NACK_MAX];
+    uint8_t count = 0;
+
+    if (!g_missing)
+        return;
+    for (uint32_t seq = g_next_seq - RECEIVE_RING; seq != g_next_seq; seq++)
+    {
+        Receive_slot_t* slot = Receive_slot(seq);
+
+        if ((slot == NULL) || (slot->state != RECEIVE_MISSING) || (now < slot->due))
+            continue;
+        if (slot->tries >= RECEIVE_NACK_TRIES)
+        {
+            slot->state = RECEIVE_LOST;
+            g_stats.lost++;
+            g_missing--;
+            continue;
+        }
+        slot->tries++;
+        slot->due = now + nack_retry;
+        nack[4 + 4 * count] = (uint8_t)(seq >> 24);
+        nack[5 + 4 * count] = (uint8_t)(seq >> 16);
+        nack[6 + 4 * count] = (uint8_t)(seq >> 8);
+        nack[7 + 4 * count] = (uint8_t)seq;
+        if (++count == RECEIVE_NACK_MAX)
+            break;
+    }
+    if (!count || !g_radar_known)
+        return;
+    nack[0] = RECEIVE_NACK_MAGIC >> 8;
+    nack[1] = RECEIVE_NACK_MAGIC & 0xFF;
+    nack[2] = RECEIVE_STREAM_VERSION;
+    nack[3] = count;
+    sendto(sock, nack, 4 + 4 * count, 0, (struct sockaddr*)&g_radar, sizeof(g_radar));
+    g_stats.nack_sent++;
+}
+
+static void Receive_report(const char* what)
+{
+    unsigned long total = g_stats.received + g_stats.gaps;
+
+    printf("%-5s received:%lu injected:%lu gaps:%lu fec:%lu nack:%lu late:%lu lost:%lu dup:%lu parity:%lu "
+           "nacks sent:%lu residual loss:%.3f%%\n", what,
+           g_stats.received, g_stats.injected, g_stats.gaps, g_stats.fec, g_stats.nack, g_stats.late,
+           g_stats.lost, g_stats.duplicate, g_stats.parity, g_stats.nack_sent,
+           total ? 100.0 * (double)g_stats.lost / (double)total : 0.0);
+    fflush(stdout);
+}
+
+static void Receive_usage(void)
+{
+    fprintf(stderr, "usage: radar_receive [-s stream port] [-m stream group] [-i interface address] [-c control port]\n"
+                    "                     [-l loss %%] [-b burst] [-n nack delay ms] [-r nack retry ms] [-t seconds] [-q]\n"
+                    "  ports 1..65535, loss 0..100, burst >= 1, nack delay >= 0, nack retry > 0,\n"
+                    "  seconds >= 0 (0: until interrupted)\n");
+    exit(2);
+}
+
+/* UDP port option, the usage on anything but 1..65535 */
+static uint16_t Receive_parse_port(const char* arg)
+{
+    unsigned long value;
+    char* end;
+
+    errno = 0;
+    value = strtoul(arg, &end, 10);
+    if ((errno != 0) || (end == arg) || (*end != '\0') || (arg[0] == '-') || (value == 0) || (value > 65535))
+        Receive_usage();
+    return (uint16_t)value;
+}
+
+/* Count option, the usage on anything but 1..INT_MAX */
+static int Receive_parse_count(const char* arg)
+{
+    unsigned long value;
+    char* end;
+
+    errno = 0;
+    value = strtoul(arg, &end, 10);
+    if ((errno != 0) || (end == arg) || (*end != '\0') || (arg[0] == '-') || (value == 0) || (value > INT_MAX))
+        Receive_usage();
+    return (int)value;
+}
+
+/* Real option, the usage unless min <= value <= max, or min < value when open */
+static double Receive_parse_real(const char* arg, double min, double max, bool open)
+{
+    double value;
+    char* end;
+
+    errno = 0;
+    value = strtod(arg, &end);
+    if ((errno != 0) || (end == arg) || (*end != '\0') || !isfinite(value) ||
+        (value < min) || (open && (value == min)) || (value > max))
+        Receive_usage();
+    return value;
+}
+
+int main(int argc, char** argv)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_ANY) };
+    const char* group = NULL;
+    const char* interface = NULL;
+    uint16_t stream_port = RECEIVE_STREAM_PORT;
+    uint16_t control_port = RECEIVE_CONTROL_PORT;
+    double loss = 0;
+    int burst = 1;
+    int burst_left = 0;
+    double nack_delay = 0.010;
+    double nack_retry = 0.050;
+    double seconds = 0;
+    bool quiet = false;
+    struct pollfd fd;
+    int opt = 1;
+    double start;
+    double report;
+
+    while ((opt = getopt(argc, argv, "s:m:i:c:l:b:n:r:t:q")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': stream_port = Receive_parse_port(optarg); break;
+        case 'm': group = optarg; break;
+        case 'i': interface = optarg; break;
+        case 'c': control_port = Receive_parse_port(optarg); break;
+        case 'l': loss = Receive_parse_real(optarg, 0.0, 100.0, false) / 100.0; break;
+        case 'b': burst = Receive_parse_count(optarg); break;
+        case 'n': nack_delay = Receive_parse_real(optarg, 0.0, HUGE_VAL, false) / 1000.0; break;
+        case 'r': nack_retry = Receive_parse_real(optarg, 0.0, HUGE_VAL, true) / 1000.0; break;
+        case 't': seconds = Receive_parse_real(optarg, 0.0, HUGE_VAL, false); break;
+        case 'q': quiet = true; break;
+        default: Receive_usage();
+        }
+    }
+    if (optind < argc)
+        Receive_usage();
+    srand((unsigned)time(NULL));
+
+    fd.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    fd.events = POLLIN;
+    if (fd.fd < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+    opt = 1;
+    setsockopt(fd.fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd.fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+    addr.sin_port = htons(stream_port);
+    if (bind(fd.fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        return 1;
+    }
+    if (group != NULL)
+    {
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr.s_addr = inet_addr(group);
+        mreq.imr_interface.s_addr = interface ? inet_addr(interface) : htonl(INADDR_ANY);
+        if (setsockopt(fd.fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+            perror("IP_ADD_MEMBERSHIP");
+    }
+    printf("receiving on port %u, injected loss %.1f%% in bursts of %d\n", stream_port, loss * 100.0, burst);
+    fflush(stdout);
+
+    start = Receive_clock();
+    report = start + 1.0;
+    while ((seconds <= 0) || (Receive_clock() - start < seconds))
+    {
+        double now;
+
+        if (poll(&fd, 1, 2) > 0)
+        {
+            uint8_t buf[RECEIVE_STREAM_HEAD + RECEIVE_PARITY_HEAD + 1 + RECEIVE_PAYLOAD_MAX];
+            struct sockaddr_in source;
+            socklen_t socklen = sizeof(source);
+            ssize_t len = recvfrom(fd.fd, buf, sizeof(buf), 0, (struct sockaddr*)&source, &socklen);
+
+            now = Receive_clock();
+            if ((len < RECEIVE_STREAM_HEAD) || (Receive_get_u16(buf) != RECEIVE_STREAM_MAGIC) ||
+                (buf[2] != RECEIVE_STREAM_VERSION))
+                continue;
+            if (burst_left || ((double)rand() / RAND_MAX < loss))
+            {
+                burst_left = burst_left ? burst_left - 1 : burst - 1;
+                g_stats.injected++;
+                continue;
+            }
+            g_radar = source;
+            g_radar.sin_port = htons(control_port);
+            g_radar_known = true;
+            if (buf[28] & RECEIVE_FLAG_PARITY)
+                Receive_parity(buf, (size_t)len, now, nack_delay);
+            else
+                Receive_data(buf, (size_t)len, now, nack_delay);
+        }
+        now = Receive_clock();
+        Receive_send_nacks(fd.fd, now, nack_retry);
+        if (!quiet && (now >= report))
+        {
+            report += 1.0;
+            Receive_report("");
+        }
+    }
+    Receive_report("total");
+    return 0;
+}
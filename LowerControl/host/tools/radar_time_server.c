@@ -0,0 +1,119 @@
+/*
+ * Reference time server for the radar time sync client (main/wifi_task/time_sync.h).
+ * Answers every request with the host clock (CLOCK_REALTIME, µs since the Unix epoch) at
+ * reception, taken by the kernel when available, and just before the answer is sent.
+ * Run it on the fusion host, or on a host disciplined by NTP/PTP that every fusion host follows.
+ *
+ * usage: radar_time_server [port] [-v]
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TIME_PORT           3337    /* CONFIG_RADAR_TIME_PORT */
+#define TIME_MAGIC          0x5254  /* RADAR_TIME_MAGIC */
+#define TIME_VERSION        0x01
+#define TIME_TYPE_REQUEST   0x01
+#define TIME_TYPE_RESPONSE  0x02
+#define TIME_REQUEST_LEN    14
+#define TIME_RESPONSE_LEN   30
+
+static int64_t Time_to_us(const struct timespec* ts)
+{
+    return (int64_t)ts->tv_sec * 1000000 + ts->tv_nsec / 1000;
+}
+
+static int64_t Time_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return Time_to_us(&ts);
+}
+
+static void Time_put_i64(uint8_t* p, int64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t)((uint64_t)value >> (56 - 8 * i));
+}
+
+int main(int argc, char** argv)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_ANY) };
+    uint16_t port = TIME_PORT;
+    bool verbose = false;
+    int opt = 1;
+    int sock;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+            verbose = true;
+        else
+            port = (uint16_t)atoi(argv[i]);
+    }
+    addr.sin_port = htons(port);
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &opt, sizeof(opt)); /* kernel receive time */
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        return 1;
+    }
+    printf("time server on port %u\n", port);
+    fflush(stdout);
+
+    while (1)
+    {
+        uint8_t buf[64];
+        uint8_t control[CMSG_SPACE(sizeof(struct timespec))];
+        struct sockaddr_in source;
+        struct iovec iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+        struct msghdr msg = {
+            .msg_name = &source, .msg_namelen = sizeof(source),
+            .msg_iov = &iov, .msg_iovlen = 1,
+            .msg_control = control, .msg_controllen = sizeof(control),
+        };
+        ssize_t len = recvmsg(sock, &msg, 0);
+        int64_t t2 = Time_now_us();
+
+        if (len < 0)
+        {
+            perror("recvmsg");
+            return 1;
+        }
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPNS))
+            {
+                struct timespec ts;
+                memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                t2 = Time_to_us(&ts);
+            }
+        }
+        if ((len != TIME_REQUEST_LEN) || (((buf[0] << 8) | buf[1]) != TIME_MAGIC) ||
+            (buf[2] != TIME_VERSION) || (buf[3] != TIME_TYPE_REQUEST))
+            continue;
+
+        buf[3] = TIME_TYPE_RESPONSE;    /* sequence and t1 are echoed in place */
+        Time_put_i64(&buf[14], t2);
+        Time_put_i64(&buf[22], Time_now_us());
+        sendto(sock, buf, TIME_RESPONSE_LEN, 0, (struct sockaddr*)&source, sizeof(source));
+        if (verbose)
+            printf("%s:%u seq %u\n", inet_ntoa(source.sin_addr), ntohs(source.sin_port), (buf[4] << 8) | buf[5]);
+    }
+}
@@ -0,0 +1,485 @@
+/*
+ * Dump and render the hot-path event trace of the radar (main/diag_task/radar_trace.h).
+ * Stops the trace over the UDP control port, reads the ring of every core with function code 0x12,
+ * starts it again, then prints the events of both cores merged into one timeline.
+ * The raw dump can be saved and rendered later without the radar.
+ * A line is marked with '!' when its core was silent for longer than the gap threshold before it.
+ *
+ * usage: radar_trace -a radar address [-c control port] [-d device address] [-w dump file] [-k]
+ *                    [-g gap us] [-q]
+ *        radar_trace -f dump file [-g gap us] [-q]
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define TRACE_CONTROL_PORT      3334    /* CONFIG_RADAR_CONTROL_PORT */
+#define TRACE_FUNCODE           0x12    /* MODBUS_FUNCODE_TRACE */
+#define TRACE_CMD_STOP          0x00    /* RADAR_TRACE_CMD_STOP */
+#define TRACE_CMD_START         0x01
+#define TRACE_RECORD_LEN        12      /* RADAR_TRACE_RECORD_LEN */
+#define TRACE_CORE_MAX          2
+#define TRACE_RING_MAX          4096    /* 1 << 12, largest CONFIG_RADAR_TRACE_RING_ORDER */
+#define TRACE_TIMEOUT_MS        300
+#define TRACE_TRIES             5
+#define TRACE_FILE_MAGIC        "RTRC"
+
+/* Modbus framing, see main/communication_protocol/mod_bus.h */
+#define MODBUS_MASTER_HEAD      0x51
+#define MODBUS_SLAVE_HEAD       0x55
+#define MODBUS_SENSOR_TYPE      0x0B
+#define MODBUS_OPT_READ         0x00
+#define MODBUS_OPT_WRITE        0x01
+#define MODBUS_OPT_ERROR        0xFF
+
+typedef struct {
+    uint32_t time_us;
+    uint8_t event;
+    uint8_t core;
+    uint16_t arg0;
+    uint32_t arg1;
+    int64_t at;             /* Time relative to the newest record, once unwrapped */
+} Trace_record_t;
+
+/* What the radar holds: slot i of a core is its record n with n % ring_len == i */
+typedef struct {
+    uint8_t core_num;
+    uint16_t ring_len;
+    uint32_t head[TRACE_CORE_MAX];
+    uint8_t slots[TRACE_CORE_MAX][TRACE_RING_MAX * TRACE_RECORD_LEN];
+} Trace_dump_t;
+
+static const char* const g_event_name[] = {
+    [0x01] = "uart_rx",
+    [0x02] = "frame_parsed",
+    [0x03] = "frame_rejected",
+    [0x04] = "dispatch_begin",
+    [0x05] = "dispatch_end",
+    [0x06] = "servo",
+    [0x07] = "sensor_tx",
+    [0x08] = "sensor_rx",
+    [0x09] = "sweep_publish",
+};
+#define TRACE_EVENT_NUM (sizeof(g_event_name) / sizeof(g_event_name[0]))
+
+static Trace_dump_t g_dump;
+
+static void Trace_usage(void)
+{
+    fprintf(stderr, "usage: radar_trace -a radar address [-c control port] [-d device address] [-w dump file] [-k]\n"
+                    "                   [-g gap us] [-q]\n"
+                    "       radar_trace -f dump file [-g gap us] [-q]\n"
+                    "  control port 1..65535, device address 0..0xFFFF, gap 0..4294967295 us (0: none marked)\n");
+    exit(2);
+}
+
+/* Unsigned option in the given base (0: C prefixes), the usage unless min <= value <= max */
+static unsigned long Trace_parse_unsigned(const char* arg, int base, unsigned long min, unsigned long max)
+{
+    unsigned long value;
+    char* end;
+
+    errno = 0;
+    value = strtoul(arg, &end, base);
+    if ((errno != 0) || (end == arg) || (*end != '\0') || (arg[0] == '-') || (value < min) || (value > max))
+        Trace_usage();
+    return value;
+}
+
+static uint16_t Trace_get_u16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t Trace_get_u32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void Trace_put_u16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static uint16_t Trace_checksum(const uint8_t* buf, size_t len)
+{
+    uint16_t sum = 0;
+    while (len--)
+        sum += *buf++;
+    return sum;
+}
+
+/*
+ * One request, answered within TRACE_TIMEOUT_MS or sent again: a lost reply of a command is harmless,
+ * stop, start and page reads can all be repeated. Returns the data length of a read answer,
+ * 0 for a write acknowledge, -1 on error.
+ */
+static int Trace_request(int sock, uint16_t address, uint8_t opt, const uint8_t* data, uint8_t len, uint8_t* answer)
+{
+    uint8_t frame[9 + 255];
+    size_t frame_len = 7;
+
+    frame[0] = MODBUS_MASTER_HEAD;
+    frame[1] = MODBUS_SENSOR_TYPE;
+    Trace_put_u16(&frame[2], address);
+    frame[4] = opt;
+    frame[5] = TRACE_FUNCODE;
+    frame[6] = len;
+    if (opt == MODBUS_OPT_WRITE)
+    {
+        memcpy(&frame[7], data, len);
+        frame_len += len;
+    }
+    Trace_put_u16(&frame[frame_len], Trace_checksum(frame, frame_len));
+    frame_len += 2;
+
+    for (int tries = 0; tries < TRACE_TRIES; tries++)
+    {
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+        uint8_t buf[512];
+        ssize_t n;
+
+        if (send(sock, frame, frame_len, 0) != (ssize_t)frame_len)
+        {
+            perror("send");
+            return -1;
+        }
+        while (poll(&pfd, 1, TRACE_TIMEOUT_MS) > 0)
+        {
+            n = recv(sock, buf, sizeof(buf), 0);
+            if ((n < 8) || (buf[0] != MODBUS_SLAVE_HEAD) || (buf[1] != MODBUS_SENSOR_TYPE))
+                continue;   /* not a Modbus answer */
+            if (buf[2] == MODBUS_OPT_ERROR)
+            {
+                fprintf(stderr, "radar_trace: error status 0x%02X (trace compiled out?)\n", buf[5]);
+                return -1;
+            }
+            if ((buf[4] == MODBUS_OPT_WRITE) && (buf[5] == TRACE_FUNCODE))
+                return 0;
+            if ((n >= 10) && (buf[4] == MODBUS_OPT_READ) && (buf[6] == TRACE_FUNCODE) && (n >= 10 + buf[7]) &&
+                (Trace_get_u16(&buf[8 + buf[7]]) == Trace_checksum(buf, 8 + buf[7])))
+            {
+                memcpy(answer, &buf[8], buf[7]);
+                return buf[7];
+            }
+        }
+    }
+    fprintf(stderr, "radar_trace: no answer\n");
+    return -1;
+}
+
+static int Trace_command(int sock, uint16_t address, uint8_t cmd)
+{
+    uint8_t answer[255];
+    return Trace_request(sock, address, MODBUS_OPT_WRITE, &cmd, 1, answer);
+}
+
+// Stop the trace, read the information and every slot of every core
+static int Trace_fetch(int sock, uint16_t address, bool keep_stopped)
+{
+    uint8_t answer[255];
+    int len;
+
+    if (Trace_command(sock, address, TRACE_CMD_STOP) < 0)
+        return -1;
+    len = Trace_request(sock, address, MODBUS_OPT_READ, NULL, 0, answer);
+    if (len < 5)
+        return -1;
+    g_dump.core_num = answer[1];
+    g_dump.ring_len = Trace_get_u16(&answer[2]);
+    if ((g_dump.core_num == 0) || (g_dump.core_num > TRACE_CORE_MAX) || (g_dump.ring_len > TRACE_RING_MAX) ||
+        (answer[4] != TRACE_RECORD_LEN) || (len < 5 + 4 * g_dump.core_num))
+    {
+        fprintf(stderr, "radar_trace: unexpected trace information\n");
+        return -1;
+    }
+    for (uint8_t core = 0; core < g_dump.core_num; core++)
+        g_dump.head[core] = Trace_get_u32(&answer[5 + 4 * core]);
+
+    for (uint8_t core = 0; core < g_dump.core_num; core++)
+    {
+        uint16_t slot = 0;
+        while (slot < g_dump.ring_len)
+        {
+            uint8_t page[3] = { core, (uint8_t)(slot >> 8), (uint8_t)slot };
+            uint8_t num;
+
+            len = Trace_request(sock, address, MODBUS_OPT_WRITE, page, sizeof(page), answer);
+            if ((len < 4) || (answer[0] != core) || (Trace_get_u16(&answer[1]) != slot))
+                return -1;
+            num = answer[3];
+            if ((num == 0) || (len < 4 + num * TRACE_RECORD_LEN) || (slot + num > g_dump.ring_len))
+                return -1;
+            memcpy(&g_dump.slots[core][slot * TRACE_RECORD_LEN], &answer[4], (size_t)num * TRACE_RECORD_LEN);
+            slot += num;
+        }
+    }
+    if (!keep_stopped)
+        Trace_command(sock, address, TRACE_CMD_START);
+    return 0;
+}
+
+// File: magic(4) core_num(1) ring_len(2) head of each core(4) then the slots of each core, as on the wire
+static int Trace_save(const char* path)
+{
+    FILE* f = fopen(path, "wb");
+    uint8_t head[7 + 4 * TRACE_CORE_MAX];
+
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    memcpy(head, TRACE_FILE_MAGIC, 4);
+    head[4] = g_dump.core_num;
+    Trace_put_u16(&head[5], g_dump.ring_len);
+    for (uint8_t core = 0; core < g_dump.core_num; core++)
+    {
+        head[7 + 4 * core] = (uint8_t)(g_dump.head[core] >> 24);
+        head[8 + 4 * core] = (uint8_t)(g_dump.head[core] >> 16);
+        head[9 + 4 * core] = (uint8_t)(g_dump.head[core] >> 8);
+        head[10 + 4 * core] = (uint8_t)g_dump.head[core];
+    }
+    fwrite(head, 1, 7 + 4 * g_dump.core_num, f);
+    for (uint8_t core = 0; core < g_dump.core_num; core++)
+        fwrite(g_dump.slots[core], TRACE_RECORD_LEN, g_dump.ring_len, f);
+    return fclose(f);
+}
+
+static int Trace_load(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    uint8_t head[7 + 4 * TRACE_CORE_MAX];
+    int ret = -1;
+
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    if ((fread(head, 1, 7, f) == 7) && (memcmp(head, TRACE_FILE_MAGIC, 4) == 0))
+    {
+        g_dump.core_num = head[4];
+        g_dump.ring_len = Trace_get_u16(&head[5]);
+        if ((g_dump.core_num > 0) && (g_dump.core_num <= TRACE_CORE_MAX) && (g_dump.ring_len <= TRACE_RING_MAX) &&
+            (fread(&head[7], 4, g_dump.core_num, f) == g_dump.core_num))
+        {
+            ret = 0;
+            for (uint8_t core = 0; core < g_dump.core_num; core++)
+            {
+                g_dump.head[core] = Trace_get_u32(&head[7 + 4 * core]);
+                if (fread(g_dump.slots[core], TRACE_RECORD_LEN, g_dump.ring_len, f) != g_dump.ring_len)
+                    ret = -1;
+            }
+        }
+    }
+    if (ret < 0)
+        fprintf(stderr, "%s: not a radar trace dump\n", path);
+    fclose(f);
+    return ret;
+}
+
+static int Trace_compare(const void* a, const void* b)
+{
+    const Trace_record_t* ra = a;
+    const Trace_record_t* rb = b;
+    return (ra->at > rb->at) - (ra->at < rb->at);
+}
+
+// Records still in the rings, oldest first on each core, then merged by time
+static size_t Trace_collect(Trace_record_t* records)
+{
+    size_t count = 0;
+    uint32_t newest = 0;
+    bool any = false;
+
+    for (uint8_t core = 0; core < g_dump.core_num; core++)
+    {
+        uint32_t head = g_dump.head[core];
+        uint32_t num = (head < g_dump.ring_len) ? head : g_dump.ring_len;
+
+        for (uint32_t n = head - num; n != head; n++)
+        {
+            const uint8_t* p = &g_dump.slots[core][(n % g_dump.ring_len) * TRACE_RECORD_LEN];
+            Trace_record_t* record = &records[count++];
+
+            record->time_us = Trace_get_u32(&p[0]);
+            record->event   = p[4];
+            record->core    = p[5];
+            record->arg0    = Trace_get_u16(&p[6]);
+            record->arg1    = Trace_get_u32(&p[8]);
+            if (!any || ((int32_t)(record->time_us - newest) > 0))
+                newest = record->time_us;
+            any = true;
+        }
+    }
+    /* 32-bit µs wraps every 71 minutes, the rings span much less than half of that */
+    for (size_t i = 0; i < count; i++)
+        records[i].at = (int32_t)(records[i].time_us - newest);
+    qsort(records, count, sizeof(records[0]), Trace_compare);
+    return count;
+}
+
+static void Trace_describe(const Trace_record_t* record, char* text, size_t size)
+{
+    const char* name = (record->event < TRACE_EVENT_NUM) ? g_event_name[record->event] : NULL;
+
+    switch (record->event)
+    {
+    case 0x01:
+        snprintf(text, size, "%s port %u, %u bytes", name, record->arg0, record->arg1);
+        break;
+    case 0x02:
+    case 0x04:
+    case 0x05:
+        snprintf(text, size, "%s fun 0x%02X %s", name, record->arg0 >> 8,
+                 (record->arg0 & 0xFF) == MODBUS_OPT_WRITE ? "write" : "read");
+        if (record->event == 0x02)
+            snprintf(text + strlen(text), size - strlen(text), ", %u bytes", record->arg1);
+        break;
+    case 0x03:
+        snprintf(text, size, "%s %s, %u bytes", name, record->arg0 == 3 ? "frame error" : "busy", record->arg1);
+        break;
+    case 0x06:
+        snprintf(text, size, "%s %u deg", name, record->arg0);
+        break;
+    case 0x07:
+        snprintf(text, size, "%s fun 0x%02X addr 0x%04X", name, record->arg0, record->arg1);
+        break;
+    case 0x08:
+        if (record->arg0 == 0)
+            snprintf(text, size, "%s ok %u", name, record->arg1);
+        else
+            snprintf(text, size, "%s error %u", name, record->arg0);
+        break;
+    case 0x09:
+        snprintf(text, size, "%s seq %u, %u points", name, record->arg1, record->arg0);
+        break;
+    default:
+        snprintf(text, size, "event 0x%02X %u %u", record->event, record->arg0, record->arg1);
+        break;
+    }
+}
+
+// One line per event, the cores in their own column, and the silence of the core before it
+static void Trace_render(const Trace_record_t* records, size_t count, uint32_t gap_us, bool quiet)
+{
+    int64_t last[TRACE_CORE_MAX];
+    bool seen[TRACE_CORE_MAX] = { false };
+    unsigned long events[256] = { 0 };
+    unsigned long stalls = 0;
+    char text[96];
+
+    if (count == 0)
+    {
+        printf("no events\n");
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        const Trace_record_t* record = &records[i];
+        uint8_t core = (record->core < TRACE_CORE_MAX) ? record->core : 0;
+        int64_t since = seen[core] ? record->at - last[core] : 0;
+        bool stall = seen[core] && (gap_us > 0) && (since > gap_us);
+
+        events[record->event]++;
+        stalls += stall;
+        if (!quiet || stall)
+        {
+            Trace_describe(record, text, sizeof(text));
+            printf("%c %12.3f ms %9lld us  %*s%s\n", stall ? '!' : ' ', (double)(record->at - records[0].at) / 1000.0,
+                   (long long)since, core * 40, "", text);
+        }
+        last[core] = record->at;
+        seen[core] = true;
+    }
+
+    printf("\n%zu events over %.3f ms", count, (double)(records[count - 1].at - records[0].at) / 1000.0);
+    if (gap_us)
+        printf(", %lu gaps over %u us", stalls, gap_us);
+    printf("\n");
+    for (unsigned e = 0; e < 256; e++)
+    {
+        if (events[e])
+            printf("  %-16s %lu\n", (e < TRACE_EVENT_NUM && g_event_name[e]) ? g_event_name[e] : "unknown", events[e]);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* radar = NULL;
+    const char* save = NULL;
+    const char* load = NULL;
+    uint16_t port = TRACE_CONTROL_PORT;
+    uint16_t address = 0x0001;
+    uint32_t gap_us = 0;
+    bool keep_stopped = false;
+    bool quiet = false;
+    Trace_record_t* records;
+    size_t count;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:c:d:w:kf:g:q")) != -1)
+    {
+        switch (opt)
+        {
+        case 'a': radar = optarg; break;
+        case 'c': port = (uint16_t)Trace_parse_unsigned(optarg, 10, 1, 65535); break;
+        case 'd': address = (uint16_t)Trace_parse_unsigned(optarg, 0, 0, 0xFFFF); break;
+        case 'w': save = optarg; break;
+        case 'k': keep_stopped = true; break;
+        case 'f': load = optarg; break;
+        case 'g': gap_us = (uint32_t)Trace_parse_unsigned(optarg, 10, 0, UINT32_MAX); break;
+        case 'q': quiet = true; break;
+        default: Trace_usage();
+        }
+    }
+    if (((radar == NULL) == (load == NULL)) || (optind < argc))
+        Trace_usage();
+
+    if (load)
+    {
+        if (Trace_load(load) < 0)
+            return 1;
+    }
+    else
+    {
+        struct sockaddr_in dest = { .sin_family = AF_INET, .sin_port = htons(port) };
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+        if (inet_pton(AF_INET, radar, &dest.sin_addr) != 1)
+        {
+            fprintf(stderr, "radar_trace: bad address %s\n", radar);
+            return 1;
+        }
+        if ((sock < 0) || (connect(sock, (struct sockaddr*)&dest, sizeof(dest)) < 0))
+        {
+            perror("connect");
+            return 1;
+        }
+        if (Trace_fetch(sock, address, keep_stopped) < 0)
+            return 1;
+        close(sock);
+        if (save && (Trace_save(save) < 0))
+            return 1;
+    }
+
+    records = calloc((size_t)g_dump.core_num * g_dump.ring_len + 1, sizeof(records[0]));
+    if (records == NULL)
+        return 1;
+    count = Trace_collect(records);
+    Trace_render(records, count, gap_us, quiet);
+    free(records);
+    return 0;
+}